@@ -1,5 +0,0 @@
-C:/VulkanSDK/1.3.211.0/Bin/glslc.exe assets/shaders/simple_shader.vert -o assets/shaders/simple_shader.vert.spv
-C:/VulkanSDK/1.3.211.0/Bin/glslc.exe assets/shaders/simple_shader.frag -o assets/shaders/simple_shader.frag.spv
-C:/VulkanSDK/1.3.211.0/Bin/glslc.exe assets/shaders/point_light.vert -o assets/shaders/point_light.vert.spv
-C:/VulkanSDK/1.3.211.0/Bin/glslc.exe assets/shaders/point_light.frag -o assets/shaders/point_light.frag.spv
-pause
\ No newline at end of file
@@ -0,0 +1,18 @@
+// shared by every shader that reads the global uniform buffer
+// must match GlobalUbo and MAX_LIGHTS in ZFrameInfo.h
+#define MAX_LIGHTS 10
+
+struct PointLight
+{
+    vec4 position;
+    vec4 color;
+};
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+    mat4 projection;
+    mat4 view;
+    mat4 invView;
+    vec4 ambientLightColor; // w is intensity
+    PointLight pointLights[MAX_LIGHTS];
+    int numLights;
+} ubo;
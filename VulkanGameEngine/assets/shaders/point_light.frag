@@ -1,24 +1,12 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
 layout(location = 0) in vec2 fragOffset;
 
 // output color to the first (and only) framebuffer at index 0
 layout(location = 0) out vec4 outColor;
 
-struct PointLight
-{
-    vec4 position;
-    vec4 color;
-};
-
-layout(set = 0, binding = 0) uniform GlobalUbo {
-    mat4 projection;
-    mat4 view;
-    mat4 invView;
-    vec4 ambientLightColor; // w is intensity
-    PointLight pointLights[10];
-    int numLights;
-} ubo;
+#include "global_ubo.glsl"
 
 layout(push_constant) uniform Push {
     vec4 position;
@@ -1,4 +1,16 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
+
+// USE_FP16 is defined for the reduced-precision variant (needs shaderFloat16):
+// light accumulation and attenuation run in fp16, positions and the specular power stay in fp32
+#ifdef USE_FP16
+#extension GL_EXT_shader_explicit_arithmetic_types_float16 : require
+#define light_float float16_t
+#define light_vec3 f16vec3
+#else
+#define light_float float
+#define light_vec3 vec3
+#endif
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec3 fragPosWorld;
@@ -7,20 +19,12 @@ layout(location = 2) in vec3 fragNormalWorld;
 // output color to the first (and only) framebuffer at index 0
 layout(location = 0) out vec4 outColor;
 
-struct PointLight
-{
-    vec4 position;
-    vec4 color;
-};
-
-layout(set = 0, binding = 0) uniform GlobalUbo {
-    mat4 projection;
-    mat4 view;
-    mat4 invView;
-    vec4 ambientLightColor; // w is intensity
-    PointLight pointLights[10];
-    int numLights;
-} ubo;
+#include "global_ubo.glsl"
+
+// specialization constants, baked in when the pipeline is created
+// number of lights to shade; a negative value reads ubo.numLights at runtime instead
+layout(constant_id = 0) const int LIGHT_COUNT = -1;
+layout(constant_id = 1) const bool ENABLE_SPECULAR = true;
 
 layout(push_constant) uniform Push {
     mat4 modelMatrix; 
@@ -28,28 +32,34 @@ layout(push_constant) uniform Push {
 } push;
 
 void main() {
-    vec3 diffuseLight = ubo.ambientLightColor.xyz * ubo.ambientLightColor.w;
-    vec3 specularLight = vec3(0.0);
+    light_vec3 diffuseLight = light_vec3(ubo.ambientLightColor.xyz * ubo.ambientLightColor.w);
+    light_vec3 specularLight = light_vec3(0.0);
     vec3 surfaceNormal = normalize(fragNormalWorld);
     vec3 cameraPosWorld = ubo.invView[3].xyz;
     vec3 viewDirection = normalize(cameraPosWorld - fragPosWorld);
-    for(int i = 0; i < ubo.numLights; i++)
+    // with a constant light count the driver can fully unroll this loop
+    int lightCount = LIGHT_COUNT < 0 ? ubo.numLights : LIGHT_COUNT;
+    for(int i = 0; i < lightCount; i++)
     {
         PointLight light = ubo.pointLights[i]; 
         vec3 directionToLight = light.position.xyz - fragPosWorld;
-        float attenuation = 1.0 / dot(directionToLight, directionToLight);
+        light_float attenuation = light_float(1.0) / light_float(dot(directionToLight, directionToLight));
         directionToLight = normalize(directionToLight);
 
-        float cosAngIncidence = max(dot(surfaceNormal, directionToLight), 0);
-        vec3 intensity = light.color.xyz * light.color.w * attenuation;
+        light_float cosAngIncidence = light_float(max(dot(surfaceNormal, directionToLight), 0));
+        light_vec3 intensity = light_vec3(light.color.xyz * light.color.w) * attenuation;
         diffuseLight += intensity * cosAngIncidence;
 
         // specular lighting 
-        vec3 halfAngle = normalize(directionToLight + viewDirection);
-        float blinnTerm = dot(surfaceNormal, halfAngle);
-        blinnTerm = clamp(blinnTerm, 0, 1);
-        blinnTerm = pow(blinnTerm, 512.0);
-        specularLight += intensity * blinnTerm;
+        if (ENABLE_SPECULAR)
+        {
+            vec3 halfAngle = normalize(directionToLight + viewDirection);
+            float blinnTerm = dot(surfaceNormal, halfAngle);
+            blinnTerm = clamp(blinnTerm, 0, 1);
+            // fp16 would flush most of this to zero
+            blinnTerm = pow(blinnTerm, 512.0);
+            specularLight += intensity * light_float(blinnTerm);
+        }
     }
-    outColor = vec4(diffuseLight * fragColor + specularLight * fragColor, 1.0);
+    outColor = vec4(vec3(diffuseLight) * fragColor + vec3(specularLight) * fragColor, 1.0);
 }
\ No newline at end of file
@@ -1,5 +1,5 @@
-project "VulkanGameEngine"
-	kind "ConsoleApp"
+-- the settings every executable built from the engine's sources shares
+function engineProject()
 	language "C++"
 	cppdialect "C++20"
 	staticruntime "off"
@@ -19,7 +19,9 @@ project "VulkanGameEngine"
 
 	libdirs
 	{
-		"vendor/libs"
+		"vendor/libs",
+		-- shaderc and SPIRV-Tools ship with the Vulkan SDK
+		"$(VULKAN_SDK)/Lib"
 	}
 
 	includedirs
@@ -30,16 +32,12 @@ project "VulkanGameEngine"
 
 	links 
 	{
-		"glfw3.lib", "vulkan-1.lib"
+		"glfw3.lib", "vulkan-1.lib", "shaderc_shared.lib", "SPIRV-Tools-opt.lib", "SPIRV-Tools.lib"
 	}
 
 	filter "system:windows"
 		systemversion "latest"
 
-	prebuildcommands {
-		"assets/shaders/compile.bat"
-	}
-
 	filter "configurations:Debug"
 		defines "GLCORE_DEBUG"
 		runtime "Debug"
@@ -49,3 +47,37 @@ project "VulkanGameEngine"
 		defines "GLCORE_RELEASE"
 		runtime "Release"
         optimize "on"
+
+	-- back to the project scope, so the caller's settings apply to every configuration
+	filter {}
+end
+
+project "VulkanGameEngine"
+	kind "ConsoleApp"
+	engineProject()
+
+-- replays a capture made with --capture on a headless device and reports its timing
+project "ZReplay"
+	kind "ConsoleApp"
+	engineProject()
+	-- the engine's sources, with the tool's main instead of the app's
+	files { "tools/replay/**.cpp" }
+	removefiles { "src/entry.cpp" }
+	includedirs { "tools/common" }
+
+-- renders synthetic scenes for a fixed number of frames and reports (or compares against a baseline) their timing;
+-- tools/common holds the report and baseline helpers it shares with ZReplay and ZMicrobench
+project "ZBenchmark"
+	kind "ConsoleApp"
+	engineProject()
+	files { "tools/benchmark/**.cpp" }
+	removefiles { "src/entry.cpp" }
+	includedirs { "tools/common" }
+
+-- times CPU hot paths (transforms, model loading, hashing, light sorting, descriptor writes) without a GPU
+project "ZMicrobench"
+	kind "ConsoleApp"
+	engineProject()
+	files { "tools/microbench/**.cpp" }
+	removefiles { "src/entry.cpp" }
+	includedirs { "tools/common" }
@@ -6,17 +6,47 @@
 #include "ZCamera.h"
 #include "KeyboardMovementController.h"
 #include "ZBuffer.h"
+#include "ZSwapChainBenchmark.h"
+#include "ZFrameLimiter.h"
+#include "ZParallelRecorder.h"
+#include "ZRenderGraph.h"
+#include "ZGpuProfiler.h"
+#include "ZCpuProfiler.h"
+#include "ZPipelineStatistics.h"
+#include "ZCommandCapture.h"
+#include "ZCameraPath.h"
 
 namespace ZZX
 {
-	FirstApp::FirstApp()
+	// how far the scene advances per frame when headless (no real time to follow)
+	static constexpr float HEADLESS_FRAME_TIME = 1.f / 60.f;
+
+	// input-to-present latency of the frames measured so far
+	struct LatencyStats
 	{
+		uint32_t sampleCount = 0;
+		double totalMs = 0.0;
+		double maxMs = 0.0;
+
+		void add(double latencyMs)
+		{
+			sampleCount++;
+			totalMs += latencyMs;
+			maxMs = std::max(maxMs, latencyMs);
+		}
+	};
+
+	FirstApp::FirstApp(const AppOptions& options)
+		: m_options{options}
+	{
+		ZCpuProfiler::setEnabled(!m_options.tracePath.empty());
+		ZCpuProfiler::setThreadName("main");
 		m_globalPool = ZDescriptorPool::Builder(m_zDevice)
 		               .setMaxSets(ZSwapChain::MAX_FRAMES_IN_FLIGHT)
 		               .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, ZSwapChain::MAX_FRAMES_IN_FLIGHT)
 		               .build();
 
-		loadGameObjects();
+		loadGameObjects(m_options.scene);
 	}
 
 	FirstApp::~FirstApp()
@@ -25,6 +55,20 @@ namespace ZZX
 
 	void FirstApp::run()
 	{
+		bool supportsFp16 = m_zDevice.getCapabilities().shaderFloat16;
+		if (m_options.compareFp16 && (!supportsFp16 || !m_zRenderer.supportsCapture()))
+		{
+			std::cout << "Cannot compare fp16 lighting: "
+				<< (supportsFp16 ? "swap chain images cannot be captured" : "device does not support shaderFloat16")
+				<< '\n';
+			return;
+		}
+		if (!m_options.dumpFrames.empty() && !m_zRenderer.supportsCapture())
+		{
+			std::cout << "Cannot dump frames: swap chain images cannot be captured\n";
+			return;
+		}
+
 		std::vector<std::unique_ptr<ZBuffer>> uboBuffers(ZSwapChain::MAX_FRAMES_IN_FLIGHT);
 		for (int i = 0; i < uboBuffers.size(); i++)
 		{
@@ -48,13 +92,71 @@ namespace ZZX
 				.build(globalDescriptorSets[i]);
 		}
 
+		// the scene's light count never changes, so bake it into the shader and let the driver unroll the light loop
+		ShadingProfile shadingProfile{};
+		shadingProfile.lightCount = static_cast<int32_t>(std::count_if(m_gameObjects.begin(),
+		                                                               m_gameObjects.end(),
+		                                                               [](const auto& kv)
+		                                                               {
+			                                                               return kv.second.m_pointLight != nullptr;
+		                                                               }));
+		// use fp16 lighting wherever it is available; the comparison starts from the fp32 reference
+		shadingProfile.reducedPrecision = supportsFp16 && !m_options.compareFp16;
 		SimpleRenderSystem simpleRenderSystem{
-			m_zDevice, m_zRenderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout()
+			m_zDevice, m_pipelineRegistry, m_zRenderer.getSwapChainRenderTarget(), *globalSetLayout, shadingProfile
 		};
 
 		PointLightSystem pointLightSystem{
-			m_zDevice, m_zRenderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout()
+			m_zDevice, m_pipelineRegistry, m_zRenderer.getSwapChainRenderTarget(), *globalSetLayout
 		};
+		simpleRenderSystem.setStaticCaching(m_options.cacheStaticObjects);
+		ZParallelRecorder parallelRecorder{m_zDevice, m_recordingPool};
+		// statistics queries would have to be inherited by secondary command buffers, and captures need the
+		// commands in order, so both mean recording every draw on the main thread
+		bool serialRecording = m_options.serialRecording || m_options.pipelineStatistics ||
+			!m_options.capturePath.empty();
+		std::optional<ZCommandCapture> commandCapture;
+		if (!m_options.capturePath.empty())
+		{
+			commandCapture.emplace(m_pipelineRegistry, m_zRenderer.getSwapChainExtent());
+		}
+		bool useRenderGraph = m_options.useRenderGraph && m_zRenderer.usesDynamicRendering() &&
+			m_zDevice.getCapabilities().synchronization2;
+		std::optional<ZRenderGraph> renderGraph;
+		if (useRenderGraph)
+		{
+			renderGraph.emplace(m_zDevice);
+		}
+		bool isRenderGraphPrinted = false;
+		// GPU time of the frame and its passes, read back a few frames later
+		ZGpuProfiler gpuProfiler{m_zDevice};
+		// when each frame in flight was submitted, to place its GPU scopes on the CPU trace
+		std::array<std::pair<uint64_t, ZCpuProfiler::Clock::time_point>, ZSwapChain::MAX_FRAMES_IN_FLIGHT> submitTimes{};
+		// how much work each render system gives the GPU, read back like the GPU times
+		std::optional<ZPipelineStatistics> pipelineStatistics;
+		if (m_options.pipelineStatistics)
+		{
+			pipelineStatistics.emplace(m_zDevice);
+		}
+		auto beginStatistics = [&](VkCommandBuffer commandBuffer, const std::string& name)
+		{
+			return pipelineStatistics
+				       ? pipelineStatistics->beginScope(commandBuffer, name)
+				       : ZPipelineStatistics::INVALID_SCOPE;
+		};
+		auto endStatistics = [&](VkCommandBuffer commandBuffer, ZPipelineStatistics::ScopeId scope)
+		{
+			if (pipelineStatistics)
+			{
+				pipelineStatistics->endScope(commandBuffer, scope);
+			}
+		};
+		uint64_t lastTracedGpuFrame = 0;
+		uint64_t lastSampledGpuFrame = 0;
+		m_runStats = {};
+		// CPU time spent recording the render pass, to compare serial and parallel recording
+		double recordingMs = 0.0;
+		size_t reusedCommandBuffers = 0;
 
 		ZCamera camera{};
 		camera.setViewTarget(glm::vec3{-1.f, -2.f, 2.f}, glm::vec3{0.0f, 0.f, 2.5f});
@@ -64,24 +166,113 @@ namespace ZZX
 		viewerObject.m_transform.translation.z = -2.5f;
 
 		KeyboardMovementController cameraController{};
+		std::optional<ZCameraPath> cameraPath;
+		if (!m_options.cameraPath.empty())
+		{
+			auto pathType = ZCameraPath::typeFromName(m_options.cameraPath);
+			if (!pathType)
+			{
+				throw std::runtime_error("unknown camera path " + m_options.cameraPath);
+			}
+			cameraPath.emplace(*pathType, m_sceneRadius);
+		}
+		// how far the scene has advanced, which is where the camera is on its path
+		float sceneTime = 0.f;
 		auto currentTime = std::chrono::high_resolution_clock::now();
-
-		while (!m_zWindow.shouldClose())
+		float frameTime = 0.f;
+		// poll events and move the camera; returns when the input was sampled
+		auto sampleInput = [&]()
 		{
-			glfwPollEvents();
+			if (!m_zWindow.isHeadless())
+			{
+				ZZX_PROFILE_SCOPE("poll events");
+				glfwPollEvents();
+			}
+			auto inputTime = ZSwapChainBenchmark::Clock::now();
 
 			auto newTime = std::chrono::high_resolution_clock::now();
-			auto frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
+			frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
 			currentTime = newTime;
+			if (m_options.compareFp16)
+			{
+				// both captures must show the exact same scene
+				frameTime = 0.f;
+			}
+			else if (m_zWindow.isHeadless())
+			{
+				// the same frame always shows the same scene, however fast the device is
+				frameTime = HEADLESS_FRAME_TIME;
+			}
 
-			cameraController.moveInPlaneXZ(m_zWindow.getGLFWWindow(), frameTime, viewerObject);
+			sceneTime += frameTime;
+			if (cameraPath)
+			{
+				viewerObject.m_transform = cameraPath->at(sceneTime);
+			}
+			else if (!m_zWindow.isHeadless())
+			{
+				cameraController.moveInPlaneXZ(m_zWindow.getGLFWWindow(), frameTime, viewerObject);
+			}
 			camera.setViewYXZ(viewerObject.m_transform.translation, viewerObject.m_transform.rotation);
 			float aspect = m_zRenderer.getAspectRatio();
 			camera.setPerspectiveProjection(glm::radians(50.f), aspect, 0.1f, 100.f);
-			 
-			if (auto commandBuffer = m_zRenderer.beginFrame())
+			return inputTime;
+		};
+
+		ZFrameLimiter frameLimiter{m_options.maxFramesPerSecond};
+		LatencyStats latency{};
+		// when input was sampled for the last frame submitted
+		std::optional<ZSwapChainBenchmark::Clock::time_point> previousInputTime;
+		uint32_t lastUniquePipelines = 0;
+		uint32_t framesRendered = 0;
+		auto startTime = std::chrono::high_resolution_clock::now();
+		// whether the capture in flight should be written to a PNG
+		bool isDumpRequested = false;
+		// the fp32 frame the fp16 one is compared against
+		std::optional<ImageData> referenceImage;
+		std::optional<ZSwapChainBenchmark> benchmark;
+		if (m_options.benchmarkSwapChain)
+		{
+			benchmark.emplace(m_zRenderer.supportsPresentWait() && !m_zRenderer.isHeadless()
+				                  ? ZSwapChainBenchmark::LatencyKind::INPUT_TO_PRESENT
+				                  : ZSwapChainBenchmark::LatencyKind::INPUT_TO_SLOT_REUSE,
+			                  m_options.benchmarkSecondsPerConfig);
+			m_zRenderer.setSwapChainSettings(benchmark->getSettings());
+		}
+
+		while (!m_zWindow.shouldClose())
+		{
+			ZZX_PROFILE_SCOPE("frame");
+			auto frameStart = std::chrono::steady_clock::now();
+			VkCommandBuffer commandBuffer;
+			ZSwapChainBenchmark::Clock::time_point inputTime;
+			if (m_options.lowLatency)
+			{
+				// do all the blocking first (display, frame limiter, GPU), then sample input right before recording
+				if (m_zRenderer.waitForPreviousPresent() && previousInputTime)
+				{
+					latency.add(std::chrono::duration<double, std::milli>(
+						ZSwapChainBenchmark::Clock::now() - *previousInputTime).count());
+				}
+				frameLimiter.wait();
+				commandBuffer = m_zRenderer.beginFrame();
+				inputTime = sampleInput();
+			}
+			else
+			{
+				frameLimiter.wait();
+				inputTime = sampleInput();
+				commandBuffer = m_zRenderer.beginFrame();
+			}
+
+			if (commandBuffer)
 			{
+				m_pipelineRegistry.beginFrame();
 				int frameIndex = m_zRenderer.getFrameIndex();
+				if (benchmark)
+				{
+					benchmark->recordFrame(frameIndex, inputTime);
+				}
 				FrameInfo frameInfo{
 					frameIndex,
 					frameTime,
@@ -90,51 +281,416 @@ namespace ZZX
 					globalDescriptorSets[frameIndex],
 					m_gameObjects
 				};
+				bool isCapturing = commandCapture && commandCapture->frameCount() < m_options.captureFrameCount;
+				if (isCapturing)
+				{
+					commandCapture->beginFrame();
+					frameInfo.capture = &*commandCapture;
+				}
 				// update 
 				GlobalUbo ubo{};
+				{
+					ZZX_PROFILE_SCOPE("update systems");
+					pointLightSystem.update(frameInfo, ubo);
+					if (m_options.scene == "synthetic")
+					{
+						ZSceneGenerator::animate(m_gameObjects, frameTime);
+					}
+				}
+
+				// frames drawn with the fallback pipeline are not what we want to measure
+				if (m_options.compareFp16 && simpleRenderSystem.isPipelineReady())
+				{
+					m_zRenderer.requestCapture();
+				}
+				if (std::ranges::find(m_options.dumpFrames, framesRendered) != m_options.dumpFrames.end())
+				{
+					m_zRenderer.requestCapture();
+					isDumpRequested = true;
+				}
+
+				// render
+				auto recordingStart = ZCpuProfiler::Clock::now();
+				gpuProfiler.beginFrame(commandBuffer, frameIndex, m_zRenderer.currentFrameValue());
+				// beginFrame just read back the last frame that used this index
+				auto [submittedValue, submitTime] = submitTimes[frameIndex];
+				if (gpuProfiler.getLastResolvedFrameValue() != lastTracedGpuFrame &&
+					gpuProfiler.getLastResolvedFrameValue() == submittedValue)
+				{
+					ZCpuProfiler::addGpuFrame(gpuProfiler.getLastResolvedFrame(), submitTime);
+					lastTracedGpuFrame = submittedValue;
+				}
+				if (gpuProfiler.getLastResolvedFrameValue() != lastSampledGpuFrame)
+				{
+					lastSampledGpuFrame = gpuProfiler.getLastResolvedFrameValue();
+					for (const auto& scope : gpuProfiler.getLastResolvedFrame())
+					{
+						if (scope.name == "frame")
+						{
+							m_runStats.gpuFrameMs.push_back(static_cast<double>(scope.endNs - scope.beginNs) / 1e6);
+						}
+					}
+				}
+				if (pipelineStatistics)
+				{
+					pipelineStatistics->beginFrame(commandBuffer, frameIndex, m_zRenderer.currentFrameValue());
+				}
+				auto frameScope = gpuProfiler.beginScope(commandBuffer, "frame");
+				if (renderGraph)
+				{
+					if (!serialRecording)
+					{
+						parallelRecorder.beginFrame(m_zRenderer);
+					}
+					renderGraph->reset(frameIndex);
+					auto color = m_zRenderer.importSwapChainImage(*renderGraph);
+					// the swap chain allocates depth images anyway, for the paths without a graph
+					auto depth = m_zRenderer.importSwapChainDepthImage(*renderGraph);
+					// each pass draws inline, or executes what its system recorded on the recording threads
+					auto opaque = renderGraph->addPass("opaque", [&](VkCommandBuffer passCommandBuffer)
+					{
+						if (serialRecording)
+						{
+							auto statisticsScope = beginStatistics(passCommandBuffer, "opaque");
+							simpleRenderSystem.renderGameObjects(frameInfo);
+							endStatistics(passCommandBuffer, statisticsScope);
+							return;
+						}
+						simpleRenderSystem.renderGameObjects(frameInfo, parallelRecorder);
+						parallelRecorder.executeCommands(passCommandBuffer);
+					});
+					opaque.writeColor(color, VkClearColorValue{{0.01f, 0.01f, 0.01f, 1.0f}}).writeDepth(depth, 1.0f);
+					// order here matters!
+					auto pointLights = renderGraph->addPass("point lights", [&](VkCommandBuffer passCommandBuffer)
+					{
+						if (serialRecording)
+						{
+							auto statisticsScope = beginStatistics(passCommandBuffer, "point lights");
+							pointLightSystem.render(frameInfo);
+							endStatistics(passCommandBuffer, statisticsScope);
+							return;
+						}
+						pointLightSystem.render(frameInfo, parallelRecorder);
+						parallelRecorder.executeCommands(passCommandBuffer);
+					});
+					pointLights.writeColor(color).writeDepth(depth);
+					if (!serialRecording)
+					{
+						opaque.useSecondaryCommandBuffers();
+						pointLights.useSecondaryCommandBuffers();
+					}
+					m_zRenderer.addCapturePass(*renderGraph, color);
+
+					renderGraph->compile();
+					renderGraph->execute(commandBuffer, &gpuProfiler);
+					if (!isRenderGraphPrinted)
+					{
+						renderGraph->printPlan(std::cout);
+						isRenderGraphPrinted = true;
+					}
+					if (!serialRecording)
+					{
+						reusedCommandBuffers += parallelRecorder.reusedCount();
+					}
+				}
+				else if (serialRecording)
+				{
+					auto renderPassScope = gpuProfiler.beginScope(commandBuffer, "render pass");
+					m_zRenderer.beginSwapChainRenderPass(commandBuffer);
+
+					// order here matters!
+					auto opaqueScope = gpuProfiler.beginScope(commandBuffer, "opaque");
+					auto opaqueStatistics = beginStatistics(commandBuffer, "opaque");
+					simpleRenderSystem.renderGameObjects(frameInfo);
+					endStatistics(commandBuffer, opaqueStatistics);
+					gpuProfiler.endScope(commandBuffer, opaqueScope);
+
+					auto pointLightsScope = gpuProfiler.beginScope(commandBuffer, "point lights");
+					auto pointLightsStatistics = beginStatistics(commandBuffer, "point lights");
+					pointLightSystem.render(frameInfo);
+					endStatistics(commandBuffer, pointLightsStatistics);
+					gpuProfiler.endScope(commandBuffer, pointLightsScope);
+					m_zRenderer.endSwapChainRenderPass(commandBuffer);
+					gpuProfiler.endScope(commandBuffer, renderPassScope);
+				}
+				else
+				{
+					// a pass of secondary command buffers can't write timestamps itself, so only the whole pass is timed
+					auto renderPassScope = gpuProfiler.beginScope(commandBuffer, "render pass");
+					m_zRenderer.beginSwapChainRenderPass(commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+					parallelRecorder.beginFrame(m_zRenderer);
+					simpleRenderSystem.renderGameObjects(frameInfo, parallelRecorder);
+					pointLightSystem.render(frameInfo, parallelRecorder);
+					parallelRecorder.executeCommands(commandBuffer);
+					reusedCommandBuffers += parallelRecorder.reusedCount();
+					m_zRenderer.endSwapChainRenderPass(commandBuffer);
+					gpuProfiler.endScope(commandBuffer, renderPassScope);
+				}
+				gpuProfiler.endScope(commandBuffer, frameScope);
+				auto recordingEnd = ZCpuProfiler::Clock::now();
+				double frameRecordingMs =
+					std::chrono::duration<double, std::milli>(recordingEnd - recordingStart).count();
+				recordingMs += frameRecordingMs;
+				m_runStats.recordingMs.push_back(frameRecordingMs);
+				if (ZCpuProfiler::isEnabled())
+				{
+					ZCpuProfiler::record("record commands", recordingStart, recordingEnd);
+				}
+
+				// the GPU only reads the ubo once the frame is submitted, so the camera can go in last
 				ubo.projection = camera.getProjection();
 				ubo.view = camera.getView();
 				ubo.inverseView = camera.getInverseView();
-				pointLightSystem.update(frameInfo, ubo);
 				uboBuffers[frameIndex]->writeToBuffer(&ubo);
 				uboBuffers[frameIndex]->flush();
+				if (isCapturing)
+				{
+					commandCapture->endFrame(ubo);
+					if (commandCapture->frameCount() == m_options.captureFrameCount)
+					{
+						commandCapture->getStream().save(m_options.capturePath);
+						std::cout << "Saved " << m_options.capturePath << " (" << commandCapture->frameCount()
+							<< " frames)\n";
+					}
+				}
+				uint64_t frameValue = m_zRenderer.currentFrameValue();
+				m_zRenderer.endFrame();
+				submitTimes[frameIndex] = {frameValue, ZCpuProfiler::Clock::now()};
+				previousInputTime = inputTime;
+				if (benchmark && benchmark->getLatencyKind() == ZSwapChainBenchmark::LatencyKind::INPUT_TO_PRESENT)
+				{
+					benchmark->recordPresent(m_zRenderer.lastPresentId(), inputTime);
+					benchmark->pollPresents(m_zRenderer.lastPresentId(),
+					                        [&](uint64_t presentId) { return m_zRenderer.isPresented(presentId); });
+				}
 
-				// render
-				m_zRenderer.beginSwapChainRenderPass(commandBuffer);
+				if (m_zRenderer.isCaptureReady())
+				{
+					ImageData image = m_zRenderer.takeCapture();
+					if (isDumpRequested)
+					{
+						std::string path = "frame_" + std::to_string(framesRendered) + ".png";
+						image.writePng(path);
+						std::cout << "Saved " << path << '\n';
+						isDumpRequested = false;
+					}
+					if (m_options.compareFp16 && !referenceImage)
+					{
+						referenceImage = std::move(image);
+						shadingProfile.reducedPrecision = true;
+						simpleRenderSystem.setShadingProfile(shadingProfile);
+					}
+					else if (m_options.compareFp16)
+					{
+						ImageDiff diff = ImageDiff::compare(*referenceImage, image);
+						std::cout << "fp16 vs fp32 lighting: max error " << diff.maxError
+							<< ", mean error " << diff.meanError
+							<< ", PSNR " << diff.psnr << " dB, "
+							<< diff.pixelsAboveThreshold << " of " << diff.pixelCount << " pixels differ noticeably\n";
+						m_zWindow.setShouldClose();
+					}
+				}
 
-				// order here matters!
-				simpleRenderSystem.renderGameObjects(frameInfo);
+				if (benchmark && benchmark->isConfigDone())
+				{
+					benchmark->nextConfig(m_zRenderer.getPresentMode(), m_zRenderer.getSwapChainImageCount());
+					if (benchmark->isFinished())
+					{
+						benchmark->printReport();
+						m_zWindow.setShouldClose();
+					}
+					else
+					{
+						m_zRenderer.setSwapChainSettings(benchmark->getSettings());
+					}
+				}
 
-				pointLightSystem.render(frameInfo);
-				m_zRenderer.endSwapChainRenderPass(commandBuffer);
-				m_zRenderer.endFrame();
+				// report whenever the set of pipelines a frame needs changes
+				auto pipelineStats = m_pipelineRegistry.getFrameStats();
+				if (pipelineStats.uniquePipelines != lastUniquePipelines)
+				{
+					std::cout << "Frame binds " << pipelineStats.uniquePipelines << " unique pipelines ("
+						<< pipelineStats.pipelineBinds << " binds, " << pipelineStats.fastLinkedBinds << " fast-linked, "
+						<< m_pipelineRegistry.size() << " registered, "
+						<< m_pipelineCompiler.libraryCount() << " pipeline libraries)\n";
+					lastUniquePipelines = pipelineStats.uniquePipelines;
+				}
+
+				framesRendered++;
+				m_runStats.frameMs.push_back(
+					std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+				if (m_zDevice.getCapabilities().memoryBudget)
+				{
+					m_runStats.deviceMemoryMiB.push_back(
+						static_cast<double>(m_zDevice.getDeviceLocalMemoryUsage()) / (1024.0 * 1024.0));
+				}
+				if (m_options.frameCount > 0 && framesRendered >= m_options.frameCount)
+				{
+					m_zWindow.setShouldClose();
+				}
 			}
 		}
 		// wait for the logical device to finish operations
 		vkDeviceWaitIdle(m_zDevice.device());
+
+		float totalSeconds = std::chrono::duration<float, std::chrono::seconds::period>(
+			std::chrono::high_resolution_clock::now() - startTime).count();
+		std::cout << "Rendered " << framesRendered << " frames in " << totalSeconds << " s"
+			<< (m_zWindow.isHeadless() ? " (headless)\n" : "\n");
+		if (framesRendered > 0)
+		{
+			std::cout << "Recording the render pass took " << recordingMs / framesRendered << " ms per frame ("
+				<< (serialRecording
+					    ? std::string{"serial"}
+					    : "up to " + std::to_string(parallelRecorder.maxJobCount()) + " threads, "
+					    + std::to_string(reusedCommandBuffers) + " cached command buffers reused")
+				<< ")\n";
+		}
+		if (renderGraph)
+		{
+			const auto& graphStats = renderGraph->getStats();
+			std::cout << "Render graph: " << graphStats.passCount - graphStats.culledPassCount << " of "
+				<< graphStats.passCount << " passes, " << graphStats.barrierCount << " barriers per frame, "
+				<< graphStats.transientMemory / 1024 << " KiB of transient images ("
+				<< graphStats.unaliasedTransientMemory / 1024 << " KiB without aliasing)\n";
+		}
+		if (gpuProfiler.isSupported())
+		{
+			gpuProfiler.resolveFinishedFrames();
+			std::cout << "GPU time per frame (ms):\n";
+			for (const auto& scope : gpuProfiler.getStats())
+			{
+				std::cout << '\t' << scope.name << ": average " << scope.averageMs << ", p50 " << scope.p50Ms
+					<< ", p95 " << scope.p95Ms << ", p99 " << scope.p99Ms << ", max " << scope.maxMs << '\n';
+			}
+			if (!m_options.gpuProfilePath.empty())
+			{
+				std::ofstream file{m_options.gpuProfilePath};
+				if (!file)
+				{
+					throw std::runtime_error("failed to open " + m_options.gpuProfilePath + "!");
+				}
+				if (std::filesystem::path{m_options.gpuProfilePath}.extension() == ".json")
+				{
+					gpuProfiler.writeJson(file);
+				}
+				else
+				{
+					gpuProfiler.writeCsv(file);
+				}
+				std::cout << "Saved " << m_options.gpuProfilePath << '\n';
+			}
+		}
+		else
+		{
+			std::cout << "GPU timing is not available: the graphics queue cannot write timestamps\n";
+		}
+		if (pipelineStatistics && pipelineStatistics->isSupported())
+		{
+			pipelineStatistics->resolveFinishedFrames();
+			VkExtent2D extent = m_zRenderer.getSwapChainExtent();
+			double pixelCount = static_cast<double>(extent.width) * extent.height;
+			std::cout << "GPU work per frame:\n";
+			for (const auto& [name, counters] : pipelineStatistics->getAverages())
+			{
+				// fragment shader invocations per pixel of the target: how often the pass shades each pixel
+				std::cout << '\t' << name << ": " << counters.inputAssemblyVertices << " vertices, "
+					<< counters.inputAssemblyPrimitives << " primitives, "
+					<< counters.vertexShaderInvocations << " vertex shader invocations, "
+					<< counters.clippingPrimitives << " of " << counters.clippingInvocations
+					<< " primitives past clipping, "
+					<< counters.fragmentShaderInvocations << " fragment shader invocations ("
+					<< counters.fragmentShaderInvocations / pixelCount << " per pixel), "
+					<< counters.samplesPassed << " samples passed depth\n";
+			}
+		}
+		else if (pipelineStatistics)
+		{
+			std::cout << "Pipeline statistics are not available: the device does not support pipelineStatisticsQuery\n";
+		}
+		if (!m_options.tracePath.empty())
+		{
+			// every recording thread is idle now
+			std::ofstream file{m_options.tracePath};
+			if (!file)
+			{
+				throw std::runtime_error("failed to open " + m_options.tracePath + "!");
+			}
+			ZCpuProfiler::writeChromeTrace(file);
+			std::cout << "Saved " << m_options.tracePath << " (open it in chrome://tracing or ui.perfetto.dev)\n";
+		}
+		std::cout << "Fallback and fast-linked pipelines avoided " << m_pipelineRegistry.getFrameStats().hitchFramesAvoided
+			<< " frames that would have waited for a pipeline compile\n";
+		if (latency.sampleCount > 0)
+		{
+			std::cout << (m_zRenderer.supportsPresentWait() ? "Input-to-present" : "Input-to-GPU-completion")
+				<< " latency: " << latency.totalMs / latency.sampleCount << " ms average, "
+				<< latency.maxMs << " ms max over " << latency.sampleCount << " frames\n";
+		}
 	}
 
-	void FirstApp::loadGameObjects()
+	void FirstApp::loadGameObjects(const std::string& scene)
 	{
-		std::shared_ptr<ZModel> zModel = ZModel::createModelFromFile(m_zDevice, "assets/models/flat_vase.obj");
-		auto flat_vase = ZGameObject::createGameObject();
-		flat_vase.m_model = zModel;
-		flat_vase.m_transform.translation = {-0.5f, 0.5f, 0.f};
-		flat_vase.m_transform.scale = glm::vec3{3.f, 1.5f, 3.f};
-		m_gameObjects.emplace(flat_vase.getId(), std::move(flat_vase));
-
-		zModel = ZModel::createModelFromFile(m_zDevice, "assets/models/smooth_vase.obj");
-		auto smoothVase = ZGameObject::createGameObject();
-		smoothVase.m_model = zModel;
-		smoothVase.m_transform.translation = {0.5f, 0.5f, 0.f};
-		smoothVase.m_transform.scale = glm::vec3{3.f, 1.5f, 3.f};
-		m_gameObjects.emplace(smoothVase.getId(), std::move(smoothVase));
-
-		zModel = ZModel::createModelFromFile(m_zDevice, "assets/models/quad.obj");
+		if (scene == "synthetic")
+		{
+			// brings its own floor and lights
+			ZSceneGenerator generator{m_options.syntheticScene};
+			generator.generate(m_zDevice, m_gameObjects);
+			m_sceneRadius = generator.getRadius();
+			return;
+		}
+
+		std::shared_ptr<ZModel> flatVaseModel = ZModel::createModelFromFile(m_zDevice, "assets/models/flat_vase.obj");
+		std::shared_ptr<ZModel> smoothVaseModel = ZModel::createModelFromFile(m_zDevice, "assets/models/smooth_vase.obj");
+		if (scene == "default")
+		{
+			auto flat_vase = ZGameObject::createGameObject();
+			flat_vase.m_model = flatVaseModel;
+			flat_vase.m_transform.translation = {-0.5f, 0.5f, 0.f};
+			flat_vase.m_transform.scale = glm::vec3{3.f, 1.5f, 3.f};
+			flat_vase.m_isStatic = true;
+			m_gameObjects.emplace(flat_vase.getId(), std::move(flat_vase));
+
+			auto smoothVase = ZGameObject::createGameObject();
+			smoothVase.m_model = smoothVaseModel;
+			smoothVase.m_transform.translation = {0.5f, 0.5f, 0.f};
+			smoothVase.m_transform.scale = glm::vec3{3.f, 1.5f, 3.f};
+			smoothVase.m_isStatic = true;
+			m_gameObjects.emplace(smoothVase.getId(), std::move(smoothVase));
+		}
+		else if (scene == "grid")
+		{
+			// alternating vases covering the floor, for more draws than the default scene
+			// (large grids are for stressing the CPU side, the vases get tiny)
+			const int gridSize = static_cast<int>(std::max(m_options.gridSize, 1u));
+			const float spacing = 2.f / gridSize;
+			const float scale = 6.f / gridSize;
+			for (int x = 0; x < gridSize; x++)
+			{
+				for (int z = 0; z < gridSize; z++)
+				{
+					auto vase = ZGameObject::createGameObject();
+					vase.m_model = (x + z) % 2 == 0 ? flatVaseModel : smoothVaseModel;
+					vase.m_transform.translation = {
+						(x - (gridSize - 1) / 2.f) * spacing, 0.5f, (z - (gridSize - 1) / 2.f) * spacing
+					};
+					vase.m_transform.scale = glm::vec3{scale, scale * 2.f / 3.f, scale};
+					vase.m_isStatic = true;
+					m_gameObjects.emplace(vase.getId(), std::move(vase));
+				}
+			}
+		}
+		else
+		{
+			throw std::runtime_error("unknown scene " + scene);
+		}
+
+		std::shared_ptr<ZModel> zModel = ZModel::createModelFromFile(m_zDevice, "assets/models/quad.obj");
 		auto floor = ZGameObject::createGameObject();
 		floor.m_model = zModel;
 		floor.m_transform.translation = {0.0f, 0.5f, 0.f};
 		floor.m_transform.scale = glm::vec3{3.f, 1.f, 3.f};
+		floor.m_isStatic = true;
 		m_gameObjects.emplace(floor.getId(), std::move(floor));
 
 
@@ -5,9 +5,79 @@
 #include "ZWindow.h"
 #include "ZRenderer.h"
 #include "ZDescriptors.h"
+#include "ZThreadPool.h"
+#include "ZPipelineCompiler.h"
+#include "ZPipelineRegistry.h"
+#include "ZSceneGenerator.h"
 
 namespace ZZX
 {
+	// what the app should do besides rendering the scene, usually set from the command line
+	struct AppOptions
+	{
+		// render one frame with fp32 and one with fp16 lighting, print how far apart they are, then quit
+		bool compareFp16 = false;
+		SwapChainSettings swapChain{};
+		// sweep swap chain settings, print throughput and latency for each, then quit
+		bool benchmarkSwapChain = false;
+		float benchmarkSecondsPerConfig = 3.f;
+		// block on the previous present before sampling input, so frames show the freshest input possible
+		bool lowLatency = false;
+		// cap the frame rate; 0 renders as fast as the swap chain lets us
+		double maxFramesPerSecond = 0.0;
+		// render without a window or surface (CI, servers, software drivers); there is no input then,
+		// and every frame advances the scene by the same fixed time step
+		bool headless = false;
+		// window (or offscreen image) size; 0 keeps FirstApp::WINDOW_WIDTH/WINDOW_HEIGHT
+		uint32_t width = 0;
+		uint32_t height = 0;
+		// quit after rendering this many frames; 0 runs until the window is closed
+		uint32_t frameCount = 0;
+		// which scene to load, see FirstApp::loadGameObjects
+		std::string scene = "default";
+		// the grid scene has gridSize * gridSize vases
+		uint32_t gridSize = 8;
+		// what the synthetic scene is made of
+		SceneParams syntheticScene{};
+		// move the camera along this ZCameraPath ("orbit" or "flythrough") instead of with the keyboard
+		std::string cameraPath;
+		// record every draw into the primary command buffer on the main thread, instead of into secondary
+		// command buffers on the recording threads
+		bool serialRecording = false;
+		// record the draws of static objects once and reuse the command buffers (ignored with serialRecording)
+		bool cacheStaticObjects = false;
+		// declare each frame as a render graph, which works out the barriers and allocates the depth buffer itself
+		// (only with dynamic rendering and synchronization2; otherwise the swap chain render pass is used)
+		bool useRenderGraph = true;
+		// write the GPU time of each scope to this file at exit, as JSON if it ends in .json and CSV otherwise
+		std::string gpuProfilePath;
+		// count the vertices, primitives, shader invocations and samples of each render system, and print the
+		// per-frame averages at exit; draws are then recorded serially (like serialRecording)
+		bool pipelineStatistics = false;
+		// record CPU scopes (and the GPU scopes, where timestamps are supported) and write them to this file at
+		// exit as a Chrome trace
+		std::string tracePath;
+		// capture the commands of the first captureFrameCount frames to this file, to be run again with the replay
+		// tool; draws are then recorded serially (like serialRecording)
+		std::string capturePath;
+		uint32_t captureFrameCount = 1;
+		// frames (counting from 0) to save as frame_<n>.png in the working directory
+		std::vector<uint32_t> dumpFrames;
+	};
+
+	// what run() measured, one sample per frame, for benchmarks to summarize
+	struct RunStats
+	{
+		// the main thread's time for the whole frame, waits included
+		std::vector<double> frameMs;
+		// recording the frame's commands
+		std::vector<double> recordingMs;
+		// the GPU's "frame" scope; empty without timestamps, and short of the frames still in flight at exit
+		std::vector<double> gpuFrameMs;
+		// device local memory in use; empty without DeviceCapabilities::memoryBudget
+		std::vector<double> deviceMemoryMiB;
+	};
+
 	class FirstApp
 	{
 	public:
@@ -16,7 +86,7 @@ namespace ZZX
 		static constexpr int WINDOW_WIDTH = 3000;
 		static constexpr int WINDOW_HEIGHT = 1600;
 
-		FirstApp();
+		FirstApp(const AppOptions& options = {});
 		~FirstApp();
 
 		// delete copy ctor and assignment to avoid dangling pointer
@@ -24,14 +94,31 @@ namespace ZZX
 		FirstApp& operator=(const FirstApp&) = delete;
 
 		void run();
+		const RunStats& getRunStats() const { return m_runStats; }
 	private:
-		void loadGameObjects();
-		ZWindow m_zWindow{WINDOW_WIDTH, WINDOW_HEIGHT, "Vulkan Engine"};
+		// "default" is two vases on a floor, "grid" a grid of AppOptions::gridSize^2 of them, "synthetic" one made
+		// by a ZSceneGenerator from AppOptions::syntheticScene; throws for anything else
+		void loadGameObjects(const std::string& scene);
+		AppOptions m_options;
+		ZWindow m_zWindow{
+			m_options.width > 0 ? static_cast<int>(m_options.width) : WINDOW_WIDTH,
+			m_options.height > 0 ? static_cast<int>(m_options.height) : WINDOW_HEIGHT,
+			"Vulkan Engine",
+			m_options.headless
+		};
 		ZDevice m_zDevice{m_zWindow};
-		ZRenderer m_zRenderer{ m_zWindow, m_zDevice };
+		ZRenderer m_zRenderer{ m_zWindow, m_zDevice, m_options.swapChain };
+		ZThreadPool m_jobPool{};
+		// separate from the job pool, so recording never waits behind a pipeline compile
+		ZThreadPool m_recordingPool{};
+		ZPipelineCompiler m_pipelineCompiler{ m_zDevice, m_jobPool };
+		ZPipelineRegistry m_pipelineRegistry{ m_zDevice, m_pipelineCompiler };
 
 		// note: order of declarations matters
 		std::unique_ptr<ZDescriptorPool> m_globalPool{};
 		ZGameObject::Map m_gameObjects;
+		// half the size of the loaded scene, for camera paths
+		float m_sceneRadius = 2.5f;
+		RunStats m_runStats;
 	};
 }
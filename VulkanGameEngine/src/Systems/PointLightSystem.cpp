@@ -1,10 +1,15 @@
 ﻿#include "pch.h"
 #include "PointLightSystem.h"
+#include "ZShaderReflection.h"
+#include "ZCommandCapture.h"
 
 
 
 namespace ZZX
 {
+	static constexpr const char* VERT_SHADER_PATH = "assets/shaders/point_light.vert";
+	static constexpr const char* FRAG_SHADER_PATH = "assets/shaders/point_light.frag";
+
 	struct PointLightPushConstants
 	{
 		glm::vec4 position{};
@@ -12,48 +17,33 @@ namespace ZZX
 		float radius;
 	};
 
-	PointLightSystem::PointLightSystem(ZDevice& device, VkRenderPass renderPass,
-	                                   VkDescriptorSetLayout globalSetLayout)
-		: m_zDevice(device)
+	PointLightSystem::PointLightSystem(ZDevice& device,
+	                                   ZPipelineRegistry& pipelineRegistry,
+	                                   const PipelineRenderTarget& renderTarget,
+	                                   const ZDescriptorSetLayout& globalSetLayout)
+		: m_zDevice(device), m_pipelineRegistry(pipelineRegistry)
 	{
 		createPipelineLayout(globalSetLayout);
-		createPipeline(renderPass);
-	}
-
-	PointLightSystem::~PointLightSystem()
-	{
-		vkDestroyPipelineLayout(m_zDevice.device(), m_pipelineLayout, nullptr);
+		createPipeline(renderTarget);
 	}
 
-	void PointLightSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
+	void PointLightSystem::createPipelineLayout(const ZDescriptorSetLayout& globalSetLayout)
 	{
-		VkPushConstantRange pushConstantRange{
-			// both vert/frag shaders can access push constants
-			.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-			.offset = 0,
-			.size = sizeof(PointLightPushConstants)
-		};
-
-		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout};
-
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo{
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-			.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size()),
-			.pSetLayouts = descriptorSetLayouts.data(),
-			.pushConstantRangeCount = 1,
-			.pPushConstantRanges = &pushConstantRange,
-		};
-
-		if (vkCreatePipelineLayout(m_zDevice.device(),
-		                           &pipelineLayoutInfo,
-		                           nullptr,
-		                           &m_pipelineLayout) != VK_SUCCESS)
-		{
-			throw std::runtime_error("failed to create pipeline layout!");
-		}
+		// the layout is derived from the shaders themselves, the C++ side only has to agree with them
+		auto& shaderModules = m_pipelineRegistry.getPipelineCompiler().getShaderModuleCache();
+		auto vertCode = shaderModules.getCode(VERT_SHADER_PATH);
+		auto fragCode = shaderModules.getCode(FRAG_SHADER_PATH);
+		ZShaderReflection reflection{vertCode.get(), fragCode.get()};
+
+		reflection.validatePushConstantSize(sizeof(PointLightPushConstants));
+		reflection.validateBlockSize(0, 0, sizeof(GlobalUbo));
+		m_pushConstantStages = reflection.getPushConstantStages();
+
+		// set 0 is the global set shared by all systems; the registry owns the layout
+		m_pipelineLayout = m_pipelineRegistry.getPipelineLayout(reflection, {{0, &globalSetLayout}});
 	}
 
-	void PointLightSystem::createPipeline(VkRenderPass renderPass)
+	void PointLightSystem::createPipeline(const PipelineRenderTarget& renderTarget)
 	{
 		assert(m_pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
@@ -65,13 +55,14 @@ namespace ZZX
 		pipelineConfig.attributeDescriptions.clear();
 		pipelineConfig.bindingDescriptions.clear();
 
-		pipelineConfig.m_VkRenderPass = renderPass;
+		ZPipeline::setRenderTarget(pipelineConfig, renderTarget);
 		pipelineConfig.m_VkPipelineLayout = m_pipelineLayout;
-		m_zPipeline = std::make_unique<ZPipeline>(m_zDevice,
-		                                          pipelineConfig,
-		                                          "assets/shaders/point_light.vert.spv",
-		                                          "assets/shaders/point_light.frag.spv"
-		);
+		// don't block here: the pipeline compiles in the background while the other systems are being set up
+		m_pipeline = m_pipelineRegistry.request({
+			std::move(pipelineConfig),
+			VERT_SHADER_PATH,
+			FRAG_SHADER_PATH,
+		});
 	}
 
 
@@ -98,6 +89,30 @@ namespace ZZX
 	}
 
 	void PointLightSystem::render(FrameInfo& frameInfo)
+	{
+		std::vector<ZGameObject*> lights = sortLights(frameInfo);
+		recordDraws(frameInfo.commandBuffer,
+		            frameInfo.globalDescriptorSet,
+		            lights.data(),
+		            lights.data() + lights.size(),
+		            frameInfo.capture);
+	}
+
+	void PointLightSystem::render(FrameInfo& frameInfo, ZParallelRecorder& recorder)
+	{
+		std::vector<ZGameObject*> lights = sortLights(frameInfo);
+		// the ranges are executed in order, so splitting them keeps the back-to-front order
+		recorder.record(static_cast<uint32_t>(lights.size()),
+		                [&](VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end)
+		                {
+			                recordDraws(commandBuffer,
+			                            frameInfo.globalDescriptorSet,
+			                            lights.data() + begin,
+			                            lights.data() + end);
+		                });
+	}
+
+	std::vector<ZGameObject*> PointLightSystem::sortLights(FrameInfo& frameInfo)
 	{
 		// sort lights
 		std::map<float, ZGameObject::id_t> sorted;
@@ -111,31 +126,54 @@ namespace ZZX
 			sorted[disSquared] = obj.getId();
 		}
 
-		m_zPipeline->bind(frameInfo.commandBuffer);
-		vkCmdBindDescriptorSets(frameInfo.commandBuffer,
+		// iterate through sorted lights in reverse order
+		std::vector<ZGameObject*> lights;
+		lights.reserve(sorted.size());
+		for (auto it = sorted.rbegin(); it != sorted.rend(); ++it)
+		{
+			lights.push_back(&frameInfo.gameObjects.at(it->second));
+		}
+		return lights;
+	}
+
+	void PointLightSystem::recordDraws(VkCommandBuffer commandBuffer, VkDescriptorSet globalDescriptorSet,
+	                                   ZGameObject* const* first, ZGameObject* const* last,
+	                                   ZCommandCapture* capture)
+	{
+		m_pipelineRegistry.bind(m_pipeline, commandBuffer);
+		vkCmdBindDescriptorSets(commandBuffer,
 		                        VK_PIPELINE_BIND_POINT_GRAPHICS,
 		                        m_pipelineLayout,
 		                        0,
 		                        1,
-		                        &frameInfo.globalDescriptorSet,
+		                        &globalDescriptorSet,
 		                        0,
 		                        nullptr);
-		 
-		// iterate through sorted lights in reverse order
-		for (auto it = sorted.rbegin(); it != sorted.rend(); ++it)
+		if (capture)
+		{
+			capture->bindPipeline(m_pipeline);
+			capture->bindGlobalDescriptorSet();
+		}
+
+		for (auto it = first; it != last; ++it)
 		{
-			auto& obj = frameInfo.gameObjects.at(it->second);
+			auto& obj = **it;
 			PointLightPushConstants push{};
 			push.position = glm::vec4(obj.m_transform.translation, 1.0f);
 			push.color = glm::vec4(obj.m_color, obj.m_pointLight->lightIntensity);
 			push.radius = obj.m_transform.scale.x;
-			vkCmdPushConstants(frameInfo.commandBuffer,
+			vkCmdPushConstants(commandBuffer,
 			                   m_pipelineLayout,
-			                   VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+			                   m_pushConstantStages,
 			                   0,
 			                   sizeof(PointLightPushConstants),
 			                   &push);
-			vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
+			vkCmdDraw(commandBuffer, 6, 1, 0, 0);
+			if (capture)
+			{
+				capture->pushConstants(&push, sizeof(PointLightPushConstants));
+				capture->draw(6, 1, 0, 0);
+			}
 		}
 	}
 }
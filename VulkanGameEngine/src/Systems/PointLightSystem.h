@@ -3,16 +3,21 @@
 #include "ZDevice.h"
 #include "ZGameObject.h"
 #include "ZPipeline.h"
+#include "ZPipelineRegistry.h"
 #include "ZCamera.h"
 #include "ZFrameInfo.h"
+#include "ZDescriptors.h"
+#include "ZParallelRecorder.h"
 
 namespace ZZX
 {
 	class PointLightSystem
 	{
 	public:
-		PointLightSystem(ZDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
-		~PointLightSystem();
+		PointLightSystem(ZDevice& device,
+		                 ZPipelineRegistry& pipelineRegistry,
+		                 const PipelineRenderTarget& renderTarget,
+		                 const ZDescriptorSetLayout& globalSetLayout);
 
 		// delete copy ctor and assignment to avoid dangling pointer
 		PointLightSystem(const PointLightSystem&) = delete;
@@ -20,12 +25,26 @@ namespace ZZX
 
 		void update(FrameInfo& frameInfo, GlobalUbo& ubo);
 		void render(FrameInfo& frameInfo);
+		// record into secondary command buffers; the lights are still drawn back to front
+		void render(FrameInfo& frameInfo, ZParallelRecorder& recorder);
+
+		// the point lights, farthest from the camera first, as they are blended; only reads the camera and the
+		// game objects, so it needs no device
+		static std::vector<ZGameObject*> sortLights(FrameInfo& frameInfo);
 	private:
-		void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-		void createPipeline(VkRenderPass renderPass);
+		void createPipelineLayout(const ZDescriptorSetLayout& globalSetLayout);
+		void createPipeline(const PipelineRenderTarget& renderTarget);
+		// the capture, if there is one, gets the same commands
+		void recordDraws(VkCommandBuffer commandBuffer, VkDescriptorSet globalDescriptorSet,
+		                 ZGameObject* const* first, ZGameObject* const* last, ZCommandCapture* capture = nullptr);
 
 		ZDevice& m_zDevice;
-		std::unique_ptr<ZPipeline> m_zPipeline;
+		// owns the pipeline and its layout, which may be shared with other systems
+		ZPipelineRegistry& m_pipelineRegistry;
 		VkPipelineLayout m_pipelineLayout;
+		// compiled on a worker thread and picked up on first use
+		ZPipelineRegistry::PipelineId m_pipeline;
+		// the stages that read the push block, as reflected from the shaders
+		VkShaderStageFlags m_pushConstantStages = 0;
 	};
 }
@@ -1,99 +1,217 @@
 ﻿#include "pch.h"
 #include "SimpleRenderSystem.h"
+#include "ZShaderReflection.h"
+#include "ZUtils.h"
+#include "ZCommandCapture.h"
 
 namespace ZZX
 {
+	static constexpr const char* VERT_SHADER_PATH = "assets/shaders/simple_shader.vert";
+	static constexpr const char* FRAG_SHADER_PATH = "assets/shaders/simple_shader.frag";
+
+	// must match the layout(constant_id = ...) declarations in simple_shader.frag
+	enum SimpleShaderConstant : uint32_t
+	{
+		LIGHT_COUNT_CONSTANT = 0,
+		ENABLE_SPECULAR_CONSTANT = 1,
+	};
+
 	struct SimplePushConstantData
 	{
 		glm::mat4 modelMatrix{1.f};
 		glm::mat4 normalMatrix{1.f};
 	};
 
-	SimpleRenderSystem::SimpleRenderSystem(ZDevice& device, VkRenderPass renderPass,
-	                                       VkDescriptorSetLayout globalSetLayout)
-		: m_zDevice(device)
+	SimpleRenderSystem::SimpleRenderSystem(ZDevice& device,
+	                                       ZPipelineRegistry& pipelineRegistry,
+	                                       const PipelineRenderTarget& renderTarget,
+	                                       const ZDescriptorSetLayout& globalSetLayout,
+	                                       const ShadingProfile& shadingProfile)
+		: m_zDevice(device), m_pipelineRegistry(pipelineRegistry), m_renderTarget(renderTarget)
 	{
 		createPipelineLayout(globalSetLayout);
-		createPipeline(renderPass);
+		// the shader's default constants make it an uber-shader that works for every profile
+		m_fallbackPipeline = m_pipelineRegistry.request(makePipelineRequest());
+		setShadingProfile(shadingProfile);
 	}
 
-	SimpleRenderSystem::~SimpleRenderSystem()
+	void SimpleRenderSystem::createPipelineLayout(const ZDescriptorSetLayout& globalSetLayout)
 	{
-		vkDestroyPipelineLayout(m_zDevice.device(), m_VkPipelineLayout, nullptr);
-	}
+		// the layout is derived from the shaders themselves, the C++ side only has to agree with them
+		auto& shaderModules = m_pipelineRegistry.getPipelineCompiler().getShaderModuleCache();
+		auto vertCode = shaderModules.getCode(VERT_SHADER_PATH);
+		auto fragCode = shaderModules.getCode(FRAG_SHADER_PATH);
+		ZShaderReflection reflection{vertCode.get(), fragCode.get()};
 
-	void SimpleRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
-	{
-		VkPushConstantRange pushConstantRange{
-			// both vert/frag shaders can access push constants
-			.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-			.offset = 0,
-			.size = sizeof(SimplePushConstantData)
-		};
-
-		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout};
-
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo{
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-			.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size()),
-			.pSetLayouts = descriptorSetLayouts.data(),
-			.pushConstantRangeCount = 1,
-			.pPushConstantRanges = &pushConstantRange,
-		};
-
-		if (vkCreatePipelineLayout(m_zDevice.device(),
-		                           &pipelineLayoutInfo,
-		                           nullptr,
-		                           &m_VkPipelineLayout) != VK_SUCCESS)
-		{
-			throw std::runtime_error("failed to create pipeline layout!");
-		}
+		reflection.validatePushConstantSize(sizeof(SimplePushConstantData));
+		reflection.validateBlockSize(0, 0, sizeof(GlobalUbo));
+		reflection.validateVertexInputs(ZModel::Vertex::getAttributeDescriptions());
+		m_pushConstantStages = reflection.getPushConstantStages();
+
+		// set 0 is the global set shared by all systems; the registry owns the layout
+		m_VkPipelineLayout = m_pipelineRegistry.getPipelineLayout(reflection, {{0, &globalSetLayout}});
 	}
 
-	void SimpleRenderSystem::createPipeline(VkRenderPass renderPass)
+	PipelineBuildRequest SimpleRenderSystem::makePipelineRequest() const
 	{
 		assert(m_VkPipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
 		PipelineConfigInfo pipelineConfig{};
 		ZPipeline::defaultPipelineConfigInfo(pipelineConfig);
-		pipelineConfig.m_VkRenderPass = renderPass;
+		ZPipeline::setRenderTarget(pipelineConfig, m_renderTarget);
 		pipelineConfig.m_VkPipelineLayout = m_VkPipelineLayout;
-		m_zPipeline = std::make_unique<ZPipeline>(m_zDevice,
-		                                          pipelineConfig,
-		                                          "assets/shaders/simple_shader.vert.spv",
-		                                          "assets/shaders/simple_shader.frag.spv"
-		);
+		return {std::move(pipelineConfig), VERT_SHADER_PATH, FRAG_SHADER_PATH};
+	}
+
+	void SimpleRenderSystem::setShadingProfile(const ShadingProfile& shadingProfile)
+	{
+		assert(shadingProfile.lightCount <= MAX_LIGHTS && "Shading profile has more lights than the ubo can hold");
+		assert((!shadingProfile.reducedPrecision || m_zDevice.getCapabilities().shaderFloat16) &&
+			"Reduced precision shading requires shaderFloat16");
+
+		PipelineBuildRequest request = makePipelineRequest();
+		request.specialization.set(LIGHT_COUNT_CONSTANT, shadingProfile.lightCount)
+		                      .set(ENABLE_SPECULAR_CONSTANT, shadingProfile.specular);
+		if (shadingProfile.reducedPrecision)
+		{
+			// float16 types change the shader's code, not just a constant, so this needs its own module
+			request.defines["USE_FP16"] = "1";
+		}
+
+		// don't block here: a new variant compiles in the background, frames use the fallback until it is done
+		m_pipeline = m_pipelineRegistry.request(std::move(request), m_fallbackPipeline);
 	}
 
 
 	void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo)
 	{
-		m_zPipeline->bind(frameInfo.commandBuffer);
-		vkCmdBindDescriptorSets(frameInfo.commandBuffer,
+		std::vector<ZGameObject*> drawables = collectDrawables(frameInfo.gameObjects);
+		recordDraws(frameInfo.commandBuffer,
+		            frameInfo.globalDescriptorSet,
+		            drawables.data(),
+		            drawables.data() + drawables.size(),
+		            frameInfo.capture);
+	}
+
+	void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo, ZParallelRecorder& recorder)
+	{
+		if (!m_isStaticCachingEnabled)
+		{
+			std::vector<ZGameObject*> drawables = collectDrawables(frameInfo.gameObjects);
+			recorder.record(static_cast<uint32_t>(drawables.size()),
+			                [&](VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end)
+			                {
+				                recordDraws(commandBuffer,
+				                            frameInfo.globalDescriptorSet,
+				                            drawables.data() + begin,
+				                            drawables.data() + end);
+			                });
+			return;
+		}
+
+		// walking every game object each frame is what caching is meant to avoid, so only do it when they change
+		if (m_collectedGameObjects != &frameInfo.gameObjects)
+		{
+			m_staticDrawables.clear();
+			m_dynamicDrawables.clear();
+			for (ZGameObject* obj : collectDrawables(frameInfo.gameObjects))
+			{
+				(obj->m_isStatic ? m_staticDrawables : m_dynamicDrawables).push_back(obj);
+			}
+			m_collectedGameObjects = &frameInfo.gameObjects;
+		}
+
+		if (!m_staticCache)
+		{
+			m_staticCache = recorder.createCache();
+		}
+		// the pipeline changes when the requested variant (or its optimized version) finishes compiling
+		size_t contentKey = 0;
+		hashCombine(contentKey,
+		            m_gameObjectsVersion,
+		            m_pipelineRegistry.getBoundPipeline(m_pipeline),
+		            frameInfo.globalDescriptorSet);
+		recorder.recordCached(*m_staticCache,
+		                      contentKey,
+		                      static_cast<uint32_t>(m_staticDrawables.size()),
+		                      [&](VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end)
+		                      {
+			                      recordDraws(commandBuffer,
+			                                  frameInfo.globalDescriptorSet,
+			                                  m_staticDrawables.data() + begin,
+			                                  m_staticDrawables.data() + end);
+		                      });
+		recorder.record(static_cast<uint32_t>(m_dynamicDrawables.size()),
+		                [&](VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end)
+		                {
+			                recordDraws(commandBuffer,
+			                            frameInfo.globalDescriptorSet,
+			                            m_dynamicDrawables.data() + begin,
+			                            m_dynamicDrawables.data() + end);
+		                });
+	}
+
+	void SimpleRenderSystem::invalidateGameObjects()
+	{
+		m_gameObjectsVersion++;
+		m_collectedGameObjects = nullptr;
+	}
+
+	std::vector<ZGameObject*> SimpleRenderSystem::collectDrawables(ZGameObject::Map& gameObjects)
+	{
+		std::vector<ZGameObject*> drawables;
+		drawables.reserve(gameObjects.size());
+		for (auto& kv : gameObjects)
+		{
+			// skip game objects with no model objects
+			if (kv.second.m_model != nullptr)
+			{
+				drawables.push_back(&kv.second);
+			}
+		}
+		return drawables;
+	}
+
+	void SimpleRenderSystem::recordDraws(VkCommandBuffer commandBuffer, VkDescriptorSet globalDescriptorSet,
+	                                     ZGameObject* const* first, ZGameObject* const* last,
+	                                     ZCommandCapture* capture)
+	{
+		// may run on several threads at once: the registry is thread-safe, and each thread has its own command buffer
+		m_pipelineRegistry.bind(m_pipeline, commandBuffer);
+		vkCmdBindDescriptorSets(commandBuffer,
 		                        VK_PIPELINE_BIND_POINT_GRAPHICS,
 		                        m_VkPipelineLayout,
 		                        0,
 		                        1,
-		                        &frameInfo.globalDescriptorSet,
+		                        &globalDescriptorSet,
 		                        0,
 		                        nullptr);
-		for (auto& kv : frameInfo.gameObjects)
+		if (capture)
 		{
-			auto& obj = kv.second;
-			// skip game objects with no model objects
-			if (obj.m_model == nullptr) continue;
+			capture->bindPipeline(m_pipeline);
+			capture->bindGlobalDescriptorSet();
+		}
+		for (auto it = first; it != last; ++it)
+		{
+			auto& obj = **it;
 			SimplePushConstantData push{
 				.modelMatrix = obj.m_transform.mat4(),
 				.normalMatrix = obj.m_transform.normalMatrix(),
 			};
-			vkCmdPushConstants(frameInfo.commandBuffer,
+			vkCmdPushConstants(commandBuffer,
 			                   m_VkPipelineLayout,
-			                   VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+			                   m_pushConstantStages,
 			                   0,
 			                   sizeof(SimplePushConstantData),
 			                   &push);
-			obj.m_model->bind(frameInfo.commandBuffer);
-			obj.m_model->draw(frameInfo.commandBuffer);
+			obj.m_model->bind(commandBuffer);
+			obj.m_model->draw(commandBuffer);
+			if (capture)
+			{
+				capture->pushConstants(&push, sizeof(SimplePushConstantData));
+				capture->bindModel(*obj.m_model);
+				capture->drawModel();
+			}
 		}
 	}
 }
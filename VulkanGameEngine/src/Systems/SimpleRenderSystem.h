@@ -3,27 +3,79 @@
 #include "ZDevice.h"
 #include "ZGameObject.h"
 #include "ZPipeline.h"
+#include "ZPipelineRegistry.h"
 #include "ZCamera.h"
 #include "ZFrameInfo.h"
+#include "ZDescriptors.h"
+#include "ZParallelRecorder.h"
 
 namespace ZZX
 {
+	// shading options that are baked into the pipeline through specialization constants and shader defines
+	struct ShadingProfile
+	{
+		// number of point lights to shade; -1 reads the count from the ubo at runtime
+		int32_t lightCount = -1;
+		bool specular = true;
+		// accumulate lighting in 16-bit floats; requires DeviceCapabilities::shaderFloat16
+		bool reducedPrecision = false;
+	};
+
 	class SimpleRenderSystem
 	{
 	public:
-		SimpleRenderSystem(ZDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
-		~SimpleRenderSystem();
+		SimpleRenderSystem(ZDevice& device,
+		                   ZPipelineRegistry& pipelineRegistry,
+		                   const PipelineRenderTarget& renderTarget,
+		                   const ZDescriptorSetLayout& globalSetLayout,
+		                   const ShadingProfile& shadingProfile = {});
 
 		// delete copy ctor and assignment to avoid dangling pointer
 		SimpleRenderSystem(const SimpleRenderSystem&) = delete;
 		SimpleRenderSystem& operator=(const SimpleRenderSystem&) = delete;
 		void renderGameObjects(FrameInfo& frameInfo);
+		// record the draws into secondary command buffers, split over the recorder's threads
+		void renderGameObjects(FrameInfo& frameInfo, ZParallelRecorder& recorder);
+		// switch to the pipeline variant for another profile, compiling it in the background if it is new;
+		// the generic variant is drawn with until then
+		void setShadingProfile(const ShadingProfile& shadingProfile);
+		// whether the variant for the current profile is compiled, i.e. frames no longer draw with the fallback
+		bool isPipelineReady() const { return m_pipelineRegistry.isReady(m_pipeline); }
+		// with a recorder, draw static game objects from command buffers that are recorded once and reused until
+		// the pipeline, the render pass or the objects change; the other objects are still recorded every frame
+		void setStaticCaching(bool enabled) { m_isStaticCachingEnabled = enabled; }
+		// with static caching, call this after adding or removing game objects or moving static ones
+		void invalidateGameObjects();
 	private:
-		void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-		void createPipeline(VkRenderPass renderPass);
+		void createPipelineLayout(const ZDescriptorSetLayout& globalSetLayout);
+		// the config and shaders every variant shares
+		PipelineBuildRequest makePipelineRequest() const;
+		// the game objects that have a model
+		static std::vector<ZGameObject*> collectDrawables(ZGameObject::Map& gameObjects);
+		// bind everything and draw the objects [first, last), repeating the commands to the capture if there is one
+		void recordDraws(VkCommandBuffer commandBuffer, VkDescriptorSet globalDescriptorSet,
+		                 ZGameObject* const* first, ZGameObject* const* last, ZCommandCapture* capture = nullptr);
 
 		ZDevice& m_zDevice;
-		std::unique_ptr<ZPipeline> m_zPipeline;
+		// owns the pipeline and its layout, which may be shared with other systems
+		ZPipelineRegistry& m_pipelineRegistry;
+		PipelineRenderTarget m_renderTarget;
 		VkPipelineLayout m_VkPipelineLayout;
+		// the variant for the current shading profile; compiled on a worker thread and picked up once it is ready
+		ZPipelineRegistry::PipelineId m_pipeline;
+		// the unspecialized variant, which handles any profile (reading the light count from the ubo)
+		ZPipelineRegistry::PipelineId m_fallbackPipeline;
+		// the stages that read the push block, as reflected from the shaders
+		VkShaderStageFlags m_pushConstantStages = 0;
+
+		bool m_isStaticCachingEnabled = false;
+		// created on first use, in the recorder that is passed to renderGameObjects
+		std::optional<ZParallelRecorder::CacheId> m_staticCache;
+		// bumped by invalidateGameObjects, so the cache is recorded again
+		uint64_t m_gameObjectsVersion = 0;
+		// the drawables, split by m_isStatic; collected once per version when caching
+		const ZGameObject::Map* m_collectedGameObjects = nullptr;
+		std::vector<ZGameObject*> m_staticDrawables;
+		std::vector<ZGameObject*> m_dynamicDrawables;
 	};
 }
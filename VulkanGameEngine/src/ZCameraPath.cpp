@@ -0,0 +1,65 @@
+﻿#include "pch.h"
+#include "ZCameraPath.h"
+
+namespace ZZX
+{
+	// y points down, so these are above the floor
+	static constexpr float ORBIT_HEIGHT = -1.5f;
+	static constexpr float FLYTHROUGH_HEIGHT = -0.3f;
+	// one lap (or one crossing and back) per this many seconds
+	static constexpr float PERIOD_SECONDS = 20.f;
+
+	// the rotation that makes ZCamera::setViewYXZ look along direction
+	static glm::vec3 rotationTowards(glm::vec3 direction)
+	{
+		direction = glm::normalize(direction);
+		return {glm::asin(-direction.y), glm::atan(direction.x, direction.z), 0.f};
+	}
+
+	ZCameraPath::ZCameraPath(Type type, float radius)
+		: m_type{type}, m_radius{radius}
+	{
+	}
+
+	std::optional<ZCameraPath::Type> ZCameraPath::typeFromName(const std::string& name)
+	{
+		if (name == "orbit")
+		{
+			return Type::ORBIT;
+		}
+		if (name == "flythrough")
+		{
+			return Type::FLYTHROUGH;
+		}
+		return std::nullopt;
+	}
+
+	TransformComponent ZCameraPath::at(float seconds) const
+	{
+		float phase = glm::two_pi<float>() * seconds / PERIOD_SECONDS;
+		TransformComponent transform{};
+		switch (m_type)
+		{
+		case Type::ORBIT:
+			{
+				float distance = 1.5f * m_radius;
+				transform.translation = {distance * glm::sin(phase), ORBIT_HEIGHT, -distance * glm::cos(phase)};
+				transform.rotation = rotationTowards(-transform.translation);
+				break;
+			}
+		case Type::FLYTHROUGH:
+			{
+				// along z, weaving a little in x, and turning around at either end
+				float z = -m_radius * glm::cos(phase);
+				float x = 0.25f * m_radius * glm::sin(2.f * phase);
+				transform.translation = {x, FLYTHROUGH_HEIGHT, z};
+				// never zero: where z stands still, x moves fastest
+				glm::vec3 velocity{0.5f * m_radius * glm::cos(2.f * phase), 0.f, m_radius * glm::sin(phase)};
+				// look slightly down at the objects
+				transform.rotation = rotationTowards(velocity + glm::vec3{0.f, 0.2f * glm::length(velocity), 0.f});
+				break;
+			}
+		}
+		return transform;
+	}
+}
@@ -0,0 +1,35 @@
+﻿#pragma once
+
+#include "ZGameObject.h"
+
+namespace ZZX
+{
+	/**
+	 * Moves the viewer along a scripted path, so runs see the same views in the same order
+	 * (with a fixed frame time, the same views in the same frames).
+	 */
+	class ZCameraPath
+	{
+	public:
+		enum class Type
+		{
+			// circles the scene, looking at its middle
+			ORBIT,
+			// flies low over the scene from one side to the other and back, looking ahead
+			FLYTHROUGH,
+		};
+
+		// radius: half the size of the scene, which is assumed to be centered on the origin
+		ZCameraPath(Type type, float radius);
+
+		// "orbit" or "flythrough"
+		static std::optional<Type> typeFromName(const std::string& name);
+
+		// the viewer's transform (translation and rotation, as ZCamera::setViewYXZ takes them) after this much time
+		TransformComponent at(float seconds) const;
+
+	private:
+		Type m_type;
+		float m_radius;
+	};
+}
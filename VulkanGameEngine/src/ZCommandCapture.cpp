@@ -0,0 +1,293 @@
+﻿#include "pch.h"
+#include "ZCommandCapture.h"
+
+namespace ZZX
+{
+	// "ZCAP"; the file is in the byte order of the machine that wrote it
+	static constexpr uint32_t CAPTURE_MAGIC = 0x5041435a;
+	static constexpr uint32_t CAPTURE_VERSION = 1;
+
+	static constexpr uint8_t ALPHA_BLENDING_FLAG = 1 << 0;
+	static constexpr uint8_t VERTEX_INPUT_FLAG = 1 << 1;
+
+	template <typename T>
+	static void writeValue(std::ostream& out, const T& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	// the element count, then the elements
+	template <typename T>
+	static void writeArray(std::ostream& out, const std::vector<T>& values)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		writeValue(out, static_cast<uint32_t>(values.size()));
+		out.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T)));
+	}
+
+	template <typename T>
+	static T readValue(std::istream& in)
+	{
+		T value{};
+		if (!in.read(reinterpret_cast<char*>(&value), sizeof(T)))
+		{
+			throw std::runtime_error("failed to read capture: file is truncated!");
+		}
+		return value;
+	}
+
+	template <typename T>
+	static std::vector<T> readArray(std::istream& in)
+	{
+		std::vector<T> values(readValue<uint32_t>(in));
+		if (!in.read(reinterpret_cast<char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T))))
+		{
+			throw std::runtime_error("failed to read capture: file is truncated!");
+		}
+		return values;
+	}
+
+	bool ZCommandStream::Reader::next(Command& command)
+	{
+		if (m_offset == m_commands.size())
+		{
+			return false;
+		}
+		command = Command{static_cast<CapturedOp>(m_commands[m_offset++])};
+		switch (command.op)
+		{
+		case CapturedOp::BIND_PIPELINE:
+		case CapturedOp::BIND_MODEL:
+			command.index = readWord();
+			break;
+		case CapturedOp::PUSH_CONSTANTS:
+			{
+				uint32_t size = readWord();
+				if (m_offset + size > m_commands.size())
+				{
+					throw std::runtime_error("failed to read capture: commands are truncated!");
+				}
+				command.pushConstants = {m_commands.data() + m_offset, size};
+				m_offset += size;
+				break;
+			}
+		case CapturedOp::DRAW:
+			for (uint32_t& value : command.draw)
+			{
+				value = readWord();
+			}
+			break;
+		case CapturedOp::BIND_GLOBAL_SET:
+		case CapturedOp::DRAW_MODEL:
+			break;
+		default:
+			throw std::runtime_error("failed to read capture: unknown command!");
+		}
+		return true;
+	}
+
+	uint32_t ZCommandStream::Reader::readWord()
+	{
+		if (m_offset + sizeof(uint32_t) > m_commands.size())
+		{
+			throw std::runtime_error("failed to read capture: commands are truncated!");
+		}
+		uint32_t word;
+		std::memcpy(&word, m_commands.data() + m_offset, sizeof(word));
+		m_offset += sizeof(word);
+		return word;
+	}
+
+	void ZCommandStream::save(const std::string& filepath) const
+	{
+		std::ofstream file{filepath, std::ios::binary};
+		if (!file)
+		{
+			throw std::runtime_error("failed to open file: " + filepath);
+		}
+		writeValue(file, CAPTURE_MAGIC);
+		writeValue(file, CAPTURE_VERSION);
+		writeValue(file, extent);
+
+		writeValue(file, static_cast<uint32_t>(pipelines.size()));
+		for (const Pipeline& pipeline : pipelines)
+		{
+			writeArray(file, pipeline.vertCode);
+			writeArray(file, pipeline.fragCode);
+			// every constant is one word, see ZSpecializationConstants
+			VkSpecializationInfo info = pipeline.specialization.getInfo();
+			writeValue(file, info.mapEntryCount);
+			for (uint32_t i = 0; i < info.mapEntryCount; i++)
+			{
+				uint32_t word;
+				std::memcpy(&word,
+				            static_cast<const uint8_t*>(info.pData) + info.pMapEntries[i].offset,
+				            sizeof(word));
+				writeValue(file, info.pMapEntries[i].constantID);
+				writeValue(file, word);
+			}
+			uint8_t flags = (pipeline.alphaBlending ? ALPHA_BLENDING_FLAG : 0) |
+				(pipeline.hasVertexInput ? VERTEX_INPUT_FLAG : 0);
+			writeValue(file, flags);
+		}
+
+		writeValue(file, static_cast<uint32_t>(meshes.size()));
+		for (const ZModel::Builder& mesh : meshes)
+		{
+			writeArray(file, mesh.vertices);
+			writeArray(file, mesh.indices);
+		}
+
+		writeValue(file, static_cast<uint32_t>(frames.size()));
+		for (const Frame& frame : frames)
+		{
+			writeValue(file, frame.ubo);
+			writeArray(file, frame.commands);
+		}
+		if (!file)
+		{
+			throw std::runtime_error("failed to write capture: " + filepath);
+		}
+	}
+
+	ZCommandStream ZCommandStream::load(const std::string& filepath)
+	{
+		std::ifstream file{filepath, std::ios::binary};
+		if (!file)
+		{
+			throw std::runtime_error("failed to open file: " + filepath);
+		}
+		if (readValue<uint32_t>(file) != CAPTURE_MAGIC || readValue<uint32_t>(file) != CAPTURE_VERSION)
+		{
+			throw std::runtime_error("failed to read capture: " + filepath + " is not a capture of this version!");
+		}
+
+		ZCommandStream stream{};
+		stream.extent = readValue<VkExtent2D>(file);
+
+		stream.pipelines.resize(readValue<uint32_t>(file));
+		for (Pipeline& pipeline : stream.pipelines)
+		{
+			pipeline.vertCode = readArray<uint32_t>(file);
+			pipeline.fragCode = readArray<uint32_t>(file);
+			auto constantCount = readValue<uint32_t>(file);
+			for (uint32_t i = 0; i < constantCount; i++)
+			{
+				auto constantId = readValue<uint32_t>(file);
+				pipeline.specialization.set(constantId, readValue<uint32_t>(file));
+			}
+			auto flags = readValue<uint8_t>(file);
+			pipeline.alphaBlending = (flags & ALPHA_BLENDING_FLAG) != 0;
+			pipeline.hasVertexInput = (flags & VERTEX_INPUT_FLAG) != 0;
+		}
+
+		stream.meshes.resize(readValue<uint32_t>(file));
+		for (ZModel::Builder& mesh : stream.meshes)
+		{
+			mesh.vertices = readArray<ZModel::Vertex>(file);
+			mesh.indices = readArray<uint32_t>(file);
+		}
+
+		stream.frames.resize(readValue<uint32_t>(file));
+		for (Frame& frame : stream.frames)
+		{
+			frame.ubo = readValue<GlobalUbo>(file);
+			frame.commands = readArray<uint8_t>(file);
+		}
+		return stream;
+	}
+
+	ZCommandCapture::ZCommandCapture(ZPipelineRegistry& pipelineRegistry, VkExtent2D extent)
+		: m_pipelineRegistry{pipelineRegistry}
+	{
+		m_stream.extent = extent;
+	}
+
+	void ZCommandCapture::beginFrame()
+	{
+		assert(!m_isFrameStarted && "Can't call beginFrame while already in progress");
+		m_stream.frames.emplace_back();
+		m_isFrameStarted = true;
+	}
+
+	void ZCommandCapture::endFrame(const GlobalUbo& ubo)
+	{
+		assert(m_isFrameStarted && "Can't call endFrame while frame is not in progress");
+		m_stream.frames.back().ubo = ubo;
+		m_isFrameStarted = false;
+	}
+
+	void ZCommandCapture::bindPipeline(ZPipelineRegistry::PipelineId pipeline)
+	{
+		auto it = m_pipelineIndices.find(pipeline);
+		if (it == m_pipelineIndices.end())
+		{
+			PipelineBuildRequest request = m_pipelineRegistry.getRequest(pipeline);
+			// the SPIR-V the pipeline was made from, with the defines already compiled in
+			auto& shaderModules = m_pipelineRegistry.getPipelineCompiler().getShaderModuleCache();
+			m_stream.pipelines.push_back(ZCommandStream::Pipeline{
+				.vertCode = *shaderModules.getCode(request.vertFilepath, request.defines),
+				.fragCode = *shaderModules.getCode(request.fragFilepath, request.defines),
+				.specialization = request.specialization,
+				.alphaBlending = request.configInfo.colorBlendAttachment.blendEnable == VK_TRUE,
+				.hasVertexInput = !request.configInfo.bindingDescriptions.empty(),
+			});
+			it = m_pipelineIndices.emplace(pipeline, static_cast<uint32_t>(m_stream.pipelines.size() - 1)).first;
+		}
+		writeOp(CapturedOp::BIND_PIPELINE);
+		writeWord(it->second);
+	}
+
+	void ZCommandCapture::bindGlobalDescriptorSet()
+	{
+		writeOp(CapturedOp::BIND_GLOBAL_SET);
+	}
+
+	void ZCommandCapture::pushConstants(const void* data, uint32_t size)
+	{
+		writeOp(CapturedOp::PUSH_CONSTANTS);
+		writeWord(size);
+		writeBytes(data, size);
+	}
+
+	void ZCommandCapture::bindModel(const ZModel& model)
+	{
+		auto it = m_modelIndices.find(&model);
+		if (it == m_modelIndices.end())
+		{
+			m_stream.meshes.push_back(model.readBack());
+			it = m_modelIndices.emplace(&model, static_cast<uint32_t>(m_stream.meshes.size() - 1)).first;
+		}
+		writeOp(CapturedOp::BIND_MODEL);
+		writeWord(it->second);
+	}
+
+	void ZCommandCapture::drawModel()
+	{
+		writeOp(CapturedOp::DRAW_MODEL);
+	}
+
+	void ZCommandCapture::draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex,
+	                           uint32_t firstInstance)
+	{
+		writeOp(CapturedOp::DRAW);
+		for (uint32_t value : {vertexCount, instanceCount, firstVertex, firstInstance})
+		{
+			writeWord(value);
+		}
+	}
+
+	void ZCommandCapture::writeOp(CapturedOp op)
+	{
+		assert(m_isFrameStarted && "Commands can only be captured within a frame");
+		m_stream.frames.back().commands.push_back(static_cast<uint8_t>(op));
+	}
+
+	void ZCommandCapture::writeBytes(const void* data, size_t size)
+	{
+		auto& commands = m_stream.frames.back().commands;
+		const auto* bytes = static_cast<const uint8_t*>(data);
+		commands.insert(commands.end(), bytes, bytes + size);
+	}
+}
@@ -0,0 +1,120 @@
+﻿#pragma once
+
+#include "ZModel.h"
+#include "ZPipelineRegistry.h"
+#include "ZFrameInfo.h"
+
+namespace ZZX
+{
+	// the commands the render systems record, as they are stored in a ZCommandStream
+	enum class CapturedOp : uint8_t
+	{
+		BIND_PIPELINE, // uint32_t pipeline index
+		BIND_GLOBAL_SET, // the frame's global descriptor set, at set 0
+		PUSH_CONSTANTS, // uint32_t size, then the bytes
+		BIND_MODEL, // uint32_t model index
+		DRAW_MODEL, // ZModel::draw of the bound model
+		DRAW, // uint32_t vertexCount, instanceCount, firstVertex, firstInstance
+	};
+
+	/**
+	 * Frames of engine commands with everything needed to run them again: the pipelines (with their SPIR-V),
+	 * the meshes, and each frame's global ubo. No other assets are referenced, so a stream can be replayed
+	 * without the app, and stored in a compact binary file.
+	 */
+	struct ZCommandStream
+	{
+		struct Pipeline
+		{
+			std::vector<uint32_t> vertCode;
+			std::vector<uint32_t> fragCode;
+			ZSpecializationConstants specialization;
+			// the config is ZPipeline::defaultPipelineConfigInfo, changed in the ways the render systems change it
+			bool alphaBlending = false;
+			bool hasVertexInput = true;
+		};
+
+		struct Frame
+		{
+			GlobalUbo ubo{};
+			// CapturedOp, each followed by its arguments
+			std::vector<uint8_t> commands;
+		};
+
+		struct Command
+		{
+			CapturedOp op;
+			// pipeline or model index
+			uint32_t index = 0;
+			std::span<const uint8_t> pushConstants;
+			// vertexCount, instanceCount, firstVertex, firstInstance
+			std::array<uint32_t, 4> draw{};
+		};
+
+		// decodes the commands of a frame one by one
+		class Reader
+		{
+		public:
+			explicit Reader(const Frame& frame) : m_commands{frame.commands} {}
+			// false once every command was read; throws if the stream is truncated
+			bool next(Command& command);
+
+		private:
+			uint32_t readWord();
+
+			const std::vector<uint8_t>& m_commands;
+			size_t m_offset = 0;
+		};
+
+		VkExtent2D extent{};
+		std::vector<Pipeline> pipelines;
+		std::vector<ZModel::Builder> meshes;
+		std::vector<Frame> frames;
+
+		void save(const std::string& filepath) const;
+		static ZCommandStream load(const std::string& filepath);
+	};
+
+	/**
+	 * Captures what the render systems record into a ZCommandStream, alongside the real command buffer.
+	 *
+	 * A pipeline or a model is copied into the stream the first time it is used, so a capture only stalls then
+	 * (models are read back from the GPU). Commands must come from one thread, in order: capture with serial
+	 * recording.
+	 */
+	class ZCommandCapture
+	{
+	public:
+		ZCommandCapture(ZPipelineRegistry& pipelineRegistry, VkExtent2D extent);
+
+		// delete copy ctor and assignment to avoid dangling pointer
+		ZCommandCapture(const ZCommandCapture&) = delete;
+		ZCommandCapture& operator=(const ZCommandCapture&) = delete;
+
+		void beginFrame();
+		// the ubo is only complete once the frame is recorded
+		void endFrame(const GlobalUbo& ubo);
+
+		void bindPipeline(ZPipelineRegistry::PipelineId pipeline);
+		void bindGlobalDescriptorSet();
+		void pushConstants(const void* data, uint32_t size);
+		void bindModel(const ZModel& model);
+		void drawModel();
+		void draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance);
+
+		uint32_t frameCount() const { return static_cast<uint32_t>(m_stream.frames.size()); }
+		const ZCommandStream& getStream() const { return m_stream; }
+
+	private:
+		void writeOp(CapturedOp op);
+		void writeBytes(const void* data, size_t size);
+		void writeWord(uint32_t word) { writeBytes(&word, sizeof(word)); }
+
+		ZPipelineRegistry& m_pipelineRegistry;
+		ZCommandStream m_stream;
+		// where each pipeline and model went in the stream
+		std::unordered_map<ZPipelineRegistry::PipelineId, uint32_t> m_pipelineIndices;
+		std::unordered_map<const ZModel*, uint32_t> m_modelIndices;
+		bool m_isFrameStarted = false;
+	};
+}
@@ -0,0 +1,141 @@
+﻿#include "pch.h"
+#include "ZCpuProfiler.h"
+#include "ZUtils.h"
+
+namespace ZZX
+{
+	std::atomic<bool> ZCpuProfiler::s_isEnabled{false};
+
+	// the GPU gets a track of its own in the trace, next to the CPU threads
+	static constexpr uint32_t GPU_TRACK_ID = 0;
+
+	ZCpuProfiler::Registry& ZCpuProfiler::registry()
+	{
+		// constructed on first use, so scopes in other static initializers are safe
+		static Registry registry;
+		return registry;
+	}
+
+	ZCpuProfiler::ThreadBuffer& ZCpuProfiler::threadBuffer()
+	{
+		thread_local ThreadBuffer* buffer = nullptr;
+		if (buffer == nullptr)
+		{
+			Registry& shared = registry();
+			std::lock_guard<std::mutex> lock{shared.mutex};
+			auto threadId = static_cast<uint32_t>(shared.threads.size() + 1);
+			shared.threads.push_back(std::make_unique<ThreadBuffer>());
+			buffer = shared.threads.back().get();
+			buffer->threadId = threadId;
+			buffer->name = "thread " + std::to_string(threadId);
+		}
+		return *buffer;
+	}
+
+	int64_t ZCpuProfiler::toNs(Clock::time_point time)
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(time - registry().epoch).count();
+	}
+
+	void ZCpuProfiler::setThreadName(const std::string& name)
+	{
+		ThreadBuffer& buffer = threadBuffer();
+		std::lock_guard<std::mutex> lock{registry().mutex};
+		buffer.name = name;
+	}
+
+	void ZCpuProfiler::record(const char* name, Clock::time_point start, Clock::time_point end)
+	{
+		ThreadBuffer& buffer = threadBuffer();
+		// only threads that actually record pay for a buffer
+		if (buffer.events.empty())
+		{
+			buffer.events.resize(EVENTS_PER_THREAD);
+		}
+		size_t index = buffer.count.load(std::memory_order_relaxed);
+		int64_t startNs = toNs(start);
+		buffer.events[index % EVENTS_PER_THREAD] = Event{name, startNs, toNs(end) - startNs};
+		buffer.count.store(index + 1, std::memory_order_release);
+	}
+
+	void ZCpuProfiler::addGpuFrame(const std::vector<ZGpuProfiler::ResolvedScope>& scopes,
+	                               Clock::time_point submitTime)
+	{
+		if (!isEnabled() || scopes.empty())
+		{
+			return;
+		}
+		uint64_t firstBeginNs = std::ranges::min(scopes, {}, &ZGpuProfiler::ResolvedScope::beginNs).beginNs;
+
+		Registry& shared = registry();
+		std::lock_guard<std::mutex> lock{shared.mutex};
+		// the GPU can't start a frame before it was submitted, nor before it finished the last one
+		int64_t frameStartNs = std::max(toNs(submitTime), shared.gpuEndNs);
+		for (const auto& scope : scopes)
+		{
+			int64_t startNs = frameStartNs + static_cast<int64_t>(scope.beginNs - firstBeginNs);
+			int64_t durationNs = static_cast<int64_t>(scope.endNs - scope.beginNs);
+			shared.gpuEvents.push_back(GpuEvent{scope.name, startNs, durationNs});
+			if (shared.gpuEvents.size() > EVENTS_PER_THREAD)
+			{
+				shared.gpuEvents.pop_front();
+			}
+			shared.gpuEndNs = std::max(shared.gpuEndNs, startNs + durationNs);
+		}
+	}
+
+	void ZCpuProfiler::writeChromeTrace(std::ostream& out)
+	{
+		Registry& shared = registry();
+		std::lock_guard<std::mutex> lock{shared.mutex};
+
+		// trace event timestamps are in microseconds
+		// always preceded by the track name
+		auto writeEvent = [&out](const std::string& name, const char* category, uint32_t trackId, int64_t startNs,
+		                         int64_t durationNs)
+		{
+			out << ",\n\t\t{\"name\": " << toJsonString(name)
+				<< ", \"cat\": \"" << category << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << trackId
+				<< ", \"ts\": " << static_cast<double>(startNs) / 1e3
+				<< ", \"dur\": " << static_cast<double>(durationNs) / 1e3 << "}";
+		};
+		auto writeTrackName = [&out](bool isFirst, uint32_t trackId, const std::string& name)
+		{
+			out << (isFirst ? "\n" : ",\n")
+				<< "\t\t{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << trackId
+				<< ", \"args\": {\"name\": " << toJsonString(name) << "}}";
+		};
+
+		auto flags = out.flags();
+		out << std::fixed << std::setprecision(3);
+		out << "{\n\t\"displayTimeUnit\": \"ms\",\n\t\"traceEvents\": [";
+		bool isFirst = true;
+		for (const auto& thread : shared.threads)
+		{
+			size_t count = thread->count.load(std::memory_order_acquire);
+			if (count == 0)
+			{
+				continue;
+			}
+			writeTrackName(isFirst, thread->threadId, thread->name);
+			isFirst = false;
+			// oldest first; older events were overwritten
+			size_t first = count > EVENTS_PER_THREAD ? count - EVENTS_PER_THREAD : 0;
+			for (size_t i = first; i < count; i++)
+			{
+				const Event& event = thread->events[i % EVENTS_PER_THREAD];
+				writeEvent(event.name, "cpu", thread->threadId, event.startNs, event.durationNs);
+			}
+		}
+		if (!shared.gpuEvents.empty())
+		{
+			writeTrackName(isFirst, GPU_TRACK_ID, "GPU");
+			for (const GpuEvent& event : shared.gpuEvents)
+			{
+				writeEvent(event.name, "gpu", GPU_TRACK_ID, event.startNs, event.durationNs);
+			}
+		}
+		out << "\n\t]\n}\n";
+		out.flags(flags);
+	}
+}
@@ -0,0 +1,123 @@
+﻿#pragma once
+
+#include "ZGpuProfiler.h"
+
+// time the rest of the enclosing block as a CPU trace event; name must be a string literal (or otherwise
+// outlive the profiler), as only the pointer is stored
+#define ZZX_PROFILE_CONCAT_INNER(a, b) a##b
+#define ZZX_PROFILE_CONCAT(a, b) ZZX_PROFILE_CONCAT_INNER(a, b)
+#ifdef ZZX_DISABLE_PROFILING
+#define ZZX_PROFILE_SCOPE(name)
+#else
+#define ZZX_PROFILE_SCOPE(name) ::ZZX::ZCpuProfiler::Scope ZZX_PROFILE_CONCAT(profileScope, __LINE__){name}
+#endif
+
+namespace ZZX
+{
+	/**
+	 * Records scoped CPU events on any thread and exports them as a Chrome trace (chrome://tracing, Perfetto).
+	 *
+	 * Every thread writes into its own ring buffer, so recording takes no lock; once a buffer is full the oldest
+	 * events are overwritten. While the profiler is disabled a scope costs one relaxed atomic load. GPU scopes
+	 * from a ZGpuProfiler can be added to the same trace, on a track of their own.
+	 *
+	 * The trace is exported with writeChromeTrace(), which must only run while no other thread records.
+	 */
+	class ZCpuProfiler
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		// events kept per thread
+		static constexpr size_t EVENTS_PER_THREAD = 1 << 16;
+
+		class Scope
+		{
+		public:
+			explicit Scope(const char* name)
+			{
+				if (isEnabled())
+				{
+					m_name = name;
+					m_start = Clock::now();
+				}
+			}
+
+			~Scope()
+			{
+				if (m_name != nullptr)
+				{
+					record(m_name, m_start, Clock::now());
+				}
+			}
+
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+
+		private:
+			// null if the profiler was disabled when the scope began
+			const char* m_name = nullptr;
+			Clock::time_point m_start;
+		};
+
+		static void setEnabled(bool isEnabled) { s_isEnabled.store(isEnabled, std::memory_order_relaxed); }
+		static bool isEnabled() { return s_isEnabled.load(std::memory_order_relaxed); }
+		// shown as the calling thread's track name in the trace
+		static void setThreadName(const std::string& name);
+
+		static void record(const char* name, Clock::time_point start, Clock::time_point end);
+		/**
+		 * \brief Add the GPU scopes of one frame to the trace
+		 * GPU and CPU clocks aren't calibrated against each other, so the frame is placed at the CPU time it was
+		 * submitted (or right after the previous GPU frame, if that ends later): the durations and gaps within the
+		 * frame are exact, its start is an estimate
+		 */
+		static void addGpuFrame(const std::vector<ZGpuProfiler::ResolvedScope>& scopes, Clock::time_point submitTime);
+
+		static void writeChromeTrace(std::ostream& out);
+
+	private:
+		struct Event
+		{
+			const char* name;
+			int64_t startNs;
+			int64_t durationNs;
+		};
+
+		struct ThreadBuffer
+		{
+			std::string name;
+			uint32_t threadId;
+			std::vector<Event> events;
+			// total events recorded; the ring holds the last EVENTS_PER_THREAD of them
+			std::atomic<size_t> count{0};
+		};
+
+		struct GpuEvent
+		{
+			std::string name;
+			int64_t startNs;
+			int64_t durationNs;
+		};
+
+		struct Registry
+		{
+			std::mutex mutex;
+			// every thread's buffer, kept after the thread exits so its events still get exported
+			std::vector<std::unique_ptr<ThreadBuffer>> threads;
+			// bounded like the thread buffers, oldest dropped first
+			std::deque<GpuEvent> gpuEvents;
+			// where the last GPU frame ended
+			int64_t gpuEndNs = 0;
+			// trace timestamps count from here
+			Clock::time_point epoch = Clock::now();
+		};
+
+		static Registry& registry();
+		// the calling thread's buffer, created on first use
+		static ThreadBuffer& threadBuffer();
+		static int64_t toNs(Clock::time_point time);
+
+		static std::atomic<bool> s_isEnabled;
+	};
+}
@@ -157,20 +157,30 @@ namespace ZZX
 	// *************** Descriptor Writer *********************
 
 	ZDescriptorWriter::ZDescriptorWriter(ZDescriptorSetLayout& setLayout, ZDescriptorPool& pool)
-		: m_setLayout{setLayout}, m_pool{pool}
+		: m_bindings{setLayout.getBindings()}, m_setLayout{setLayout.getDescriptorSetLayout()}, m_pool{&pool}
 	{
 	}
 
-	ZDescriptorWriter& ZDescriptorWriter::writeBuffer(
-		uint32_t binding, VkDescriptorBufferInfo* bufferInfo)
+	ZDescriptorWriter::ZDescriptorWriter(const std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding>& bindings)
+		: m_bindings{bindings}
 	{
-		assert(m_setLayout.m_bindings.count(binding) == 1 && "Layout does not contain specified binding");
+	}
 
-		auto& bindingDescription = m_setLayout.m_bindings[binding];
+	const VkDescriptorSetLayoutBinding& ZDescriptorWriter::getBinding(uint32_t binding) const
+	{
+		auto it = m_bindings.find(binding);
+		assert(it != m_bindings.end() && "Layout does not contain specified binding");
 
 		assert(
-			bindingDescription.descriptorCount == 1 &&
+			it->second.descriptorCount == 1 &&
 			"Binding single descriptor info, but binding expects multiple");
+		return it->second;
+	}
+
+	ZDescriptorWriter& ZDescriptorWriter::writeBuffer(
+		uint32_t binding, VkDescriptorBufferInfo* bufferInfo)
+	{
+		auto& bindingDescription = getBinding(binding);
 
 		VkWriteDescriptorSet write{};
 		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -186,13 +196,7 @@ namespace ZZX
 	ZDescriptorWriter& ZDescriptorWriter::writeImage(
 		uint32_t binding, VkDescriptorImageInfo* imageInfo)
 	{
-		assert(m_setLayout.m_bindings.count(binding) == 1 && "Layout does not contain specified binding");
-
-		auto& bindingDescription = m_setLayout.m_bindings[binding];
-
-		assert(
-			bindingDescription.descriptorCount == 1 &&
-			"Binding single descriptor info, but binding expects multiple");
+		auto& bindingDescription = getBinding(binding);
 
 		VkWriteDescriptorSet write{};
 		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -207,7 +211,8 @@ namespace ZZX
 
 	bool ZDescriptorWriter::build(VkDescriptorSet& set)
 	{
-		bool success = m_pool.allocateDescriptorSet(m_setLayout.getDescriptorSetLayout(), set);
+		assert(m_pool != nullptr && "Writer was created without a pool");
+		bool success = m_pool->allocateDescriptorSet(m_setLayout, set);
 		if (!success)
 		{
 			return false;
@@ -218,11 +223,12 @@ namespace ZZX
 
 	void ZDescriptorWriter::overwrite(VkDescriptorSet& set)
 	{
+		assert(m_pool != nullptr && "Writer was created without a pool");
 		for (auto& write : m_writes)
 		{
 			write.dstSet = set;
 		}
-		vkUpdateDescriptorSets(m_pool.m_zDevice.device(),
+		vkUpdateDescriptorSets(m_pool->m_zDevice.device(),
 		                       static_cast<uint32_t>(m_writes.size()),
 		                       m_writes.data(),
 		                       0,
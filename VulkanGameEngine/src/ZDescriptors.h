@@ -34,13 +34,12 @@ namespace ZZX
 		ZDescriptorSetLayout& operator=(const ZDescriptorSetLayout&) = delete;
 
 		VkDescriptorSetLayout getDescriptorSetLayout() const { return m_descriptorSetLayout; }
+		const std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding>& getBindings() const { return m_bindings; }
 
 	private:
 		ZDevice& m_zDevice;
 		VkDescriptorSetLayout m_descriptorSetLayout;
 		std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> m_bindings;
-
-		friend class ZDescriptorWriter;
 	};
 
 	class ZDescriptorPool
@@ -92,6 +91,8 @@ namespace ZZX
 	{
 	public:
 		ZDescriptorWriter(ZDescriptorSetLayout& setLayout, ZDescriptorPool& pool);
+		// only collects the writes (see getWrites), so it needs no device; build and overwrite need a pool
+		explicit ZDescriptorWriter(const std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding>& bindings);
 
 		ZDescriptorWriter& writeBuffer(uint32_t binding, VkDescriptorBufferInfo* bufferInfo);
 		ZDescriptorWriter& writeImage(uint32_t binding, VkDescriptorImageInfo* imageInfo);
@@ -99,9 +100,15 @@ namespace ZZX
 		bool build(VkDescriptorSet& set);
 		void overwrite(VkDescriptorSet& set);
 
+		const std::vector<VkWriteDescriptorSet>& getWrites() const { return m_writes; }
+
 	private:
-		ZDescriptorSetLayout& m_setLayout;
-		ZDescriptorPool& m_pool;
+		// the binding's description, which the write is checked against
+		const VkDescriptorSetLayoutBinding& getBinding(uint32_t binding) const;
+
+		const std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding>& m_bindings;
+		VkDescriptorSetLayout m_setLayout = VK_NULL_HANDLE;
+		ZDescriptorPool* m_pool = nullptr;
 		std::vector<VkWriteDescriptorSet> m_writes;
 	};
 }
@@ -59,10 +59,13 @@ namespace ZZX
 		createLogicalDevice();
 		// Command pool creation
 		createCommandPool();
+		m_graphicsTimeline = std::make_unique<ZTimeline>(m_VkDevice, m_capabilities.timelineSemaphore);
 	}
 
 	ZDevice::~ZDevice()
 	{
+		m_graphicsTimeline = nullptr;
+
 		// this call will destroy both the command pool and any command buffers allocated from this pool
 		vkDestroyCommandPool(m_VkDevice, m_VkCommandPool, nullptr);
 
@@ -92,6 +95,10 @@ namespace ZZX
 			throw std::runtime_error("extensions requested, but not available!");
 		}
 
+		// ask for Vulkan 1.3 when the loader knows it; optional 1.3 features are only used when the device has them too
+		vkEnumerateInstanceVersion(&m_instanceApiVersion);
+		m_instanceApiVersion = std::min(m_instanceApiVersion, static_cast<uint32_t>(VK_API_VERSION_1_3));
+
 		// Before creating an instance, we can optionally provide some info about our application to the driver for potential optimization
 		VkApplicationInfo appInfo{
 			.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
@@ -99,7 +106,7 @@ namespace ZZX
 			.applicationVersion = VK_MAKE_VERSION(1, 0, 0),
 			.pEngineName = "No Engine",
 			.engineVersion = VK_MAKE_VERSION(1, 0, 0),
-			.apiVersion = VK_API_VERSION_1_0,
+			.apiVersion = m_instanceApiVersion,
 		};
 
 		// To create an instance, we must provide a createInfo struct that tells the Vulkan driver which *global* extensions and validation layers we want to use
@@ -170,6 +177,7 @@ namespace ZZX
 		if (candidates.rbegin()->first > 0)
 		{
 			m_VkPhysicalDevice = std::get<0>(candidates.rbegin()->second);
+			vkGetPhysicalDeviceProperties(m_VkPhysicalDevice, &m_properties);
 		}
 		else
 		{
@@ -199,7 +207,8 @@ namespace ZZX
 		score += deviceProperties.limits.maxImageDimension2D;
 
 		// Application can't function without geometry shaders
-		if (!deviceFeatures.geometryShader)
+		// (headless runs are meant for CI and software drivers like lavapipe, which don't need to be picky)
+		if (!deviceFeatures.geometryShader && !isHeadless())
 		{
 			return { 0, deviceProperties.deviceName };
 		}
@@ -218,6 +227,12 @@ namespace ZZX
 			score += 1000;
 		}
 
+		// nothing to present to without a window
+		if (isHeadless())
+		{
+			return { score + 1, deviceProperties.deviceName };
+		}
+
 		// check if swap chain support is sufficient
 		bool swapChainAdequate = false;
 		if (checkDeviceExtensionSupport(device))
@@ -261,12 +276,72 @@ namespace ZZX
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
 		createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
-		// Specifying used device features (empty for now)
+		// optional Vulkan 1.2 and 1.3 features; extended dynamic state 1 and 2 are core without a feature bit
+		queryCapabilities();
+
+		// Specifying used device features (only optional ones)
 		VkPhysicalDeviceFeatures deviceFeatures{};
+		deviceFeatures.occlusionQueryPrecise = m_capabilities.occlusionQueryPrecise;
+		deviceFeatures.pipelineStatisticsQuery = m_capabilities.pipelineStatisticsQuery;
 		createInfo.pEnabledFeatures = &deviceFeatures;
+		VkPhysicalDeviceVulkan13Features vulkan13Features{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+			.synchronization2 = m_capabilities.synchronization2,
+			.dynamicRendering = m_capabilities.dynamicRendering,
+		};
+		if (m_capabilities.apiVersion >= VK_API_VERSION_1_3)
+		{
+			createInfo.pNext = &vulkan13Features;
+		}
+		VkPhysicalDeviceVulkan12Features vulkan12Features{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+			.pNext = const_cast<void*>(createInfo.pNext),
+			.shaderFloat16 = m_capabilities.shaderFloat16,
+			.timelineSemaphore = m_capabilities.timelineSemaphore,
+		};
+		if (m_capabilities.apiVersion >= VK_API_VERSION_1_2)
+		{
+			createInfo.pNext = &vulkan12Features;
+		}
+
+		// optional extensions; headless devices don't need a swap chain
+		std::vector<const char*> deviceExtensions = isHeadless() ? std::vector<const char*>{} : m_deviceExtensions;
+		VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipelineLibraryFeatures{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT,
+			.pNext = const_cast<void*>(createInfo.pNext),
+			.graphicsPipelineLibrary = VK_TRUE,
+		};
+		if (m_capabilities.graphicsPipelineLibrary)
+		{
+			deviceExtensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+			deviceExtensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+			createInfo.pNext = &pipelineLibraryFeatures;
+		}
+		VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+			.pNext = const_cast<void*>(createInfo.pNext),
+			.presentId = VK_TRUE,
+		};
+		VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR,
+			.pNext = &presentIdFeatures,
+			.presentWait = VK_TRUE,
+		};
+		if (m_capabilities.presentWait)
+		{
+			deviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+			deviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+			createInfo.pNext = &presentWaitFeatures;
+		}
+
+		if (m_capabilities.memoryBudget)
+		{
+			deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		}
+
 		// Enabling device extensions
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(m_deviceExtensions.size());
-		createInfo.ppEnabledExtensionNames = m_deviceExtensions.data();
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
 		// Enabling device layers (deprecated)
 		if (m_enableValidationLayers)
 		{
@@ -289,6 +364,152 @@ namespace ZZX
 		// we only have a single queue from each queue family. Thus, queueIndex is 0
 		vkGetDeviceQueue(m_VkDevice, indices.graphicsFamily.value(), 0, &m_VkGraphicsQueue);
 		vkGetDeviceQueue(m_VkDevice, indices.presentFamily.value(), 0, &m_VkPresentQueue);
+
+		if (m_capabilities.presentWait)
+		{
+			m_vkWaitForPresentKHR = reinterpret_cast<PFN_vkWaitForPresentKHR>(
+				vkGetDeviceProcAddr(m_VkDevice, "vkWaitForPresentKHR"));
+		}
+	}
+
+	VkResult ZDevice::waitForPresent(VkSwapchainKHR swapChain, uint64_t presentId, uint64_t timeout)
+	{
+		assert(m_vkWaitForPresentKHR != nullptr && "present wait is not enabled on this device");
+		return m_vkWaitForPresentKHR(m_VkDevice, swapChain, presentId, timeout);
+	}
+
+	VkDeviceSize ZDevice::getDeviceLocalMemoryUsage()
+	{
+		assert(m_capabilities.memoryBudget && "memory budget is not enabled on this device");
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+		};
+		VkPhysicalDeviceMemoryProperties2 memoryProperties{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+			.pNext = &budget,
+		};
+		vkGetPhysicalDeviceMemoryProperties2(m_VkPhysicalDevice, &memoryProperties);
+
+		VkDeviceSize usage = 0;
+		for (uint32_t i = 0; i < memoryProperties.memoryProperties.memoryHeapCount; i++)
+		{
+			if (memoryProperties.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+			{
+				usage += budget.heapUsage[i];
+			}
+		}
+		return usage;
+	}
+
+	void ZDevice::queryCapabilities()
+	{
+		m_capabilities = {};
+		// a 1.3 device is only usable as one if the instance was created for 1.3 as well
+		m_capabilities.apiVersion = std::min(m_properties.apiVersion, m_instanceApiVersion);
+
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(m_VkPhysicalDevice, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(m_VkPhysicalDevice, nullptr, &extensionCount, availableExtensions.data());
+		std::set<std::string> extensions;
+		for (const auto& extension : availableExtensions)
+		{
+			extensions.insert(extension.extensionName);
+		}
+
+		if (m_capabilities.apiVersion >= VK_API_VERSION_1_2)
+		{
+			bool hasPresentWait = extensions.count(VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+				extensions.count(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+
+			VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{
+				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+			};
+			VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{
+				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR,
+				.pNext = &presentIdFeatures,
+			};
+			VkPhysicalDeviceVulkan12Features vulkan12Features{
+				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+				.pNext = hasPresentWait ? &presentWaitFeatures : nullptr,
+			};
+			VkPhysicalDeviceFeatures2 features{
+				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+				.pNext = &vulkan12Features,
+			};
+			vkGetPhysicalDeviceFeatures2(m_VkPhysicalDevice, &features);
+			m_capabilities.shaderFloat16 = vulkan12Features.shaderFloat16;
+			m_capabilities.timelineSemaphore = vulkan12Features.timelineSemaphore;
+			// both build on the swap chain extension
+			m_capabilities.presentWait = presentIdFeatures.presentId && presentWaitFeatures.presentWait &&
+				!isHeadless();
+		}
+		if (m_capabilities.apiVersion >= VK_API_VERSION_1_3)
+		{
+			bool hasPipelineLibrary = extensions.count(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+				extensions.count(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+
+			VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipelineLibraryFeatures{
+				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT,
+			};
+			VkPhysicalDeviceVulkan13Features vulkan13Features{
+				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+				// the extension structs may only be chained if the extension exists
+				.pNext = hasPipelineLibrary ? &pipelineLibraryFeatures : nullptr,
+			};
+			VkPhysicalDeviceFeatures2 features{
+				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+				.pNext = &vulkan13Features,
+			};
+			vkGetPhysicalDeviceFeatures2(m_VkPhysicalDevice, &features);
+
+			VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT pipelineLibraryProperties{
+				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT,
+			};
+			VkPhysicalDeviceProperties2 properties{
+				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+				.pNext = hasPipelineLibrary ? &pipelineLibraryProperties : nullptr,
+			};
+			vkGetPhysicalDeviceProperties2(m_VkPhysicalDevice, &properties);
+
+			m_capabilities.extendedDynamicState = true;
+			m_capabilities.extendedDynamicState2 = true;
+			m_capabilities.dynamicRendering = vulkan13Features.dynamicRendering;
+			m_capabilities.synchronization2 = vulkan13Features.synchronization2;
+			// without fast linking, a link costs about as much as a full compile and libraries don't buy anything
+			m_capabilities.graphicsPipelineLibrary = pipelineLibraryFeatures.graphicsPipelineLibrary &&
+				pipelineLibraryProperties.graphicsPipelineLibraryFastLinking;
+		}
+
+		uint32_t queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(m_VkPhysicalDevice, &queueFamilyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(m_VkPhysicalDevice, &queueFamilyCount, queueFamilies.data());
+		m_capabilities.timestampValidBits =
+			queueFamilies[findQueueFamilyIndices(m_VkPhysicalDevice).graphicsFamily.value()].timestampValidBits;
+		VkPhysicalDeviceFeatures features;
+		vkGetPhysicalDeviceFeatures(m_VkPhysicalDevice, &features);
+		m_capabilities.pipelineStatisticsQuery = features.pipelineStatisticsQuery;
+		m_capabilities.occlusionQueryPrecise = features.occlusionQueryPrecise;
+		// read through vkGetPhysicalDeviceMemoryProperties2, core in 1.1
+		m_capabilities.memoryBudget = extensions.count(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) &&
+			m_capabilities.apiVersion >= VK_API_VERSION_1_1;
+
+		std::cout << "Device capabilities:\n"
+			<< "\tVulkan " << VK_API_VERSION_MAJOR(m_capabilities.apiVersion) << '.'
+			<< VK_API_VERSION_MINOR(m_capabilities.apiVersion) << '\n'
+			<< "\tExtended dynamic state: " << m_capabilities.extendedDynamicState << '\n'
+			<< "\tExtended dynamic state 2: " << m_capabilities.extendedDynamicState2 << '\n'
+			<< "\tDynamic rendering: " << m_capabilities.dynamicRendering << '\n'
+			<< "\tSynchronization2: " << m_capabilities.synchronization2 << '\n'
+			<< "\tGraphics pipeline library: " << m_capabilities.graphicsPipelineLibrary << '\n'
+			<< "\tShader float16: " << m_capabilities.shaderFloat16 << '\n'
+			<< "\tTimeline semaphore: " << m_capabilities.timelineSemaphore << '\n'
+			<< "\tPresent wait: " << m_capabilities.presentWait << '\n'
+			<< "\tTimestamp bits: " << m_capabilities.timestampValidBits << '\n'
+			<< "\tPipeline statistics query: " << m_capabilities.pipelineStatisticsQuery << '\n'
+			<< "\tPrecise occlusion query: " << m_capabilities.occlusionQueryPrecise << '\n'
+			<< "\tMemory budget: " << m_capabilities.memoryBudget << '\n';
 	}
 
 	void ZDevice::createCommandPool()
@@ -309,7 +530,13 @@ namespace ZZX
 		}
 	}
 
-	void ZDevice::createSurface() { m_ZWindow.createWindowSurface(m_VkInstance, &m_VkSurfaceKHR); }
+	void ZDevice::createSurface()
+	{
+		if (!isHeadless())
+		{
+			m_ZWindow.createWindowSurface(m_VkInstance, &m_VkSurfaceKHR);
+		}
+	}
 
 	void ZDevice::populateDebugMessengerCreateInfo(
 		VkDebugUtilsMessengerCreateInfoEXT& createInfo)
@@ -398,8 +625,12 @@ namespace ZZX
 
 		// fill desired extensions
 		uint32_t glfwExtensionCount = 0;
-		const char** glfwExtensions;
-		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		const char** glfwExtensions = nullptr;
+		// GLFW isn't even initialized without a window
+		if (!isHeadless())
+		{
+			glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		}
 		// these extensions are requested by GLFW 
 		for (uint32_t i = 0; i < glfwExtensionCount; i++)
 		{
@@ -438,8 +669,16 @@ namespace ZZX
 			}
 
 			// find at least one queue family that supports presentation
+			// (when headless nothing is presented, so the graphics queue stands in)
 			VkBool32 presentSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_VkSurfaceKHR, &presentSupport);
+			if (isHeadless())
+			{
+				presentSupport = (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+			}
+			else
+			{
+				vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_VkSurfaceKHR, &presentSupport);
+			}
 			if (presentSupport)
 			{
 				indices.presentFamily = i;
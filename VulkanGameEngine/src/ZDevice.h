@@ -1,5 +1,6 @@
 ﻿#pragma once
 #include "ZWindow.h"
+#include "ZTimeline.h"
 
 namespace ZZX
 {
@@ -30,6 +31,38 @@ namespace ZZX
 		std::vector<VkPresentModeKHR> presentModes;
 	};
 
+	// optional device features, detected when the logical device is created
+	// everything here has a fallback, so the engine still runs on a plain Vulkan 1.0 device
+	struct DeviceCapabilities
+	{
+		// the Vulkan version both the instance and the physical device support
+		uint32_t apiVersion = VK_API_VERSION_1_0;
+		// cull mode, front face, topology and depth test state can be set on the command buffer
+		bool extendedDynamicState = false;
+		// depth bias, primitive restart and rasterizer discard enables can be set on the command buffer
+		bool extendedDynamicState2 = false;
+		// render without VkRenderPass and VkFramebuffer objects
+		bool dynamicRendering = false;
+		// barriers and submits with 64-bit stage/access masks (vkCmdPipelineBarrier2, core in 1.3)
+		bool synchronization2 = false;
+		// pipelines can be linked from separately compiled parts, and linking without optimization is fast
+		bool graphicsPipelineLibrary = false;
+		// shaders can do arithmetic on 16-bit floats (VK_KHR_shader_float16_int8, core in 1.2)
+		bool shaderFloat16 = false;
+		// semaphores with a 64-bit counter that the CPU can wait on (VK_KHR_timeline_semaphore, core in 1.2)
+		bool timelineSemaphore = false;
+		// presents can carry an id and the CPU can wait until an id is on screen (VK_KHR_present_id/present_wait)
+		bool presentWait = false;
+		// how many bits of a timestamp the graphics queue writes; 0 if it can't write timestamps at all
+		uint32_t timestampValidBits = 0;
+		// pipeline statistics queries (vertex/fragment invocations and the like)
+		bool pipelineStatisticsQuery = false;
+		// occlusion queries count the exact number of samples, rather than just whether any passed
+		bool occlusionQueryPrecise = false;
+		// the driver reports how much of each memory heap the process uses (VK_EXT_memory_budget)
+		bool memoryBudget = false;
+	};
+
 	class ZDevice
 	{
 	public:
@@ -55,6 +88,15 @@ namespace ZZX
 		VkQueue graphicsQueue() { return m_VkGraphicsQueue; }
 		VkQueue presentQueue() { return m_VkPresentQueue; }
 		ZWindow& getZWindow() const { return m_ZWindow; }
+		// no surface, no swap chain extension; frames render to offscreen images
+		bool isHeadless() const { return m_ZWindow.isHeadless(); }
+		const DeviceCapabilities& getCapabilities() const { return m_capabilities; }
+		// counts the frames submitted to the graphics queue
+		ZTimeline& graphicsTimeline() { return *m_graphicsTimeline; }
+		// vkWaitForPresentKHR; requires DeviceCapabilities::presentWait
+		VkResult waitForPresent(VkSwapchainKHR swapChain, uint64_t presentId, uint64_t timeout);
+		// bytes of device local memory the process uses right now; requires DeviceCapabilities::memoryBudget
+		VkDeviceSize getDeviceLocalMemoryUsage();
 
 		SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(m_VkPhysicalDevice); }
 		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -91,6 +133,7 @@ namespace ZZX
 		void pickPhysicalDevice();
 		void createLogicalDevice();
 		void createCommandPool();
+		void queryCapabilities();
 
 		// helper functions
 		std::tuple<int, std::string> rateDeviceSuitability(VkPhysicalDevice device);
@@ -102,6 +145,9 @@ namespace ZZX
 		SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
 		VkInstance m_VkInstance;
+		// the highest version the loader supports, capped at the version we are written against
+		uint32_t m_instanceApiVersion = VK_API_VERSION_1_0;
+		DeviceCapabilities m_capabilities;
 		VkDebugUtilsMessengerEXT m_VkDebugUtilsMessengerEXT;
 
 		// the graphics card that supports the features we need
@@ -111,9 +157,13 @@ namespace ZZX
 		VkCommandPool m_VkCommandPool;
 
 		VkDevice m_VkDevice;
-		VkSurfaceKHR m_VkSurfaceKHR;
+		// VK_NULL_HANDLE when headless
+		VkSurfaceKHR m_VkSurfaceKHR = VK_NULL_HANDLE;
 		VkQueue m_VkGraphicsQueue;
 		VkQueue m_VkPresentQueue;
+		std::unique_ptr<ZTimeline> m_graphicsTimeline;
+		// extension functions are not exported by the loader
+		PFN_vkWaitForPresentKHR m_vkWaitForPresentKHR = nullptr;
 
 		const std::vector<const char*> m_validationLayers = {
 			"VK_LAYER_KHRONOS_validation"
@@ -4,6 +4,9 @@
 
 namespace ZZX
 {
+	class ZCommandCapture;
+
+	// keep in sync with assets/shaders/global_ubo.glsl
 #define MAX_LIGHTS 10
 	struct PointLight
 	{
@@ -29,5 +32,7 @@ namespace ZZX
 		ZCamera& camera;
 		VkDescriptorSet globalDescriptorSet;
 		ZGameObject::Map& gameObjects;
+		// set while the frame is being captured; only the serial render functions capture their commands
+		ZCommandCapture* capture = nullptr;
 	};
 }
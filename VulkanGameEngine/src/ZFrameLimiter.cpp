@@ -0,0 +1,43 @@
+﻿#include "pch.h"
+#include "ZFrameLimiter.h"
+
+namespace ZZX
+{
+	// how long before the deadline to stop trusting the OS sleep and spin instead
+	static constexpr auto SPIN_THRESHOLD = std::chrono::microseconds{1500};
+
+	ZFrameLimiter::ZFrameLimiter(double framesPerSecond)
+		: m_period{
+			  framesPerSecond > 0.0
+				  ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>{1.0 / framesPerSecond})
+				  : Clock::duration::zero()
+		  },
+		  m_nextFrame{Clock::now()}
+	{
+	}
+
+	void ZFrameLimiter::wait()
+	{
+		if (!isEnabled())
+		{
+			return;
+		}
+
+		auto now = Clock::now();
+		if (now - m_nextFrame > m_period)
+		{
+			// we fell behind by more than a frame, start over from now
+			m_nextFrame = now;
+		}
+
+		if (m_nextFrame - now > SPIN_THRESHOLD)
+		{
+			std::this_thread::sleep_for(m_nextFrame - now - SPIN_THRESHOLD);
+		}
+		while (Clock::now() < m_nextFrame)
+		{
+			std::this_thread::yield();
+		}
+		m_nextFrame += m_period;
+	}
+}
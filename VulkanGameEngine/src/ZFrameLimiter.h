@@ -0,0 +1,29 @@
+﻿#pragma once
+
+namespace ZZX
+{
+	/**
+	 * Paces the render loop to a fixed frame rate.
+	 *
+	 * The OS sleep is only accurate to a millisecond or worse, so wait() sleeps until shortly before the
+	 * deadline and spins for the rest. Deadlines advance by whole frame periods, so an early frame doesn't
+	 * make the next one late; after a hitch of more than a frame the limiter starts over instead of
+	 * rushing to catch up.
+	 */
+	class ZFrameLimiter
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		// 0 disables the limiter
+		ZFrameLimiter(double framesPerSecond = 0.0);
+
+		bool isEnabled() const { return m_period.count() > 0; }
+		// returns once the next frame is due
+		void wait();
+
+	private:
+		Clock::duration m_period;
+		Clock::time_point m_nextFrame;
+	};
+}
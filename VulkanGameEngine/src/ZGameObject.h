@@ -45,6 +45,8 @@ namespace ZZX
 		std::shared_ptr<ZModel> m_model{};
 		glm::vec3 m_color{};
 		TransformComponent m_transform{};
+		// never moves, so its draws can be recorded once and reused (see SimpleRenderSystem::setStaticCaching)
+		bool m_isStatic = false;
 
 		std::unique_ptr<PointLightComponent> m_pointLight = nullptr;
 	private:
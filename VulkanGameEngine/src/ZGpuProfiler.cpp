@@ -0,0 +1,205 @@
+﻿#include "pch.h"
+#include "ZGpuProfiler.h"
+#include "ZUtils.h"
+
+namespace ZZX
+{
+	ZGpuProfiler::ZGpuProfiler(ZDevice& device, uint32_t maxScopesPerFrame)
+		: m_zDevice{device}, m_maxScopes{maxScopesPerFrame},
+		  m_nsPerTick{device.m_properties.limits.timestampPeriod}
+	{
+		uint32_t validBits = device.getCapabilities().timestampValidBits;
+		if (validBits == 0)
+		{
+			return;
+		}
+		m_validBitsMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+		VkQueryPoolCreateInfo poolInfo{
+			.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+			.queryType = VK_QUERY_TYPE_TIMESTAMP,
+			// a begin and an end per scope
+			.queryCount = 2 * m_maxScopes,
+		};
+		m_queries.emplace(m_zDevice, std::vector{poolInfo});
+		m_frameScopes.resize(m_queries->getFrameCount());
+	}
+
+	void ZGpuProfiler::beginFrame(VkCommandBuffer commandBuffer, int frameIndex, uint64_t frameValue)
+	{
+		if (!isSupported())
+		{
+			return;
+		}
+		assert(m_depth == 0 && "the last frame has scopes that never ended");
+		m_queries->beginFrame(commandBuffer, frameIndex, frameValue, std::bind_front(&ZGpuProfiler::resolve, this));
+		m_frameScopes[frameIndex].clear();
+	}
+
+	ZGpuProfiler::ScopeId ZGpuProfiler::beginScope(VkCommandBuffer commandBuffer, const std::string& name)
+	{
+		if (!isSupported())
+		{
+			return INVALID_SCOPE;
+		}
+		assert(m_queries->getFrameIndex() >= 0 && "cannot begin a scope before beginFrame");
+		std::vector<Scope>& scopes = m_frameScopes[m_queries->getFrameIndex()];
+		if (scopes.size() >= m_maxScopes)
+		{
+			return INVALID_SCOPE;
+		}
+		auto scope = static_cast<ScopeId>(scopes.size());
+		scopes.push_back(Scope{name, m_depth++});
+		// written once everything before it has started, i.e. as soon as the scope's first command can
+		writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, 2 * scope);
+		return scope;
+	}
+
+	void ZGpuProfiler::endScope(VkCommandBuffer commandBuffer, ScopeId scope)
+	{
+		if (scope == INVALID_SCOPE)
+		{
+			return;
+		}
+		std::vector<Scope>& scopes = m_frameScopes[m_queries->getFrameIndex()];
+		assert(scope < scopes.size() && !scopes[scope].isEnded && "Scope was not begun this frame");
+		// written once everything before it has finished
+		writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, 2 * scope + 1);
+		scopes[scope].isEnded = true;
+		m_depth--;
+	}
+
+	void ZGpuProfiler::resolveFinishedFrames()
+	{
+		if (isSupported())
+		{
+			m_queries->resolveFinishedFrames(std::bind_front(&ZGpuProfiler::resolve, this));
+		}
+	}
+
+	void ZGpuProfiler::writeTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlags2 stage, uint32_t query)
+	{
+		VkQueryPool queryPool = m_queries->getPool(m_queries->getFrameIndex(), 0);
+		if (m_zDevice.getCapabilities().synchronization2)
+		{
+			vkCmdWriteTimestamp2(commandBuffer, stage, queryPool, query);
+		}
+		else
+		{
+			vkCmdWriteTimestamp(commandBuffer,
+			                    stage == VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT
+				                    ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT
+				                    : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			                    queryPool,
+			                    query);
+		}
+	}
+
+	void ZGpuProfiler::resolve(int frameIndex, uint64_t frameValue)
+	{
+		std::vector<Scope>& scopes = m_frameScopes[frameIndex];
+		if (scopes.empty())
+		{
+			return;
+		}
+
+		// a value and an availability word per query
+		std::vector<uint64_t> results =
+			m_queries->getResults(frameIndex, 0, static_cast<uint32_t>(2 * scopes.size()), 1);
+
+		m_lastResolvedFrame.clear();
+		m_lastResolvedFrameValue = frameValue;
+		for (size_t i = 0; i < scopes.size(); i++)
+		{
+			const Scope& scope = scopes[i];
+			uint64_t begin = results[4 * i];
+			uint64_t end = results[4 * i + 2];
+			bool isAvailable = results[4 * i + 1] != 0 && results[4 * i + 3] != 0;
+			if (!scope.isEnded || !isAvailable)
+			{
+				continue;
+			}
+			// the difference is right even if the counter wrapped in between
+			uint64_t ticks = (end - begin) & m_validBitsMask;
+			double durationNs = static_cast<double>(ticks) * m_nsPerTick;
+			auto beginNs = static_cast<uint64_t>(static_cast<double>(begin & m_validBitsMask) * m_nsPerTick);
+			m_lastResolvedFrame.push_back(ResolvedScope{
+				scope.name, scope.depth, beginNs, beginNs + static_cast<uint64_t>(durationNs)
+			});
+			double durationMs = durationNs / 1e6;
+
+			auto [index, isNew] = m_historyIndices.try_emplace(scope.name, m_histories.size());
+			if (isNew)
+			{
+				m_histories.push_back(History{scope.name});
+			}
+			History& history = m_histories[index->second];
+			if (history.samplesMs.size() < HISTORY_SIZE)
+			{
+				history.samplesMs.push_back(durationMs);
+			}
+			else
+			{
+				history.samplesMs[history.next] = durationMs;
+			}
+			history.next = (history.next + 1) % HISTORY_SIZE;
+		}
+		scopes.clear();
+	}
+
+	std::vector<ZGpuProfiler::ScopeStats> ZGpuProfiler::getStats() const
+	{
+		std::vector<ScopeStats> stats;
+		stats.reserve(m_histories.size());
+		for (const History& history : m_histories)
+		{
+			std::vector<double> sorted = history.samplesMs;
+			std::ranges::sort(sorted);
+			double sum = 0.0;
+			for (double sample : sorted)
+			{
+				sum += sample;
+			}
+			stats.push_back(ScopeStats{
+				.name = history.name,
+				.sampleCount = sorted.size(),
+				.averageMs = sorted.empty() ? 0.0 : sum / static_cast<double>(sorted.size()),
+				.p50Ms = percentile(sorted, 0.50),
+				.p95Ms = percentile(sorted, 0.95),
+				.p99Ms = percentile(sorted, 0.99),
+				.maxMs = sorted.empty() ? 0.0 : sorted.back(),
+			});
+		}
+		return stats;
+	}
+
+	void ZGpuProfiler::writeCsv(std::ostream& out) const
+	{
+		out << "scope,samples,average_ms,p50_ms,p95_ms,p99_ms,max_ms\n";
+		for (const ScopeStats& scope : getStats())
+		{
+			// scope names are ours and never contain commas or quotes
+			out << scope.name << ',' << scope.sampleCount << ',' << scope.averageMs << ',' << scope.p50Ms << ','
+				<< scope.p95Ms << ',' << scope.p99Ms << ',' << scope.maxMs << '\n';
+		}
+	}
+
+	void ZGpuProfiler::writeJson(std::ostream& out) const
+	{
+		out << "{\n\t\"scopes\": [";
+		auto stats = getStats();
+		for (size_t i = 0; i < stats.size(); i++)
+		{
+			const ScopeStats& scope = stats[i];
+			out << (i > 0 ? ",\n" : "\n")
+				<< "\t\t{\"name\": " << toJsonString(scope.name)
+				<< ", \"samples\": " << scope.sampleCount
+				<< ", \"average_ms\": " << scope.averageMs
+				<< ", \"p50_ms\": " << scope.p50Ms
+				<< ", \"p95_ms\": " << scope.p95Ms
+				<< ", \"p99_ms\": " << scope.p99Ms
+				<< ", \"max_ms\": " << scope.maxMs << "}";
+		}
+		out << "\n\t]\n}\n";
+	}
+}
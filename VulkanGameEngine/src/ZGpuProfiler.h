@@ -0,0 +1,108 @@
+﻿#pragma once
+
+#include "ZQueryRing.h"
+
+namespace ZZX
+{
+	/**
+	 * Measures how long scopes of a frame take on the GPU, with timestamp queries.
+	 *
+	 * A scope writes one timestamp when it begins and one when it ends, into the frame's pool of a ZQueryRing,
+	 * which reads them back without stalling. Scopes may nest, and a scope with the same name in every frame
+	 * builds up a rolling history that averages and percentiles are computed from.
+	 *
+	 * Devices whose graphics queue can't write timestamps get a profiler that records nothing.
+	 */
+	class ZGpuProfiler
+	{
+	public:
+		using ScopeId = uint32_t;
+		// returned when the frame has no queries left; ending it does nothing
+		static constexpr ScopeId INVALID_SCOPE = std::numeric_limits<ScopeId>::max();
+		static constexpr uint32_t DEFAULT_MAX_SCOPES = 64;
+		// samples kept per scope for the statistics
+		static constexpr size_t HISTORY_SIZE = 256;
+
+		struct ScopeStats
+		{
+			std::string name;
+			size_t sampleCount;
+			double averageMs;
+			double p50Ms;
+			double p95Ms;
+			double p99Ms;
+			double maxMs;
+		};
+
+		// one scope of a resolved frame, in nanoseconds of the GPU clock
+		struct ResolvedScope
+		{
+			std::string name;
+			// 0 for top-level scopes
+			uint32_t depth;
+			uint64_t beginNs;
+			uint64_t endNs;
+		};
+
+		ZGpuProfiler(ZDevice& device, uint32_t maxScopesPerFrame = DEFAULT_MAX_SCOPES);
+
+		// delete copy ctor and assignment to avoid dangling pointer
+		ZGpuProfiler(const ZGpuProfiler&) = delete;
+		ZGpuProfiler& operator=(const ZGpuProfiler&) = delete;
+
+		bool isSupported() const { return m_validBitsMask != 0; }
+
+		// see ZQueryRing::beginFrame
+		void beginFrame(VkCommandBuffer commandBuffer, int frameIndex, uint64_t frameValue);
+		// scopes must end in the command buffer they began in, in reverse order of beginning
+		ScopeId beginScope(VkCommandBuffer commandBuffer, const std::string& name);
+		void endScope(VkCommandBuffer commandBuffer, ScopeId scope);
+		// e.g. once the device is idle before reporting
+		void resolveFinishedFrames();
+
+		// one entry per scope name, in the order they first appeared
+		std::vector<ScopeStats> getStats() const;
+		// the scopes of the most recently resolved frame and the timeline value it signalled
+		const std::vector<ResolvedScope>& getLastResolvedFrame() const { return m_lastResolvedFrame; }
+		uint64_t getLastResolvedFrameValue() const { return m_lastResolvedFrameValue; }
+
+		void writeCsv(std::ostream& out) const;
+		void writeJson(std::ostream& out) const;
+
+	private:
+		struct Scope
+		{
+			std::string name;
+			uint32_t depth;
+			bool isEnded = false;
+		};
+
+		// the last HISTORY_SIZE durations of a scope, as a ring buffer
+		struct History
+		{
+			std::string name;
+			std::vector<double> samplesMs;
+			size_t next = 0;
+		};
+
+		void resolve(int frameIndex, uint64_t frameValue);
+		void writeTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlags2 stage, uint32_t query);
+
+		ZDevice& m_zDevice;
+		uint32_t m_maxScopes;
+		// timestamps wrap around after this many bits
+		uint64_t m_validBitsMask = 0;
+		double m_nsPerTick;
+
+		// empty if timestamps aren't supported
+		std::optional<ZQueryRing> m_queries;
+		// the scopes recorded into each frame in flight
+		std::vector<std::vector<Scope>> m_frameScopes;
+		uint32_t m_depth = 0;
+
+		std::vector<History> m_histories;
+		std::unordered_map<std::string, size_t> m_historyIndices;
+		std::vector<ResolvedScope> m_lastResolvedFrame;
+		uint64_t m_lastResolvedFrameValue = 0;
+	};
+}
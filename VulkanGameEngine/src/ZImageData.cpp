@@ -0,0 +1,161 @@
+﻿#include "pch.h"
+#include "ZImageData.h"
+
+namespace ZZX
+{
+	static uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+	{
+		static const std::array<uint32_t, 256> table = []
+		{
+			std::array<uint32_t, 256> result{};
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				uint32_t value = i;
+				for (int bit = 0; bit < 8; bit++)
+				{
+					value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+				}
+				result[i] = value;
+			}
+			return result;
+		}();
+
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++)
+		{
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	static void appendBigEndian(std::vector<uint8_t>& bytes, uint32_t value)
+	{
+		bytes.push_back(static_cast<uint8_t>(value >> 24));
+		bytes.push_back(static_cast<uint8_t>(value >> 16));
+		bytes.push_back(static_cast<uint8_t>(value >> 8));
+		bytes.push_back(static_cast<uint8_t>(value));
+	}
+
+	static void writeChunk(std::ofstream& file, const char type[4], const std::vector<uint8_t>& data)
+	{
+		std::vector<uint8_t> chunk;
+		chunk.reserve(data.size() + 12);
+		appendBigEndian(chunk, static_cast<uint32_t>(data.size()));
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), data.begin(), data.end());
+		// the checksum covers the type and the data, not the length
+		appendBigEndian(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+		file.write(reinterpret_cast<const char*>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+	}
+
+	void ImageData::writePng(const std::string& path) const
+	{
+		std::ofstream file{path, std::ios::binary};
+		if (!file.is_open())
+		{
+			throw std::runtime_error("failed to open file: " + path);
+		}
+
+		static constexpr uint8_t SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+		file.write(reinterpret_cast<const char*>(SIGNATURE), sizeof(SIGNATURE));
+
+		std::vector<uint8_t> header;
+		appendBigEndian(header, width);
+		appendBigEndian(header, height);
+		// 8 bits per channel, RGBA, deflate, adaptive filtering, no interlacing
+		header.insert(header.end(), {8, 6, 0, 0, 0});
+		writeChunk(file, "IHDR", header);
+
+		// every row starts with its filter type, 0 (none)
+		size_t rowSize = static_cast<size_t>(width) * 4;
+		std::vector<uint8_t> scanlines;
+		scanlines.reserve((rowSize + 1) * height);
+		for (uint32_t y = 0; y < height; y++)
+		{
+			scanlines.push_back(0);
+			auto row = pixels.begin() + static_cast<std::ptrdiff_t>(y * rowSize);
+			scanlines.insert(scanlines.end(), row, row + static_cast<std::ptrdiff_t>(rowSize));
+		}
+
+		// a zlib stream of stored (uncompressed) deflate blocks, at most 65535 bytes each
+		static constexpr size_t MAX_BLOCK_SIZE = 65535;
+		std::vector<uint8_t> zlib{0x78, 0x01};
+		zlib.reserve(scanlines.size() + scanlines.size() / MAX_BLOCK_SIZE * 5 + 16);
+		size_t offset = 0;
+		do
+		{
+			size_t blockSize = std::min(MAX_BLOCK_SIZE, scanlines.size() - offset);
+			bool isFinal = offset + blockSize == scanlines.size();
+			zlib.push_back(isFinal ? 1 : 0);
+			zlib.push_back(static_cast<uint8_t>(blockSize));
+			zlib.push_back(static_cast<uint8_t>(blockSize >> 8));
+			zlib.push_back(static_cast<uint8_t>(~blockSize));
+			zlib.push_back(static_cast<uint8_t>(~blockSize >> 8));
+			zlib.insert(zlib.end(),
+			            scanlines.begin() + static_cast<std::ptrdiff_t>(offset),
+			            scanlines.begin() + static_cast<std::ptrdiff_t>(offset + blockSize));
+			offset += blockSize;
+		}
+		while (offset < scanlines.size());
+
+		// Adler-32 of the uncompressed data
+		uint32_t a = 1;
+		uint32_t b = 0;
+		for (uint8_t byte : scanlines)
+		{
+			a = (a + byte) % 65521;
+			b = (b + a) % 65521;
+		}
+		appendBigEndian(zlib, (b << 16) | a);
+		writeChunk(file, "IDAT", zlib);
+		writeChunk(file, "IEND", {});
+
+		if (!file)
+		{
+			throw std::runtime_error("failed to write file: " + path);
+		}
+	}
+
+	ImageDiff ImageDiff::compare(const ImageData& reference, const ImageData& image, uint32_t threshold)
+	{
+		if (reference.width != image.width || reference.height != image.height)
+		{
+			throw std::runtime_error("cannot compare images of different sizes!");
+		}
+
+		ImageDiff diff{};
+		diff.pixelCount = static_cast<size_t>(image.width) * image.height;
+		uint64_t errorSum = 0;
+		uint64_t squaredErrorSum = 0;
+		for (size_t pixel = 0; pixel < diff.pixelCount; pixel++)
+		{
+			uint32_t pixelError = 0;
+			for (size_t channel = 0; channel < 3; channel++)
+			{
+				size_t index = pixel * 4 + channel;
+				uint32_t error = static_cast<uint32_t>(std::abs(
+					static_cast<int>(reference.pixels[index]) - static_cast<int>(image.pixels[index])));
+				errorSum += error;
+				squaredErrorSum += error * error;
+				pixelError = std::max(pixelError, error);
+			}
+			diff.maxError = std::max(diff.maxError, pixelError);
+			if (pixelError > threshold)
+			{
+				diff.pixelsAboveThreshold++;
+			}
+		}
+
+		size_t sampleCount = diff.pixelCount * 3;
+		if (sampleCount == 0)
+		{
+			return diff;
+		}
+		diff.meanError = static_cast<double>(errorSum) / static_cast<double>(sampleCount);
+		double meanSquaredError = static_cast<double>(squaredErrorSum) / static_cast<double>(sampleCount);
+		diff.psnr = meanSquaredError == 0.0
+			            ? std::numeric_limits<double>::infinity()
+			            : 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+		return diff;
+	}
+}
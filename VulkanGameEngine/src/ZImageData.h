@@ -0,0 +1,33 @@
+﻿#pragma once
+
+namespace ZZX
+{
+	// an 8-bit RGBA image in host memory, e.g. a captured frame
+	struct ImageData
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		// tightly packed rows, 4 bytes per pixel
+		std::vector<uint8_t> pixels;
+
+		// write as an 8-bit RGBA PNG; the image data is stored uncompressed, as we have no deflate library
+		void writePng(const std::string& path) const;
+	};
+
+	// how far an image is from a reference image, over the color channels (alpha is ignored)
+	struct ImageDiff
+	{
+		// largest difference of any channel, 0-255
+		uint32_t maxError = 0;
+		// average absolute difference per channel
+		double meanError = 0.0;
+		// peak signal-to-noise ratio in dB; infinite for identical images
+		double psnr = 0.0;
+		// pixels where some channel differs by more than the threshold
+		size_t pixelsAboveThreshold = 0;
+		size_t pixelCount = 0;
+
+		// both images must have the same size
+		static ImageDiff compare(const ImageData& reference, const ImageData& image, uint32_t threshold = 2);
+	};
+}
@@ -1,20 +1,6 @@
 ﻿#include "pch.h"
 #include "ZModel.h"
-#include "ZUtils.h"
-
-namespace std
-{
-	template <>
-	struct hash<ZZX::ZModel::Vertex>
-	{
-		size_t operator()(ZZX::ZModel::Vertex const& vertex) const
-		{
-			size_t seed = 0;
-			ZZX::hashCombine(seed, vertex.pos, vertex.color, vertex.normal, vertex.uv);
-			return seed;
-		}
-	};
-}
+#include "ZCpuProfiler.h"
 
 namespace ZZX
 {
@@ -134,6 +120,7 @@ namespace ZZX
 
 	std::unique_ptr<ZModel> ZModel::createModelFromFile(ZDevice& device, const std::string& filepath)
 	{
+		ZZX_PROFILE_SCOPE("load model");
 		Builder builder{};
 		builder.loadModel(filepath);
 		std::cout << "Vertex count: " << builder.vertices.size() << '\n';
@@ -163,6 +150,34 @@ namespace ZZX
 		}
 	}
 
+	ZModel::Builder ZModel::readBack() const
+	{
+		// the buffers are device local, so they go through host visible copies
+		auto copyToHost = [this](const ZBuffer& buffer, void* data)
+		{
+			ZBuffer stagingBuffer{
+				m_zDevice,
+				buffer.getInstanceSize(),
+				buffer.getInstanceCount(),
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			};
+			m_zDevice.copyBuffer(buffer.getBuffer(), stagingBuffer.getBuffer(), buffer.getBufferSize());
+			stagingBuffer.map();
+			std::memcpy(data, stagingBuffer.getMappedMemory(), buffer.getBufferSize());
+		};
+
+		Builder builder{};
+		builder.vertices.resize(m_vertexCount);
+		copyToHost(*m_vertexBuffer, builder.vertices.data());
+		if (m_hasIndexBuffer)
+		{
+			builder.indices.resize(m_indexCount);
+			copyToHost(*m_indexBuffer, builder.indices.data());
+		}
+		return builder;
+	}
+
 	void ZModel::createVertexBuffers(const std::vector<Vertex>& vertices)
 	{
 		m_vertexCount = static_cast<uint32_t>(vertices.size());
@@ -184,7 +199,8 @@ namespace ZZX
 		m_vertexBuffer = std::make_unique<ZBuffer>(m_zDevice,
 		                                           vertexSize,
 		                                           m_vertexCount,
-		                                           VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		                                           VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+		                                           VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 		                                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
 		m_zDevice.copyBuffer(stagingBuffer.getBuffer(), m_vertexBuffer->getBuffer(), bufferSize);
@@ -213,7 +229,8 @@ namespace ZZX
 		m_indexBuffer = std::make_unique<ZBuffer>(m_zDevice,
 		                                          indexSize,
 		                                          m_indexCount,
-		                                          VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		                                          VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+		                                          VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 		                                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
 		m_zDevice.copyBuffer(stagingBuffer.getBuffer(), m_indexBuffer->getBuffer(), bufferSize);
@@ -1,6 +1,7 @@
 ﻿#pragma once
 #include "ZDevice.h"
 #include "ZBuffer.h"
+#include "ZUtils.h"
 
 namespace ZZX
 {
@@ -45,6 +46,8 @@ namespace ZZX
 
 		void bind(VkCommandBuffer commandBuffer);
 		void draw(VkCommandBuffer commandBuffer);
+		// copy the vertices and indices back from the GPU; waits for the copy, so keep it out of the frame loop
+		Builder readBack() const;
 	private:
 		void createVertexBuffers(const std::vector<Vertex>& vertices);
 		void createIndexBuffers(const std::vector<uint32_t>& indices);
@@ -59,3 +62,18 @@ namespace ZZX
 		uint32_t m_indexCount;
 	};
 };
+
+// in the header, so vertices can be deduplicated (and the hash measured) outside of ZModel.cpp
+namespace std
+{
+	template <>
+	struct hash<ZZX::ZModel::Vertex>
+	{
+		size_t operator()(ZZX::ZModel::Vertex const& vertex) const
+		{
+			size_t seed = 0;
+			ZZX::hashCombine(seed, vertex.pos, vertex.color, vertex.normal, vertex.uv);
+			return seed;
+		}
+	};
+}
@@ -0,0 +1,215 @@
+﻿#include "pch.h"
+#include "ZOffscreenTarget.h"
+#include "ZSwapChain.h"
+
+namespace ZZX
+{
+	ZOffscreenTarget::ZOffscreenTarget(ZDevice& device, VkExtent2D extent, uint32_t framesInFlight)
+		: m_device{device}, m_extent{extent}
+	{
+		// same limit as the swap chain, so per-frame resources sized for it keep working
+		if (framesInFlight == 0 || framesInFlight > ZSwapChain::MAX_FRAMES_IN_FLIGHT)
+		{
+			throw std::runtime_error("failed to create offscreen target: unsupported number of frames in flight!");
+		}
+		if (extent.width == 0 || extent.height == 0)
+		{
+			throw std::runtime_error("failed to create offscreen target: empty extent!");
+		}
+
+		m_depthFormat = m_device.findSupportedFormat(
+			{VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+
+		createRenderPass();
+		m_frames.resize(framesInFlight);
+		for (Frame& frame : m_frames)
+		{
+			createFrame(frame);
+		}
+	}
+
+	ZOffscreenTarget::~ZOffscreenTarget()
+	{
+		VkDevice device = m_device.device();
+		for (Frame& frame : m_frames)
+		{
+			// the renderer only destroys a target once its frames are done, but be safe
+			m_device.graphicsTimeline().waitForValue(frame.frameValue);
+
+			vkDestroyFramebuffer(device, frame.framebuffer, nullptr);
+			vkDestroyImageView(device, frame.colorImageView, nullptr);
+			vkDestroyImage(device, frame.colorImage, nullptr);
+			vkFreeMemory(device, frame.colorMemory, nullptr);
+			vkDestroyImageView(device, frame.depthImageView, nullptr);
+			vkDestroyImage(device, frame.depthImage, nullptr);
+			vkFreeMemory(device, frame.depthMemory, nullptr);
+		}
+		vkDestroyRenderPass(device, m_renderPass, nullptr);
+	}
+
+	VkResult ZOffscreenTarget::acquireNextImage(uint32_t* imageIndex)
+	{
+		// there is no presentation engine handing out images: each frame slot renders to its own image,
+		// which is free once the last frame rendered to it is done
+		m_device.graphicsTimeline().waitForValue(m_frames[m_currentFrame].frameValue);
+		*imageIndex = m_currentFrame;
+		return VK_SUCCESS;
+	}
+
+	VkResult ZOffscreenTarget::submitCommandBuffers(
+		const VkCommandBuffer* buffers, uint32_t* imageIndex, uint64_t frameValue)
+	{
+		assert(*imageIndex == m_currentFrame && "frames must be submitted in the order they were acquired");
+		m_frames[*imageIndex].frameValue = frameValue;
+
+		// nothing to wait for and nothing to present, the timeline alone tells us when the frame is done
+		VkSubmitInfo submitInfo = {
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.commandBufferCount = 1,
+			.pCommandBuffers = buffers,
+		};
+		m_device.graphicsTimeline().submit(m_device.graphicsQueue(), submitInfo, frameValue);
+
+		m_currentFrame = (m_currentFrame + 1) % framesInFlight();
+		return VK_SUCCESS;
+	}
+
+	void ZOffscreenTarget::createRenderPass()
+	{
+		VkAttachmentDescription colorAttachment{};
+		colorAttachment.format = COLOR_FORMAT;
+		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		// ready to be copied out, instead of ready to be presented
+		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+		VkAttachmentDescription depthAttachment{};
+		depthAttachment.format = m_depthFormat;
+		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference colorAttachmentRef{};
+		colorAttachmentRef.attachment = 0;
+		colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference depthAttachmentRef{};
+		depthAttachmentRef.attachment = 1;
+		depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkSubpassDescription subpass{};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorAttachmentRef;
+		subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+		std::array<VkSubpassDependency, 2> dependencies{};
+		// a previous frame in this slot may still read the color image (a capture), and the depth test of
+		// the previous frame must be done before we clear depth again
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask =
+			VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dstStageMask =
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[0].dstAccessMask =
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		// the color image is read by transfers (captures) once the frame is rendered
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
+		VkRenderPassCreateInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassInfo.pAttachments = attachments.data();
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassInfo.pDependencies = dependencies.data();
+
+		if (vkCreateRenderPass(m_device.device(), &renderPassInfo, nullptr, &m_renderPass) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create offscreen render pass!");
+		}
+	}
+
+	void ZOffscreenTarget::createFrame(Frame& frame)
+	{
+		createImage(COLOR_FORMAT,
+		            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+		            VK_IMAGE_ASPECT_COLOR_BIT,
+		            frame.colorImage, frame.colorMemory, frame.colorImageView);
+		createImage(m_depthFormat,
+		            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+		            VK_IMAGE_ASPECT_DEPTH_BIT,
+		            frame.depthImage, frame.depthMemory, frame.depthImageView);
+
+		std::array<VkImageView, 2> attachments = {frame.colorImageView, frame.depthImageView};
+		VkFramebufferCreateInfo framebufferInfo{};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = m_renderPass;
+		framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		framebufferInfo.pAttachments = attachments.data();
+		framebufferInfo.width = m_extent.width;
+		framebufferInfo.height = m_extent.height;
+		framebufferInfo.layers = 1;
+
+		if (vkCreateFramebuffer(m_device.device(), &framebufferInfo, nullptr, &frame.framebuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create offscreen framebuffer!");
+		}
+	}
+
+	void ZOffscreenTarget::createImage(VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect,
+	                                   VkImage& image, VkDeviceMemory& memory, VkImageView& view)
+	{
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent.width = m_extent.width;
+		imageInfo.extent.height = m_extent.height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = usage;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		m_device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = format;
+		viewInfo.subresourceRange.aspectMask = aspect;
+		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		if (vkCreateImageView(m_device.device(), &viewInfo, nullptr, &view) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create offscreen image view!");
+		}
+	}
+}
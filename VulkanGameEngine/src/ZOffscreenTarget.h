@@ -0,0 +1,72 @@
+﻿#pragma once
+
+#include "ZDevice.h"
+#include "ZRenderTarget.h"
+
+namespace ZZX
+{
+	/**
+	 * A render target without a surface, for headless runs (CI, servers, software drivers).
+	 *
+	 * Every frame slot owns one color and one depth image, so a frame renders to the image of its slot and
+	 * nothing is presented. Finished frames are left in TRANSFER_SRC_OPTIMAL, ready to be read back.
+	 */
+	class ZOffscreenTarget : public ZRenderTarget
+	{
+	public:
+		// same format a window surface usually gives us, so pipelines and captures behave the same
+		static constexpr VkFormat COLOR_FORMAT = VK_FORMAT_B8G8R8A8_SRGB;
+
+		ZOffscreenTarget(ZDevice& device, VkExtent2D extent, uint32_t framesInFlight);
+		~ZOffscreenTarget() override;
+
+		ZOffscreenTarget(const ZOffscreenTarget&) = delete;
+		ZOffscreenTarget& operator=(const ZOffscreenTarget&) = delete;
+
+		VkRenderPass getRenderPass() override { return m_renderPass; }
+		VkFramebuffer getFrameBuffer(int index) override { return m_frames[index].framebuffer; }
+		VkImage getImage(int index) override { return m_frames[index].colorImage; }
+		VkImageView getImageView(int index) override { return m_frames[index].colorImageView; }
+		VkImage getDepthImage(int index) override { return m_frames[index].depthImage; }
+		VkImageView getDepthImageView(int index) override { return m_frames[index].depthImageView; }
+		size_t imageCount() override { return m_frames.size(); }
+		uint32_t framesInFlight() const override { return static_cast<uint32_t>(m_frames.size()); }
+
+		VkFormat getColorFormat() override { return COLOR_FORMAT; }
+		VkFormat getDepthFormat() override { return m_depthFormat; }
+		VkExtent2D getExtent() override { return m_extent; }
+
+		VkImageLayout getFinalColorLayout() const override { return VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL; }
+		bool supportsTransferSrc() const override { return true; }
+
+		VkResult acquireNextImage(uint32_t* imageIndex) override;
+		VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex,
+		                              uint64_t frameValue) override;
+
+	private:
+		struct Frame
+		{
+			VkImage colorImage = VK_NULL_HANDLE;
+			VkDeviceMemory colorMemory = VK_NULL_HANDLE;
+			VkImageView colorImageView = VK_NULL_HANDLE;
+			VkImage depthImage = VK_NULL_HANDLE;
+			VkDeviceMemory depthMemory = VK_NULL_HANDLE;
+			VkImageView depthImageView = VK_NULL_HANDLE;
+			VkFramebuffer framebuffer = VK_NULL_HANDLE;
+			// the graphics timeline value of the last frame rendered in this slot (0 if none)
+			uint64_t frameValue = 0;
+		};
+
+		void createRenderPass();
+		void createFrame(Frame& frame);
+		void createImage(VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect,
+		                 VkImage& image, VkDeviceMemory& memory, VkImageView& view);
+
+		ZDevice& m_device;
+		VkExtent2D m_extent;
+		VkFormat m_depthFormat;
+		VkRenderPass m_renderPass = VK_NULL_HANDLE;
+		std::vector<Frame> m_frames;
+		uint32_t m_currentFrame = 0;
+	};
+}
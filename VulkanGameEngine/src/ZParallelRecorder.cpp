@@ -0,0 +1,268 @@
+﻿#include "pch.h"
+#include "ZParallelRecorder.h"
+#include "ZCpuProfiler.h"
+
+namespace ZZX
+{
+	ZParallelRecorder::ZParallelRecorder(ZDevice& device, ZThreadPool& threadPool)
+		: m_zDevice{device}, m_threadPool{threadPool}
+	{
+		// sized for the most frames in flight, so changing the swap chain settings doesn't affect us
+		m_jobPools.resize(ZSwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (auto& framePools : m_jobPools)
+		{
+			// rerecorded every time the frame comes around
+			framePools = createJobPools(VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+		}
+	}
+
+	ZParallelRecorder::~ZParallelRecorder()
+	{
+		// destroying a pool frees its command buffers
+		auto destroyPools = [this](std::vector<CommandPool>& pools)
+		{
+			for (CommandPool& pool : pools)
+			{
+				vkDestroyCommandPool(m_zDevice.device(), pool.pool, nullptr);
+			}
+		};
+		for (auto& framePools : m_jobPools)
+		{
+			destroyPools(framePools);
+		}
+		for (CachedRecording& cache : m_caches)
+		{
+			for (auto& slot : cache.slots)
+			{
+				destroyPools(slot.jobPools);
+			}
+		}
+	}
+
+	std::vector<ZParallelRecorder::CommandPool> ZParallelRecorder::createJobPools(VkCommandPoolCreateFlags flags)
+	{
+		// the calling thread records one range itself while the workers do the rest
+		std::vector<CommandPool> pools(m_threadPool.threadCount() + 1);
+		VkCommandPoolCreateInfo poolInfo{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+			// no RESET_COMMAND_BUFFER: the buffers are only ever reset with their pool
+			.flags = flags,
+			.queueFamilyIndex = m_zDevice.findPhysicalQueueFamilies().graphicsFamily.value(),
+		};
+		for (CommandPool& pool : pools)
+		{
+			if (vkCreateCommandPool(m_zDevice.device(), &poolInfo, nullptr, &pool.pool) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to create command pool!");
+			}
+		}
+		return pools;
+	}
+
+	void ZParallelRecorder::beginFrame(const ZRenderer& renderer)
+	{
+		m_frameIndex = renderer.getFrameIndex();
+		m_inheritance = renderer.getRenderPassInheritance();
+		m_recorded.clear();
+		m_executedCount = 0;
+		m_reusedCount = 0;
+		for (CommandPool& pool : m_jobPools[m_frameIndex])
+		{
+			if (pool.usedCount > 0)
+			{
+				vkResetCommandPool(m_zDevice.device(), pool.pool, 0);
+				pool.usedCount = 0;
+			}
+		}
+	}
+
+	void ZParallelRecorder::record(uint32_t itemCount, const RecordFunction& recordRange)
+	{
+		assert(m_frameIndex >= 0 && "cannot record before beginFrame");
+		recordRanges(m_jobPools[m_frameIndex], itemCount, recordRange, m_inheritance, false, m_recorded);
+	}
+
+	ZParallelRecorder::CacheId ZParallelRecorder::createCache()
+	{
+		CachedRecording cache{};
+		cache.slots.resize(ZSwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (auto& slot : cache.slots)
+		{
+			slot.jobPools = createJobPools(0);
+		}
+		m_caches.push_back(std::move(cache));
+		return static_cast<CacheId>(m_caches.size() - 1);
+	}
+
+	void ZParallelRecorder::recordCached(CacheId cache, uint64_t contentKey, uint32_t itemCount,
+	                                     const RecordFunction& recordRange)
+	{
+		assert(m_frameIndex >= 0 && "cannot record before beginFrame");
+		assert(cache < m_caches.size() && "Cache was never created");
+		auto& slot = m_caches[cache].slots[m_frameIndex];
+
+		// the framebuffer differs per swap chain image, but a compatible render pass is all the commands need
+		RenderPassInheritance inheritance = m_inheritance;
+		inheritance.framebuffer = VK_NULL_HANDLE;
+		bool isUpToDate = slot.contentKey == contentKey &&
+			slot.inheritance.renderPass == inheritance.renderPass &&
+			slot.inheritance.colorFormat == inheritance.colorFormat &&
+			slot.inheritance.depthFormat == inheritance.depthFormat &&
+			slot.inheritance.extent.width == inheritance.extent.width &&
+			slot.inheritance.extent.height == inheritance.extent.height;
+		if (isUpToDate)
+		{
+			m_recorded.insert(m_recorded.end(), slot.commandBuffers.begin(), slot.commandBuffers.end());
+			m_reusedCount += slot.commandBuffers.size();
+			return;
+		}
+
+		// the last frame with this index, the only one that could still execute them, is done
+		slot.commandBuffers.clear();
+		slot.contentKey.reset();
+		for (CommandPool& pool : slot.jobPools)
+		{
+			if (pool.usedCount > 0)
+			{
+				vkResetCommandPool(m_zDevice.device(), pool.pool, 0);
+				pool.usedCount = 0;
+			}
+		}
+
+		recordRanges(slot.jobPools, itemCount, recordRange, inheritance, true, slot.commandBuffers);
+		slot.contentKey = contentKey;
+		slot.inheritance = inheritance;
+		m_recorded.insert(m_recorded.end(), slot.commandBuffers.begin(), slot.commandBuffers.end());
+	}
+
+	void ZParallelRecorder::recordRanges(std::vector<CommandPool>& jobPools, uint32_t itemCount,
+	                                     const RecordFunction& recordRange, const RenderPassInheritance& inheritance,
+	                                     bool isReusable, std::vector<VkCommandBuffer>& recorded)
+	{
+		if (itemCount == 0)
+		{
+			return;
+		}
+
+		uint32_t jobCount = std::min(maxJobCount(),
+		                             (itemCount + MIN_ITEMS_PER_JOB - 1) / MIN_ITEMS_PER_JOB);
+		std::vector<VkCommandBuffer> jobBuffers(jobCount, VK_NULL_HANDLE);
+		std::vector<std::future<void>> jobs;
+		jobs.reserve(jobCount - 1);
+		for (uint32_t job = 1; job < jobCount; job++)
+		{
+			uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(itemCount) * job / jobCount);
+			uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(itemCount) * (job + 1) / jobCount);
+			jobs.push_back(m_threadPool.submit([&, job, begin, end]()
+			{
+				recordJob(jobPools[job], recordRange, begin, end, inheritance, isReusable, jobBuffers[job]);
+			}));
+		}
+
+		// the first range is ours, so this thread doesn't idle while the workers record
+		std::exception_ptr error;
+		try
+		{
+			recordJob(jobPools[0], recordRange, 0, itemCount / jobCount, inheritance, isReusable, jobBuffers[0]);
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+		// every job must be done before we return, as they reference our locals
+		for (auto& job : jobs)
+		{
+			job.wait();
+		}
+		if (error)
+		{
+			std::rethrow_exception(error);
+		}
+		for (auto& job : jobs)
+		{
+			job.get();
+		}
+
+		recorded.insert(recorded.end(), jobBuffers.begin(), jobBuffers.end());
+	}
+
+	void ZParallelRecorder::executeCommands(VkCommandBuffer primaryCommandBuffer)
+	{
+		if (m_executedCount < m_recorded.size())
+		{
+			vkCmdExecuteCommands(primaryCommandBuffer,
+			                     static_cast<uint32_t>(m_recorded.size() - m_executedCount),
+			                     m_recorded.data() + m_executedCount);
+			m_executedCount = m_recorded.size();
+		}
+	}
+
+	VkCommandBuffer ZParallelRecorder::beginCommandBuffer(CommandPool& pool, const RenderPassInheritance& inheritance,
+	                                                      bool isReusable)
+	{
+		if (pool.usedCount == pool.commandBuffers.size())
+		{
+			VkCommandBufferAllocateInfo allocInfo{
+				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+				.commandPool = pool.pool,
+				.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+				.commandBufferCount = 1,
+			};
+			VkCommandBuffer commandBuffer;
+			if (vkAllocateCommandBuffers(m_zDevice.device(), &allocInfo, &commandBuffer) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to allocate secondary command buffer!");
+			}
+			pool.commandBuffers.push_back(commandBuffer);
+		}
+		VkCommandBuffer commandBuffer = pool.commandBuffers[pool.usedCount++];
+
+		// with dynamic rendering there is no render pass object, the attachment formats are inherited instead
+		VkCommandBufferInheritanceRenderingInfo renderingInfo{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+			.colorAttachmentCount = 1,
+			.pColorAttachmentFormats = &inheritance.colorFormat,
+			.depthAttachmentFormat = inheritance.depthFormat,
+			.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+		};
+		bool usesDynamicRendering = inheritance.renderPass == VK_NULL_HANDLE;
+		VkCommandBufferInheritanceInfo inheritanceInfo{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+			.pNext = usesDynamicRendering ? &renderingInfo : nullptr,
+			.renderPass = inheritance.renderPass,
+			.subpass = 0,
+			// optional, but lets the driver know the exact attachments
+			.framebuffer = inheritance.framebuffer,
+		};
+		VkCommandBufferBeginInfo beginInfo{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			// executed entirely inside the render pass; once, unless it is cached
+			.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT |
+			(isReusable
+				 ? VkCommandBufferUsageFlags{0}
+				 : static_cast<VkCommandBufferUsageFlags>(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT)),
+			.pInheritanceInfo = &inheritanceInfo,
+		};
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to begin recording secondary command buffer!");
+		}
+		// dynamic state isn't inherited from the primary command buffer
+		ZRenderer::setViewportAndScissor(commandBuffer, inheritance.extent);
+		return commandBuffer;
+	}
+
+	void ZParallelRecorder::recordJob(CommandPool& pool, const RecordFunction& recordRange, uint32_t begin,
+	                                  uint32_t end, const RenderPassInheritance& inheritance, bool isReusable,
+	                                  VkCommandBuffer& recorded)
+	{
+		ZZX_PROFILE_SCOPE("record job");
+		VkCommandBuffer commandBuffer = beginCommandBuffer(pool, inheritance, isReusable);
+		recordRange(commandBuffer, begin, end);
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to end recording secondary command buffer!");
+		}
+		recorded = commandBuffer;
+	}
+}
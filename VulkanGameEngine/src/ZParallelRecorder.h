@@ -0,0 +1,116 @@
+﻿#pragma once
+
+#include "ZDevice.h"
+#include "ZRenderer.h"
+#include "ZThreadPool.h"
+
+namespace ZZX
+{
+	/**
+	 * Records the draws of the swap chain render pass on several threads.
+	 *
+	 * A list of items (e.g. game objects) is split into ranges, and each range is recorded by a job into its
+	 * own secondary command buffer; the primary command buffer then executes them in order.
+	 * Command pools must not be used by two threads at once, so every job slot has its own pool, and every
+	 * frame in flight its own set of them: a frame's pools are reset as a whole when the frame comes around
+	 * again, which is cheaper than resetting buffers one by one.
+	 *
+	 * Content that doesn't change from frame to frame (static geometry) can go into a cached recording
+	 * instead: its command buffers are recorded once per frame index and executed again every frame, until
+	 * its key or the render pass changes.
+	 */
+	class ZParallelRecorder
+	{
+	public:
+		// records the items [begin, end) into commandBuffer, which is already begun and has viewport and scissor set;
+		// called from worker threads, several at once
+		using RecordFunction = std::function<void(VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end)>;
+		// identifies a cached recording; valid as long as the recorder exists
+		using CacheId = uint32_t;
+
+		// below this many items per job, handing the work to another thread costs more than it saves
+		static constexpr uint32_t MIN_ITEMS_PER_JOB = 256;
+
+		ZParallelRecorder(ZDevice& device, ZThreadPool& threadPool);
+		~ZParallelRecorder();
+
+		// delete copy ctor and assignment to avoid dangling pointer
+		ZParallelRecorder(const ZParallelRecorder&) = delete;
+		ZParallelRecorder& operator=(const ZParallelRecorder&) = delete;
+
+		// call once per frame, after renderer.beginFrame(); recycles the command buffers of the frame that last
+		// used this frame index, which the renderer has already waited for
+		void beginFrame(const ZRenderer& renderer);
+		// record itemCount items into secondary command buffers, split over the thread pool; blocks until done
+		void record(uint32_t itemCount, const RecordFunction& recordRange);
+		// make a cached recording, see recordCached
+		CacheId createCache();
+		/**
+		 * \brief Record into the cache's command buffers for this frame index, unless they already hold the same content
+		 * Either way, they are executed with the rest of the frame, in order
+		 * \param contentKey Whatever the recorded commands depend on besides the render pass (pipelines, descriptor
+		 * sets, the set of items); the cache is recorded again when it changes
+		 */
+		void recordCached(CacheId cache, uint64_t contentKey, uint32_t itemCount, const RecordFunction& recordRange);
+		// execute everything recorded since the last call this frame, in the order it was recorded, so each pass
+		// of a render graph can execute its own draws; the render pass must have been begun with
+		// VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+		void executeCommands(VkCommandBuffer primaryCommandBuffer);
+
+		// the most command buffers a single record() call fills at once
+		uint32_t maxJobCount() const { return static_cast<uint32_t>(m_jobPools[0].size()); }
+		// how many secondary command buffers the current frame executes
+		size_t recordedCount() const { return m_recorded.size(); }
+		// how many of them were recorded in an earlier frame and reused
+		size_t reusedCount() const { return m_reusedCount; }
+
+	private:
+		struct CommandPool
+		{
+			VkCommandPool pool = VK_NULL_HANDLE;
+			// allocated once and reused every time the pool is reset
+			std::vector<VkCommandBuffer> commandBuffers;
+			size_t usedCount = 0;
+		};
+
+		struct CachedRecording
+		{
+			// per frame index, as each frame binds its own descriptor sets
+			struct Slot
+			{
+				std::vector<CommandPool> jobPools;
+				std::vector<VkCommandBuffer> commandBuffers;
+				std::optional<uint64_t> contentKey;
+				// what the command buffers were recorded for; the framebuffer is left out so they work with any image
+				RenderPassInheritance inheritance{};
+			};
+
+			std::vector<Slot> slots;
+		};
+
+		std::vector<CommandPool> createJobPools(VkCommandPoolCreateFlags flags);
+		// split the items over the job pools and record them; reusable command buffers may be executed again in
+		// later frames
+		void recordRanges(std::vector<CommandPool>& jobPools, uint32_t itemCount, const RecordFunction& recordRange,
+		                  const RenderPassInheritance& inheritance, bool isReusable,
+		                  std::vector<VkCommandBuffer>& recorded);
+		// take the next free command buffer of a pool and begin it for the render pass
+		VkCommandBuffer beginCommandBuffer(CommandPool& pool, const RenderPassInheritance& inheritance,
+		                                   bool isReusable);
+		void recordJob(CommandPool& pool, const RecordFunction& recordRange, uint32_t begin, uint32_t end,
+		               const RenderPassInheritance& inheritance, bool isReusable, VkCommandBuffer& recorded);
+
+		ZDevice& m_zDevice;
+		ZThreadPool& m_threadPool;
+
+		// [frame index][job slot]
+		std::vector<std::vector<CommandPool>> m_jobPools;
+		int m_frameIndex = -1;
+		RenderPassInheritance m_inheritance{};
+		std::vector<VkCommandBuffer> m_recorded;
+		// how many of m_recorded were already executed
+		size_t m_executedCount = 0;
+		size_t m_reusedCount = 0;
+		std::vector<CachedRecording> m_caches;
+	};
+}
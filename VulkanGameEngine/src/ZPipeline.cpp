@@ -1,21 +1,109 @@
 ﻿#include "pch.h"
 #include "ZPipeline.h"
+#include "ZUtils.h"
 
 namespace ZZX
 {
+	namespace
+	{
+		// to use the shaders, we must assign them to a specific pipeline stage through VkPipelineShaderStageCreateInfo struct
+		VkPipelineShaderStageCreateInfo makeShaderStage(VkShaderStageFlagBits stage,
+		                                                const ZShaderModule& shaderModule,
+		                                                const VkSpecializationInfo* specializationInfo)
+		{
+			return VkPipelineShaderStageCreateInfo{
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = stage,
+				.module = shaderModule.getShaderModule(),
+				// specify entry point
+				.pName = "main",
+				// constant ids a stage doesn't declare are ignored, so both stages can share one set of constants
+				.pSpecializationInfo = specializationInfo,
+			};
+		}
+	}
+
 	ZPipeline::ZPipeline(ZDevice& zDevice,
 	                     const PipelineConfigInfo& config_info,
-	                     const std::string& vertFilepath,
-	                     const std::string& fragFilepath)
+	                     const ZShaderModule& vertShaderModule,
+	                     const ZShaderModule& fragShaderModule,
+	                     VkPipelineCache pipelineCache,
+	                     const VkSpecializationInfo* specializationInfo)
 		: m_ZDevice(zDevice)
 	{
-		createGraphicsPipeline(vertFilepath, fragFilepath, config_info);
+		createGraphicsPipeline(config_info,
+		                       {
+			                       makeShaderStage(VK_SHADER_STAGE_VERTEX_BIT, vertShaderModule, specializationInfo),
+			                       makeShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, fragShaderModule, specializationInfo),
+		                       },
+		                       ALL_PIPELINE_LIBRARY_PARTS,
+		                       0,
+		                       nullptr,
+		                       pipelineCache);
+	}
+
+	ZPipeline::ZPipeline(ZDevice& zDevice,
+	                     const PipelineConfigInfo& config_info,
+	                     VkGraphicsPipelineLibraryFlagBitsEXT part,
+	                     const ZShaderModule* shaderModule,
+	                     VkPipelineCache pipelineCache,
+	                     const VkSpecializationInfo* specializationInfo)
+		: m_ZDevice(zDevice)
+	{
+		std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
+		if (part == VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT)
+		{
+			assert(shaderModule && "Cannot create pre-rasterization library: no vertex shader provided");
+			shaderStages.push_back(makeShaderStage(VK_SHADER_STAGE_VERTEX_BIT, *shaderModule, specializationInfo));
+		}
+		else if (part == VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT)
+		{
+			assert(shaderModule && "Cannot create fragment shader library: no fragment shader provided");
+			shaderStages.push_back(makeShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, *shaderModule, specializationInfo));
+		}
+
+		VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo{
+			.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT,
+			.flags = static_cast<VkGraphicsPipelineLibraryFlagsEXT>(part),
+		};
+		// keep what the optimizer needs, so the library can also be part of an optimized link later
+		createGraphicsPipeline(config_info,
+		                       shaderStages,
+		                       part,
+		                       VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT,
+		                       &libraryInfo,
+		                       pipelineCache);
+	}
+
+	ZPipeline::ZPipeline(ZDevice& zDevice,
+	                     const PipelineConfigInfo& config_info,
+	                     const std::vector<const ZPipeline*>& libraries,
+	                     bool optimize,
+	                     VkPipelineCache pipelineCache)
+		: m_ZDevice(zDevice)
+	{
+		std::vector<VkPipeline> libraryHandles;
+		libraryHandles.reserve(libraries.size());
+		for (const ZPipeline* library : libraries)
+		{
+			libraryHandles.push_back(library->getPipeline());
+		}
+
+		VkPipelineLibraryCreateInfoKHR linkInfo{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR,
+			.libraryCount = static_cast<uint32_t>(libraryHandles.size()),
+			.pLibraries = libraryHandles.data(),
+		};
+		createGraphicsPipeline(config_info,
+		                       {},
+		                       0,
+		                       optimize ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0,
+		                       &linkInfo,
+		                       pipelineCache);
 	}
 
 	ZPipeline::~ZPipeline()
 	{
-		vkDestroyShaderModule(m_ZDevice.device(), m_VkVertexShaderModule, nullptr);
-		vkDestroyShaderModule(m_ZDevice.device(), m_VkFragmentShaderModule, nullptr);
 		vkDestroyPipeline(m_ZDevice.device(), m_VkPipeline, nullptr);
 	}
 
@@ -87,7 +175,7 @@ namespace ZZX
 		configInfo.colorBlendInfo.logicOpEnable = VK_FALSE;
 		configInfo.colorBlendInfo.logicOp = VK_LOGIC_OP_COPY; // Optional
 		configInfo.colorBlendInfo.attachmentCount = 1;
-		configInfo.colorBlendInfo.pAttachments = &configInfo.colorBlendAttachment;
+		// pAttachments is pointed at colorBlendAttachment when the pipeline is created
 		configInfo.colorBlendInfo.blendConstants[0] = 0.0f; // Optional
 		configInfo.colorBlendInfo.blendConstants[1] = 0.0f; // Optional
 		configInfo.colorBlendInfo.blendConstants[2] = 0.0f; // Optional
@@ -107,10 +195,8 @@ namespace ZZX
 
 		// dynamic state: configure the pipeline to expect dynamic viewport/scissor to be provided later at drawing time
 		configInfo.dynamicStateEnables = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+		// pDynamicStates and dynamicStateCount are taken from dynamicStateEnables when the pipeline is created
 		configInfo.dynamicStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-		configInfo.dynamicStateInfo.pDynamicStates = configInfo.dynamicStateEnables.data();
-		configInfo.dynamicStateInfo.dynamicStateCount =
-			static_cast<uint32_t>(configInfo.dynamicStateEnables.size());
 		configInfo.dynamicStateInfo.flags = 0;
 
 		configInfo.bindingDescriptions = ZModel::Vertex::getBindingDescriptions();
@@ -134,64 +220,219 @@ namespace ZZX
 			VK_COLOR_COMPONENT_A_BIT;
 	}
 
-	std::vector<char> ZPipeline::readFile(const std::string& filepath)
+	void ZPipeline::setRenderTarget(PipelineConfigInfo& configInfo, const PipelineRenderTarget& renderTarget)
 	{
-		// start reading at the end of the file + read file as binary
-		std::ifstream file(filepath, std::ios::ate | std::ios::binary);
+		configInfo.m_VkRenderPass = renderTarget.renderPass;
+		configInfo.colorAttachmentFormat = renderTarget.colorAttachmentFormat;
+		configInfo.depthAttachmentFormat = renderTarget.depthAttachmentFormat;
+	}
 
-		if (!file.is_open())
+	DynamicPipelineState ZPipeline::makeStateDynamic(PipelineConfigInfo& configInfo)
+	{
+		DynamicPipelineState state{
+			.cullMode = configInfo.rasterizationInfo.cullMode,
+			.frontFace = configInfo.rasterizationInfo.frontFace,
+			.primitiveTopology = configInfo.inputAssemblyInfo.topology,
+			.depthTestEnable = configInfo.depthStencilInfo.depthTestEnable,
+			.depthWriteEnable = configInfo.depthStencilInfo.depthWriteEnable,
+			.depthCompareOp = configInfo.depthStencilInfo.depthCompareOp,
+			.depthBiasEnable = configInfo.rasterizationInfo.depthBiasEnable,
+			.primitiveRestartEnable = configInfo.inputAssemblyInfo.primitiveRestartEnable,
+			.rasterizerDiscardEnable = configInfo.rasterizationInfo.rasterizerDiscardEnable,
+		};
+
+		static constexpr VkDynamicState dynamicStates[] = {
+			VK_DYNAMIC_STATE_CULL_MODE,
+			VK_DYNAMIC_STATE_FRONT_FACE,
+			VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY,
+			VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE,
+			VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE,
+			VK_DYNAMIC_STATE_DEPTH_COMPARE_OP,
+			VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE,
+			VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE,
+			VK_DYNAMIC_STATE_RASTERIZER_DISCARD_ENABLE,
+		};
+		for (VkDynamicState dynamicState : dynamicStates)
 		{
-			throw std::runtime_error("failed to open file: " + filepath);
+			if (std::find(configInfo.dynamicStateEnables.begin(), configInfo.dynamicStateEnables.end(), dynamicState)
+				== configInfo.dynamicStateEnables.end())
+			{
+				configInfo.dynamicStateEnables.push_back(dynamicState);
+			}
 		}
 
-		// since we read at the end of the file, we can directly compute the size of the file
-		size_t fileSize = static_cast<size_t>(file.tellg());
-		std::vector<char> buffer(fileSize);
+		configInfo.rasterizationInfo.cullMode = VK_CULL_MODE_NONE;
+		configInfo.rasterizationInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+		configInfo.rasterizationInfo.depthBiasEnable = VK_FALSE;
+		configInfo.rasterizationInfo.rasterizerDiscardEnable = VK_FALSE;
+		configInfo.depthStencilInfo.depthTestEnable = VK_FALSE;
+		configInfo.depthStencilInfo.depthWriteEnable = VK_FALSE;
+		configInfo.depthStencilInfo.depthCompareOp = VK_COMPARE_OP_NEVER;
+		configInfo.inputAssemblyInfo.primitiveRestartEnable = VK_FALSE;
 
-		// seek back to the beginning of the file
-		file.seekg(0);
-		// read all of the bytes at once
-		file.read(buffer.data(), fileSize);
-		file.close();
+		// without dynamicPrimitiveTopologyUnrestricted the dynamic topology must stay in the class the pipeline was created with
+		switch (configInfo.inputAssemblyInfo.topology)
+		{
+		case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+			configInfo.inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+			break;
+		case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP:
+		case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN:
+			configInfo.inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+			break;
+		default:
+			break;
+		}
+		return state;
+	}
 
-		return buffer;
+	void ZPipeline::setDynamicState(VkCommandBuffer commandBuffer, const DynamicPipelineState& state)
+	{
+		vkCmdSetCullMode(commandBuffer, state.cullMode);
+		vkCmdSetFrontFace(commandBuffer, state.frontFace);
+		vkCmdSetPrimitiveTopology(commandBuffer, state.primitiveTopology);
+		vkCmdSetDepthTestEnable(commandBuffer, state.depthTestEnable);
+		vkCmdSetDepthWriteEnable(commandBuffer, state.depthWriteEnable);
+		vkCmdSetDepthCompareOp(commandBuffer, state.depthCompareOp);
+		vkCmdSetDepthBiasEnable(commandBuffer, state.depthBiasEnable);
+		vkCmdSetPrimitiveRestartEnable(commandBuffer, state.primitiveRestartEnable);
+		vkCmdSetRasterizerDiscardEnable(commandBuffer, state.rasterizerDiscardEnable);
 	}
 
-	void ZPipeline::createGraphicsPipeline(const std::string& vertFilepath,
-	                                       const std::string& fragFilepath,
-	                                       const PipelineConfigInfo& config_info)
+	uint64_t PipelineConfigInfo::hash() const
 	{
-		assert(
-			config_info.m_VkPipelineLayout != VK_NULL_HANDLE &&
-			"Cannot create graphics pipeline:: no pipelineLayout provided in configInfo");
-		assert(
-			config_info.m_VkRenderPass != VK_NULL_HANDLE &&
-			"Cannot create graphics pipeline:: no renderPass provided in configInfo");
+		std::vector<uint8_t> bytes = stateBytes();
+		return hashBytes(bytes.data(), bytes.size());
+	}
 
-		// load the bytecode of the two shaders
-		auto vertShaderCode = readFile(vertFilepath);
-		auto fragShaderCode = readFile(fragFilepath);
+	std::vector<uint8_t> PipelineConfigInfo::stateBytes(VkGraphicsPipelineLibraryFlagsEXT parts) const
+	{
+		std::vector<uint8_t> bytes;
+		bytes.reserve(512);
+		auto appendField = [&bytes](const auto& field)
+		{
+			const auto* data = reinterpret_cast<const uint8_t*>(&field);
+			bytes.insert(bytes.end(), data, data + sizeof(field));
+		};
 
-		createShaderModule(vertShaderCode, &m_VkVertexShaderModule);
-		createShaderModule(fragShaderCode, &m_VkFragmentShaderModule);
+		bool vertexInput = parts & VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT;
+		bool preRasterization = parts & VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT;
+		bool fragmentShader = parts & VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT;
+		bool fragmentOutput = parts & VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT;
 
-		// to use the shaders, we must assign them to a specific pipeline stage through VkPipelineShaderStageCreateInfo struct
-		VkPipelineShaderStageCreateInfo vertShaderStageInfo{
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-			.stage = VK_SHADER_STAGE_VERTEX_BIT,
-			.module = m_VkVertexShaderModule,
-			// specify entry point
-			.pName = "main",
-		};
+		appendField(parts);
+		// the parts of one pipeline must agree on their dynamic state, so every part depends on all of it
+		appendField(dynamicStateEnables.size());
+		for (VkDynamicState dynamicState : dynamicStateEnables)
+		{
+			appendField(dynamicState);
+		}
 
-		VkPipelineShaderStageCreateInfo fragShaderStageInfo{
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-			.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-			.module = m_VkFragmentShaderModule,
-			.pName = "main",
-		};
+		if (vertexInput)
+		{
+			// the counts keep e.g. one binding plus no attributes apart from the reverse
+			appendField(bindingDescriptions.size());
+			appendField(attributeDescriptions.size());
+			for (const auto& binding : bindingDescriptions)
+			{
+				appendField(binding);
+			}
+			for (const auto& attribute : attributeDescriptions)
+			{
+				appendField(attribute);
+			}
+
+			appendField(inputAssemblyInfo.topology);
+			appendField(inputAssemblyInfo.primitiveRestartEnable);
+		}
 
-		VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+		if (preRasterization)
+		{
+			// viewports and scissors are dynamic, only their count is part of the pipeline
+			appendField(viewportInfo.viewportCount);
+			appendField(viewportInfo.scissorCount);
+
+			appendField(rasterizationInfo.depthClampEnable);
+			appendField(rasterizationInfo.rasterizerDiscardEnable);
+			appendField(rasterizationInfo.polygonMode);
+			appendField(rasterizationInfo.cullMode);
+			appendField(rasterizationInfo.frontFace);
+			appendField(rasterizationInfo.depthBiasEnable);
+			appendField(rasterizationInfo.depthBiasConstantFactor);
+			appendField(rasterizationInfo.depthBiasClamp);
+			appendField(rasterizationInfo.depthBiasSlopeFactor);
+			appendField(rasterizationInfo.lineWidth);
+		}
+
+		if (fragmentShader || fragmentOutput)
+		{
+			appendField(multisampleInfo.rasterizationSamples);
+			appendField(multisampleInfo.sampleShadingEnable);
+			appendField(multisampleInfo.minSampleShading);
+			appendField(multisampleInfo.alphaToCoverageEnable);
+			appendField(multisampleInfo.alphaToOneEnable);
+		}
+
+		if (fragmentOutput)
+		{
+			// plain 32-bit fields only (no padding), so the whole struct can be appended at once
+			appendField(colorBlendAttachment);
+			appendField(colorBlendInfo.logicOpEnable);
+			appendField(colorBlendInfo.logicOp);
+			appendField(colorBlendInfo.attachmentCount);
+			appendField(colorBlendInfo.blendConstants);
+			appendField(colorAttachmentFormat);
+			appendField(depthAttachmentFormat);
+		}
+
+		if (fragmentShader)
+		{
+			appendField(depthStencilInfo.depthTestEnable);
+			appendField(depthStencilInfo.depthWriteEnable);
+			appendField(depthStencilInfo.depthCompareOp);
+			appendField(depthStencilInfo.depthBoundsTestEnable);
+			appendField(depthStencilInfo.stencilTestEnable);
+			appendField(depthStencilInfo.front);
+			appendField(depthStencilInfo.back);
+			appendField(depthStencilInfo.minDepthBounds);
+			appendField(depthStencilInfo.maxDepthBounds);
+		}
+
+		if (preRasterization || fragmentShader)
+		{
+			appendField(m_VkPipelineLayout);
+		}
+		if (preRasterization || fragmentShader || fragmentOutput)
+		{
+			appendField(m_VkRenderPass);
+			appendField(subpass);
+		}
+		return bytes;
+	}
+
+	void ZPipeline::createGraphicsPipeline(const PipelineConfigInfo& config_info,
+	                                       const std::vector<VkPipelineShaderStageCreateInfo>& shaderStages,
+	                                       VkGraphicsPipelineLibraryFlagsEXT parts,
+	                                       VkPipelineCreateFlags flags,
+	                                       void* pNext,
+	                                       VkPipelineCache pipelineCache)
+	{
+		bool vertexInput = parts & VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT;
+		bool preRasterization = parts & VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT;
+		bool fragmentShader = parts & VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT;
+		bool fragmentOutput = parts & VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT;
+		// a link takes all of its state from the libraries, except for the layout
+		bool linking = parts == 0;
+		bool needsLayout = preRasterization || fragmentShader || linking;
+		bool needsRenderTarget = preRasterization || fragmentShader || fragmentOutput;
+
+		assert(
+			(!needsLayout || config_info.m_VkPipelineLayout != VK_NULL_HANDLE) &&
+			"Cannot create graphics pipeline:: no pipelineLayout provided in configInfo");
+		assert(
+			(!needsRenderTarget || config_info.m_VkRenderPass != VK_NULL_HANDLE ||
+				config_info.colorAttachmentFormat != VK_FORMAT_UNDEFINED) &&
+			"Cannot create graphics pipeline:: no renderPass or attachment formats provided in configInfo");
 
 		// Vertex input stage
 		// We need to describe the format of the vertex data that will be passed to the vertex shader
@@ -207,28 +448,52 @@ namespace ZZX
 			.pVertexAttributeDescriptions = attributeDescriptions.data(),
 		};
 
+		// the config is a copyable value, so it can't hold pointers into itself; point them at its fields here
+		VkPipelineColorBlendStateCreateInfo colorBlendInfo = config_info.colorBlendInfo;
+		colorBlendInfo.pAttachments = &config_info.colorBlendAttachment;
+
+		VkPipelineDynamicStateCreateInfo dynamicStateInfo = config_info.dynamicStateInfo;
+		dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(config_info.dynamicStateEnables.size());
+		dynamicStateInfo.pDynamicStates = config_info.dynamicStateEnables.data();
+
+		// with dynamic rendering the attachment formats take the place of the render pass
+		VkPipelineRenderingCreateInfo renderingInfo{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+			.pNext = pNext,
+			.colorAttachmentCount = 1,
+			.pColorAttachmentFormats = &config_info.colorAttachmentFormat,
+			.depthAttachmentFormat = config_info.depthAttachmentFormat,
+		};
+		if (needsRenderTarget && config_info.m_VkRenderPass == VK_NULL_HANDLE)
+		{
+			pNext = &renderingInfo;
+		}
+
 		// create graphics pipeline given already filled stages
 		VkGraphicsPipelineCreateInfo pipelineInfo{
 			.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-			.stageCount = 2,
-			.pStages = shaderStages,
-			.pVertexInputState = &vertexInputInfo,
-			.pInputAssemblyState = &config_info.inputAssemblyInfo,
-			.pViewportState = &config_info.viewportInfo,
-			.pRasterizationState = &config_info.rasterizationInfo,
-			.pMultisampleState = &config_info.multisampleInfo,
-			.pDepthStencilState = &config_info.depthStencilInfo,
-			.pColorBlendState = &config_info.colorBlendInfo,
-			.pDynamicState = &config_info.dynamicStateInfo, // dynamic viewport/scissor
-			.layout = config_info.m_VkPipelineLayout,
-			.renderPass = config_info.m_VkRenderPass,
+			.pNext = pNext,
+			.flags = flags,
+			.stageCount = static_cast<uint32_t>(shaderStages.size()),
+			.pStages = shaderStages.empty() ? nullptr : shaderStages.data(),
+			.pVertexInputState = vertexInput ? &vertexInputInfo : nullptr,
+			.pInputAssemblyState = vertexInput ? &config_info.inputAssemblyInfo : nullptr,
+			.pViewportState = preRasterization ? &config_info.viewportInfo : nullptr,
+			.pRasterizationState = preRasterization ? &config_info.rasterizationInfo : nullptr,
+			.pMultisampleState = fragmentShader || fragmentOutput ? &config_info.multisampleInfo : nullptr,
+			.pDepthStencilState = fragmentShader ? &config_info.depthStencilInfo : nullptr,
+			.pColorBlendState = fragmentOutput ? &colorBlendInfo : nullptr,
+			.pDynamicState = linking ? nullptr : &dynamicStateInfo, // dynamic viewport/scissor
+			.layout = needsLayout ? config_info.m_VkPipelineLayout : VK_NULL_HANDLE,
+			.renderPass = needsRenderTarget ? config_info.m_VkRenderPass : VK_NULL_HANDLE,
 			.subpass = config_info.subpass,
 			.basePipelineHandle = VK_NULL_HANDLE, // Optional
 			.basePipelineIndex = -1, // Optional
 		};
 
+		// a pipeline cache lets the driver reuse compiled state across pipelines (and across runs)
 		if (vkCreateGraphicsPipelines(m_ZDevice.device(),
-		                              VK_NULL_HANDLE,
+		                              pipelineCache,
 		                              1,
 		                              &pipelineInfo,
 		                              nullptr,
@@ -237,22 +502,4 @@ namespace ZZX
 			throw std::runtime_error("failed to create graphics pipeline!");
 		}
 	}
-
-	void ZPipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule)
-	{
-		// wrap the raw SPIR-V data into a VkShaderModule
-		VkShaderModuleCreateInfo createInfo{
-			.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-			// specify the length of the bytecode in bytes
-			.codeSize = code.size(),
-			// notice that pCode expects const uint32_t* rather than const char*
-			// Note: this works because we use std::vector<char>, which ensures the data satisfy the worst-case alignment requirement
-			.pCode = reinterpret_cast<const uint32_t*>(code.data())
-		};
-
-		if (vkCreateShaderModule(m_ZDevice.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS)
-		{
-			throw std::runtime_error("failed to create shader module!");
-		}
-	}
 }
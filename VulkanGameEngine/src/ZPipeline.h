@@ -1,15 +1,30 @@
 ﻿#pragma once
 #include "ZDevice.h"
 #include "ZModel.h"
+#include "ZShaderModule.h"
 
 namespace ZZX
 {
-	// this struct contains data specifying how we want to configure the pipeline
+	// the four parts a pipeline consists of when it is linked from graphics pipeline libraries
+	constexpr VkGraphicsPipelineLibraryFlagsEXT ALL_PIPELINE_LIBRARY_PARTS =
+		VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT |
+		VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT |
+		VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT |
+		VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT;
+
+	/**
+	 * This struct contains data specifying how we want to configure the pipeline.
+	 *
+	 * It is a plain value: it can be copied, compared and hashed. The pointers inside the create infos
+	 * (pAttachments, pDynamicStates) are ignored and filled in from the fields below when the pipeline is created.
+	 */
 	struct PipelineConfigInfo
 	{
-		PipelineConfigInfo() = default;
-		PipelineConfigInfo(const PipelineConfigInfo&) = delete;
-		PipelineConfigInfo& operator=(const PipelineConfigInfo&) = delete;
+		bool operator==(const PipelineConfigInfo& other) const { return stateBytes() == other.stateBytes(); }
+		uint64_t hash() const;
+		// the pipeline state packed into bytes, leaving out every pointer; equal bytes mean an identical pipeline
+		// (or pipeline library, when only some of the parts are asked for)
+		std::vector<uint8_t> stateBytes(VkGraphicsPipelineLibraryFlagsEXT parts = ALL_PIPELINE_LIBRARY_PARTS) const;
 
 		std::vector<VkVertexInputBindingDescription> bindingDescriptions{};
 		std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
@@ -25,6 +40,33 @@ namespace ZZX
 		VkPipelineLayout m_VkPipelineLayout = nullptr;
 		VkRenderPass m_VkRenderPass = nullptr;
 		uint32_t subpass = 0;
+		// with dynamic rendering there is no render pass, the pipeline only needs the attachment formats
+		VkFormat colorAttachmentFormat = VK_FORMAT_UNDEFINED;
+		VkFormat depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+	};
+
+	// what a pipeline renders into: a render pass, or with dynamic rendering only the attachment formats
+	struct PipelineRenderTarget
+	{
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		VkFormat colorAttachmentFormat = VK_FORMAT_UNDEFINED;
+		VkFormat depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+	};
+
+	// the fixed-function state that extended dynamic state (1 and 2) moves from the pipeline to the command buffer
+	struct DynamicPipelineState
+	{
+		VkCullModeFlags cullMode;
+		VkFrontFace frontFace;
+		VkPrimitiveTopology primitiveTopology;
+		VkBool32 depthTestEnable;
+		VkBool32 depthWriteEnable;
+		VkCompareOp depthCompareOp;
+		VkBool32 depthBiasEnable;
+		VkBool32 primitiveRestartEnable;
+		VkBool32 rasterizerDiscardEnable;
+
+		bool operator==(const DynamicPipelineState& other) const = default;
 	};
 
 	class ZPipeline
@@ -32,26 +74,60 @@ namespace ZZX
 	public:
 		ZPipeline(ZDevice& device,
 		          const PipelineConfigInfo& config_info,
-		          const std::string& vertFilepath,
-		          const std::string& fragFilepath);
+		          const ZShaderModule& vertShaderModule,
+		          const ZShaderModule& fragShaderModule,
+		          VkPipelineCache pipelineCache = VK_NULL_HANDLE,
+		          const VkSpecializationInfo* specializationInfo = nullptr);
+		/**
+		 * \brief Create one part of a pipeline as a graphics pipeline library
+		 * \param shaderModule The vertex shader for the pre-rasterization part, the fragment shader for the fragment
+		 * shader part, nullptr for the interface parts
+		 */
+		ZPipeline(ZDevice& device,
+		          const PipelineConfigInfo& config_info,
+		          VkGraphicsPipelineLibraryFlagBitsEXT part,
+		          const ZShaderModule* shaderModule,
+		          VkPipelineCache pipelineCache = VK_NULL_HANDLE,
+		          const VkSpecializationInfo* specializationInfo = nullptr);
+		/**
+		 * \brief Link a complete pipeline from libraries that together contain all four parts
+		 * \param optimize Whether to run link time optimization. Without it, linking is fast enough to do while
+		 * recording a frame, but the pipeline may run slower
+		 */
+		ZPipeline(ZDevice& device,
+		          const PipelineConfigInfo& config_info,
+		          const std::vector<const ZPipeline*>& libraries,
+		          bool optimize,
+		          VkPipelineCache pipelineCache = VK_NULL_HANDLE);
 		~ZPipeline();
 
 		ZPipeline(const ZPipeline&) = delete;
 		ZPipeline& operator=(const ZPipeline&) = delete;
 
 		void bind(VkCommandBuffer commandBuffer);
+		VkPipeline getPipeline() const { return m_VkPipeline; }
 		static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 		static void enableAlphaBlending(PipelineConfigInfo& configInfo);
+		static void setRenderTarget(PipelineConfigInfo& configInfo, const PipelineRenderTarget& renderTarget);
+
+		/**
+		 * \brief Turn the state covered by DynamicPipelineState into dynamic state
+		 * The values are reset to defaults in the config, so configs that only differ in them become equal
+		 * and can share one pipeline
+		 * \return The values the config had; record them with setDynamicState after binding the pipeline
+		 */
+		static DynamicPipelineState makeStateDynamic(PipelineConfigInfo& configInfo);
+		static void setDynamicState(VkCommandBuffer commandBuffer, const DynamicPipelineState& state);
 	private:
-		// read all of the bytes from the specified file and return them in a byte array
-		static std::vector<char> readFile(const std::string& filepath);
-		void createGraphicsPipeline(const std::string& vertFilepath,
-		                            const std::string& fragFilepath,
-		                            const PipelineConfigInfo& config_info);
-		void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
+		// the shader modules are only needed during this call; the pipeline does not keep them alive
+		// only the state belonging to the given parts is passed on, none at all when linking libraries
+		void createGraphicsPipeline(const PipelineConfigInfo& config_info,
+		                            const std::vector<VkPipelineShaderStageCreateInfo>& shaderStages,
+		                            VkGraphicsPipelineLibraryFlagsEXT parts,
+		                            VkPipelineCreateFlags flags,
+		                            void* pNext,
+		                            VkPipelineCache pipelineCache);
 		ZDevice& m_ZDevice;
 		VkPipeline m_VkPipeline;
-		VkShaderModule m_VkVertexShaderModule;
-		VkShaderModule m_VkFragmentShaderModule;
 	};
 }
@@ -0,0 +1,361 @@
+﻿#include "pch.h"
+#include "ZPipelineCompiler.h"
+#include "ZShaderReflection.h"
+#include "ZUtils.h"
+
+namespace ZZX
+{
+	ZPipelineCompiler::ZPipelineCompiler(ZDevice& device, ZThreadPool& threadPool, const std::string& cacheFilepath,
+	                                     bool usePipelineLibraries)
+		: m_zDevice{device}, m_threadPool{threadPool}, m_cacheFilepath{cacheFilepath}, m_shaderModules{device, &m_shaderCompiler, &m_shaderOptimizer},
+		  m_usePipelineLibraries{usePipelineLibraries && device.getCapabilities().graphicsPipelineLibrary}
+	{
+		createPipelineCache();
+	}
+
+	ZPipelineCompiler::~ZPipelineCompiler()
+	{
+		// the workers still reference the pipeline cache, so they must finish before it is destroyed
+		waitIdle();
+		saveCache();
+		vkDestroyPipelineCache(m_zDevice.device(), m_pipelineCache, nullptr);
+	}
+
+	std::future<std::unique_ptr<ZPipeline>> ZPipelineCompiler::compile(PipelineBuildRequest request)
+	{
+		return submitJob([this, request = std::move(request)]() -> std::unique_ptr<ZPipeline>
+		{
+			if (m_usePipelineLibraries)
+			{
+				return link(request, true);
+			}
+
+			// the modules are dropped at the end of this scope: once the pipeline exists they are not needed anymore
+			auto vertShaderModule = m_shaderModules.getModule(request.vertFilepath, request.defines);
+			auto fragShaderModule = m_shaderModules.getModule(request.fragFilepath, request.defines);
+			VkSpecializationInfo specializationInfo = request.specialization.getInfo();
+			return std::make_unique<ZPipeline>(m_zDevice,
+			                                   request.configInfo,
+			                                   *vertShaderModule,
+			                                   *fragShaderModule,
+			                                   m_pipelineCache,
+			                                   request.specialization.empty() ? nullptr : &specializationInfo);
+		});
+	}
+
+	std::future<std::unique_ptr<ZPipeline>> ZPipelineCompiler::submitJob(
+		std::function<std::unique_ptr<ZPipeline>()> job)
+	{
+		beginJob();
+		return m_threadPool.submit([this, job = std::move(job)]() -> std::unique_ptr<ZPipeline>
+		{
+			std::unique_ptr<ZPipeline> pipeline;
+			std::exception_ptr error;
+			try
+			{
+				pipeline = job();
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+			endJob();
+
+			// the exception travels to whoever calls get() on the future
+			if (error)
+			{
+				std::rethrow_exception(error);
+			}
+			return pipeline;
+		});
+	}
+
+	std::vector<std::future<std::unique_ptr<ZPipeline>>> ZPipelineCompiler::compileBatch(
+		std::vector<PipelineBuildRequest> requests)
+	{
+		std::vector<std::future<std::unique_ptr<ZPipeline>>> futures;
+		futures.reserve(requests.size());
+		for (auto& request : requests)
+		{
+			futures.push_back(compile(std::move(request)));
+		}
+		return futures;
+	}
+
+	std::future<std::unique_ptr<ZPipeline>> ZPipelineCompiler::fastLink(PipelineBuildRequest request)
+	{
+		assert(m_usePipelineLibraries && "Cannot fast-link pipelines without graphics pipeline library support");
+		if (!hasLibraries(request))
+		{
+			// compiling a part means compiling shaders and creating a library, which would stall the caller
+			return submitJob([this, request = std::move(request)]() { return link(request, false); });
+		}
+
+		std::promise<std::unique_ptr<ZPipeline>> promise;
+		try
+		{
+			promise.set_value(link(request, false));
+		}
+		catch (...)
+		{
+			promise.set_exception(std::current_exception());
+		}
+		return promise.get_future();
+	}
+
+	bool ZPipelineCompiler::hasLibraries(const PipelineBuildRequest& request)
+	{
+		for (VkGraphicsPipelineLibraryFlagBitsEXT part : {
+			     VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT,
+			     VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+			     VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,
+			     VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT
+		     })
+		{
+			// a library can only exist if its shader has been loaded
+			std::shared_ptr<const std::vector<uint32_t>> code;
+			if (const std::string* filepath = getShaderFilepath(part, request))
+			{
+				code = m_shaderModules.findCode(*filepath, request.defines);
+				if (!code)
+				{
+					return false;
+				}
+			}
+			LibraryKey key = makeLibraryKey(part, request, code.get());
+
+			std::lock_guard<std::mutex> lock{m_librariesMutex};
+			auto it = m_libraries.find(key);
+			if (it == m_libraries.end() || it->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	size_t ZPipelineCompiler::libraryCount() const
+	{
+		std::lock_guard<std::mutex> lock{m_librariesMutex};
+		return m_libraries.size();
+	}
+
+	std::unique_ptr<ZPipeline> ZPipelineCompiler::link(const PipelineBuildRequest& request, bool optimize)
+	{
+		std::shared_ptr<ZPipeline> vertexInput =
+			getLibrary(VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT, request);
+		std::shared_ptr<ZPipeline> preRasterization =
+			getLibrary(VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT, request);
+		std::shared_ptr<ZPipeline> fragmentShader =
+			getLibrary(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT, request);
+		std::shared_ptr<ZPipeline> fragmentOutput =
+			getLibrary(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT, request);
+
+		return std::make_unique<ZPipeline>(m_zDevice,
+		                                   request.configInfo,
+		                                   std::vector<const ZPipeline*>{
+			                                   vertexInput.get(), preRasterization.get(),
+			                                   fragmentShader.get(), fragmentOutput.get()
+		                                   },
+		                                   optimize,
+		                                   m_pipelineCache);
+	}
+
+	ZPipelineCompiler::LibraryKey ZPipelineCompiler::makeLibraryKey(VkGraphicsPipelineLibraryFlagBitsEXT part,
+	                                                                const PipelineBuildRequest& request,
+	                                                                const std::vector<uint32_t>* code)
+	{
+		LibraryKey key{request.configInfo.stateBytes(part)};
+		if (const std::string* filepath = getShaderFilepath(part, request))
+		{
+			key.filepath = *filepath;
+			key.defines = request.defines;
+			// only the constants the stage declares, so that e.g. variants that differ in fragment constants alone
+			// share their pre-rasterization part
+			key.specialization = request.specialization.subset(
+				ZShaderReflection{code}.getSpecializationConstantIds());
+		}
+		return key;
+	}
+
+	const std::string* ZPipelineCompiler::getShaderFilepath(VkGraphicsPipelineLibraryFlagBitsEXT part,
+	                                                        const PipelineBuildRequest& request)
+	{
+		if (part == VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT)
+		{
+			return &request.vertFilepath;
+		}
+		if (part == VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT)
+		{
+			return &request.fragFilepath;
+		}
+		return nullptr;
+	}
+
+	std::shared_ptr<ZPipeline> ZPipelineCompiler::getLibrary(VkGraphicsPipelineLibraryFlagBitsEXT part,
+	                                                         const PipelineBuildRequest& request)
+	{
+		std::shared_ptr<const std::vector<uint32_t>> code;
+		if (const std::string* filepath = getShaderFilepath(part, request))
+		{
+			code = m_shaderModules.getCode(*filepath, request.defines);
+		}
+		LibraryKey key = makeLibraryKey(part, request, code.get());
+
+		// the first thread to ask compiles the library, the others wait for it
+		std::promise<std::shared_ptr<ZPipeline>> promise;
+		std::shared_future<std::shared_ptr<ZPipeline>> existing;
+		{
+			std::lock_guard<std::mutex> lock{m_librariesMutex};
+			auto it = m_libraries.find(key);
+			if (it != m_libraries.end())
+			{
+				existing = it->second;
+			}
+			else
+			{
+				m_libraries.emplace(key, promise.get_future().share());
+			}
+		}
+		if (existing.valid())
+		{
+			// rethrows if the thread compiling it failed
+			return existing.get();
+		}
+
+		try
+		{
+			std::shared_ptr<ZShaderModule> shaderModule;
+			if (!key.filepath.empty())
+			{
+				shaderModule = m_shaderModules.getModule(key.filepath, key.defines);
+			}
+			VkSpecializationInfo specializationInfo = key.specialization.getInfo();
+			auto library = std::make_shared<ZPipeline>(m_zDevice,
+			                                           request.configInfo,
+			                                           part,
+			                                           shaderModule.get(),
+			                                           m_pipelineCache,
+			                                           key.specialization.empty() ? nullptr : &specializationInfo);
+			promise.set_value(library);
+			return library;
+		}
+		catch (...)
+		{
+			// forget the failed library, so that the next request tries again (e.g. after the shader was fixed)
+			{
+				std::lock_guard<std::mutex> lock{m_librariesMutex};
+				m_libraries.erase(key);
+			}
+			promise.set_exception(std::current_exception());
+			throw;
+		}
+	}
+
+	void ZPipelineCompiler::beginJob()
+	{
+		std::lock_guard<std::mutex> lock{m_pendingMutex};
+		m_pendingJobs++;
+	}
+
+	void ZPipelineCompiler::endJob()
+	{
+		{
+			std::lock_guard<std::mutex> lock{m_pendingMutex};
+			m_pendingJobs--;
+		}
+		m_pendingCondition.notify_all();
+	}
+
+	void ZPipelineCompiler::waitIdle()
+	{
+		std::unique_lock<std::mutex> lock{m_pendingMutex};
+		m_pendingCondition.wait(lock, [this]() { return m_pendingJobs == 0; });
+	}
+
+	size_t ZPipelineCompiler::LibraryKeyHash::operator()(const LibraryKey& key) const
+	{
+		size_t seed = 0;
+		hashCombine(seed,
+		            hashBytes(key.stateBytes.data(), key.stateBytes.size()),
+		            key.filepath,
+		            key.specialization.hash());
+		for (const auto& [name, value] : key.defines)
+		{
+			hashCombine(seed, name, value);
+		}
+		return seed;
+	}
+
+	void ZPipelineCompiler::saveCache()
+	{
+		size_t dataSize = 0;
+		if (vkGetPipelineCacheData(m_zDevice.device(), m_pipelineCache, &dataSize, nullptr) != VK_SUCCESS ||
+			dataSize == 0)
+		{
+			return;
+		}
+
+		std::vector<char> cacheData(dataSize);
+		if (vkGetPipelineCacheData(m_zDevice.device(), m_pipelineCache, &dataSize, cacheData.data()) != VK_SUCCESS)
+		{
+			return;
+		}
+
+		std::ofstream file(m_cacheFilepath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			// a missing cache only costs startup time, so don't treat it as fatal
+			std::cerr << "failed to write pipeline cache: " << m_cacheFilepath << std::endl;
+			return;
+		}
+		file.write(cacheData.data(), static_cast<std::streamsize>(dataSize));
+	}
+
+	void ZPipelineCompiler::createPipelineCache()
+	{
+		std::vector<char> cacheData;
+		std::ifstream file(m_cacheFilepath, std::ios::ate | std::ios::binary);
+		if (file.is_open())
+		{
+			cacheData.resize(static_cast<size_t>(file.tellg()));
+			file.seekg(0);
+			file.read(cacheData.data(), static_cast<std::streamsize>(cacheData.size()));
+			file.close();
+
+			if (!isCacheCompatible(cacheData))
+			{
+				std::cout << "Discarding incompatible pipeline cache: " << m_cacheFilepath << '\n';
+				cacheData.clear();
+			}
+		}
+
+		VkPipelineCacheCreateInfo cacheInfo{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+			.initialDataSize = cacheData.size(),
+			.pInitialData = cacheData.empty() ? nullptr : cacheData.data(),
+		};
+
+		if (vkCreatePipelineCache(m_zDevice.device(), &cacheInfo, nullptr, &m_pipelineCache) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create pipeline cache!");
+		}
+	}
+
+	bool ZPipelineCompiler::isCacheCompatible(const std::vector<char>& cacheData) const
+	{
+		if (cacheData.size() < sizeof(VkPipelineCacheHeaderVersionOne))
+		{
+			return false;
+		}
+
+		VkPipelineCacheHeaderVersionOne header;
+		memcpy(&header, cacheData.data(), sizeof(header));
+
+		const VkPhysicalDeviceProperties& properties = m_zDevice.m_properties;
+		return header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+			header.vendorID == properties.vendorID &&
+			header.deviceID == properties.deviceID &&
+			memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+	}
+}
@@ -0,0 +1,136 @@
+﻿#pragma once
+#include "ZDevice.h"
+#include "ZPipeline.h"
+#include "ZShaderModule.h"
+#include "ZShaderCompiler.h"
+#include "ZSpecializationConstants.h"
+#include "ZThreadPool.h"
+
+namespace ZZX
+{
+	// everything a worker thread needs to create one graphics pipeline
+	struct PipelineBuildRequest
+	{
+		PipelineConfigInfo configInfo{};
+		// GLSL sources are compiled at runtime, .spv files are loaded as-is
+		std::string vertFilepath;
+		std::string fragFilepath;
+		// applied to both stages when compiling GLSL
+		ShaderDefines defines{};
+		// applied to both stages when creating the pipeline; unlike defines, these don't need a new shader module
+		ZSpecializationConstants specialization{};
+	};
+
+	/**
+	 * Compiles graphics pipelines concurrently on a thread pool.
+	 *
+	 * All pipelines are created through one VkPipelineCache. A pipeline cache is internally synchronized
+	 * (we never create it with VK_PIPELINE_CACHE_CREATE_EXTERNALLY_SYNCHRONIZED_BIT), so every worker can
+	 * share it. The cache is loaded from and saved to disk so that later runs skip most of the driver compilation.
+	 * Shader modules come from a shared ZShaderModuleCache and are released once the pipelines using them exist.
+	 *
+	 * With VK_EXT_graphics_pipeline_library, a pipeline is linked from four separately compiled parts (vertex input,
+	 * pre-rasterization, fragment shader, fragment output). The parts are cached and shared by every pipeline that
+	 * uses them, so a new combination of known parts can be fast-linked right away, while compile() does the
+	 * optimized link in the background.
+	 */
+	class ZPipelineCompiler
+	{
+	public:
+		// graphics pipeline libraries are only used if the device supports them
+		ZPipelineCompiler(ZDevice& device, ZThreadPool& threadPool,
+		                  const std::string& cacheFilepath = "pipeline_cache.bin",
+		                  bool usePipelineLibraries = true);
+		~ZPipelineCompiler();
+
+		// delete copy ctor and assignment to avoid dangling pointer
+		ZPipelineCompiler(const ZPipelineCompiler&) = delete;
+		ZPipelineCompiler& operator=(const ZPipelineCompiler&) = delete;
+
+		// queue a single pipeline for compilation
+		std::future<std::unique_ptr<ZPipeline>> compile(PipelineBuildRequest request);
+		// queue a batch of pipelines; the returned futures are in the same order as the requests
+		std::vector<std::future<std::unique_ptr<ZPipeline>>> compileBatch(std::vector<PipelineBuildRequest> requests);
+
+		/**
+		 * \brief Link a pipeline from its libraries without optimization
+		 * If every part exists already, this is cheap and done on the calling thread, so the future is ready on
+		 * return. Otherwise the missing parts are compiled and the pipeline linked on the thread pool. The result
+		 * may run slower than the pipeline compile() produces, so use it only until that one is ready.
+		 * Requires usesPipelineLibraries()
+		 */
+		std::future<std::unique_ptr<ZPipeline>> fastLink(PipelineBuildRequest request);
+
+		// block until every queued pipeline has been created
+		void waitIdle();
+		// write the current contents of the pipeline cache to disk
+		void saveCache();
+
+		VkPipelineCache getPipelineCache() const { return m_pipelineCache; }
+		bool usesPipelineLibraries() const { return m_usePipelineLibraries; }
+		// number of distinct pipeline libraries created so far
+		size_t libraryCount() const;
+		ZShaderModuleCache& getShaderModuleCache() { return m_shaderModules; }
+		ZShaderCompiler& getShaderCompiler() { return m_shaderCompiler; }
+		ZShaderOptimizer& getShaderOptimizer() { return m_shaderOptimizer; }
+
+	private:
+		// the state and shader a pipeline library is made of; see PipelineConfigInfo::stateBytes
+		struct LibraryKey
+		{
+			std::vector<uint8_t> stateBytes;
+			// only set for the two shader parts
+			std::string filepath;
+			ShaderDefines defines;
+			// only the constants the part's shader declares
+			ZSpecializationConstants specialization;
+
+			bool operator==(const LibraryKey& other) const = default;
+		};
+
+		struct LibraryKeyHash
+		{
+			size_t operator()(const LibraryKey& key) const;
+		};
+
+		// run a job on the thread pool, counted by waitIdle()
+		std::future<std::unique_ptr<ZPipeline>> submitJob(std::function<std::unique_ptr<ZPipeline>()> job);
+		// link a pipeline from its four libraries, compiling the ones that don't exist yet
+		std::unique_ptr<ZPipeline> link(const PipelineBuildRequest& request, bool optimize);
+		// whether all four libraries have been compiled, so link() won't have to wait for any
+		bool hasLibraries(const PipelineBuildRequest& request);
+		// code is the SPIR-V of the part's shader (nullptr for the parts without one)
+		static LibraryKey makeLibraryKey(VkGraphicsPipelineLibraryFlagBitsEXT part, const PipelineBuildRequest& request,
+		                                 const std::vector<uint32_t>* code);
+		// the shader the part is compiled from, or nullptr if it has none
+		static const std::string* getShaderFilepath(VkGraphicsPipelineLibraryFlagBitsEXT part,
+		                                            const PipelineBuildRequest& request);
+		std::shared_ptr<ZPipeline> getLibrary(VkGraphicsPipelineLibraryFlagBitsEXT part, const PipelineBuildRequest& request);
+		// add a compile job to the pending count, which waitIdle() waits on
+		void beginJob();
+		void endJob();
+
+		void createPipelineCache();
+		// the driver rejects (or worse, misbehaves on) cache blobs from a different GPU or driver version
+		bool isCacheCompatible(const std::vector<char>& cacheData) const;
+
+		ZDevice& m_zDevice;
+		ZThreadPool& m_threadPool;
+		std::string m_cacheFilepath;
+		VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+		// note: order of declarations matters, the module cache refers to the compiler and the optimizer
+		ZShaderCompiler m_shaderCompiler;
+		ZShaderOptimizer m_shaderOptimizer;
+		ZShaderModuleCache m_shaderModules;
+
+		bool m_usePipelineLibraries;
+		// shared, because other threads may be waiting for a library that is still being compiled
+		std::unordered_map<LibraryKey, std::shared_future<std::shared_ptr<ZPipeline>>, LibraryKeyHash> m_libraries;
+		mutable std::mutex m_librariesMutex;
+
+		// number of compile jobs that are queued or running
+		uint32_t m_pendingJobs = 0;
+		std::mutex m_pendingMutex;
+		std::condition_variable m_pendingCondition;
+	};
+}
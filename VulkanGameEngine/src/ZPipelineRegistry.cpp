@@ -0,0 +1,313 @@
+﻿#include "pch.h"
+#include "ZPipelineRegistry.h"
+#include "ZUtils.h"
+
+namespace ZZX
+{
+	ZPipelineRegistry::ZPipelineRegistry(ZDevice& device, ZPipelineCompiler& pipelineCompiler, bool useDynamicState)
+		: m_zDevice{device}, m_pipelineCompiler{pipelineCompiler}
+	{
+		const DeviceCapabilities& capabilities = device.getCapabilities();
+		m_useDynamicState = useDynamicState &&
+			capabilities.extendedDynamicState &&
+			capabilities.extendedDynamicState2;
+	}
+
+	ZPipelineRegistry::~ZPipelineRegistry()
+	{
+		// pipelines that are still compiling reference the layouts we are about to destroy
+		waitIdle();
+		m_entries.clear();
+		for (auto& [key, pipelineLayout] : m_pipelineLayouts)
+		{
+			vkDestroyPipelineLayout(m_zDevice.device(), pipelineLayout, nullptr);
+		}
+	}
+
+	ZPipelineRegistry::PipelineId ZPipelineRegistry::request(PipelineBuildRequest request,
+	                                                         std::optional<PipelineId> fallback)
+	{
+		std::optional<DynamicPipelineState> dynamicState;
+		if (m_useDynamicState)
+		{
+			dynamicState = ZPipeline::makeStateDynamic(request.configInfo);
+		}
+
+		PipelineKey key{
+			request.vertFilepath,
+			request.fragFilepath,
+			request.defines,
+			request.specialization,
+			request.configInfo,
+		};
+
+		std::unique_lock<std::mutex> lock{m_mutex};
+		assert((!fallback || *fallback < m_handles.size()) && "Fallback pipeline was never requested");
+		auto it = m_entryIds.find(key);
+		if (it == m_entryIds.end())
+		{
+			std::shared_future<std::unique_ptr<ZPipeline>> fastLinked;
+			if (m_pipelineCompiler.usesPipelineLibraries())
+			{
+				// link without holding the lock, so other threads can keep binding meanwhile
+				lock.unlock();
+				fastLinked = m_pipelineCompiler.fastLink(request).share();
+				lock.lock();
+				// another thread may have requested the same pipeline in the meantime
+				it = m_entryIds.find(key);
+			}
+
+			if (it == m_entryIds.end())
+			{
+				m_entries.push_back({m_pipelineCompiler.compile(std::move(request)).share(), std::move(fastLinked)});
+				it = m_entryIds.emplace(std::move(key), static_cast<uint32_t>(m_entries.size() - 1)).first;
+			}
+		}
+		uint32_t entryId = it->second;
+
+		// the same request made twice gives the same id
+		auto handle = std::find_if(m_handles.begin(),
+		                           m_handles.end(),
+		                           [&](const Handle& h)
+		                           {
+			                           return h.entry == entryId && h.dynamicState == dynamicState && h.fallback == fallback;
+		                           });
+		if (handle != m_handles.end())
+		{
+			return static_cast<PipelineId>(handle - m_handles.begin());
+		}
+		m_handles.push_back({entryId, dynamicState, fallback});
+		return static_cast<PipelineId>(m_handles.size() - 1);
+	}
+
+	void ZPipelineRegistry::bind(PipelineId id, VkCommandBuffer commandBuffer)
+	{
+		Entry* entry;
+		ZPipeline* pipeline;
+		std::optional<DynamicPipelineState> dynamicState;
+		{
+			std::lock_guard<std::mutex> lock{m_mutex};
+			assert(id < m_handles.size() && "Pipeline was never requested");
+			const Handle* handle = &m_handles[id];
+			entry = &m_entries[handle->entry];
+			pipeline = getReadyPipeline(*entry);
+
+			if (!pipeline && handle->fallback)
+			{
+				const Handle& fallbackHandle = m_handles[*handle->fallback];
+				Entry& fallbackEntry = m_entries[fallbackHandle.entry];
+				if (ZPipeline* fallbackPipeline = getReadyPipeline(fallbackEntry))
+				{
+					handle = &fallbackHandle;
+					entry = &fallbackEntry;
+					pipeline = fallbackPipeline;
+					m_frameStats.fallbackBinds++;
+				}
+			}
+			if (!pipeline)
+			{
+				m_frameStats.blockingBinds++;
+			}
+
+			dynamicState = handle->dynamicState;
+			if (entry->lastUsedFrame != m_frameNumber)
+			{
+				entry->lastUsedFrame = m_frameNumber;
+				m_frameStats.uniquePipelines++;
+			}
+			m_frameStats.pipelineBinds++;
+		}
+
+		if (!pipeline)
+		{
+			// none is ready: block until a worker has finished
+			pipeline = waitForPipeline(*entry);
+		}
+		pipeline->bind(commandBuffer);
+		if (dynamicState)
+		{
+			ZPipeline::setDynamicState(commandBuffer, *dynamicState);
+		}
+	}
+
+	bool ZPipelineRegistry::isReady(PipelineId id) const
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		assert(id < m_handles.size() && "Pipeline was never requested");
+		const Entry& entry = m_entries[m_handles[id].entry];
+		return isFinished(entry.pipeline) || findReadyPipeline(entry) != nullptr;
+	}
+
+	ZPipeline* ZPipelineRegistry::getReadyPipeline(Entry& entry)
+	{
+		ZPipeline* pipeline = findReadyPipeline(entry);
+		if (pipeline != nullptr && !isFinished(entry.pipeline))
+		{
+			m_frameStats.fastLinkedBinds++;
+		}
+		return pipeline;
+	}
+
+	ZPipeline* ZPipelineRegistry::findReadyPipeline(const Entry& entry)
+	{
+		if (isFinished(entry.pipeline))
+		{
+			// rethrows compile errors
+			return entry.pipeline.get().get();
+		}
+		if (entry.fastLinked.valid() && isFinished(entry.fastLinked))
+		{
+			try
+			{
+				return entry.fastLinked.get().get();
+			}
+			catch (const std::exception&)
+			{
+				// the optimized compile fails the same way, and bind() reports it from there
+			}
+		}
+		return nullptr;
+	}
+
+	ZPipeline* ZPipelineRegistry::waitForPipeline(const Entry& entry)
+	{
+		// the fast link is queued first and takes less time, so it is done first
+		if (entry.fastLinked.valid())
+		{
+			try
+			{
+				return entry.fastLinked.get().get();
+			}
+			catch (const std::exception&)
+			{
+				// the optimized compile fails the same way, and reports it below
+			}
+		}
+		return entry.pipeline.get().get();
+	}
+
+	bool ZPipelineRegistry::isFinished(const std::shared_future<std::unique_ptr<ZPipeline>>& pipeline)
+	{
+		return pipeline.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+
+	VkPipeline ZPipelineRegistry::getBoundPipeline(PipelineId id) const
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		assert(id < m_handles.size() && "Pipeline was never requested");
+		const Handle& handle = m_handles[id];
+		ZPipeline* pipeline = findReadyPipeline(m_entries[handle.entry]);
+		if (!pipeline && handle.fallback)
+		{
+			pipeline = findReadyPipeline(m_entries[m_handles[*handle.fallback].entry]);
+		}
+		return pipeline ? pipeline->getPipeline() : VK_NULL_HANDLE;
+	}
+
+	PipelineBuildRequest ZPipelineRegistry::getRequest(PipelineId id) const
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		assert(id < m_handles.size() && "Pipeline was never requested");
+		// only the key knows the request, and entries don't point back to their key
+		auto it = std::ranges::find(m_entryIds, m_handles[id].entry, [](const auto& kv) { return kv.second; });
+		assert(it != m_entryIds.end() && "Pipeline entry has no key");
+		const PipelineKey& key = it->first;
+		return {key.configInfo, key.vertFilepath, key.fragFilepath, key.defines, key.specialization};
+	}
+
+	VkPipelineLayout ZPipelineRegistry::getPipelineLayout(
+		const ZShaderReflection& reflection,
+		const std::map<uint32_t, const ZDescriptorSetLayout*>& setLayouts)
+	{
+		reflection.validateSetLayouts(setLayouts);
+
+		LayoutKey key{};
+		for (const auto& binding : reflection.getDescriptorBindings())
+		{
+			if (setLayouts.find(binding.set) == setLayouts.end())
+			{
+				throw std::runtime_error("no descriptor set layout provided for set " + std::to_string(binding.set) +
+					" (" + binding.name + ")");
+			}
+		}
+		for (const auto& [set, setLayout] : setLayouts)
+		{
+			key.first.resize(std::max<size_t>(key.first.size(), set + 1), VK_NULL_HANDLE);
+			key.first[set] = setLayout->getDescriptorSetLayout();
+		}
+		if (const auto& pushConstantRange = reflection.getPushConstantRange())
+		{
+			key.second = {pushConstantRange->stageFlags, pushConstantRange->offset, pushConstantRange->size};
+		}
+
+		std::lock_guard<std::mutex> lock{m_mutex};
+		auto it = m_pipelineLayouts.find(key);
+		if (it != m_pipelineLayouts.end())
+		{
+			return it->second;
+		}
+
+		// every set has a layout, so reflection doesn't need to create any
+		std::vector<std::unique_ptr<ZDescriptorSetLayout>> ownedSetLayouts;
+		VkPipelineLayout pipelineLayout = reflection.createPipelineLayout(m_zDevice, setLayouts, ownedSetLayouts);
+		assert(ownedSetLayouts.empty() && "Set layouts must be dense, starting at set 0");
+		m_pipelineLayouts.emplace(std::move(key), pipelineLayout);
+		return pipelineLayout;
+	}
+
+	void ZPipelineRegistry::beginFrame()
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		// a fast-linked bind saves the frame as much as a fallback does
+		if ((m_frameStats.fallbackBinds > 0 || m_frameStats.fastLinkedBinds > 0) && m_frameStats.blockingBinds == 0)
+		{
+			m_hitchFramesAvoided++;
+		}
+		m_frameNumber++;
+		m_frameStats = {};
+		m_frameStats.hitchFramesAvoided = m_hitchFramesAvoided;
+	}
+
+	ZPipelineRegistry::FrameStats ZPipelineRegistry::getFrameStats() const
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		return m_frameStats;
+	}
+
+	void ZPipelineRegistry::waitIdle()
+	{
+		std::vector<std::shared_future<std::unique_ptr<ZPipeline>>> pipelines;
+		{
+			std::lock_guard<std::mutex> lock{m_mutex};
+			for (const auto& entry : m_entries)
+			{
+				pipelines.push_back(entry.pipeline);
+				if (entry.fastLinked.valid())
+				{
+					pipelines.push_back(entry.fastLinked);
+				}
+			}
+		}
+		for (const auto& pipeline : pipelines)
+		{
+			pipeline.wait();
+		}
+	}
+
+	size_t ZPipelineRegistry::size() const
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		return m_entries.size();
+	}
+
+	size_t ZPipelineRegistry::PipelineKeyHash::operator()(const PipelineKey& key) const
+	{
+		size_t seed = 0;
+		hashCombine(seed, key.vertFilepath, key.fragFilepath, key.specialization.hash(), key.configInfo.hash());
+		for (const auto& [name, value] : key.defines)
+		{
+			hashCombine(seed, name, value);
+		}
+		return seed;
+	}
+}
@@ -0,0 +1,154 @@
+﻿#pragma once
+#include "ZPipelineCompiler.h"
+#include "ZShaderReflection.h"
+
+namespace ZZX
+{
+	/**
+	 * Hands out one shared pipeline per distinct (shaders, defines, specialization constants, pipeline state) key.
+	 *
+	 * The pipeline state includes the layout and the render pass, so systems that ask for identical pipelines
+	 * get the same VkPipeline. To make that possible, pipeline layouts are shared too: identical set layouts and
+	 * push constant ranges give the same VkPipelineLayout.
+	 * With extended dynamic state, state such as culling and depth testing is taken out of the key and set on the
+	 * command buffer when the pipeline is bound, so requests that only differ in it share a pipeline as well.
+	 * Anything new is compiled in the background by the ZPipelineCompiler. With graphics pipeline libraries, a
+	 * fast-linked version is used until the optimized one is done; it is made right away if its parts are compiled
+	 * already, and in the background too otherwise. While neither is ready, a request can name a fallback (e.g. a
+	 * generic uber-shader variant) that is bound instead.
+	 * The registry also counts which pipelines each frame binds, so duplicated or needless state shows up.
+	 * All functions are safe to call from several threads.
+	 */
+	class ZPipelineRegistry
+	{
+	public:
+		// identifies a request: a pipeline plus the dynamic state to set with it; valid as long as the registry exists
+		using PipelineId = uint32_t;
+
+		struct FrameStats
+		{
+			// distinct pipelines that were bound this frame
+			uint32_t uniquePipelines = 0;
+			uint32_t pipelineBinds = 0;
+			// binds that used a fast-linked pipeline because the optimized one was still compiling
+			uint32_t fastLinkedBinds = 0;
+			// binds that used the fallback pipeline because the requested one was still compiling
+			uint32_t fallbackBinds = 0;
+			// binds that had to wait for a compile; each frame with one of these hitches
+			uint32_t blockingBinds = 0;
+			// since the registry was created: frames that would have waited for a compile without fallbacks or
+			// fast-linked pipelines
+			uint64_t hitchFramesAvoided = 0;
+		};
+
+		// extended dynamic state is only used if the device supports it
+		ZPipelineRegistry(ZDevice& device, ZPipelineCompiler& pipelineCompiler, bool useDynamicState = true);
+		~ZPipelineRegistry();
+
+		// delete copy ctor and assignment to avoid dangling pointer
+		ZPipelineRegistry(const ZPipelineRegistry&) = delete;
+		ZPipelineRegistry& operator=(const ZPipelineRegistry&) = delete;
+
+		/**
+		 * \brief Start compiling the pipeline unless an identical one is already known
+		 * Never compiles on the calling thread (with pipeline libraries, it only fast-links a usable version here
+		 * if every part of it exists)
+		 * \param fallback A previously requested pipeline to bind instead while this one is not ready. It must use
+		 * the same layout and render target, and should be one that is needed anyway, so it is likely compiled
+		 */
+		PipelineId request(PipelineBuildRequest request, std::optional<PipelineId> fallback = std::nullopt);
+		// bind a requested pipeline (and its dynamic state), its fast-linked stand-in, or its fallback while it is
+		// compiling; only blocks if none is ready
+		void bind(PipelineId id, VkCommandBuffer commandBuffer);
+		// whether binding the pipeline itself (not its fallback) would not block
+		bool isReady(PipelineId id) const;
+		// the pipeline bind() would bind right now (the requested one, its fast-linked stand-in or the fallback),
+		// or VK_NULL_HANDLE if it would block; command buffers that are recorded once and reused compare this
+		// to know when they have to be recorded again
+		VkPipeline getBoundPipeline(PipelineId id) const;
+		// the request a pipeline was made from (with dynamic state, its config no longer holds the state that was made dynamic)
+		PipelineBuildRequest getRequest(PipelineId id) const;
+
+		/**
+		 * \brief Get the pipeline layout for a set of shaders, creating it on first use
+		 * \param setLayouts The layout of every descriptor set the shaders use, keyed by set index. They are validated
+		 * against the shaders. The registry owns the returned layout
+		 */
+		VkPipelineLayout getPipelineLayout(const ZShaderReflection& reflection,
+		                                   const std::map<uint32_t, const ZDescriptorSetLayout*>& setLayouts);
+
+		// reset the per-frame counters
+		void beginFrame();
+		FrameStats getFrameStats() const;
+
+		// block until every requested pipeline has been created
+		void waitIdle();
+		// number of distinct pipelines requested so far
+		size_t size() const;
+
+		ZPipelineCompiler& getPipelineCompiler() { return m_pipelineCompiler; }
+		bool usesDynamicState() const { return m_useDynamicState; }
+
+	private:
+		struct PipelineKey
+		{
+			std::string vertFilepath;
+			std::string fragFilepath;
+			ShaderDefines defines;
+			ZSpecializationConstants specialization;
+			PipelineConfigInfo configInfo;
+
+			bool operator==(const PipelineKey& other) const = default;
+		};
+
+		struct PipelineKeyHash
+		{
+			size_t operator()(const PipelineKey& key) const;
+		};
+
+		struct Entry
+		{
+			// shared so that several threads can wait for the same pipeline
+			std::shared_future<std::unique_ptr<ZPipeline>> pipeline;
+			// unoptimized stand-in until the pipeline above is ready (not valid without pipeline libraries); kept after
+			// that, since command buffers that are still in flight may use it
+			std::shared_future<std::unique_ptr<ZPipeline>> fastLinked;
+			// the last frame that bound this pipeline
+			uint64_t lastUsedFrame = 0;
+		};
+
+		struct Handle
+		{
+			// index into m_entries
+			uint32_t entry;
+			std::optional<DynamicPipelineState> dynamicState;
+			std::optional<PipelineId> fallback;
+		};
+
+		// the pipeline to bind for an entry right now, or nullptr if it is still compiling; call with the lock held
+		ZPipeline* getReadyPipeline(Entry& entry);
+		// same, without counting it as a bind
+		static ZPipeline* findReadyPipeline(const Entry& entry);
+		// block until the entry has a pipeline to bind; rethrows compile errors
+		static ZPipeline* waitForPipeline(const Entry& entry);
+		static bool isFinished(const std::shared_future<std::unique_ptr<ZPipeline>>& pipeline);
+
+		// set layouts and push constant range (stages, offset, size) a pipeline layout is made of
+		using LayoutKey = std::pair<std::vector<VkDescriptorSetLayout>, std::array<uint32_t, 3>>;
+
+		ZDevice& m_zDevice;
+		ZPipelineCompiler& m_pipelineCompiler;
+		bool m_useDynamicState;
+
+		mutable std::mutex m_mutex;
+		std::unordered_map<PipelineKey, uint32_t, PipelineKeyHash> m_entryIds;
+		std::vector<Handle> m_handles;
+		// a deque never moves its elements, so a pipeline can be waited for without holding the lock
+		std::deque<Entry> m_entries;
+		std::map<LayoutKey, VkPipelineLayout> m_pipelineLayouts;
+
+		uint64_t m_frameNumber = 1;
+		FrameStats m_frameStats{};
+		uint64_t m_hitchFramesAvoided = 0;
+	};
+}
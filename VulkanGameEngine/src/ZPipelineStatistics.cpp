@@ -0,0 +1,181 @@
+﻿#include "pch.h"
+#include "ZPipelineStatistics.h"
+
+namespace ZZX
+{
+	// results come back in the order of these bits
+	static constexpr VkQueryPipelineStatisticFlags STATISTICS =
+		VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+	static constexpr uint32_t STATISTIC_COUNT = 6;
+	// the ZQueryRing's pools, in the order they are created
+	static constexpr size_t STATISTICS_POOL = 0;
+	static constexpr size_t OCCLUSION_POOL = 1;
+
+	ZPipelineStatistics::Counters& ZPipelineStatistics::Counters::operator+=(const Counters& other)
+	{
+		inputAssemblyVertices += other.inputAssemblyVertices;
+		inputAssemblyPrimitives += other.inputAssemblyPrimitives;
+		vertexShaderInvocations += other.vertexShaderInvocations;
+		clippingInvocations += other.clippingInvocations;
+		clippingPrimitives += other.clippingPrimitives;
+		fragmentShaderInvocations += other.fragmentShaderInvocations;
+		samplesPassed += other.samplesPassed;
+		return *this;
+	}
+
+	ZPipelineStatistics::ZPipelineStatistics(ZDevice& device, uint32_t maxScopesPerFrame)
+		: m_zDevice{device}, m_maxScopes{maxScopesPerFrame}
+	{
+		if (!device.getCapabilities().pipelineStatisticsQuery)
+		{
+			return;
+		}
+
+		VkQueryPoolCreateInfo statisticsInfo{
+			.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+			.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+			.queryCount = m_maxScopes,
+			.pipelineStatistics = STATISTICS,
+		};
+		VkQueryPoolCreateInfo occlusionInfo{
+			.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+			.queryType = VK_QUERY_TYPE_OCCLUSION,
+			.queryCount = m_maxScopes,
+		};
+		m_queries.emplace(m_zDevice, std::vector{statisticsInfo, occlusionInfo});
+		m_frameScopes.resize(m_queries->getFrameCount());
+	}
+
+	void ZPipelineStatistics::beginFrame(VkCommandBuffer commandBuffer, int frameIndex, uint64_t frameValue)
+	{
+		if (!isSupported())
+		{
+			return;
+		}
+		assert(!m_isScopeOpen && "the last frame has a scope that never ended");
+		m_queries->beginFrame(commandBuffer,
+		                      frameIndex,
+		                      frameValue,
+		                      std::bind_front(&ZPipelineStatistics::resolve, this));
+		m_frameScopes[frameIndex].clear();
+	}
+
+	ZPipelineStatistics::ScopeId ZPipelineStatistics::beginScope(VkCommandBuffer commandBuffer,
+	                                                             const std::string& name)
+	{
+		if (!isSupported())
+		{
+			return INVALID_SCOPE;
+		}
+		int frameIndex = m_queries->getFrameIndex();
+		assert(frameIndex >= 0 && "cannot begin a scope before beginFrame");
+		assert(!m_isScopeOpen && "pipeline statistics scopes cannot nest");
+		std::vector<std::string>& scopes = m_frameScopes[frameIndex];
+		if (scopes.size() >= m_maxScopes)
+		{
+			return INVALID_SCOPE;
+		}
+		auto scope = static_cast<ScopeId>(scopes.size());
+		scopes.push_back(name);
+		vkCmdBeginQuery(commandBuffer, m_queries->getPool(frameIndex, STATISTICS_POOL), scope, 0);
+		vkCmdBeginQuery(commandBuffer,
+		                m_queries->getPool(frameIndex, OCCLUSION_POOL),
+		                scope,
+		                m_zDevice.getCapabilities().occlusionQueryPrecise ? VK_QUERY_CONTROL_PRECISE_BIT : 0);
+		m_isScopeOpen = true;
+		return scope;
+	}
+
+	void ZPipelineStatistics::endScope(VkCommandBuffer commandBuffer, ScopeId scope)
+	{
+		if (scope == INVALID_SCOPE)
+		{
+			return;
+		}
+		int frameIndex = m_queries->getFrameIndex();
+		assert(m_isScopeOpen && scope + 1 == m_frameScopes[frameIndex].size() && "Scope is not the one that is open");
+		vkCmdEndQuery(commandBuffer, m_queries->getPool(frameIndex, OCCLUSION_POOL), scope);
+		vkCmdEndQuery(commandBuffer, m_queries->getPool(frameIndex, STATISTICS_POOL), scope);
+		m_isScopeOpen = false;
+	}
+
+	void ZPipelineStatistics::resolveFinishedFrames()
+	{
+		if (isSupported())
+		{
+			m_queries->resolveFinishedFrames(std::bind_front(&ZPipelineStatistics::resolve, this));
+		}
+	}
+
+	void ZPipelineStatistics::resolve(int frameIndex, uint64_t)
+	{
+		std::vector<std::string>& scopes = m_frameScopes[frameIndex];
+		if (scopes.empty())
+		{
+			return;
+		}
+
+		// each result is followed by its availability
+		auto scopeCount = static_cast<uint32_t>(scopes.size());
+		std::vector<uint64_t> statistics = m_queries->getResults(frameIndex, STATISTICS_POOL, scopeCount,
+		                                                         STATISTIC_COUNT);
+		std::vector<uint64_t> occlusion = m_queries->getResults(frameIndex, OCCLUSION_POOL, scopeCount, 1);
+
+		m_lastResolvedFrame.clear();
+		for (uint32_t i = 0; i < scopeCount; i++)
+		{
+			const uint64_t* values = &statistics[i * (STATISTIC_COUNT + 1)];
+			if (values[STATISTIC_COUNT] == 0 || occlusion[2 * i + 1] == 0)
+			{
+				continue;
+			}
+			Counters counters{
+				.inputAssemblyVertices = values[0],
+				.inputAssemblyPrimitives = values[1],
+				.vertexShaderInvocations = values[2],
+				.clippingInvocations = values[3],
+				.clippingPrimitives = values[4],
+				.fragmentShaderInvocations = values[5],
+				.samplesPassed = occlusion[2 * i],
+			};
+			m_lastResolvedFrame.push_back(ScopeCounters{scopes[i], counters});
+
+			auto total = std::ranges::find(m_totals, scopes[i], &Total::name);
+			if (total == m_totals.end())
+			{
+				m_totals.push_back(Total{scopes[i]});
+				total = m_totals.end() - 1;
+			}
+			total->sum += counters;
+			total->frameCount++;
+		}
+		scopes.clear();
+	}
+
+	std::vector<ZPipelineStatistics::ScopeCounters> ZPipelineStatistics::getAverages() const
+	{
+		std::vector<ScopeCounters> averages;
+		for (const Total& total : m_totals)
+		{
+			uint64_t n = total.frameCount;
+			averages.push_back(ScopeCounters{
+				total.name,
+				Counters{
+					.inputAssemblyVertices = total.sum.inputAssemblyVertices / n,
+					.inputAssemblyPrimitives = total.sum.inputAssemblyPrimitives / n,
+					.vertexShaderInvocations = total.sum.vertexShaderInvocations / n,
+					.clippingInvocations = total.sum.clippingInvocations / n,
+					.clippingPrimitives = total.sum.clippingPrimitives / n,
+					.fragmentShaderInvocations = total.sum.fragmentShaderInvocations / n,
+					.samplesPassed = total.sum.samplesPassed / n,
+				}
+			});
+		}
+		return averages;
+	}
+}
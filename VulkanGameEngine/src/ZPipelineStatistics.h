@@ -0,0 +1,87 @@
+﻿#pragma once
+
+#include "ZQueryRing.h"
+
+namespace ZZX
+{
+	/**
+	 * Counts the work the GPU does in scopes of a frame, with pipeline statistics and occlusion queries.
+	 *
+	 * Like ZGpuProfiler, the queries live in a ZQueryRing, so reading them never stalls. A query of a type can
+	 * only be active once at a time, so scopes don't nest. Scopes that execute secondary command buffers would
+	 * need the inheritedQueries feature, which isn't used: record the draws inline while collecting statistics.
+	 *
+	 * Needs the pipelineStatisticsQuery feature; without it nothing is recorded.
+	 */
+	class ZPipelineStatistics
+	{
+	public:
+		using ScopeId = uint32_t;
+		// returned when statistics aren't supported or the frame has no queries left; ending it does nothing
+		static constexpr ScopeId INVALID_SCOPE = std::numeric_limits<ScopeId>::max();
+		static constexpr uint32_t DEFAULT_MAX_SCOPES = 16;
+
+		struct Counters
+		{
+			uint64_t inputAssemblyVertices = 0;
+			uint64_t inputAssemblyPrimitives = 0;
+			uint64_t vertexShaderInvocations = 0;
+			// primitives that reach clipping, and those that come out of it (i.e. weren't clipped or culled away)
+			uint64_t clippingInvocations = 0;
+			uint64_t clippingPrimitives = 0;
+			uint64_t fragmentShaderInvocations = 0;
+			// samples that passed the depth test; only exact with DeviceCapabilities::occlusionQueryPrecise
+			uint64_t samplesPassed = 0;
+
+			Counters& operator+=(const Counters& other);
+		};
+
+		struct ScopeCounters
+		{
+			std::string name;
+			Counters counters;
+		};
+
+		ZPipelineStatistics(ZDevice& device, uint32_t maxScopesPerFrame = DEFAULT_MAX_SCOPES);
+
+		// delete copy ctor and assignment to avoid dangling pointer
+		ZPipelineStatistics(const ZPipelineStatistics&) = delete;
+		ZPipelineStatistics& operator=(const ZPipelineStatistics&) = delete;
+
+		bool isSupported() const { return m_queries.has_value(); }
+
+		// see ZQueryRing::beginFrame
+		void beginFrame(VkCommandBuffer commandBuffer, int frameIndex, uint64_t frameValue);
+		// a scope begun inside a render pass must end in it
+		ScopeId beginScope(VkCommandBuffer commandBuffer, const std::string& name);
+		void endScope(VkCommandBuffer commandBuffer, ScopeId scope);
+		// e.g. once the device is idle before reporting
+		void resolveFinishedFrames();
+
+		// the counters of the most recently resolved frame
+		const std::vector<ScopeCounters>& getLastResolvedFrame() const { return m_lastResolvedFrame; }
+		// per scope name, averaged over every resolved frame it appeared in
+		std::vector<ScopeCounters> getAverages() const;
+
+	private:
+		struct Total
+		{
+			std::string name;
+			Counters sum;
+			uint64_t frameCount = 0;
+		};
+
+		void resolve(int frameIndex, uint64_t frameValue);
+
+		ZDevice& m_zDevice;
+		uint32_t m_maxScopes;
+		// a statistics and an occlusion pool per frame; empty if statistics aren't supported
+		std::optional<ZQueryRing> m_queries;
+		// the names of the scopes recorded into each frame in flight
+		std::vector<std::vector<std::string>> m_frameScopes;
+		bool m_isScopeOpen = false;
+
+		std::vector<ScopeCounters> m_lastResolvedFrame;
+		std::vector<Total> m_totals;
+	};
+}
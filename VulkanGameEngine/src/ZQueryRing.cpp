@@ -0,0 +1,96 @@
+﻿#include "pch.h"
+#include "ZQueryRing.h"
+#include "ZSwapChain.h"
+
+namespace ZZX
+{
+	ZQueryRing::ZQueryRing(ZDevice& device, const std::vector<VkQueryPoolCreateInfo>& poolInfos)
+		: m_zDevice{device}
+	{
+		for (const VkQueryPoolCreateInfo& poolInfo : poolInfos)
+		{
+			m_queryCounts.push_back(poolInfo.queryCount);
+		}
+		m_frames.resize(ZSwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (Frame& frame : m_frames)
+		{
+			for (const VkQueryPoolCreateInfo& poolInfo : poolInfos)
+			{
+				VkQueryPool pool;
+				if (vkCreateQueryPool(m_zDevice.device(), &poolInfo, nullptr, &pool) != VK_SUCCESS)
+				{
+					throw std::runtime_error("failed to create query pool!");
+				}
+				frame.pools.push_back(pool);
+			}
+		}
+	}
+
+	ZQueryRing::~ZQueryRing()
+	{
+		for (Frame& frame : m_frames)
+		{
+			for (VkQueryPool pool : frame.pools)
+			{
+				vkDestroyQueryPool(m_zDevice.device(), pool, nullptr);
+			}
+		}
+	}
+
+	void ZQueryRing::beginFrame(VkCommandBuffer commandBuffer, int frameIndex, uint64_t frameValue,
+	                            const ResolveFunction& resolve)
+	{
+		m_frameIndex = frameIndex;
+		this->resolve(frameIndex, resolve);
+
+		Frame& frame = m_frames[frameIndex];
+		frame.frameValue = frameValue;
+		for (size_t i = 0; i < frame.pools.size(); i++)
+		{
+			vkCmdResetQueryPool(commandBuffer, frame.pools[i], 0, m_queryCounts[i]);
+		}
+	}
+
+	void ZQueryRing::resolveFinishedFrames(const ResolveFunction& resolve)
+	{
+		std::vector<int> frameIndices(m_frames.size());
+		std::iota(frameIndices.begin(), frameIndices.end(), 0);
+		std::ranges::sort(frameIndices, {}, [&](int frameIndex) { return m_frames[frameIndex].frameValue; });
+		for (int frameIndex : frameIndices)
+		{
+			this->resolve(frameIndex, resolve);
+		}
+	}
+
+	std::vector<uint64_t> ZQueryRing::getResults(int frameIndex, size_t pool, uint32_t queryCount,
+	                                             uint32_t valueCount) const
+	{
+		std::vector<uint64_t> results(queryCount * (valueCount + 1));
+		VkResult result = vkGetQueryPoolResults(m_zDevice.device(),
+		                                        m_frames[frameIndex].pools[pool],
+		                                        0,
+		                                        queryCount,
+		                                        results.size() * sizeof(uint64_t),
+		                                        results.data(),
+		                                        (valueCount + 1) * sizeof(uint64_t),
+		                                        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+		if (result != VK_SUCCESS && result != VK_NOT_READY)
+		{
+			throw std::runtime_error("failed to get query pool results!");
+		}
+		return results;
+	}
+
+	void ZQueryRing::resolve(int frameIndex, const ResolveFunction& resolve)
+	{
+		Frame& frame = m_frames[frameIndex];
+		// the renderer waits for a frame before reusing its index, so this is only a safety net: rather drop
+		// the frame than stall on it
+		if (frame.frameValue == 0 || m_zDevice.graphicsTimeline().completedValue() < frame.frameValue)
+		{
+			return;
+		}
+		resolve(frameIndex, frame.frameValue);
+		frame.frameValue = 0;
+	}
+}
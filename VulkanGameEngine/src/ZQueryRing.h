@@ -0,0 +1,59 @@
+﻿#pragma once
+
+#include "ZDevice.h"
+
+namespace ZZX
+{
+	/**
+	 * The per-frame query pools that ZGpuProfiler and ZPipelineStatistics are built on.
+	 *
+	 * Every frame in flight has its own pools, one per VkQueryPoolCreateInfo given. A frame's queries are
+	 * resolved when its slot comes around again, by which time the renderer has already waited for that frame,
+	 * so reading them never stalls. A frame that hasn't finished is skipped rather than waited on, and every
+	 * frame is resolved at most once.
+	 */
+	class ZQueryRing
+	{
+	public:
+		// reads the queries of a finished frame, e.g. with getResults
+		using ResolveFunction = std::function<void(int frameIndex, uint64_t frameValue)>;
+
+		ZQueryRing(ZDevice& device, const std::vector<VkQueryPoolCreateInfo>& poolInfos);
+		~ZQueryRing();
+
+		// delete copy ctor and assignment to avoid dangling pointer
+		ZQueryRing(const ZQueryRing&) = delete;
+		ZQueryRing& operator=(const ZQueryRing&) = delete;
+
+		// sized for the most frames in flight, so changing the swap chain settings doesn't affect us
+		size_t getFrameCount() const { return m_frames.size(); }
+		// the frame being recorded, or -1 before the first one
+		int getFrameIndex() const { return m_frameIndex; }
+		VkQueryPool getPool(int frameIndex, size_t pool) const { return m_frames[frameIndex].pools[pool]; }
+
+		// call at the start of the frame's command buffer, outside any render pass: resolves the last frame that
+		// used this frame index and resets its queries
+		void beginFrame(VkCommandBuffer commandBuffer, int frameIndex, uint64_t frameValue,
+		                const ResolveFunction& resolve);
+		// resolve every frame that has finished, oldest first, so the last one resolved is the newest
+		void resolveFinishedFrames(const ResolveFunction& resolve);
+
+		// the first queryCount queries of a pool, each as valueCount values followed by its availability
+		std::vector<uint64_t> getResults(int frameIndex, size_t pool, uint32_t queryCount, uint32_t valueCount) const;
+
+	private:
+		struct Frame
+		{
+			std::vector<VkQueryPool> pools;
+			// the timeline value the frame signals; 0 while there is nothing to resolve
+			uint64_t frameValue = 0;
+		};
+
+		void resolve(int frameIndex, const ResolveFunction& resolve);
+
+		ZDevice& m_zDevice;
+		std::vector<uint32_t> m_queryCounts;
+		std::vector<Frame> m_frames;
+		int m_frameIndex = -1;
+	};
+}
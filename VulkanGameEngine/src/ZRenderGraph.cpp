@@ -0,0 +1,753 @@
+﻿#include "pch.h"
+#include "ZRenderGraph.h"
+#include "ZRenderer.h"
+
+namespace ZZX
+{
+	// the access bits that make memory available, i.e. the ones a later access has to wait for
+	static constexpr VkAccessFlags2 WRITE_ACCESS = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_2_TRANSFER_WRITE_BIT |
+		VK_ACCESS_2_SHADER_WRITE_BIT |
+		VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+	static constexpr VkPipelineStageFlags2 DEPTH_TEST_STAGES = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+		VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+
+	static const char* layoutName(VkImageLayout layout)
+	{
+		switch (layout)
+		{
+		case VK_IMAGE_LAYOUT_UNDEFINED: return "undefined";
+		case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL: return "color attachment";
+		case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL: return "depth attachment";
+		case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL: return "depth read-only";
+		case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL: return "shader read-only";
+		case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL: return "transfer src";
+		case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL: return "transfer dst";
+		case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR: return "present src";
+		default: return "other";
+		}
+	}
+
+	ZRenderGraph::PassBuilder& ZRenderGraph::PassBuilder::writeColor(ResourceId image,
+	                                                                 std::optional<VkClearColorValue> clearValue)
+	{
+		ImageUse use{
+			.resource = image,
+			.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			.stages = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+			.access = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+			(clearValue ? VK_ACCESS_2_NONE : VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT),
+			.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+			.isWrite = true,
+			.isAttachment = true,
+			.loadOp = clearValue ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD,
+		};
+		if (clearValue)
+		{
+			use.clearValue.color = *clearValue;
+		}
+		return m_graph.addUse(*this, use);
+	}
+
+	ZRenderGraph::PassBuilder& ZRenderGraph::PassBuilder::writeDepth(ResourceId image, std::optional<float> clearDepth)
+	{
+		ImageUse use{
+			.resource = image,
+			.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			.stages = DEPTH_TEST_STAGES,
+			// the depth test reads even a cleared attachment
+			.access = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+			.isWrite = true,
+			.isAttachment = true,
+			.loadOp = clearDepth ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD,
+		};
+		if (clearDepth)
+		{
+			use.clearValue.depthStencil = {*clearDepth, 0};
+		}
+		return m_graph.addUse(*this, use);
+	}
+
+	ZRenderGraph::PassBuilder& ZRenderGraph::PassBuilder::readDepth(ResourceId image)
+	{
+		return m_graph.addUse(*this, ImageUse{
+			                      .resource = image,
+			                      .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+			                      .stages = DEPTH_TEST_STAGES,
+			                      .access = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+			                      .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+			                      .isWrite = false,
+			                      .isAttachment = true,
+		                      });
+	}
+
+	ZRenderGraph::PassBuilder& ZRenderGraph::PassBuilder::readTexture(ResourceId image)
+	{
+		return m_graph.addUse(*this, ImageUse{
+			                      .resource = image,
+			                      .layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			                      .stages = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+			                      .access = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+			                      .usage = VK_IMAGE_USAGE_SAMPLED_BIT,
+			                      .isWrite = false,
+		                      });
+	}
+
+	ZRenderGraph::PassBuilder& ZRenderGraph::PassBuilder::readTransfer(ResourceId image)
+	{
+		return m_graph.addUse(*this, ImageUse{
+			                      .resource = image,
+			                      .layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			                      .stages = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+			                      .access = VK_ACCESS_2_TRANSFER_READ_BIT,
+			                      .usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+			                      .isWrite = false,
+		                      });
+	}
+
+	ZRenderGraph::PassBuilder& ZRenderGraph::PassBuilder::writeTransfer(ResourceId image)
+	{
+		return m_graph.addUse(*this, ImageUse{
+			                      .resource = image,
+			                      .layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			                      .stages = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+			                      .access = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+			                      .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+			                      .isWrite = true,
+		                      });
+	}
+
+	ZRenderGraph::PassBuilder& ZRenderGraph::PassBuilder::setSideEffect()
+	{
+		m_graph.m_passes[m_pass].hasSideEffect = true;
+		return *this;
+	}
+
+	ZRenderGraph::PassBuilder& ZRenderGraph::PassBuilder::useSecondaryCommandBuffers()
+	{
+		m_graph.m_passes[m_pass].usesSecondaryCommandBuffers = true;
+		return *this;
+	}
+
+	// whether a use depends on what the image held before
+	static bool readsContents(bool isWrite, bool isAttachment, VkAttachmentLoadOp loadOp)
+	{
+		return !isWrite || (isAttachment && loadOp == VK_ATTACHMENT_LOAD_OP_LOAD);
+	}
+
+	ZRenderGraph::ZRenderGraph(ZDevice& device)
+		: m_zDevice{device}
+	{
+		assert(device.getCapabilities().dynamicRendering && device.getCapabilities().synchronization2 &&
+			"The render graph needs dynamic rendering and synchronization2");
+	}
+
+	ZRenderGraph::~ZRenderGraph()
+	{
+		for (auto& [frameIndex, set] : m_transientSets)
+		{
+			destroyTransientSet(set);
+		}
+	}
+
+	void ZRenderGraph::reset(int frameIndex)
+	{
+		m_frameIndex = frameIndex;
+		m_passes.clear();
+		m_resources.clear();
+		m_finalBarriers.clear();
+		m_stats = {};
+		m_isCompiled = false;
+	}
+
+	ZRenderGraph::ResourceId ZRenderGraph::importImage(const std::string& name, VkImage image, VkImageView view,
+	                                                   const ImageDesc& desc, const ImageState& initialState,
+	                                                   const ImageState& finalState)
+	{
+		assert(m_frameIndex >= 0 && "cannot declare resources before reset");
+		m_resources.push_back(Resource{
+			.name = name,
+			.desc = desc,
+			.isImported = true,
+			.initialState = initialState,
+			.finalState = finalState,
+			.image = image,
+			.view = view,
+		});
+		return static_cast<ResourceId>(m_resources.size() - 1);
+	}
+
+	ZRenderGraph::ResourceId ZRenderGraph::createImage(const std::string& name, const ImageDesc& desc)
+	{
+		assert(m_frameIndex >= 0 && "cannot declare resources before reset");
+		m_resources.push_back(Resource{.name = name, .desc = desc});
+		return static_cast<ResourceId>(m_resources.size() - 1);
+	}
+
+	ZRenderGraph::PassBuilder ZRenderGraph::addPass(const std::string& name, ExecuteFunction execute)
+	{
+		assert(m_frameIndex >= 0 && "cannot declare passes before reset");
+		assert(!m_isCompiled && "cannot add passes to a compiled graph");
+		m_passes.push_back(Pass{.name = name, .execute = std::move(execute)});
+		return PassBuilder{*this, static_cast<uint32_t>(m_passes.size() - 1)};
+	}
+
+	ZRenderGraph::PassBuilder& ZRenderGraph::addUse(PassBuilder& builder, ImageUse use)
+	{
+		assert(use.resource < m_resources.size() && "Resource was never declared");
+		auto& uses = m_passes[builder.m_pass].uses;
+		assert(std::ranges::none_of(uses, [&](const ImageUse& other) { return other.resource == use.resource; }) &&
+			"A pass can only use an image one way");
+		uses.push_back(use);
+		return builder;
+	}
+
+	void ZRenderGraph::compile()
+	{
+		assert(!m_isCompiled && "the graph is already compiled");
+		cullPasses();
+		allocateTransients();
+		computeBarriers();
+		m_isCompiled = true;
+	}
+
+	void ZRenderGraph::cullPasses()
+	{
+		// walk backwards from what must exist at the end of the frame: imported images and side effects
+		std::vector<bool> isNeeded(m_resources.size(), false);
+		for (size_t i = 0; i < m_resources.size(); i++)
+		{
+			isNeeded[i] = m_resources[i].isImported;
+		}
+
+		for (auto pass = m_passes.rbegin(); pass != m_passes.rend(); ++pass)
+		{
+			bool isUsed = pass->hasSideEffect || std::ranges::any_of(pass->uses, [&](const ImageUse& use)
+			{
+				return use.isWrite && isNeeded[use.resource];
+			});
+			pass->isCulled = !isUsed;
+			if (pass->isCulled)
+			{
+				m_stats.culledPassCount++;
+				continue;
+			}
+
+			for (const ImageUse& use : pass->uses)
+			{
+				bool isRead = readsContents(use.isWrite, use.isAttachment, use.loadOp);
+				// a pass that overwrites a transient image makes whatever was written to it before irrelevant
+				if (!isRead && !m_resources[use.resource].isImported)
+				{
+					isNeeded[use.resource] = false;
+				}
+			}
+			for (const ImageUse& use : pass->uses)
+			{
+				if (readsContents(use.isWrite, use.isAttachment, use.loadOp))
+				{
+					isNeeded[use.resource] = true;
+				}
+			}
+		}
+		m_stats.passCount = static_cast<uint32_t>(m_passes.size());
+
+		// attachments only have to be stored if a later pass reads them, or they leave the graph
+		for (size_t i = 0; i < m_passes.size(); i++)
+		{
+			if (m_passes[i].isCulled)
+			{
+				continue;
+			}
+			for (ImageUse& use : m_passes[i].uses)
+			{
+				if (!use.isAttachment)
+				{
+					continue;
+				}
+				bool isStored = m_resources[use.resource].isImported;
+				for (size_t later = i + 1; later < m_passes.size() && !isStored; later++)
+				{
+					if (m_passes[later].isCulled)
+					{
+						continue;
+					}
+					auto next = std::ranges::find_if(m_passes[later].uses, [&](const ImageUse& other)
+					{
+						return other.resource == use.resource;
+					});
+					if (next != m_passes[later].uses.end())
+					{
+						isStored = readsContents(next->isWrite, next->isAttachment, next->loadOp);
+						break;
+					}
+				}
+				use.storeOp = isStored ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			}
+		}
+	}
+
+	void ZRenderGraph::allocateTransients()
+	{
+		// lifetimes and usage, over the passes that are left
+		for (size_t i = 0; i < m_passes.size(); i++)
+		{
+			if (m_passes[i].isCulled)
+			{
+				continue;
+			}
+			for (const ImageUse& use : m_passes[i].uses)
+			{
+				Resource& resource = m_resources[use.resource];
+				if (resource.firstPass < 0)
+				{
+					resource.firstPass = static_cast<int>(i);
+				}
+				resource.lastPass = static_cast<int>(i);
+				resource.usage |= use.usage;
+			}
+		}
+
+		std::vector<ResourceId> transients;
+		std::vector<TransientSet::Image> wanted;
+		for (ResourceId id = 0; id < m_resources.size(); id++)
+		{
+			const Resource& resource = m_resources[id];
+			if (!resource.isImported && resource.firstPass >= 0)
+			{
+				transients.push_back(id);
+				wanted.push_back({
+					resource.desc.format, resource.desc.extent, resource.usage, resource.firstPass, resource.lastPass
+				});
+			}
+		}
+
+		TransientSet& set = m_transientSets[m_frameIndex];
+		if (set.descs != wanted)
+		{
+			// the last frame with this index is done, so its images can go right away
+			destroyTransientSet(set);
+			set.descs = wanted;
+
+			// place the largest images first, so each memory block is as large as its first image
+			std::vector<VkMemoryRequirements> requirements(wanted.size());
+			std::vector<VkImageCreateInfo> imageInfos(wanted.size());
+			for (size_t i = 0; i < wanted.size(); i++)
+			{
+				imageInfos[i] = VkImageCreateInfo{
+					.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+					.imageType = VK_IMAGE_TYPE_2D,
+					.format = wanted[i].format,
+					.extent = {wanted[i].extent.width, wanted[i].extent.height, 1},
+					.mipLevels = 1,
+					.arrayLayers = 1,
+					.samples = VK_SAMPLE_COUNT_1_BIT,
+					.tiling = VK_IMAGE_TILING_OPTIMAL,
+					.usage = wanted[i].usage,
+					.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+					.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+				};
+				VkDeviceImageMemoryRequirements info{
+					.sType = VK_STRUCTURE_TYPE_DEVICE_IMAGE_MEMORY_REQUIREMENTS,
+					.pCreateInfo = &imageInfos[i],
+				};
+				VkMemoryRequirements2 result{.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2};
+				vkGetDeviceImageMemoryRequirements(m_zDevice.device(), &info, &result);
+				requirements[i] = result.memoryRequirements;
+			}
+			std::vector<size_t> order(wanted.size());
+			std::iota(order.begin(), order.end(), 0);
+			std::ranges::stable_sort(order, [&](size_t a, size_t b)
+			{
+				return requirements[a].size > requirements[b].size;
+			});
+
+			// an image can share a block with the images already in it if none of their lifetimes overlap
+			struct Block
+			{
+				VkDeviceSize size;
+				uint32_t memoryTypeBits;
+				std::vector<size_t> images;
+			};
+			std::vector<Block> blocks;
+			set.memoryBlockOfImage.assign(wanted.size(), -1);
+			set.unaliasedMemorySize = 0;
+			for (size_t image : order)
+			{
+				set.unaliasedMemorySize += requirements[image].size;
+				auto fits = [&](const Block& block)
+				{
+					return block.size >= requirements[image].size &&
+						(block.memoryTypeBits & requirements[image].memoryTypeBits) != 0 &&
+						std::ranges::none_of(block.images, [&](size_t other)
+						{
+							return wanted[other].firstPass <= wanted[image].lastPass &&
+								wanted[image].firstPass <= wanted[other].lastPass;
+						});
+				};
+				auto block = std::ranges::find_if(blocks, fits);
+				if (block == blocks.end())
+				{
+					blocks.push_back({requirements[image].size, requirements[image].memoryTypeBits, {}});
+					block = blocks.end() - 1;
+				}
+				block->memoryTypeBits &= requirements[image].memoryTypeBits;
+				block->images.push_back(image);
+				set.memoryBlockOfImage[image] = static_cast<int>(block - blocks.begin());
+			}
+
+			set.memorySize = 0;
+			for (const Block& block : blocks)
+			{
+				VkMemoryAllocateInfo allocInfo{
+					.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+					.allocationSize = block.size,
+					.memoryTypeIndex = m_zDevice.findMemoryType(block.memoryTypeBits,
+					                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+				};
+				VkDeviceMemory memory;
+				if (vkAllocateMemory(m_zDevice.device(), &allocInfo, nullptr, &memory) != VK_SUCCESS)
+				{
+					throw std::runtime_error("failed to allocate transient image memory!");
+				}
+				set.memoryBlocks.push_back(memory);
+				set.memorySize += block.size;
+			}
+
+			for (size_t i = 0; i < wanted.size(); i++)
+			{
+				VkImage image;
+				if (vkCreateImage(m_zDevice.device(), &imageInfos[i], nullptr, &image) != VK_SUCCESS)
+				{
+					throw std::runtime_error("failed to create transient image!");
+				}
+				set.images.push_back(image);
+				if (vkBindImageMemory(m_zDevice.device(), image, set.memoryBlocks[set.memoryBlockOfImage[i]], 0) !=
+					VK_SUCCESS)
+				{
+					throw std::runtime_error("failed to bind transient image memory!");
+				}
+
+				// views only ever see depth, not stencil
+				VkImageAspectFlags aspect = aspectFlags(wanted[i].format);
+				VkImageViewCreateInfo viewInfo{
+					.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+					.image = image,
+					.viewType = VK_IMAGE_VIEW_TYPE_2D,
+					.format = wanted[i].format,
+					.subresourceRange = {
+						(aspect & VK_IMAGE_ASPECT_DEPTH_BIT) ? VkImageAspectFlags{VK_IMAGE_ASPECT_DEPTH_BIT} : aspect,
+						0, 1, 0, 1
+					},
+				};
+				VkImageView view;
+				if (vkCreateImageView(m_zDevice.device(), &viewInfo, nullptr, &view) != VK_SUCCESS)
+				{
+					throw std::runtime_error("failed to create transient image view!");
+				}
+				set.views.push_back(view);
+			}
+		}
+
+		for (size_t i = 0; i < transients.size(); i++)
+		{
+			Resource& resource = m_resources[transients[i]];
+			resource.image = set.images[i];
+			resource.view = set.views[i];
+			resource.memoryBlock = set.memoryBlockOfImage[i];
+		}
+		m_stats.transientMemory = set.memorySize;
+		m_stats.unaliasedTransientMemory = set.unaliasedMemorySize;
+	}
+
+	void ZRenderGraph::computeBarriers()
+	{
+		// what a later access to an image has to wait for
+		struct State
+		{
+			VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			// the last write (or layout transition)
+			VkPipelineStageFlags2 writeStages = VK_PIPELINE_STAGE_2_NONE;
+			VkAccessFlags2 writeAccess = VK_ACCESS_2_NONE;
+			// reads since then that already wait for it
+			VkPipelineStageFlags2 readStages = VK_PIPELINE_STAGE_2_NONE;
+			VkAccessFlags2 readAccess = VK_ACCESS_2_NONE;
+		};
+		std::vector<State> states(m_resources.size());
+		for (size_t i = 0; i < m_resources.size(); i++)
+		{
+			if (m_resources[i].isImported)
+			{
+				const ImageState& initial = m_resources[i].initialState;
+				states[i] = {initial.layout, initial.stages, initial.access & WRITE_ACCESS};
+			}
+		}
+		// the accesses of the last image that used each transient memory block; the next image in the block
+		// must not start before they are done
+		std::vector<State> blockStates(m_transientSets[m_frameIndex].memoryBlocks.size());
+
+		auto makeBarrier = [&](ResourceId resource, const State& from, VkImageLayout oldLayout,
+		                       VkPipelineStageFlags2 dstStages, VkAccessFlags2 dstAccess, VkImageLayout newLayout)
+		{
+			return VkImageMemoryBarrier2{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+				.srcStageMask = from.writeStages | from.readStages,
+				// reads only need an execution dependency
+				.srcAccessMask = from.writeAccess,
+				.dstStageMask = dstStages,
+				.dstAccessMask = dstAccess,
+				.oldLayout = oldLayout,
+				.newLayout = newLayout,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image = m_resources[resource].image,
+				.subresourceRange = {aspectFlags(m_resources[resource].desc.format), 0, 1, 0, 1},
+			};
+		};
+
+		for (size_t i = 0; i < m_passes.size(); i++)
+		{
+			Pass& pass = m_passes[i];
+			if (pass.isCulled)
+			{
+				continue;
+			}
+			for (const ImageUse& use : pass.uses)
+			{
+				Resource& resource = m_resources[use.resource];
+				State& state = states[use.resource];
+				if (!resource.isImported && resource.firstPass == static_cast<int>(i))
+				{
+					// a fresh transient image: wait for whatever used its memory before
+					state = blockStates[resource.memoryBlock];
+					state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+				}
+
+				bool isRead = readsContents(use.isWrite, use.isAttachment, use.loadOp);
+				bool isLayoutChange = state.layout != use.layout;
+				bool hasPriorAccess = (state.writeStages | state.readStages) != VK_PIPELINE_STAGE_2_NONE;
+				if (!use.isWrite && !isLayoutChange)
+				{
+					// read after read needs nothing; read after write needs one barrier for all readers at this stage
+					bool isVisible = (state.readStages & use.stages) == use.stages &&
+						(state.readAccess & use.access) == use.access;
+					if (state.writeStages != VK_PIPELINE_STAGE_2_NONE && !isVisible)
+					{
+						State from = state;
+						from.readStages = VK_PIPELINE_STAGE_2_NONE;
+						pass.barriers.push_back(makeBarrier(use.resource, from, state.layout,
+						                                    use.stages, use.access, use.layout));
+					}
+					state.readStages |= use.stages;
+					state.readAccess |= use.access;
+					continue;
+				}
+
+				if (isLayoutChange || hasPriorAccess)
+				{
+					// contents that are overwritten anyway can be discarded by transitioning from UNDEFINED
+					VkImageLayout oldLayout = isRead ? state.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+					pass.barriers.push_back(makeBarrier(use.resource, state, oldLayout,
+					                                    use.stages, use.access, use.layout));
+				}
+				state.layout = use.layout;
+				// the transition itself is a write the next accesses have to wait for
+				state.writeStages = use.stages;
+				state.writeAccess = use.access & WRITE_ACCESS;
+				state.readStages = use.isWrite ? VK_PIPELINE_STAGE_2_NONE : use.stages;
+				state.readAccess = use.isWrite ? VK_ACCESS_2_NONE : use.access;
+			}
+
+			for (const ImageUse& use : pass.uses)
+			{
+				const Resource& resource = m_resources[use.resource];
+				if (!resource.isImported && resource.lastPass == static_cast<int>(i))
+				{
+					blockStates[resource.memoryBlock] = states[use.resource];
+				}
+			}
+			m_stats.barrierCount += static_cast<uint32_t>(pass.barriers.size());
+		}
+
+		// hand imported images back in the state their owner expects
+		for (ResourceId id = 0; id < m_resources.size(); id++)
+		{
+			const Resource& resource = m_resources[id];
+			if (!resource.isImported)
+			{
+				continue;
+			}
+			const State& state = states[id];
+			const ImageState& final = resource.finalState;
+			if (state.layout != final.layout || final.stages != VK_PIPELINE_STAGE_2_NONE)
+			{
+				m_finalBarriers.push_back(makeBarrier(id, state, state.layout, final.stages, final.access,
+				                                      final.layout));
+			}
+		}
+		m_stats.barrierCount += static_cast<uint32_t>(m_finalBarriers.size());
+	}
+
+	void ZRenderGraph::execute(VkCommandBuffer commandBuffer, ZGpuProfiler* profiler)
+	{
+		assert(m_isCompiled && "cannot execute a graph before compiling it");
+		auto recordBarriers = [commandBuffer](const std::vector<VkImageMemoryBarrier2>& barriers)
+		{
+			if (barriers.empty())
+			{
+				return;
+			}
+			VkDependencyInfo dependencyInfo{
+				.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+				.imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size()),
+				.pImageMemoryBarriers = barriers.data(),
+			};
+			vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+		};
+
+		for (const Pass& pass : m_passes)
+		{
+			if (pass.isCulled)
+			{
+				continue;
+			}
+			auto scope = profiler ? profiler->beginScope(commandBuffer, pass.name) : ZGpuProfiler::INVALID_SCOPE;
+			recordBarriers(pass.barriers);
+			bool hasAttachments = std::ranges::any_of(pass.uses, [](const ImageUse& use) { return use.isAttachment; });
+			if (hasAttachments)
+			{
+				beginRendering(commandBuffer, pass);
+			}
+			pass.execute(commandBuffer);
+			if (hasAttachments)
+			{
+				vkCmdEndRendering(commandBuffer);
+			}
+			if (profiler)
+			{
+				profiler->endScope(commandBuffer, scope);
+			}
+		}
+		recordBarriers(m_finalBarriers);
+	}
+
+	void ZRenderGraph::beginRendering(VkCommandBuffer commandBuffer, const Pass& pass)
+	{
+		std::vector<VkRenderingAttachmentInfo> colorAttachments;
+		std::optional<VkRenderingAttachmentInfo> depthAttachment;
+		VkExtent2D extent{};
+		for (const ImageUse& use : pass.uses)
+		{
+			if (!use.isAttachment)
+			{
+				continue;
+			}
+			const Resource& resource = m_resources[use.resource];
+			extent = resource.desc.extent;
+			VkRenderingAttachmentInfo attachment{
+				.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+				.imageView = resource.view,
+				.imageLayout = use.layout,
+				.loadOp = use.loadOp,
+				.storeOp = use.storeOp,
+				.clearValue = use.clearValue,
+			};
+			if (use.layout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL)
+			{
+				colorAttachments.push_back(attachment);
+			}
+			else
+			{
+				assert(!depthAttachment && "A pass can only have one depth attachment");
+				depthAttachment = attachment;
+			}
+		}
+
+		VkRenderingInfo renderingInfo{
+			.sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+			.flags = pass.usesSecondaryCommandBuffers
+				         ? static_cast<VkRenderingFlags>(VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT)
+				         : VkRenderingFlags{0},
+			.renderArea = {.offset = {0, 0}, .extent = extent},
+			.layerCount = 1,
+			.colorAttachmentCount = static_cast<uint32_t>(colorAttachments.size()),
+			.pColorAttachments = colorAttachments.data(),
+			.pDepthAttachment = depthAttachment ? &*depthAttachment : nullptr,
+		};
+		vkCmdBeginRendering(commandBuffer, &renderingInfo);
+		// secondary command buffers set their own
+		if (!pass.usesSecondaryCommandBuffers)
+		{
+			ZRenderer::setViewportAndScissor(commandBuffer, extent);
+		}
+	}
+
+	void ZRenderGraph::destroyTransientSet(TransientSet& set)
+	{
+		for (VkImageView view : set.views)
+		{
+			vkDestroyImageView(m_zDevice.device(), view, nullptr);
+		}
+		for (VkImage image : set.images)
+		{
+			vkDestroyImage(m_zDevice.device(), image, nullptr);
+		}
+		for (VkDeviceMemory memory : set.memoryBlocks)
+		{
+			vkFreeMemory(m_zDevice.device(), memory, nullptr);
+		}
+		set = {};
+	}
+
+	VkImageAspectFlags ZRenderGraph::aspectFlags(VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_D16_UNORM:
+		case VK_FORMAT_X8_D24_UNORM_PACK32:
+		case VK_FORMAT_D32_SFLOAT:
+			return VK_IMAGE_ASPECT_DEPTH_BIT;
+		case VK_FORMAT_D16_UNORM_S8_UINT:
+		case VK_FORMAT_D24_UNORM_S8_UINT:
+		case VK_FORMAT_D32_SFLOAT_S8_UINT:
+			return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+		default:
+			return VK_IMAGE_ASPECT_COLOR_BIT;
+		}
+	}
+
+	void ZRenderGraph::printPlan(std::ostream& out) const
+	{
+		auto resourceName = [this](VkImage image)
+		{
+			auto resource = std::ranges::find_if(m_resources, [image](const Resource& r) { return r.image == image; });
+			return resource != m_resources.end() ? resource->name : std::string{"?"};
+		};
+		auto printBarriers = [&](const std::vector<VkImageMemoryBarrier2>& barriers)
+		{
+			for (const auto& barrier : barriers)
+			{
+				out << "\t\tbarrier " << resourceName(barrier.image) << ": " << layoutName(barrier.oldLayout)
+					<< " -> " << layoutName(barrier.newLayout) << '\n';
+			}
+		};
+
+		out << "Render graph (" << m_stats.passCount - m_stats.culledPassCount << " of " << m_stats.passCount
+			<< " passes, " << m_stats.barrierCount << " barriers, " << m_stats.transientMemory / 1024
+			<< " KiB transient memory, " << m_stats.unaliasedTransientMemory / 1024 << " KiB without aliasing):\n";
+		for (const Pass& pass : m_passes)
+		{
+			if (pass.isCulled)
+			{
+				out << "\t" << pass.name << " (culled)\n";
+				continue;
+			}
+			printBarriers(pass.barriers);
+			out << "\t" << pass.name << '\n';
+		}
+		printBarriers(m_finalBarriers);
+	}
+}
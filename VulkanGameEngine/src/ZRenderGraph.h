@@ -0,0 +1,211 @@
+﻿#pragma once
+
+#include "ZDevice.h"
+#include "ZGpuProfiler.h"
+
+namespace ZZX
+{
+	/**
+	 * A frame graph: the frame is declared as a list of passes, each naming the images it reads and writes.
+	 *
+	 * compile() then
+	 * - culls passes whose results nobody uses (a pass is kept if it writes an imported image, has side effects
+	 *   or writes something a kept pass reads),
+	 * - creates the transient images (those made by the graph) and lets images whose lifetimes don't overlap
+	 *   share memory,
+	 * - works out the layout transitions and the synchronization2 barriers between passes: a barrier is only
+	 *   recorded where an access actually depends on an earlier one, and reads that already see a write
+	 *   don't get another barrier.
+	 * execute() records the passes into a command buffer. Passes with attachments are wrapped in dynamic
+	 * rendering, so the graph needs the dynamicRendering and synchronization2 capabilities.
+	 *
+	 * The graph is declared again every frame (which is cheap); transient images are kept per frame index and
+	 * only recreated when their descriptions change.
+	 */
+	class ZRenderGraph
+	{
+	public:
+		using ResourceId = uint32_t;
+		using ExecuteFunction = std::function<void(VkCommandBuffer commandBuffer)>;
+
+		struct ImageDesc
+		{
+			VkFormat format = VK_FORMAT_UNDEFINED;
+			VkExtent2D extent{};
+		};
+
+		// the layout an imported image is in before the frame (or must be left in), and the accesses that
+		// precede (or follow) the graph
+		struct ImageState
+		{
+			VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_NONE;
+			VkAccessFlags2 access = VK_ACCESS_2_NONE;
+		};
+
+		struct Stats
+		{
+			uint32_t passCount = 0;
+			uint32_t culledPassCount = 0;
+			uint32_t barrierCount = 0;
+			// memory of the transient images of one frame, and what it would be without aliasing
+			VkDeviceSize transientMemory = 0;
+			VkDeviceSize unaliasedTransientMemory = 0;
+		};
+
+		class PassBuilder
+		{
+		public:
+			// a color attachment: cleared if clearValue is given, otherwise its contents are loaded (so also read)
+			PassBuilder& writeColor(ResourceId image, std::optional<VkClearColorValue> clearValue = std::nullopt);
+			// a depth attachment that is tested and written: cleared if clearDepth is given, otherwise loaded
+			PassBuilder& writeDepth(ResourceId image, std::optional<float> clearDepth = std::nullopt);
+			// a depth attachment that is only tested against
+			PassBuilder& readDepth(ResourceId image);
+			// sampled by fragment shaders
+			PassBuilder& readTexture(ResourceId image);
+			// the source or destination of copies
+			PassBuilder& readTransfer(ResourceId image);
+			PassBuilder& writeTransfer(ResourceId image);
+			// keep the pass even if nothing reads what it writes (e.g. it copies something back to the host)
+			PassBuilder& setSideEffect();
+			// the pass only executes secondary command buffers, see VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT
+			PassBuilder& useSecondaryCommandBuffers();
+
+		private:
+			friend class ZRenderGraph;
+
+			PassBuilder(ZRenderGraph& graph, uint32_t pass) : m_graph{graph}, m_pass{pass}
+			{
+			}
+
+			ZRenderGraph& m_graph;
+			uint32_t m_pass;
+		};
+
+		ZRenderGraph(ZDevice& device);
+		~ZRenderGraph();
+
+		// delete copy ctor and assignment to avoid dangling pointer
+		ZRenderGraph(const ZRenderGraph&) = delete;
+		ZRenderGraph& operator=(const ZRenderGraph&) = delete;
+
+		// forget the last frame's passes and resources and start declaring a new frame; the GPU must be done with
+		// the last frame that used this frame index, as its transient images are reused
+		void reset(int frameIndex);
+
+		// an image owned by someone else (e.g. a swap chain image); imported images always count as used
+		ResourceId importImage(const std::string& name, VkImage image, VkImageView view, const ImageDesc& desc,
+		                       const ImageState& initialState, const ImageState& finalState);
+		// an image that only lives for this frame; the graph creates it with whatever usage its passes need
+		ResourceId createImage(const std::string& name, const ImageDesc& desc);
+		// passes run in the order they are added; execute is only called if the pass isn't culled
+		PassBuilder addPass(const std::string& name, ExecuteFunction execute);
+
+		// cull passes, allocate transient images and compute barriers
+		void compile();
+		// record the frame; transitions imported images to their final state at the end. With a profiler, every
+		// pass (its barriers included) is timed as a scope named after it
+		void execute(VkCommandBuffer commandBuffer, ZGpuProfiler* profiler = nullptr);
+
+		const Stats& getStats() const { return m_stats; }
+		// one line per pass (or "culled"), with the barriers in front of it
+		void printPlan(std::ostream& out) const;
+
+	private:
+		// how a pass uses an image
+		struct ImageUse
+		{
+			ResourceId resource;
+			VkImageLayout layout;
+			VkPipelineStageFlags2 stages;
+			VkAccessFlags2 access;
+			VkImageUsageFlags usage;
+			bool isWrite;
+			// attachments only
+			bool isAttachment = false;
+			VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+			VkClearValue clearValue{};
+			// set by compile(): whether anything after this pass needs the contents
+			VkAttachmentStoreOp storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		};
+
+		struct Pass
+		{
+			std::string name;
+			ExecuteFunction execute;
+			std::vector<ImageUse> uses;
+			bool hasSideEffect = false;
+			bool usesSecondaryCommandBuffers = false;
+			// set by compile()
+			bool isCulled = false;
+			std::vector<VkImageMemoryBarrier2> barriers;
+		};
+
+		struct Resource
+		{
+			std::string name;
+			ImageDesc desc;
+			bool isImported = false;
+			// imported images only
+			ImageState initialState;
+			ImageState finalState;
+			// set by compile() for transient images
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			VkImageUsageFlags usage = 0;
+			// the first and last kept pass that uses it, or -1 if none
+			int firstPass = -1;
+			int lastPass = -1;
+			// index into the transient memory blocks
+			int memoryBlock = -1;
+		};
+
+		// the created transient images of one frame index; only rebuilt when their descriptions change
+		struct TransientSet
+		{
+			struct Image
+			{
+				VkFormat format;
+				VkExtent2D extent;
+				VkImageUsageFlags usage;
+				// the lifetime decides which images can share memory
+				int firstPass;
+				int lastPass;
+
+				bool operator==(const Image& other) const
+				{
+					return format == other.format && extent.width == other.extent.width &&
+						extent.height == other.extent.height && usage == other.usage &&
+						firstPass == other.firstPass && lastPass == other.lastPass;
+				}
+			};
+
+			std::vector<Image> descs;
+			std::vector<VkImage> images;
+			std::vector<VkImageView> views;
+			std::vector<int> memoryBlockOfImage;
+			std::vector<VkDeviceMemory> memoryBlocks;
+			VkDeviceSize memorySize = 0;
+			VkDeviceSize unaliasedMemorySize = 0;
+		};
+
+		void cullPasses();
+		// assign transient images to memory blocks and create them (or reuse last time's)
+		void allocateTransients();
+		void computeBarriers();
+		void destroyTransientSet(TransientSet& set);
+		void beginRendering(VkCommandBuffer commandBuffer, const Pass& pass);
+		static VkImageAspectFlags aspectFlags(VkFormat format);
+		PassBuilder& addUse(PassBuilder& builder, ImageUse use);
+
+		ZDevice& m_zDevice;
+		int m_frameIndex = -1;
+		std::vector<Pass> m_passes;
+		std::vector<Resource> m_resources;
+		std::vector<VkImageMemoryBarrier2> m_finalBarriers;
+		std::map<int, TransientSet> m_transientSets;
+		Stats m_stats{};
+		bool m_isCompiled = false;
+	};
+}
@@ -0,0 +1,46 @@
+﻿#pragma once
+
+namespace ZZX
+{
+	/**
+	 * What ZRenderer draws frames into: a ring of color and depth images plus the synchronization to hand
+	 * them out and submit frames rendering to them.
+	 *
+	 * ZSwapChain presents its images to a window; ZOffscreenTarget keeps them, for headless runs.
+	 */
+	class ZRenderTarget
+	{
+	public:
+		virtual ~ZRenderTarget() = default;
+
+		virtual VkRenderPass getRenderPass() = 0;
+		virtual VkFramebuffer getFrameBuffer(int index) = 0;
+		virtual VkImage getImage(int index) = 0;
+		virtual VkImageView getImageView(int index) = 0;
+		virtual VkImage getDepthImage(int index) = 0;
+		virtual VkImageView getDepthImageView(int index) = 0;
+		virtual size_t imageCount() = 0;
+		virtual uint32_t framesInFlight() const = 0;
+
+		virtual VkFormat getColorFormat() = 0;
+		virtual VkFormat getDepthFormat() = 0;
+		virtual VkExtent2D getExtent() = 0;
+
+		float extentAspectRatio()
+		{
+			VkExtent2D extent = getExtent();
+			return static_cast<float>(extent.width) / static_cast<float>(extent.height);
+		}
+
+		// the layout color images must be in when a frame is submitted (and the render pass leaves them in)
+		virtual VkImageLayout getFinalColorLayout() const = 0;
+		// whether the color images can be the source of a copy
+		virtual bool supportsTransferSrc() const = 0;
+
+		// wait until the next frame slot is free and pick the image to render it to
+		virtual VkResult acquireNextImage(uint32_t* imageIndex) = 0;
+		// frameValue is the graphics timeline value the submission signals once the GPU is done with the frame
+		virtual VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex,
+		                                      uint64_t frameValue) = 0;
+	};
+}
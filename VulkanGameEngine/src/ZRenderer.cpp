@@ -1,10 +1,13 @@
 ﻿#include "pch.h"
 #include "ZRenderer.h"
+#include "ZCpuProfiler.h"
 
 namespace ZZX
 {
-	ZRenderer::ZRenderer(ZWindow& window, ZDevice& device)
-		: m_zWindow{window}, m_zDevice{device}
+	ZRenderer::ZRenderer(ZWindow& window, ZDevice& device, const SwapChainSettings& swapChainSettings,
+	                     bool useDynamicRendering)
+		: m_zWindow{window}, m_zDevice{device}, m_swapChainSettings{swapChainSettings},
+		  m_useDynamicRendering{useDynamicRendering && device.getCapabilities().dynamicRendering}
 	{
 		recreateSwapChain();
 		createCommandBuffers();
@@ -18,8 +21,13 @@ namespace ZZX
 	VkCommandBuffer ZRenderer::beginFrame()
 	{
 		assert(!m_isFrameStarted && "cannot call beginFrame while already in progress");
+		releaseRetiredSwapChains();
 		// acquire the next available image that your application should render to
-		auto result = m_zSwapChain->acquireNextImage(&m_currentImageIndex);
+		VkResult result;
+		{
+			ZZX_PROFILE_SCOPE("acquire image");
+			result = target().acquireNextImage(&m_currentImageIndex);
+		}
 
 		// Every frame before drawing, check if window has been resized and swap chain is still valid
 		// recreate the swap chain as needed:
@@ -37,6 +45,8 @@ namespace ZZX
 		}
 
 		m_isFrameStarted = true;
+		// only reserved once the frame is sure to be submitted, as values must be submitted in order
+		m_currentFrameValue = m_zDevice.graphicsTimeline().reserveValue();
 		auto commandBuffer = getCurrentCommandBuffer();
 		VkCommandBufferBeginInfo beginInfo{
 			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
@@ -59,11 +69,17 @@ namespace ZZX
 			throw std::runtime_error("failed to end recording command buffers!");
 		}
 
-		auto result = m_zSwapChain->submitCommandBuffers(&commandBuffer, &m_currentImageIndex);
+		VkResult result;
+		{
+			ZZX_PROFILE_SCOPE("submit");
+			result = target().submitCommandBuffers(&commandBuffer, &m_currentImageIndex, m_currentFrameValue);
+		}
+		m_lastFrameValue = m_currentFrameValue;
 
 		// since some drivers/platforms will not trigger VK_ERROR_OUT_OF_DATE_KHR automatically after a window resize,
 		// extra checks are needed here:
-		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_zWindow.wasWindowResized())
+		if (!isHeadless() &&
+			(result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_zWindow.wasWindowResized()))
 		{
 			m_zWindow.resetWindowResizedFlag();
 			recreateSwapChain();
@@ -73,10 +89,70 @@ namespace ZZX
 			throw std::runtime_error("failed to present swap chain image!");
 		}
 		m_isFrameStarted = false;
-		m_currentFrameIndex = (m_currentFrameIndex + 1) % ZSwapChain::MAX_FRAMES_IN_FLIGHT;
+		m_currentFrameIndex = (m_currentFrameIndex + 1) % static_cast<int>(getFramesInFlight());
+	}
+
+	bool ZRenderer::waitForPreviousPresent()
+	{
+		assert(!m_isFrameStarted && "cannot wait for the previous present during a frame");
+		if (!supportsPresentWait())
+		{
+			if (m_lastFrameValue == 0)
+			{
+				return false;
+			}
+			waitForValue(m_lastFrameValue);
+			return true;
+		}
+
+		uint64_t presentId = m_zSwapChain->lastPresentId();
+		if (presentId == 0)
+		{
+			return false;
+		}
+		// bounded, so a window that is hidden or minimized can't stall the loop forever
+		constexpr uint64_t PRESENT_TIMEOUT_NS = 100'000'000;
+		VkResult result = m_zSwapChain->waitForPresent(presentId, PRESENT_TIMEOUT_NS);
+		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_TIMEOUT)
+		{
+			// beginFrame will recreate an out-of-date swap chain
+			return false;
+		}
+		if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+		{
+			throw std::runtime_error("failed to wait for present!");
+		}
+		return true;
+	}
+
+	bool ZRenderer::isPresented(uint64_t presentId)
+	{
+		assert(supportsPresentWait() && !isHeadless() && "presents can only be polled with present wait");
+		VkResult result = m_zSwapChain->waitForPresent(presentId, 0);
+		// out of date is left to beginFrame, which recreates the swap chain
+		if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR && result != VK_TIMEOUT &&
+			result != VK_ERROR_OUT_OF_DATE_KHR)
+		{
+			throw std::runtime_error("failed to wait for present!");
+		}
+		return result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR;
+	}
+
+	void ZRenderer::setSwapChainSettings(const SwapChainSettings& settings)
+	{
+		assert(!m_isFrameStarted && "cannot change swap chain settings while a frame is in progress");
+		vkDeviceWaitIdle(m_zDevice.device());
+		freeCommandBuffers();
+		m_swapChainSettings = settings;
+		// the frame counters of the old swap chain no longer line up with the new number of frames
+		m_zSwapChain = nullptr;
+		m_retiredSwapChains.clear();
+		m_currentFrameIndex = 0;
+		recreateSwapChain();
+		createCommandBuffers();
 	}
 
-	void ZRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer)
+	void ZRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents)
 	{
 		assert(m_isFrameStarted && "cannot call beginSwapChainRenderPass if frame is not in progress");
 		assert(
@@ -88,19 +164,64 @@ namespace ZZX
 		clearValues[0].color = {0.01f, 0.01f, 0.01f, 1.0f};
 		clearValues[1].depthStencil = {1.0f, 0};
 
-		VkRenderPassBeginInfo renderPassInfo{
-			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-			.renderPass = m_zSwapChain->getRenderPass(),
-			.framebuffer = m_zSwapChain->getFrameBuffer(m_currentImageIndex),
-			// define the size of the render area
-			.renderArea = {.offset = {0, 0}, .extent = m_zSwapChain->getSwapChainExtent()},
-			.clearValueCount = static_cast<uint32_t>(clearValues.size()),
-			.pClearValues = clearValues.data(),
-		};
+		if (m_useDynamicRendering)
+		{
+			// same load/store behavior as the swap chain render pass
+			transitionAttachmentsForRendering(commandBuffer);
+			VkRenderingAttachmentInfo colorAttachment{
+				.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+				.imageView = target().getImageView(m_currentImageIndex),
+				.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+				.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+				.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+				.clearValue = clearValues[0],
+			};
+			VkRenderingAttachmentInfo depthAttachment{
+				.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+				.imageView = target().getDepthImageView(m_currentImageIndex),
+				.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+				.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+				.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+				.clearValue = clearValues[1],
+			};
+			VkRenderingInfo renderingInfo{
+				.sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+				.flags = contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+					         ? static_cast<VkRenderingFlags>(VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT)
+					         : VkRenderingFlags{0},
+				.renderArea = {.offset = {0, 0}, .extent = target().getExtent()},
+				.layerCount = 1,
+				.colorAttachmentCount = 1,
+				.pColorAttachments = &colorAttachment,
+				.pDepthAttachment = &depthAttachment,
+			};
+			vkCmdBeginRendering(commandBuffer, &renderingInfo);
+		}
+		else
+		{
+			VkRenderPassBeginInfo renderPassInfo{
+				.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+				.renderPass = target().getRenderPass(),
+				.framebuffer = target().getFrameBuffer(m_currentImageIndex),
+				// define the size of the render area
+				.renderArea = {.offset = {0, 0}, .extent = target().getExtent()},
+				.clearValueCount = static_cast<uint32_t>(clearValues.size()),
+				.pClearValues = clearValues.data(),
+			};
 
-		// The render pass can now begin
-		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+			// The render pass can now begin
+			vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+		}
 
+		// the primary command buffer can't record anything else into a pass of secondary command buffers
+		if (contents == VK_SUBPASS_CONTENTS_INLINE)
+		{
+			setViewportAndScissor(commandBuffer, target().getExtent());
+		}
+	}
+
+	void ZRenderer::setViewportAndScissor(VkCommandBuffer commandBuffer, VkExtent2D extent)
+	{
 		// dynamic viewports/scissor: specifying viewports/scissor in the command buffer, rather than during pipeline creation,
 		// so that pipeline is no longer dependent on swap chain dimensions
 
@@ -109,8 +230,8 @@ namespace ZZX
 		VkViewport viewport{
 			.x = 0.0f,
 			.y = 0.0f,
-			.width = static_cast<float>(m_zSwapChain->getSwapChainExtent().width),
-			.height = static_cast<float>(m_zSwapChain->getSwapChainExtent().height),
+			.width = static_cast<float>(extent.width),
+			.height = static_cast<float>(extent.height),
 			.minDepth = 0.0f,
 			.maxDepth = 1.0f,
 		};
@@ -119,24 +240,325 @@ namespace ZZX
 		// Any pixels outside the scissor rectangles will be discarded by the rasterizer
 		// "cut" the triangle
 		// In this case, we want to render to the entire framebuffer
-		VkRect2D scissor{{0, 0}, m_zSwapChain->getSwapChainExtent()};
+		VkRect2D scissor{{0, 0}, extent};
 
 		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 	}
 
+	RenderPassInheritance ZRenderer::getRenderPassInheritance() const
+	{
+		assert(m_isFrameStarted && "cannot get render pass inheritance when frame not in progress");
+		return RenderPassInheritance{
+			.renderPass = m_useDynamicRendering ? VK_NULL_HANDLE : target().getRenderPass(),
+			.framebuffer = m_useDynamicRendering ? VK_NULL_HANDLE : target().getFrameBuffer(m_currentImageIndex),
+			.colorFormat = target().getColorFormat(),
+			.depthFormat = target().getDepthFormat(),
+			.extent = target().getExtent(),
+		};
+	}
+
 	void ZRenderer::endSwapChainRenderPass(VkCommandBuffer commandBuffer)
 	{
 		assert(m_isFrameStarted && "cannot call endSwapChainRenderPass if frame is not in progress");
 		assert(
 			commandBuffer == getCurrentCommandBuffer() &&
 			"cannot end render pass on command buffer from a different frame");
-		vkCmdEndRenderPass(commandBuffer);
+		if (m_useDynamicRendering)
+		{
+			vkCmdEndRendering(commandBuffer);
+			transitionColorForPresent(commandBuffer);
+		}
+		else
+		{
+			vkCmdEndRenderPass(commandBuffer);
+		}
+
+		if (m_isCaptureRequested)
+		{
+			recordCapture(commandBuffer);
+			m_isCaptureRequested = false;
+			m_isCaptureReady = true;
+		}
+	}
+
+	void ZRenderer::requestCapture()
+	{
+		if (!supportsCapture())
+		{
+			throw std::runtime_error("failed to request capture: swap chain images cannot be copied from!");
+		}
+		m_isCaptureRequested = true;
+		m_isCaptureReady = false;
+	}
+
+	ImageData ZRenderer::takeCapture()
+	{
+		assert(m_isCaptureReady && "cannot take a capture that was not recorded");
+		// the copy has to land before the buffer can be read
+		waitForValue(m_captureValue);
+
+		ImageData image{m_captureExtent.width, m_captureExtent.height};
+		image.pixels.resize(static_cast<size_t>(image.width) * image.height * 4);
+		std::memcpy(image.pixels.data(), m_captureBuffer->getMappedMemory(), image.pixels.size());
+
+		// the swap chain usually prefers BGRA
+		if (m_captureFormat == VK_FORMAT_B8G8R8A8_SRGB || m_captureFormat == VK_FORMAT_B8G8R8A8_UNORM)
+		{
+			for (size_t i = 0; i < image.pixels.size(); i += 4)
+			{
+				std::swap(image.pixels[i], image.pixels[i + 2]);
+			}
+		}
+		m_isCaptureReady = false;
+		return image;
+	}
+
+	ZRenderGraph::ResourceId ZRenderer::importSwapChainImage(ZRenderGraph& graph) const
+	{
+		assert(m_isFrameStarted && "cannot import the swap chain image when frame not in progress");
+		return graph.importImage("swap chain",
+		                         target().getImage(m_currentImageIndex),
+		                         target().getImageView(m_currentImageIndex),
+		                         {target().getColorFormat(), target().getExtent()},
+		                         // the acquire semaphore is waited for at color attachment output, and an earlier
+		                         // frame may have copied the image out; the old contents are never needed
+		                         {
+			                         VK_IMAGE_LAYOUT_UNDEFINED,
+			                         VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+			                         VK_ACCESS_2_NONE
+		                         },
+		                         // presentation (or the next acquire) synchronizes through the submit
+		                         {target().getFinalColorLayout(), VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE});
+	}
+
+	ZRenderGraph::ResourceId ZRenderer::importSwapChainDepthImage(ZRenderGraph& graph) const
+	{
+		assert(m_isFrameStarted && "cannot import the swap chain depth image when frame not in progress");
+		return graph.importImage("swap chain depth",
+		                         target().getDepthImage(m_currentImageIndex),
+		                         target().getDepthImageView(m_currentImageIndex),
+		                         // the image may be larger than the swap chain, but only this much is rendered to
+		                         {target().getDepthFormat(), target().getExtent()},
+		                         // the contents are cleared every frame, but the last frame that used this image may
+		                         // still be writing to it
+		                         {
+			                         VK_IMAGE_LAYOUT_UNDEFINED,
+			                         VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+			                         VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+			                         VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+		                         },
+		                         // nothing reads it after the frame, so it stays as the passes left it
+		                         {VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE});
+	}
+
+	void ZRenderer::addCapturePass(ZRenderGraph& graph, ZRenderGraph::ResourceId color)
+	{
+		if (!m_isCaptureRequested)
+		{
+			return;
+		}
+		VkImage image = target().getImage(m_currentImageIndex);
+		graph.addPass("capture", [this, image](VkCommandBuffer commandBuffer)
+		     {
+			     recordCaptureCopy(commandBuffer, image);
+		     })
+		     .readTransfer(color)
+		     // only the host reads the copy
+		     .setSideEffect();
+		m_isCaptureRequested = false;
+		m_isCaptureReady = true;
+	}
+
+	void ZRenderer::recordCapture(VkCommandBuffer commandBuffer)
+	{
+		VkImage image = target().getImage(m_currentImageIndex);
+		// an offscreen target already leaves its images ready to be copied from
+		bool needsTransition = target().getFinalColorLayout() != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		VkImageMemoryBarrier toTransfer{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+			.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+			.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = image,
+			.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+		};
+		if (needsTransition)
+		{
+			vkCmdPipelineBarrier(commandBuffer,
+			                     VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+			                     0,
+			                     0,
+			                     nullptr,
+			                     0,
+			                     nullptr,
+			                     1,
+			                     &toTransfer);
+		}
+
+		recordCaptureCopy(commandBuffer, image);
+
+		VkImageMemoryBarrier toPresent{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+			.dstAccessMask = 0,
+			.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = image,
+			.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+		};
+		if (needsTransition)
+		{
+			vkCmdPipelineBarrier(commandBuffer,
+			                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+			                     VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			                     0,
+			                     0,
+			                     nullptr,
+			                     0,
+			                     nullptr,
+			                     1,
+			                     &toPresent);
+		}
+	}
+
+	void ZRenderer::recordCaptureCopy(VkCommandBuffer commandBuffer, VkImage image)
+	{
+		m_captureValue = m_currentFrameValue;
+		m_captureExtent = target().getExtent();
+		m_captureFormat = target().getColorFormat();
+		VkDeviceSize captureSize = static_cast<VkDeviceSize>(m_captureExtent.width) * m_captureExtent.height * 4;
+		if (m_captureBuffer == nullptr || m_captureBuffer->getBufferSize() != captureSize)
+		{
+			m_captureBuffer = std::make_unique<ZBuffer>(m_zDevice,
+			                                            captureSize,
+			                                            1,
+			                                            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			                                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+			                                            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			m_captureBuffer->map();
+		}
+
+		VkBufferImageCopy region{
+			.bufferOffset = 0,
+			// tightly packed
+			.bufferRowLength = 0,
+			.bufferImageHeight = 0,
+			.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+			.imageOffset = {0, 0, 0},
+			.imageExtent = {m_captureExtent.width, m_captureExtent.height, 1},
+		};
+		vkCmdCopyImageToBuffer(commandBuffer,
+		                       image,
+		                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		                       m_captureBuffer->getBuffer(),
+		                       1,
+		                       &region);
+	}
+
+	PipelineRenderTarget ZRenderer::getSwapChainRenderTarget() const
+	{
+		return PipelineRenderTarget{
+			// with dynamic rendering, pipelines no longer depend on the render pass object
+			.renderPass = m_useDynamicRendering ? VK_NULL_HANDLE : target().getRenderPass(),
+			.colorAttachmentFormat = target().getColorFormat(),
+			.depthAttachmentFormat = target().getDepthFormat(),
+		};
+	}
+
+	void ZRenderer::transitionAttachmentsForRendering(VkCommandBuffer commandBuffer)
+	{
+		VkFormat depthFormat = target().getDepthFormat();
+		bool hasStencil = depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT || depthFormat == VK_FORMAT_D24_UNORM_S8_UINT;
+
+		// the previous contents are cleared anyway, so both images can start from UNDEFINED
+		std::array<VkImageMemoryBarrier, 2> barriers{
+			VkImageMemoryBarrier{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				.srcAccessMask = 0,
+				.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+				.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+				.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image = target().getImage(m_currentImageIndex),
+				.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+			},
+			VkImageMemoryBarrier{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				// the last frame that used this depth image may still be writing to it
+				.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+				VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+				.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+				.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image = target().getDepthImage(m_currentImageIndex),
+				.subresourceRange = {
+					static_cast<VkImageAspectFlags>(VK_IMAGE_ASPECT_DEPTH_BIT | (hasStencil ? VK_IMAGE_ASPECT_STENCIL_BIT : 0)),
+					0, 1, 0, 1
+				},
+			},
+		};
+
+		// matches the external subpass dependency of the swap chain render pass
+		// (plus transfers, an earlier frame may have copied the color image out)
+		vkCmdPipelineBarrier(commandBuffer,
+		                     VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+		                     VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+		                     VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+		                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+		                     VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+		                     VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+		                     VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		                     0,
+		                     0,
+		                     nullptr,
+		                     0,
+		                     nullptr,
+		                     static_cast<uint32_t>(barriers.size()),
+		                     barriers.data());
+	}
+
+	void ZRenderer::transitionColorForPresent(VkCommandBuffer commandBuffer)
+	{
+		VkImageLayout finalLayout = target().getFinalColorLayout();
+		// offscreen images are read by transfers next; the present engine synchronizes through the render
+		// finished semaphore instead
+		bool isTransferNext = finalLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		VkImageMemoryBarrier barrier{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			.dstAccessMask = isTransferNext ? static_cast<VkAccessFlags>(VK_ACCESS_TRANSFER_READ_BIT) : VkAccessFlags{0},
+			.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			.newLayout = finalLayout,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = target().getImage(m_currentImageIndex),
+			.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+		};
+		vkCmdPipelineBarrier(commandBuffer,
+		                     VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+		                     isTransferNext ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		                     0,
+		                     0,
+		                     nullptr,
+		                     0,
+		                     nullptr,
+		                     1,
+		                     &barrier);
 	}
 
 	void ZRenderer::createCommandBuffers()
 	{
-		m_commandBuffers.resize(ZSwapChain::MAX_FRAMES_IN_FLIGHT);
+		m_commandBuffers.resize(getFramesInFlight());
 
 		VkCommandBufferAllocateInfo allocInfo{
 			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
@@ -166,6 +588,16 @@ namespace ZZX
 		// retrieve the current window size
 		auto extent = m_zWindow.getExtent();
 
+		// a headless window never resizes, so this only happens on creation and when the settings change
+		if (m_zWindow.isHeadless())
+		{
+			// the old target waits for its own frames when it is destroyed
+			m_offscreenTarget = nullptr;
+			m_offscreenTarget = std::make_unique<ZOffscreenTarget>(m_zDevice, extent,
+			                                                       m_swapChainSettings.framesInFlight);
+			return;
+		}
+
 		// the program will pause and wait if one of dimensions is sizeless (e.g. when window is minimized)
 		while (extent.width == 0 || extent.height == 0)
 		{
@@ -173,23 +605,35 @@ namespace ZZX
 			glfwWaitEvents();
 		}
 
-		// wait for the logical device to finish operations
-		// before we create a new swap chain, we need to wait until the current swap chain is no longer being used 
-		vkDeviceWaitIdle(m_zDevice.device());
-
+		// no need to wait for the device here: frames using the current swap chain keep running,
+		// and the new one is built next to it (reusing its render pass and, if they fit, its depth images)
 		if (m_zSwapChain == nullptr)
 		{
-			m_zSwapChain = std::make_unique<ZSwapChain>(m_zDevice);
+			m_zSwapChain = std::make_unique<ZSwapChain>(m_zDevice, m_swapChainSettings);
 		}
 		// we have an old swap chain that has reusable resources:
 		else
 		{
 			std::shared_ptr<ZSwapChain> oldSwapChain = std::move(m_zSwapChain);
-			m_zSwapChain = std::make_unique<ZSwapChain>(m_zDevice, oldSwapChain);
+			m_zSwapChain = std::make_unique<ZSwapChain>(m_zDevice, m_swapChainSettings, oldSwapChain);
 			if (!oldSwapChain->compareSwapFormats(*m_zSwapChain))
 			{
 				throw std::runtime_error("Swap chain image(or depth) format has changed!");
 			}
+			m_retiredSwapChains.push_back({m_lastFrameValue, std::move(oldSwapChain)});
 		}
 	}
+
+	void ZRenderer::releaseRetiredSwapChains()
+	{
+		if (m_retiredSwapChains.empty())
+		{
+			return;
+		}
+		uint64_t completedValue = m_zDevice.graphicsTimeline().completedValue();
+		std::erase_if(m_retiredSwapChains, [completedValue](const RetiredSwapChain& retired)
+		{
+			return retired.lastFrameValue <= completedValue;
+		});
+	}
 }
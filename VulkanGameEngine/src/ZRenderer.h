@@ -3,23 +3,60 @@
 #include "ZDevice.h"
 #include "ZWindow.h"
 #include "ZSwapChain.h"
+#include "ZOffscreenTarget.h"
+#include "ZPipeline.h"
+#include "ZBuffer.h"
+#include "ZImageData.h"
+#include "ZRenderGraph.h"
 
 namespace ZZX
 {
+	// what secondary command buffers executed inside the swap chain render pass have to inherit
+	struct RenderPassInheritance
+	{
+		// VK_NULL_HANDLE with dynamic rendering
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		VkFramebuffer framebuffer = VK_NULL_HANDLE;
+		VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+		VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+		VkExtent2D extent{};
+	};
+
 	class ZRenderer
 	{
 	public:
-		ZRenderer(ZWindow& window, ZDevice& device);
+		// dynamic rendering is only used if the device supports it
+		ZRenderer(ZWindow& window, ZDevice& device, const SwapChainSettings& swapChainSettings = {},
+		          bool useDynamicRendering = true);
 		~ZRenderer();
 
 		// delete copy ctor and assignment to avoid dangling pointer
 		ZRenderer(const ZRenderer&) = delete;
 		ZRenderer& operator=(const ZRenderer&) = delete;
 
-		VkRenderPass getSwapChainRenderPass() const { return m_zSwapChain->getRenderPass(); }
-		float getAspectRatio() const { return m_zSwapChain->extentAspectRatio(); }
+		// headless renderers draw into an offscreen target instead of a swap chain; everything named
+		// "swap chain" below then refers to that target
+		bool isHeadless() const { return m_offscreenTarget != nullptr; }
+
+		VkRenderPass getSwapChainRenderPass() const { return target().getRenderPass(); }
+		// what pipelines drawing between begin/endSwapChainRenderPass must be compatible with
+		PipelineRenderTarget getSwapChainRenderTarget() const;
+		bool usesDynamicRendering() const { return m_useDynamicRendering; }
+		float getAspectRatio() const { return target().extentAspectRatio(); }
 		bool isFrameInProgress() const { return m_isFrameStarted; }
 
+		// rebuilds the swap chain and the per-frame command buffers; must not be called during a frame
+		void setSwapChainSettings(const SwapChainSettings& settings);
+		const SwapChainSettings& getSwapChainSettings() const { return m_swapChainSettings; }
+		// frame indices run from 0 to this - 1
+		uint32_t getFramesInFlight() const { return m_swapChainSettings.framesInFlight; }
+		// what the surface actually gave us for the requested settings; headless frames never wait for a display
+		VkPresentModeKHR getPresentMode() const
+		{
+			return isHeadless() ? VK_PRESENT_MODE_IMMEDIATE_KHR : m_zSwapChain->getPresentMode();
+		}
+		size_t getSwapChainImageCount() const { return target().imageCount(); }
+
 		VkCommandBuffer getCurrentCommandBuffer() const
 		{
 			assert(m_isFrameStarted && "cannot get command buffer when frame not in progress");
@@ -32,19 +69,82 @@ namespace ZZX
 			return m_currentFrameIndex;
 		}
 
+		// the graphics timeline value that the frame in progress signals once the GPU has finished it;
+		// anything recorded into this frame (uploads, readbacks, resources to destroy) can key off it
+		uint64_t currentFrameValue() const
+		{
+			assert(m_isFrameStarted && "cannot get frame value when frame not in progress");
+			return m_currentFrameValue;
+		}
+
+		// block until the frame that signals value (or any later one) has finished on the GPU
+		void waitForValue(uint64_t value) { m_zDevice.graphicsTimeline().waitForValue(value); }
+		uint64_t completedValue() { return m_zDevice.graphicsTimeline().completedValue(); }
+
+		// whether waitForPreviousPresent() waits for the display rather than the GPU
+		bool supportsPresentWait() const { return m_zDevice.getCapabilities().presentWait; }
+		// block until the last frame is on screen (with present wait) or has finished rendering (without);
+		// returns false if there was nothing to wait for or the wait timed out
+		bool waitForPreviousPresent();
+		// the id the last frame was presented with, or 0 (headless, without present wait, or before any present)
+		uint64_t lastPresentId() const { return isHeadless() ? 0 : m_zSwapChain->lastPresentId(); }
+		// whether the present with this id (or a later one) is on screen; doesn't block, needs present wait
+		bool isPresented(uint64_t presentId);
+
 		// start the frame, preparing for command buffer recording
 		VkCommandBuffer beginFrame();
 		// end the frame, executing the command buffer
 		void endFrame();
 
-		void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+		// with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, the pass may only execute secondary command buffers,
+		// which have to set the viewport and scissor themselves
+		void beginSwapChainRenderPass(VkCommandBuffer commandBuffer,
+		                              VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
 		void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
+		// for secondary command buffers recorded for the current frame's render pass
+		RenderPassInheritance getRenderPassInheritance() const;
+		// cover the whole extent; viewport and scissor are dynamic state
+		static void setViewportAndScissor(VkCommandBuffer commandBuffer, VkExtent2D extent);
+
+		// add the current frame's swap chain image to a render graph, instead of beginning the swap chain render
+		// pass; the graph leaves it ready to be presented (or copied out, when headless)
+		ZRenderGraph::ResourceId importSwapChainImage(ZRenderGraph& graph) const;
+		// the depth image that goes with it, so the graph doesn't need a depth image of its own
+		ZRenderGraph::ResourceId importSwapChainDepthImage(ZRenderGraph& graph) const;
+		// with a capture requested, add a pass to the graph that copies color back to the host
+		void addCapturePass(ZRenderGraph& graph, ZRenderGraph::ResourceId color);
+		VkExtent2D getSwapChainExtent() const { return target().getExtent(); }
+
+		// frame captures need swap chain images that can be copied from, which not every surface allows
+		bool supportsCapture() const { return target().supportsTransferSrc(); }
+		// copy the image of the next frame that ends its swap chain render pass (or adds a capture pass to its
+		// render graph) back to the host
+		void requestCapture();
+		bool isCaptureReady() const { return m_isCaptureReady; }
+		// waits for the captured frame to finish, then returns it as RGBA
+		ImageData takeCapture();
 	private:
+		// the swap chain, or the offscreen target when headless
+		ZRenderTarget& target() const
+		{
+			return isHeadless() ? static_cast<ZRenderTarget&>(*m_offscreenTarget) : *m_zSwapChain;
+		}
+
 		// this function is only responsible for command buffers allocation
 		void createCommandBuffers();
 
 		void freeCommandBuffers();
 		void recreateSwapChain();
+		// destroy old swap chains whose last frame has finished
+		void releaseRetiredSwapChains();
+		// layout transitions a render pass would otherwise do for us
+		void transitionAttachmentsForRendering(VkCommandBuffer commandBuffer);
+		// into the target's final color layout (PRESENT_SRC for a swap chain)
+		void transitionColorForPresent(VkCommandBuffer commandBuffer);
+		// copy the presentable image into the capture buffer
+		void recordCapture(VkCommandBuffer commandBuffer);
+		// the copy itself, from an image already in TRANSFER_SRC_OPTIMAL
+		void recordCaptureCopy(VkCommandBuffer commandBuffer, VkImage image);
 
 
 		ZWindow& m_zWindow;
@@ -54,11 +154,36 @@ namespace ZZX
 		// we can create a new swap chain with updated info (such as width and height)
 		// by simply creating a new swap chain object
 		std::unique_ptr<ZSwapChain> m_zSwapChain;
+		SwapChainSettings m_swapChainSettings;
+		// only set when the window is headless; m_zSwapChain is null then
+		std::unique_ptr<ZOffscreenTarget> m_offscreenTarget;
+
+		// replaced swap chains that frames in flight may still render to or present from
+		struct RetiredSwapChain
+		{
+			// the last frame submitted while it was current
+			uint64_t lastFrameValue;
+			std::shared_ptr<ZSwapChain> swapChain;
+		};
+		std::vector<RetiredSwapChain> m_retiredSwapChains;
 
 		std::vector<VkCommandBuffer> m_commandBuffers;
 
 		uint32_t m_currentImageIndex;
 		int m_currentFrameIndex = 0;
+		uint64_t m_currentFrameValue = 0;
+		// the value of the last frame submitted, 0 before the first one
+		uint64_t m_lastFrameValue = 0;
 		bool m_isFrameStarted = false;
+		bool m_useDynamicRendering;
+
+		// host-visible copy of a captured frame
+		std::unique_ptr<ZBuffer> m_captureBuffer;
+		VkExtent2D m_captureExtent{};
+		VkFormat m_captureFormat = VK_FORMAT_UNDEFINED;
+		// the frame the capture was recorded in
+		uint64_t m_captureValue = 0;
+		bool m_isCaptureRequested = false;
+		bool m_isCaptureReady = false;
 	};
 }
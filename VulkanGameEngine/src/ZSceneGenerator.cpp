@@ -0,0 +1,138 @@
+﻿#include "pch.h"
+#include "ZSceneGenerator.h"
+#include "ZFrameInfo.h"
+
+namespace ZZX
+{
+	// floor area per object; about what the default scene has
+	static constexpr float AREA_PER_OBJECT = 0.25f;
+	// y points down, the floor is at 0.5 like in the default scene
+	static constexpr float FLOOR_HEIGHT = 0.5f;
+	static constexpr float SPIN_SPEED = 1.f;
+
+	ZSceneGenerator::ZSceneGenerator(const SceneParams& params)
+		: m_params{params}
+	{
+		if (m_params.lightCount > MAX_LIGHTS)
+		{
+			throw std::runtime_error("synthetic scene has more than " + std::to_string(MAX_LIGHTS) + " lights!");
+		}
+		if (m_params.objectCount > 0 && m_params.modelCount == 0)
+		{
+			throw std::runtime_error("synthetic scene needs at least one model!");
+		}
+		m_radius = std::max(1.5f, 0.5f * std::sqrt(AREA_PER_OBJECT * m_params.objectCount));
+	}
+
+	void ZSceneGenerator::generate(ZDevice& device, ZGameObject::Map& gameObjects) const
+	{
+		std::mt19937 random{m_params.seed};
+		std::uniform_real_distribution<float> unit{0.f, 1.f};
+
+		std::vector<std::shared_ptr<ZModel>> models;
+		for (uint32_t i = 0; i < m_params.modelCount; i++)
+		{
+			glm::vec3 color{unit(random), unit(random), unit(random)};
+			models.push_back(std::make_shared<ZModel>(device, makeSphere(6 + 2 * i, color)));
+		}
+
+		auto staticCount = static_cast<uint32_t>(std::lround(m_params.staticFraction * m_params.objectCount));
+		for (uint32_t i = 0; i < m_params.objectCount; i++)
+		{
+			auto obj = ZGameObject::createGameObject();
+			obj.m_model = models[i % models.size()];
+			float scale = 0.1f + 0.1f * unit(random);
+			obj.m_transform.translation = {
+				(2.f * unit(random) - 1.f) * m_radius,
+				// resting on the floor
+				FLOOR_HEIGHT - scale,
+				(2.f * unit(random) - 1.f) * m_radius,
+			};
+			obj.m_transform.scale = glm::vec3{scale};
+			obj.m_transform.rotation.y = glm::two_pi<float>() * unit(random);
+			obj.m_isStatic = i < staticCount;
+			gameObjects.emplace(obj.getId(), std::move(obj));
+		}
+
+		auto floor = ZGameObject::createGameObject();
+		floor.m_model = std::make_shared<ZModel>(device, makeQuad());
+		floor.m_transform.translation = {0.f, FLOOR_HEIGHT, 0.f};
+		floor.m_transform.scale = glm::vec3{m_radius, 1.f, m_radius};
+		floor.m_isStatic = true;
+		gameObjects.emplace(floor.getId(), std::move(floor));
+
+		for (uint32_t i = 0; i < m_params.lightCount; i++)
+		{
+			auto pointLight = ZGameObject::makePointLight(0.2f);
+			pointLight.m_color = glm::vec3{0.2f} + 0.8f * glm::vec3{unit(random), unit(random), unit(random)};
+			float angle = glm::two_pi<float>() * i / m_params.lightCount;
+			pointLight.m_transform.translation = {
+				0.5f * m_radius * glm::cos(angle), FLOOR_HEIGHT - 1.5f, 0.5f * m_radius * glm::sin(angle)
+			};
+			gameObjects.emplace(pointLight.getId(), std::move(pointLight));
+		}
+	}
+
+	void ZSceneGenerator::animate(ZGameObject::Map& gameObjects, float frameTime)
+	{
+		for (auto& [id, obj] : gameObjects)
+		{
+			if (!obj.m_isStatic && obj.m_model != nullptr)
+			{
+				obj.m_transform.rotation.y = glm::mod(obj.m_transform.rotation.y + SPIN_SPEED * frameTime,
+				                                      glm::two_pi<float>());
+			}
+		}
+	}
+
+	ZModel::Builder ZSceneGenerator::makeSphere(uint32_t rings, glm::vec3 color)
+	{
+		// a unit sphere of rings x (2 * rings) quads, with the poles duplicated per segment
+		uint32_t segments = 2 * rings;
+		ZModel::Builder builder{};
+		for (uint32_t ring = 0; ring <= rings; ring++)
+		{
+			float polar = glm::pi<float>() * ring / rings;
+			for (uint32_t segment = 0; segment <= segments; segment++)
+			{
+				float azimuth = glm::two_pi<float>() * segment / segments;
+				glm::vec3 normal{
+					glm::sin(polar) * glm::cos(azimuth), glm::cos(polar), glm::sin(polar) * glm::sin(azimuth)
+				};
+				builder.vertices.push_back({
+					.pos = normal,
+					.color = color,
+					.normal = normal,
+					.uv = {static_cast<float>(segment) / segments, static_cast<float>(ring) / rings},
+				});
+			}
+		}
+		for (uint32_t ring = 0; ring < rings; ring++)
+		{
+			for (uint32_t segment = 0; segment < segments; segment++)
+			{
+				uint32_t first = ring * (segments + 1) + segment;
+				uint32_t below = first + segments + 1;
+				builder.indices.insert(builder.indices.end(), {first, below, first + 1, first + 1, below, below + 1});
+			}
+		}
+		return builder;
+	}
+
+	ZModel::Builder ZSceneGenerator::makeQuad()
+	{
+		// 2x2 in the xz plane, facing up (-y)
+		ZModel::Builder builder{};
+		for (glm::vec2 corner : {glm::vec2{-1.f, -1.f}, glm::vec2{1.f, -1.f}, glm::vec2{1.f, 1.f}, glm::vec2{-1.f, 1.f}})
+		{
+			builder.vertices.push_back({
+				.pos = {corner.x, 0.f, corner.y},
+				.color = glm::vec3{1.f},
+				.normal = {0.f, -1.f, 0.f},
+				.uv = 0.5f * (corner + 1.f),
+			});
+		}
+		builder.indices = {0, 2, 1, 0, 3, 2};
+		return builder;
+	}
+}
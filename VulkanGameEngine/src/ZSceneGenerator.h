@@ -0,0 +1,46 @@
+﻿#pragma once
+
+#include "ZGameObject.h"
+
+namespace ZZX
+{
+	// what a synthetic scene is made of
+	struct SceneParams
+	{
+		uint32_t objectCount = 1000;
+		// distinct meshes the objects are spread over; model i is a sphere with more rings than model i - 1
+		uint32_t modelCount = 4;
+		// at most MAX_LIGHTS, as that is what the global ubo holds
+		uint32_t lightCount = 6;
+		// share of the objects that never move (ZGameObject::m_isStatic); the others spin in animate()
+		float staticFraction = 0.5f;
+		// the same seed always gives the same scene
+		uint32_t seed = 1;
+	};
+
+	/**
+	 * Builds scenes of any size for stress testing, without reading any assets.
+	 *
+	 * The objects are scattered over a square floor that grows with their count, so the density (and the
+	 * overdraw) stays roughly the same; the lights circle above the middle of it.
+	 */
+	class ZSceneGenerator
+	{
+	public:
+		explicit ZSceneGenerator(const SceneParams& params);
+
+		void generate(ZDevice& device, ZGameObject::Map& gameObjects) const;
+		// spin every object that isn't static
+		static void animate(ZGameObject::Map& gameObjects, float frameTime);
+
+		// half the side of the floor the objects stand on
+		float getRadius() const { return m_radius; }
+
+	private:
+		static ZModel::Builder makeSphere(uint32_t rings, glm::vec3 color);
+		static ZModel::Builder makeQuad();
+
+		SceneParams m_params;
+		float m_radius;
+	};
+}
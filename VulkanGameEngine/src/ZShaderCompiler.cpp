@@ -0,0 +1,228 @@
+﻿#include "pch.h"
+#include "ZShaderCompiler.h"
+#include "ZShaderModule.h"
+#include "ZUtils.h"
+
+namespace ZZX
+{
+	// bump this whenever the way we drive shaderc changes, to invalidate every cached binary
+	static constexpr uint64_t SHADER_CACHE_VERSION = 2;
+	// deeper than any real include chain; past it, a file that (indirectly) includes itself is reported as an error
+	static constexpr size_t MAX_INCLUDE_DEPTH = 32;
+
+	// resolves #include directives against the file system for shaderc
+	class FileIncluder : public shaderc::CompileOptions::IncluderInterface
+	{
+	public:
+		explicit FileIncluder(std::filesystem::path shaderRootDirectory)
+			: m_shaderRootDirectory{std::move(shaderRootDirectory)}
+		{
+		}
+
+		shaderc_include_result* GetInclude(const char* requestedSource,
+		                                   shaderc_include_type type,
+		                                   const char* requestingSource,
+		                                   size_t includeDepth) override
+		{
+			// #include "file" is relative to the including file, #include <file> to the shader root
+			std::filesystem::path path = type == shaderc_include_type_relative
+				                             ? std::filesystem::path{requestingSource}.parent_path() / requestedSource
+				                             : m_shaderRootDirectory / requestedSource;
+
+			// the includer owns the result and both strings until ReleaseInclude is called
+			auto* include = new IncludeData{};
+			std::ifstream file(path, std::ios::binary);
+			if (includeDepth > MAX_INCLUDE_DEPTH)
+			{
+				include->content = "include depth exceeds " + std::to_string(MAX_INCLUDE_DEPTH) +
+					" (recursive include?): " + path.generic_string();
+			}
+			else if (file.is_open())
+			{
+				include->sourceName = path.lexically_normal().generic_string();
+				include->content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			}
+			else
+			{
+				// an empty source name tells shaderc the include failed; content holds the error message
+				include->content = "cannot open include file: " + path.generic_string();
+			}
+
+			include->result.source_name = include->sourceName.c_str();
+			include->result.source_name_length = include->sourceName.size();
+			include->result.content = include->content.c_str();
+			include->result.content_length = include->content.size();
+			include->result.user_data = include;
+			return &include->result;
+		}
+
+		void ReleaseInclude(shaderc_include_result* data) override
+		{
+			delete static_cast<IncludeData*>(data->user_data);
+		}
+
+	private:
+		struct IncludeData
+		{
+			shaderc_include_result result{};
+			std::string sourceName;
+			std::string content;
+		};
+
+		std::filesystem::path m_shaderRootDirectory;
+	};
+
+	ZShaderCompiler::ZShaderCompiler(const std::string& shaderRootDirectory, const std::string& cacheDirectory)
+		: m_shaderRootDirectory{shaderRootDirectory}, m_cacheDirectory{cacheDirectory}
+	{
+		if (!m_compiler.IsValid())
+		{
+			throw std::runtime_error("failed to initialize shaderc compiler!");
+		}
+		shaderc_get_spv_version(&m_spvVersion, &m_spvRevision);
+		m_generatorWord = queryGeneratorWord();
+
+		std::error_code error;
+		std::filesystem::create_directories(m_cacheDirectory, error);
+	}
+
+	std::vector<uint32_t> ZShaderCompiler::compile(const std::string& sourceFilepath, const ShaderDefines& defines)
+	{
+		shaderc_shader_kind shaderKind = shaderKindFromPath(sourceFilepath);
+		std::string source = readTextFile(sourceFilepath);
+		shaderc::CompileOptions options = makeCompileOptions(defines);
+
+		// preprocessing is cheap compared to a full compile, and its output captures includes and defines exactly
+		shaderc::PreprocessedSourceCompilationResult preprocessed =
+			m_compiler.PreprocessGlsl(source, shaderKind, sourceFilepath.c_str(), options);
+		if (preprocessed.GetCompilationStatus() != shaderc_compilation_status_success)
+		{
+			throw std::runtime_error("failed to preprocess shader " + sourceFilepath + ":\n" +
+				preprocessed.GetErrorMessage());
+		}
+		std::string preprocessedSource{preprocessed.cbegin(), preprocessed.cend()};
+		uint64_t cacheKey = computeCacheKey(preprocessedSource, shaderKind, defines);
+
+		{
+			std::lock_guard<std::mutex> lock{m_cacheMutex};
+			auto it = m_memoryCache.find(cacheKey);
+			if (it != m_memoryCache.end())
+			{
+				return it->second;
+			}
+		}
+
+		std::vector<uint32_t> spirv;
+		if (!loadFromDisk(cacheKey, spirv))
+		{
+			shaderc::SpvCompilationResult result =
+				m_compiler.CompileGlslToSpv(source, shaderKind, sourceFilepath.c_str(), options);
+			if (result.GetCompilationStatus() != shaderc_compilation_status_success)
+			{
+				throw std::runtime_error("failed to compile shader " + sourceFilepath + ":\n" +
+					result.GetErrorMessage());
+			}
+			spirv.assign(result.cbegin(), result.cend());
+			saveToDisk(cacheKey, spirv);
+			std::cout << "Compiled shader: " << sourceFilepath << '\n';
+		}
+
+		std::lock_guard<std::mutex> lock{m_cacheMutex};
+		m_memoryCache[cacheKey] = spirv;
+		return spirv;
+	}
+
+	bool ZShaderCompiler::isGlslSource(const std::string& filepath)
+	{
+		return std::filesystem::path{filepath}.extension() != ".spv";
+	}
+
+	shaderc::CompileOptions ZShaderCompiler::makeCompileOptions(const ShaderDefines& defines) const
+	{
+		shaderc::CompileOptions options;
+		options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_0);
+		for (const auto& [name, value] : defines)
+		{
+			options.AddMacroDefinition(name, value);
+		}
+		// optimizing is left to the ZShaderOptimizer, which treats prebuilt .spv files the same way
+		// keep names and line info around for graphics debuggers; the optimizer strips them in release builds
+		options.SetGenerateDebugInfo();
+		options.SetIncluder(std::make_unique<FileIncluder>(m_shaderRootDirectory));
+		return options;
+	}
+
+	uint64_t ZShaderCompiler::computeCacheKey(const std::string& preprocessedSource,
+	                                          shaderc_shader_kind shaderKind,
+	                                          const ShaderDefines& defines) const
+	{
+		uint64_t key = hashBytes(preprocessedSource.data(), preprocessedSource.size());
+		for (const auto& [name, value] : defines)
+		{
+			key = hashBytes(name.data(), name.size(), key);
+			key = hashBytes(value.data(), value.size(), key);
+		}
+
+		const uint64_t settings[] = {
+			static_cast<uint64_t>(shaderKind), m_spvVersion, m_spvRevision, m_generatorWord,
+			VK_HEADER_VERSION_COMPLETE, SHADER_CACHE_VERSION
+		};
+		return hashBytes(settings, sizeof(settings), key);
+	}
+
+	uint32_t ZShaderCompiler::queryGeneratorWord()
+	{
+		// the spv version stays the same across most compiler updates, but the generator word (the tool's id and
+		// glslang's version) is stamped by the shaderc that is actually loaded, which may not match the headers
+		shaderc::Compiler compiler;
+		shaderc::SpvCompilationResult result =
+			compiler.CompileGlslToSpv("#version 450\nvoid main() {}\n", shaderc_vertex_shader, "generator_probe");
+		if (result.GetCompilationStatus() != shaderc_compilation_status_success || result.cend() - result.cbegin() < 5)
+		{
+			throw std::runtime_error("failed to compile the shaderc version probe:\n" + result.GetErrorMessage());
+		}
+		// words 0-4 are the magic number, version, generator, bound and schema
+		return result.cbegin()[2];
+	}
+
+	bool ZShaderCompiler::loadFromDisk(uint64_t cacheKey, std::vector<uint32_t>& spirv) const
+	{
+		std::filesystem::path path = std::filesystem::path{m_cacheDirectory} / (toHexString(cacheKey) + ".spv");
+		return ZShaderModule::tryReadSpirvFile(path, spirv);
+	}
+
+	void ZShaderCompiler::saveToDisk(uint64_t cacheKey, const std::vector<uint32_t>& spirv) const
+	{
+		std::filesystem::path path = std::filesystem::path{m_cacheDirectory} / (toHexString(cacheKey) + ".spv");
+		ZShaderModule::writeSpirvFile(path, spirv);
+	}
+
+	shaderc_shader_kind ZShaderCompiler::shaderKindFromPath(const std::string& filepath)
+	{
+		static const std::unordered_map<std::string, shaderc_shader_kind> kinds{
+			{".vert", shaderc_vertex_shader},
+			{".frag", shaderc_fragment_shader},
+			{".comp", shaderc_compute_shader},
+			{".geom", shaderc_geometry_shader},
+			{".tesc", shaderc_tess_control_shader},
+			{".tese", shaderc_tess_evaluation_shader},
+		};
+
+		auto it = kinds.find(std::filesystem::path{filepath}.extension().string());
+		if (it == kinds.end())
+		{
+			throw std::runtime_error("cannot deduce shader stage from file name: " + filepath);
+		}
+		return it->second;
+	}
+
+	std::string ZShaderCompiler::readTextFile(const std::string& filepath)
+	{
+		std::ifstream file(filepath, std::ios::binary);
+		if (!file.is_open())
+		{
+			throw std::runtime_error("failed to open file: " + filepath);
+		}
+		return std::string{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+	}
+}
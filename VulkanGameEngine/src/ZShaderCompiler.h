@@ -0,0 +1,58 @@
+﻿#pragma once
+#include <shaderc/shaderc.hpp>
+
+namespace ZZX
+{
+	// preprocessor macros passed to a shader compile (std::map keeps them ordered, which keeps cache keys stable)
+	using ShaderDefines = std::map<std::string, std::string>;
+
+	/**
+	 * Compiles GLSL to SPIR-V at runtime through shaderc.
+	 *
+	 * #include "..." is resolved relative to the including file, #include <...> relative to the shader root directory.
+	 * Results are cached in memory and on disk, keyed by a hash of the preprocessed source (which already contains
+	 * every included file and define), the defines, the compile options and the compiler's version (the SDK the engine
+ * was built against, and the generator word the loaded shaderc stamps into its output).
+	 * Editing a shader or anything it includes therefore changes the key, while unchanged shaders are never recompiled.
+	 * compile() may be called from several threads at once.
+	 */
+	class ZShaderCompiler
+	{
+	public:
+		ZShaderCompiler(const std::string& shaderRootDirectory = "assets/shaders",
+		                const std::string& cacheDirectory = "shader_cache");
+
+		ZShaderCompiler(const ZShaderCompiler&) = delete;
+		ZShaderCompiler& operator=(const ZShaderCompiler&) = delete;
+
+		// the shader stage is deduced from the file extension (.vert, .frag, .comp, .geom, .tesc, .tese)
+		std::vector<uint32_t> compile(const std::string& sourceFilepath, const ShaderDefines& defines = {});
+
+		// true for files this compiler knows how to compile (everything but prebuilt .spv)
+		static bool isGlslSource(const std::string& filepath);
+
+	private:
+		shaderc::CompileOptions makeCompileOptions(const ShaderDefines& defines) const;
+		uint64_t computeCacheKey(const std::string& preprocessedSource,
+		                         shaderc_shader_kind shaderKind,
+		                         const ShaderDefines& defines) const;
+		bool loadFromDisk(uint64_t cacheKey, std::vector<uint32_t>& spirv) const;
+		void saveToDisk(uint64_t cacheKey, const std::vector<uint32_t>& spirv) const;
+
+		// the generator word of a trivial compile, which identifies the compiler and its version
+		static uint32_t queryGeneratorWord();
+		static shaderc_shader_kind shaderKindFromPath(const std::string& filepath);
+		static std::string readTextFile(const std::string& filepath);
+
+		shaderc::Compiler m_compiler;
+		std::string m_shaderRootDirectory;
+		std::string m_cacheDirectory;
+		// SPIR-V version/revision produced by the linked shaderc, folded into every cache key
+		unsigned int m_spvVersion = 0;
+		unsigned int m_spvRevision = 0;
+		uint32_t m_generatorWord = 0;
+
+		std::mutex m_cacheMutex;
+		std::unordered_map<uint64_t, std::vector<uint32_t>> m_memoryCache;
+	};
+}
@@ -0,0 +1,206 @@
+﻿#include "pch.h"
+#include "ZShaderModule.h"
+#include "ZUtils.h"
+
+namespace ZZX
+{
+	// *************** Shader Module *********************
+
+	ZShaderModule::ZShaderModule(ZDevice& device, const std::vector<uint32_t>& code)
+		: m_zDevice{device}, m_code{code}
+	{
+		// wrap the raw SPIR-V data into a VkShaderModule
+		VkShaderModuleCreateInfo createInfo{
+			.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+			// specify the length of the bytecode in bytes
+			.codeSize = code.size() * sizeof(uint32_t),
+			.pCode = code.data(),
+		};
+
+		if (vkCreateShaderModule(m_zDevice.device(), &createInfo, nullptr, &m_shaderModule) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create shader module!");
+		}
+	}
+
+	ZShaderModule::~ZShaderModule()
+	{
+		vkDestroyShaderModule(m_zDevice.device(), m_shaderModule, nullptr);
+	}
+
+	std::vector<uint32_t> ZShaderModule::readSpirvFile(const std::string& filepath)
+	{
+		// start reading at the end of the file + read file as binary
+		std::ifstream file(filepath, std::ios::ate | std::ios::binary);
+
+		if (!file.is_open())
+		{
+			throw std::runtime_error("failed to open file: " + filepath);
+		}
+
+		// since we read at the end of the file, we can directly compute the size of the file
+		size_t fileSize = static_cast<size_t>(file.tellg());
+		if (fileSize == 0 || fileSize % sizeof(uint32_t) != 0)
+		{
+			throw std::runtime_error("invalid SPIR-V binary: " + filepath);
+		}
+
+		// pCode expects const uint32_t*, so read straight into 32-bit words to get the alignment right
+		std::vector<uint32_t> buffer(fileSize / sizeof(uint32_t));
+
+		// seek back to the beginning of the file
+		file.seekg(0);
+		// read all of the bytes at once
+		file.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(fileSize));
+		file.close();
+
+		return buffer;
+	}
+
+	bool ZShaderModule::tryReadSpirvFile(const std::filesystem::path& path, std::vector<uint32_t>& spirv)
+	{
+		std::ifstream file(path, std::ios::ate | std::ios::binary);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		size_t fileSize = static_cast<size_t>(file.tellg());
+		if (fileSize == 0 || fileSize % sizeof(uint32_t) != 0)
+		{
+			return false;
+		}
+		spirv.resize(fileSize / sizeof(uint32_t));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(spirv.data()), static_cast<std::streamsize>(fileSize));
+		return static_cast<bool>(file);
+	}
+
+	void ZShaderModule::writeSpirvFile(const std::filesystem::path& path, const std::vector<uint32_t>& spirv)
+	{
+		std::filesystem::path tempPath = path;
+		tempPath += ".tmp" + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+			{
+				return;
+			}
+			file.write(reinterpret_cast<const char*>(spirv.data()),
+			           static_cast<std::streamsize>(spirv.size() * sizeof(uint32_t)));
+		}
+		std::error_code error;
+		std::filesystem::rename(tempPath, path, error);
+	}
+
+	// *************** Shader Module Cache *********************
+
+	ZShaderModuleCache::ZShaderModuleCache(ZDevice& device,
+	                                       ZShaderCompiler* shaderCompiler,
+	                                       ZShaderOptimizer* shaderOptimizer)
+		: m_zDevice{device}, m_shaderCompiler{shaderCompiler}, m_shaderOptimizer{shaderOptimizer}
+	{
+	}
+
+	std::shared_ptr<ZShaderModule> ZShaderModuleCache::getModule(const std::string& filepath,
+	                                                             const ShaderDefines& defines)
+	{
+		CachedFile file = loadFile(filepath, defines);
+		std::lock_guard<std::mutex> lock{m_mutex};
+		return findOrCreateModule(*file.code, file.contentHash);
+	}
+
+	std::shared_ptr<ZShaderModule> ZShaderModuleCache::getModule(const std::vector<uint32_t>& code)
+	{
+		uint64_t contentHash = hashBytes(code.data(), code.size() * sizeof(uint32_t));
+		std::lock_guard<std::mutex> lock{m_mutex};
+		return findOrCreateModule(code, contentHash);
+	}
+
+	std::shared_ptr<const std::vector<uint32_t>> ZShaderModuleCache::getCode(const std::string& filepath,
+	                                                                         const ShaderDefines& defines)
+	{
+		return loadFile(filepath, defines).code;
+	}
+
+	std::shared_ptr<const std::vector<uint32_t>> ZShaderModuleCache::findCode(const std::string& filepath,
+	                                                                          const ShaderDefines& defines)
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		auto it = m_files.find(makeFileKey(filepath, defines));
+		return it == m_files.end() ? nullptr : it->second.code;
+	}
+
+	std::string ZShaderModuleCache::makeFileKey(const std::string& filepath, const ShaderDefines& defines)
+	{
+		std::string key = filepath;
+		for (const auto& [name, value] : defines)
+		{
+			key += '|' + name + '=' + value;
+		}
+		return key;
+	}
+
+	ZShaderModuleCache::CachedFile ZShaderModuleCache::loadFile(const std::string& filepath,
+	                                                            const ShaderDefines& defines)
+	{
+		std::string key = makeFileKey(filepath, defines);
+
+		{
+			std::lock_guard<std::mutex> lock{m_mutex};
+			auto it = m_files.find(key);
+			if (it != m_files.end())
+			{
+				return it->second;
+			}
+		}
+
+		// compile/read without holding the lock so that different shaders load in parallel
+		std::shared_ptr<const std::vector<uint32_t>> code;
+		if (ZShaderCompiler::isGlslSource(filepath))
+		{
+			if (m_shaderCompiler == nullptr)
+			{
+				throw std::runtime_error("cannot load GLSL source without a shader compiler: " + filepath);
+			}
+			code = std::make_shared<const std::vector<uint32_t>>(m_shaderCompiler->compile(filepath, defines));
+		}
+		else
+		{
+			assert(defines.empty() && "defines cannot be applied to a prebuilt SPIR-V binary");
+			code = std::make_shared<const std::vector<uint32_t>>(ZShaderModule::readSpirvFile(filepath));
+		}
+		if (m_shaderOptimizer)
+		{
+			code = std::make_shared<const std::vector<uint32_t>>(m_shaderOptimizer->optimize(*code, key));
+		}
+
+		uint64_t contentHash = hashBytes(code->data(), code->size() * sizeof(uint32_t));
+		std::lock_guard<std::mutex> lock{m_mutex};
+		// if another thread loaded the same file meanwhile, keep its copy
+		return m_files.emplace(key, CachedFile{std::move(code), contentHash}).first->second;
+	}
+
+	std::shared_ptr<ZShaderModule> ZShaderModuleCache::findOrCreateModule(const std::vector<uint32_t>& code,
+	                                                                      uint64_t contentHash)
+	{
+		// reuse the module if another pipeline is currently being created with the same SPIR-V
+		auto [first, last] = m_modules.equal_range(contentHash);
+		for (auto it = first; it != last; ++it)
+		{
+			// a 64-bit hash can collide, so compare the whole binary
+			auto module = it->second.lock();
+			if (module && module->getCode() == code)
+			{
+				return module;
+			}
+		}
+
+		// modules die with the pipelines made from them, so without this the map would keep an entry for every
+		// binary ever loaded; creating a module costs far more than the sweep
+		std::erase_if(m_modules, [](const auto& entry) { return entry.second.expired(); });
+		auto module = std::make_shared<ZShaderModule>(m_zDevice, code);
+		m_modules.emplace(contentHash, module);
+		return module;
+	}
+}
@@ -0,0 +1,90 @@
+﻿#pragma once
+#include "ZDevice.h"
+#include "ZShaderCompiler.h"
+#include "ZShaderOptimizer.h"
+
+namespace ZZX
+{
+	// owns a single VkShaderModule
+	class ZShaderModule
+	{
+	public:
+		ZShaderModule(ZDevice& device, const std::vector<uint32_t>& code);
+		~ZShaderModule();
+
+		ZShaderModule(const ZShaderModule&) = delete;
+		ZShaderModule& operator=(const ZShaderModule&) = delete;
+
+		VkShaderModule getShaderModule() const { return m_shaderModule; }
+		// the SPIR-V the module was created from
+		const std::vector<uint32_t>& getCode() const { return m_code; }
+
+		// read all of the bytes of a SPIR-V binary from the specified file
+		static std::vector<uint32_t> readSpirvFile(const std::string& filepath);
+		// for cache files: returns false instead of throwing if the file is missing or not a whole number of words
+		static bool tryReadSpirvFile(const std::filesystem::path& path, std::vector<uint32_t>& spirv);
+		// writes to a temporary file first, so that a concurrent reader never sees a half-written binary
+		static void writeSpirvFile(const std::filesystem::path& path, const std::vector<uint32_t>& spirv);
+
+	private:
+		ZDevice& m_zDevice;
+		VkShaderModule m_shaderModule;
+		// kept so that binaries with the same hash can be told apart
+		std::vector<uint32_t> m_code;
+	};
+
+	/**
+	 * Hands out shared shader modules to pipeline creation.
+	 *
+	 * Each SPIR-V file is read from disk only once. GLSL sources (anything but .spv) are compiled at runtime
+	 * through the ZShaderCompiler, once per set of defines. Either way, the SPIR-V goes through the
+	 * ZShaderOptimizer if there is one. Modules are deduplicated by a hash of their SPIR-V (checked against the
+	 * whole binary), so identical binaries behind different paths share one VkShaderModule.
+	 * The registry only holds weak references to modules: a module is destroyed as soon as the last
+	 * pipeline that is being created with it is done, since a pipeline never needs its modules afterwards.
+	 * All functions are safe to call from several threads.
+	 */
+	class ZShaderModuleCache
+	{
+	public:
+		// without a compiler only prebuilt .spv files can be loaded; without an optimizer SPIR-V is used as-is
+		ZShaderModuleCache(ZDevice& device,
+		                   ZShaderCompiler* shaderCompiler = nullptr,
+		                   ZShaderOptimizer* shaderOptimizer = nullptr);
+
+		ZShaderModuleCache(const ZShaderModuleCache&) = delete;
+		ZShaderModuleCache& operator=(const ZShaderModuleCache&) = delete;
+
+		std::shared_ptr<ZShaderModule> getModule(const std::string& filepath, const ShaderDefines& defines = {});
+		std::shared_ptr<ZShaderModule> getModule(const std::vector<uint32_t>& code);
+
+		// the (cached) SPIR-V of a file, without creating a module for it
+		std::shared_ptr<const std::vector<uint32_t>> getCode(const std::string& filepath,
+		                                                     const ShaderDefines& defines = {});
+		// same, but only if the file was loaded before; returns nullptr rather than compiling or reading it
+		std::shared_ptr<const std::vector<uint32_t>> findCode(const std::string& filepath,
+		                                                      const ShaderDefines& defines = {});
+
+	private:
+		struct CachedFile
+		{
+			std::shared_ptr<const std::vector<uint32_t>> code;
+			uint64_t contentHash;
+		};
+
+		// takes m_mutex itself
+		CachedFile loadFile(const std::string& filepath, const ShaderDefines& defines);
+		static std::string makeFileKey(const std::string& filepath, const ShaderDefines& defines);
+		// expects m_mutex to be held by the caller
+		std::shared_ptr<ZShaderModule> findOrCreateModule(const std::vector<uint32_t>& code, uint64_t contentHash);
+
+		ZDevice& m_zDevice;
+		ZShaderCompiler* m_shaderCompiler;
+		ZShaderOptimizer* m_shaderOptimizer;
+		std::mutex m_mutex;
+		// keyed by file path plus defines
+		std::unordered_map<std::string, CachedFile> m_files;
+		// several modules per hash in the unlikely case of a collision; expired entries are dropped as they are found
+		std::unordered_multimap<uint64_t, std::weak_ptr<ZShaderModule>> m_modules;
+	};
+}
@@ -0,0 +1,122 @@
+﻿#include "pch.h"
+#include "ZShaderOptimizer.h"
+#include "ZShaderModule.h"
+#include "ZUtils.h"
+
+#include <spirv-tools/optimizer.hpp>
+
+namespace ZZX
+{
+	// bump this whenever the pass list changes, to invalidate every cached binary
+	static constexpr uint64_t OPTIMIZER_CACHE_VERSION = 1;
+
+	SpirvMetrics SpirvMetrics::measure(const std::vector<uint32_t>& spirv)
+	{
+		SpirvMetrics metrics{spirv.size() * sizeof(uint32_t), 0};
+		// after the 5-word header, every instruction starts with a word holding (word count << 16) | opcode
+		size_t offset = 5;
+		while (offset < spirv.size())
+		{
+			uint32_t wordCount = spirv[offset] >> 16;
+			if (wordCount == 0)
+			{
+				break;
+			}
+			offset += wordCount;
+			metrics.instructionCount++;
+		}
+		return metrics;
+	}
+
+	ZShaderOptimizer::ZShaderOptimizer(const ShaderOptimizerSettings& settings, const std::string& cacheDirectory)
+		: m_settings{settings}, m_cacheDirectory{cacheDirectory}
+	{
+		std::error_code error;
+		std::filesystem::create_directories(m_cacheDirectory, error);
+	}
+
+	std::vector<uint32_t> ZShaderOptimizer::optimize(const std::vector<uint32_t>& spirv, const std::string& name)
+	{
+		if (!m_settings.runPerformancePasses && !m_settings.stripDebugInfo)
+		{
+			return spirv;
+		}
+
+		const uint64_t settings[] = {
+			m_settings.runPerformancePasses, m_settings.stripDebugInfo, OPTIMIZER_CACHE_VERSION
+		};
+		uint64_t cacheKey = hashBytes(settings, sizeof(settings),
+		                              hashBytes(spirv.data(), spirv.size() * sizeof(uint32_t)));
+
+		{
+			std::lock_guard<std::mutex> lock{m_mutex};
+			auto it = m_memoryCache.find(cacheKey);
+			if (it != m_memoryCache.end())
+			{
+				return it->second;
+			}
+		}
+
+		std::vector<uint32_t> optimized;
+		std::filesystem::path path = std::filesystem::path{m_cacheDirectory} / (toHexString(cacheKey) + ".opt.spv");
+		if (!ZShaderModule::tryReadSpirvFile(path, optimized))
+		{
+			optimized = runOptimizer(spirv, name);
+			ZShaderModule::writeSpirvFile(path, optimized);
+		}
+
+		Report report{name, SpirvMetrics::measure(spirv), SpirvMetrics::measure(optimized)};
+		std::cout << "Optimized shader " << name << ": "
+			<< report.original.sizeInBytes << " -> " << report.optimized.sizeInBytes << " bytes, "
+			<< report.original.instructionCount << " -> " << report.optimized.instructionCount << " instructions\n";
+
+		std::lock_guard<std::mutex> lock{m_mutex};
+		// if another thread optimized the same binary meanwhile, keep its copy and its report
+		auto [it, inserted] = m_memoryCache.emplace(cacheKey, std::move(optimized));
+		if (inserted)
+		{
+			m_reports.push_back(std::move(report));
+		}
+		return it->second;
+	}
+
+	std::vector<ZShaderOptimizer::Report> ZShaderOptimizer::getReports() const
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		return m_reports;
+	}
+
+	std::vector<uint32_t> ZShaderOptimizer::runOptimizer(const std::vector<uint32_t>& spirv,
+	                                                     const std::string& name) const
+	{
+		// an Optimizer is not thread-safe, so every call gets its own
+		spvtools::Optimizer optimizer{SPV_ENV_VULKAN_1_0};
+		std::string messages;
+		optimizer.SetMessageConsumer([&messages](spv_message_level_t level, const char*,
+		                                         const spv_position_t& position, const char* message)
+		{
+			if (level <= SPV_MSG_ERROR)
+			{
+				messages += std::to_string(position.index) + ": " + message + '\n';
+			}
+		});
+
+		if (m_settings.runPerformancePasses)
+		{
+			optimizer.RegisterPerformancePasses();
+		}
+		if (m_settings.stripDebugInfo)
+		{
+			optimizer.RegisterPass(spvtools::CreateStripDebugInfoPass());
+		}
+
+		std::vector<uint32_t> optimized;
+		if (!optimizer.Run(spirv.data(), spirv.size(), &optimized))
+		{
+			// the unoptimized binary still works, so this only costs performance
+			std::cerr << "failed to optimize shader " << name << ", using it unoptimized:\n" << messages;
+			return spirv;
+		}
+		return optimized;
+	}
+}
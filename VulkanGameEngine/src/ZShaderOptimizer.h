@@ -0,0 +1,66 @@
+﻿#pragma once
+
+namespace ZZX
+{
+	// size of a SPIR-V binary, to see what the optimizer bought us
+	struct SpirvMetrics
+	{
+		size_t sizeInBytes = 0;
+		uint32_t instructionCount = 0;
+
+		static SpirvMetrics measure(const std::vector<uint32_t>& spirv);
+	};
+
+	struct ShaderOptimizerSettings
+	{
+		bool runPerformancePasses = true;
+#ifdef GLCORE_RELEASE
+		bool stripDebugInfo = true;
+#else
+		// keep names and line info around for graphics debuggers
+		bool stripDebugInfo = false;
+#endif
+	};
+
+	/**
+	 * Runs spirv-opt over SPIR-V binaries before they become shader modules.
+	 *
+	 * The performance passes (inlining, dead code elimination, constant folding, loop unrolling, ...) make
+	 * smaller modules that are faster to turn into pipelines; in release builds debug info is stripped as well.
+	 * Specialization constants are left alone, so the result can still be specialized per pipeline.
+	 * Results are cached in memory and on disk, keyed by a hash of the input binary and the settings.
+	 * A binary the optimizer rejects is used as-is. optimize() may be called from several threads at once.
+	 */
+	class ZShaderOptimizer
+	{
+	public:
+		// before and after numbers for one shader
+		struct Report
+		{
+			std::string name;
+			SpirvMetrics original;
+			SpirvMetrics optimized;
+		};
+
+		ZShaderOptimizer(const ShaderOptimizerSettings& settings = {}, const std::string& cacheDirectory = "shader_cache");
+
+		ZShaderOptimizer(const ZShaderOptimizer&) = delete;
+		ZShaderOptimizer& operator=(const ZShaderOptimizer&) = delete;
+
+		// name is only used to report the result
+		std::vector<uint32_t> optimize(const std::vector<uint32_t>& spirv, const std::string& name);
+
+		// one entry per binary optimized so far, in the order they were asked for
+		std::vector<Report> getReports() const;
+
+	private:
+		std::vector<uint32_t> runOptimizer(const std::vector<uint32_t>& spirv, const std::string& name) const;
+
+		ShaderOptimizerSettings m_settings;
+		std::string m_cacheDirectory;
+
+		mutable std::mutex m_mutex;
+		std::unordered_map<uint64_t, std::vector<uint32_t>> m_memoryCache;
+		std::vector<Report> m_reports;
+	};
+}
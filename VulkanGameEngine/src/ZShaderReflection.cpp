@@ -0,0 +1,576 @@
+﻿#include "pch.h"
+#include "ZShaderReflection.h"
+
+#define SPV_ENABLE_UTILITY_CODE
+#include <spirv-headers/spirv.hpp>
+
+namespace ZZX
+{
+	// a minimal SPIR-V parser: only what is needed to describe the resource interface of a module
+	class SpirvModule
+	{
+	public:
+		struct Variable
+		{
+			uint32_t id;
+			uint32_t pointerTypeId;
+			spv::StorageClass storageClass;
+		};
+
+		explicit SpirvModule(const std::vector<uint32_t>& words)
+		{
+			// the header is 5 words: magic number, version, generator, id bound, schema
+			if (words.size() < 5 || words[0] != spv::MagicNumber)
+			{
+				throw std::runtime_error("invalid SPIR-V module: bad magic number");
+			}
+
+			bool insideFunction = false;
+			size_t offset = 5;
+			while (offset < words.size())
+			{
+				// each instruction starts with a word holding its word count (high 16 bits) and opcode (low 16 bits)
+				uint32_t wordCount = words[offset] >> 16;
+				auto opcode = static_cast<spv::Op>(words[offset] & 0xffff);
+				if (wordCount == 0 || offset + wordCount > words.size())
+				{
+					throw std::runtime_error("invalid SPIR-V module: truncated instruction");
+				}
+				const uint32_t* operands = &words[offset + 1];
+				uint32_t operandCount = wordCount - 1;
+
+				if (opcode == spv::OpFunction)
+				{
+					insideFunction = true;
+				}
+
+				if (insideFunction)
+				{
+					markUsedIds(opcode, operands, operandCount);
+				}
+				else
+				{
+					parseDeclaration(opcode, operands, operandCount);
+				}
+				offset += wordCount;
+			}
+		}
+
+		VkShaderStageFlagBits stage() const { return m_stage; }
+		const std::vector<Variable>& variables() const { return m_variables; }
+
+		// the ids of every layout(constant_id = ...) the module declares
+		std::vector<uint32_t> specializationConstantIds() const
+		{
+			std::vector<uint32_t> constantIds;
+			for (const auto& [id, decorations] : m_decorations)
+			{
+				auto it = decorations.find(spv::DecorationSpecId);
+				if (it != decorations.end())
+				{
+					constantIds.push_back(it->second);
+				}
+			}
+			return constantIds;
+		}
+
+		// true if any function accesses the id (directly, or through an access chain)
+		bool isUsed(uint32_t id) const { return m_usedIds.count(id) > 0; }
+
+		std::optional<uint32_t> decoration(uint32_t id, spv::Decoration decoration) const
+		{
+			auto it = m_decorations.find(id);
+			if (it == m_decorations.end()) return std::nullopt;
+			auto valueIt = it->second.find(decoration);
+			if (valueIt == it->second.end()) return std::nullopt;
+			return valueIt->second;
+		}
+
+		std::optional<uint32_t> memberDecoration(uint32_t structId, uint32_t member, spv::Decoration decoration) const
+		{
+			auto it = m_memberDecorations.find({structId, member});
+			if (it == m_memberDecorations.end()) return std::nullopt;
+			auto valueIt = it->second.find(decoration);
+			if (valueIt == it->second.end()) return std::nullopt;
+			return valueIt->second;
+		}
+
+		std::string name(uint32_t id) const
+		{
+			auto it = m_names.find(id);
+			return it == m_names.end() ? std::string{} : it->second;
+		}
+
+		// the instruction that declared a type: opcode followed by its operands (minus the result id)
+		const std::vector<uint32_t>& type(uint32_t id) const
+		{
+			auto it = m_types.find(id);
+			if (it == m_types.end())
+			{
+				throw std::runtime_error("invalid SPIR-V module: unknown type id " + std::to_string(id));
+			}
+			return it->second;
+		}
+
+		uint32_t constant(uint32_t id) const
+		{
+			auto it = m_constants.find(id);
+			if (it == m_constants.end())
+			{
+				throw std::runtime_error("unsupported SPIR-V: array length is not a constant");
+			}
+			return it->second;
+		}
+
+		// size in bytes of a type laid out with explicit offsets/strides (i.e. the type of a buffer block)
+		uint32_t typeSize(uint32_t typeId) const
+		{
+			const auto& t = type(typeId);
+			switch (static_cast<spv::Op>(t[0]))
+			{
+			case spv::OpTypeBool:
+				return 4;
+			case spv::OpTypeInt:
+			case spv::OpTypeFloat:
+				return t[1] / 8;
+			case spv::OpTypeVector:
+			case spv::OpTypeMatrix:
+				// component/column type, then count
+				return typeSize(t[1]) * t[2];
+			case spv::OpTypeArray:
+				{
+					uint32_t length = constant(t[2]);
+					auto stride = decoration(typeId, spv::DecorationArrayStride);
+					return length * (stride ? *stride : typeSize(t[1]));
+				}
+			case spv::OpTypeRuntimeArray:
+				// sized at runtime; contributes nothing to the static size
+				return 0;
+			case spv::OpTypeStruct:
+				{
+					uint32_t size = 0;
+					for (uint32_t member = 0; member + 1 < t.size(); member++)
+					{
+						uint32_t memberTypeId = t[member + 1];
+						uint32_t memberOffset =
+							memberDecoration(typeId, member, spv::DecorationOffset).value_or(size);
+						uint32_t memberSize = typeSize(memberTypeId);
+						// matrices inside blocks are laid out with an explicit column stride
+						auto matrixStride = memberDecoration(typeId, member, spv::DecorationMatrixStride);
+						if (matrixStride && type(memberTypeId)[0] == spv::OpTypeMatrix)
+						{
+							memberSize = type(memberTypeId)[2] * *matrixStride;
+						}
+						size = std::max(size, memberOffset + memberSize);
+					}
+					return size;
+				}
+			default:
+				throw std::runtime_error("unsupported SPIR-V type in block: opcode " + std::to_string(t[0]));
+			}
+		}
+
+	private:
+		void parseDeclaration(spv::Op opcode, const uint32_t* operands, uint32_t operandCount)
+		{
+			switch (opcode)
+			{
+			case spv::OpEntryPoint:
+				m_stage = toShaderStage(static_cast<spv::ExecutionModel>(operands[0]));
+				break;
+			case spv::OpName:
+				m_names[operands[0]] = reinterpret_cast<const char*>(&operands[1]);
+				break;
+			case spv::OpDecorate:
+				// decorations without a literal (e.g. Block) are stored with a value of 0
+				m_decorations[operands[0]][static_cast<spv::Decoration>(operands[1])] =
+					operandCount > 2 ? operands[2] : 0;
+				break;
+			case spv::OpMemberDecorate:
+				m_memberDecorations[{operands[0], operands[1]}][static_cast<spv::Decoration>(operands[2])] =
+					operandCount > 3 ? operands[3] : 0;
+				break;
+			case spv::OpConstant:
+				// result type, result id, value (we only need 32-bit integers for array lengths)
+				m_constants[operands[1]] = operands[2];
+				break;
+			case spv::OpVariable:
+				m_variables.push_back({operands[1], operands[0], static_cast<spv::StorageClass>(operands[2])});
+				break;
+			case spv::OpTypeVoid:
+			case spv::OpTypeBool:
+			case spv::OpTypeInt:
+			case spv::OpTypeFloat:
+			case spv::OpTypeVector:
+			case spv::OpTypeMatrix:
+			case spv::OpTypeImage:
+			case spv::OpTypeSampler:
+			case spv::OpTypeSampledImage:
+			case spv::OpTypeArray:
+			case spv::OpTypeRuntimeArray:
+			case spv::OpTypeStruct:
+			case spv::OpTypePointer:
+			case spv::OpTypeAccelerationStructureKHR:
+				{
+					std::vector<uint32_t> declaration{static_cast<uint32_t>(opcode)};
+					declaration.insert(declaration.end(), operands + 1, operands + operandCount);
+					m_types[operands[0]] = std::move(declaration);
+					break;
+				}
+			default:
+				break;
+			}
+		}
+
+		void markUsedIds(spv::Op opcode, const uint32_t* operands, uint32_t operandCount)
+		{
+			bool hasResult = false;
+			bool hasResultType = false;
+			spv::HasResultAndType(opcode, &hasResult, &hasResultType);
+			uint32_t first = (hasResult ? 1 : 0) + (hasResultType ? 1 : 0);
+			// literal operands may collide with a variable id; that only ever widens a stage mask, which is harmless
+			for (uint32_t i = first; i < operandCount; i++)
+			{
+				m_usedIds.insert(operands[i]);
+			}
+		}
+
+		static VkShaderStageFlagBits toShaderStage(spv::ExecutionModel model)
+		{
+			switch (model)
+			{
+			case spv::ExecutionModelVertex: return VK_SHADER_STAGE_VERTEX_BIT;
+			case spv::ExecutionModelTessellationControl: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+			case spv::ExecutionModelTessellationEvaluation: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+			case spv::ExecutionModelGeometry: return VK_SHADER_STAGE_GEOMETRY_BIT;
+			case spv::ExecutionModelFragment: return VK_SHADER_STAGE_FRAGMENT_BIT;
+			case spv::ExecutionModelGLCompute: return VK_SHADER_STAGE_COMPUTE_BIT;
+			default: throw std::runtime_error("unsupported SPIR-V execution model");
+			}
+		}
+
+		VkShaderStageFlagBits m_stage = VK_SHADER_STAGE_ALL;
+		std::vector<Variable> m_variables;
+		std::unordered_set<uint32_t> m_usedIds;
+		std::unordered_map<uint32_t, std::string> m_names;
+		std::unordered_map<uint32_t, std::vector<uint32_t>> m_types;
+		std::unordered_map<uint32_t, uint32_t> m_constants;
+		std::unordered_map<uint32_t, std::map<spv::Decoration, uint32_t>> m_decorations;
+		std::map<std::pair<uint32_t, uint32_t>, std::map<spv::Decoration, uint32_t>> m_memberDecorations;
+	};
+
+	static VkFormat toVertexFormat(const SpirvModule& module, uint32_t typeId)
+	{
+		const auto& t = module.type(typeId);
+		uint32_t componentCount = 1;
+		const std::vector<uint32_t>* scalar = &t;
+		if (t[0] == spv::OpTypeVector)
+		{
+			componentCount = t[2];
+			scalar = &module.type(t[1]);
+		}
+
+		// only 32-bit attributes are used by the engine
+		if ((*scalar)[1] != 32)
+		{
+			return VK_FORMAT_UNDEFINED;
+		}
+
+		static constexpr VkFormat floatFormats[] = {
+			VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT
+		};
+		static constexpr VkFormat intFormats[] = {
+			VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT
+		};
+		static constexpr VkFormat uintFormats[] = {
+			VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT
+		};
+
+		if ((*scalar)[0] == spv::OpTypeFloat)
+		{
+			return floatFormats[componentCount - 1];
+		}
+		// OpTypeInt: width, signedness
+		return (*scalar)[2] ? intFormats[componentCount - 1] : uintFormats[componentCount - 1];
+	}
+
+	ZShaderReflection::ZShaderReflection(std::initializer_list<const std::vector<uint32_t>*> stages)
+	{
+		for (const auto* stage : stages)
+		{
+			addStage(*stage);
+		}
+	}
+
+	void ZShaderReflection::addStage(const std::vector<uint32_t>& spirv)
+	{
+		SpirvModule module{spirv};
+		VkShaderStageFlagBits stage = module.stage();
+		m_stages |= stage;
+
+		for (uint32_t constantId : module.specializationConstantIds())
+		{
+			auto it = std::ranges::lower_bound(m_specializationConstantIds, constantId);
+			if (it == m_specializationConstantIds.end() || *it != constantId)
+			{
+				m_specializationConstantIds.insert(it, constantId);
+			}
+		}
+
+		for (const auto& variable : module.variables())
+		{
+			// variables are always pointers; we want what they point to
+			const auto& pointerType = module.type(variable.pointerTypeId);
+			uint32_t typeId = pointerType[2];
+			bool used = module.isUsed(variable.id);
+
+			if (variable.storageClass == spv::StorageClassPushConstant)
+			{
+				if (!used) continue;
+				uint32_t size = module.typeSize(typeId);
+				if (m_pushConstantRange)
+				{
+					m_pushConstantRange->stageFlags |= stage;
+					m_pushConstantRange->size = std::max(m_pushConstantRange->size, size);
+				}
+				else
+				{
+					m_pushConstantRange = VkPushConstantRange{.stageFlags = stage, .offset = 0, .size = size};
+				}
+				continue;
+			}
+
+			if (variable.storageClass == spv::StorageClassInput && stage == VK_SHADER_STAGE_VERTEX_BIT)
+			{
+				auto location = module.decoration(variable.id, spv::DecorationLocation);
+				// built-ins (gl_VertexIndex, ...) have no location and are not fed by vertex buffers
+				if (!location || module.decoration(variable.id, spv::DecorationBuiltIn)) continue;
+				m_vertexInputs.push_back({*location, toVertexFormat(module, typeId), module.name(variable.id)});
+				continue;
+			}
+
+			if (variable.storageClass != spv::StorageClassUniform &&
+				variable.storageClass != spv::StorageClassUniformConstant &&
+				variable.storageClass != spv::StorageClassStorageBuffer)
+			{
+				continue;
+			}
+
+			auto set = module.decoration(variable.id, spv::DecorationDescriptorSet);
+			auto binding = module.decoration(variable.id, spv::DecorationBinding);
+			if (!set || !binding || !used) continue;
+
+			// arrays of descriptors
+			uint32_t descriptorCount = 1;
+			if (module.type(typeId)[0] == spv::OpTypeArray)
+			{
+				descriptorCount = module.constant(module.type(typeId)[2]);
+				typeId = module.type(typeId)[1];
+			}
+
+			const auto& t = module.type(typeId);
+			VkDescriptorType descriptorType;
+			uint32_t blockSize = 0;
+			switch (static_cast<spv::Op>(t[0]))
+			{
+			case spv::OpTypeStruct:
+				descriptorType = variable.storageClass == spv::StorageClassStorageBuffer ||
+				                 module.decoration(typeId, spv::DecorationBufferBlock)
+					                 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+					                 : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+				blockSize = module.typeSize(typeId);
+				break;
+			case spv::OpTypeSampledImage:
+				descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+				break;
+			case spv::OpTypeSampler:
+				descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+				break;
+			case spv::OpTypeImage:
+				{
+					// OpTypeImage: sampled type, dim, depth, arrayed, MS, sampled (1 = sampled, 2 = storage), format
+					auto dim = static_cast<spv::Dim>(t[2]);
+					bool storage = t[6] == 2;
+					if (dim == spv::DimSubpassData)
+						descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+					else if (dim == spv::DimBuffer)
+						descriptorType = storage
+							                 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER
+							                 : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+					else
+						descriptorType = storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+					break;
+				}
+			default:
+				continue;
+			}
+
+			// merge with the same binding seen in another stage
+			auto existing = std::find_if(m_descriptorBindings.begin(),
+			                             m_descriptorBindings.end(),
+			                             [&](const DescriptorBinding& b)
+			                             {
+				                             return b.set == *set && b.binding == *binding;
+			                             });
+			if (existing != m_descriptorBindings.end())
+			{
+				if (existing->descriptorType != descriptorType || existing->descriptorCount != descriptorCount)
+				{
+					throw std::runtime_error("shader stages disagree on descriptor (set " + std::to_string(*set) +
+						", binding " + std::to_string(*binding) + ")");
+				}
+				existing->stageFlags |= stage;
+				existing->blockSize = std::max(existing->blockSize, blockSize);
+				continue;
+			}
+
+			// uniform blocks are named after their type, e.g. "GlobalUbo"
+			std::string name = module.name(typeId);
+			m_descriptorBindings.push_back({
+				*set, *binding, descriptorType, descriptorCount, static_cast<VkShaderStageFlags>(stage), blockSize,
+				name.empty() ? module.name(variable.id) : name
+			});
+		}
+	}
+
+	VkShaderStageFlags ZShaderReflection::getPushConstantStages() const
+	{
+		return m_pushConstantRange ? m_pushConstantRange->stageFlags : 0;
+	}
+
+	void ZShaderReflection::validatePushConstantSize(size_t cppSize) const
+	{
+		uint32_t shaderSize = m_pushConstantRange ? m_pushConstantRange->size : 0;
+		if (shaderSize != cppSize)
+		{
+			throw std::runtime_error("push constant size mismatch: shader expects " + std::to_string(shaderSize) +
+				" bytes, C++ struct has " + std::to_string(cppSize));
+		}
+	}
+
+	void ZShaderReflection::validateBlockSize(uint32_t set, uint32_t binding, size_t cppSize) const
+	{
+		for (const auto& descriptorBinding : m_descriptorBindings)
+		{
+			if (descriptorBinding.set != set || descriptorBinding.binding != binding) continue;
+			if (descriptorBinding.blockSize != cppSize)
+			{
+				throw std::runtime_error("size mismatch for " + descriptorBinding.name + ": shader expects " +
+					std::to_string(descriptorBinding.blockSize) + " bytes, C++ struct has " +
+					std::to_string(cppSize));
+			}
+			return;
+		}
+		// the shaders don't use the block at all, so there is nothing to be out of sync with
+	}
+
+	void ZShaderReflection::validateVertexInputs(
+		const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions) const
+	{
+		for (const auto& input : m_vertexInputs)
+		{
+			auto attribute = std::find_if(attributeDescriptions.begin(),
+			                              attributeDescriptions.end(),
+			                              [&](const VkVertexInputAttributeDescription& a)
+			                              {
+				                              return a.location == input.location;
+			                              });
+			if (attribute == attributeDescriptions.end())
+			{
+				throw std::runtime_error("vertex input '" + input.name + "' at location " +
+					std::to_string(input.location) + " has no matching attribute description");
+			}
+			if (input.format != VK_FORMAT_UNDEFINED && attribute->format != input.format)
+			{
+				throw std::runtime_error("vertex input '" + input.name + "' at location " +
+					std::to_string(input.location) + " has a different format than its attribute description");
+			}
+		}
+	}
+
+	void ZShaderReflection::validateSetLayouts(const std::map<uint32_t, const ZDescriptorSetLayout*>& setLayouts) const
+	{
+		for (const auto& binding : m_descriptorBindings)
+		{
+			auto layout = setLayouts.find(binding.set);
+			if (layout == setLayouts.end()) continue;
+
+			const auto& layoutBindings = layout->second->getBindings();
+			auto layoutBinding = layoutBindings.find(binding.binding);
+			if (layoutBinding == layoutBindings.end() ||
+				layoutBinding->second.descriptorType != binding.descriptorType ||
+				layoutBinding->second.descriptorCount < binding.descriptorCount ||
+				(layoutBinding->second.stageFlags & binding.stageFlags) != binding.stageFlags)
+			{
+				throw std::runtime_error("shared descriptor set layout " + std::to_string(binding.set) +
+					" does not match shader binding " + std::to_string(binding.binding) + " (" + binding.name + ")");
+			}
+		}
+	}
+
+	std::unique_ptr<ZDescriptorSetLayout> ZShaderReflection::createDescriptorSetLayout(ZDevice& device,
+		uint32_t set) const
+	{
+		ZDescriptorSetLayout::Builder builder{device};
+		for (const auto& binding : m_descriptorBindings)
+		{
+			if (binding.set != set) continue;
+			builder.addBinding(binding.binding, binding.descriptorType, binding.stageFlags, binding.descriptorCount);
+		}
+		return builder.build();
+	}
+
+	VkPipelineLayout ZShaderReflection::createPipelineLayout(
+		ZDevice& device,
+		const std::map<uint32_t, const ZDescriptorSetLayout*>& sharedSetLayouts,
+		std::vector<std::unique_ptr<ZDescriptorSetLayout>>& ownedSetLayouts) const
+	{
+		uint32_t setCount = 0;
+		for (const auto& binding : m_descriptorBindings)
+		{
+			setCount = std::max(setCount, binding.set + 1);
+		}
+		for (const auto& [set, layout] : sharedSetLayouts)
+		{
+			setCount = std::max(setCount, set + 1);
+		}
+
+		validateSetLayouts(sharedSetLayouts);
+
+		std::vector<VkDescriptorSetLayout> descriptorSetLayouts(setCount, VK_NULL_HANDLE);
+		for (uint32_t set = 0; set < setCount; set++)
+		{
+			auto shared = sharedSetLayouts.find(set);
+			if (shared != sharedSetLayouts.end())
+			{
+				descriptorSetLayouts[set] = shared->second->getDescriptorSetLayout();
+				continue;
+			}
+			// sets the shaders don't use still need a (possibly empty) layout to keep the indices dense
+			ownedSetLayouts.push_back(createDescriptorSetLayout(device, set));
+			descriptorSetLayouts[set] = ownedSetLayouts.back()->getDescriptorSetLayout();
+		}
+
+		if (m_pushConstantRange && m_pushConstantRange->size > device.m_properties.limits.maxPushConstantsSize)
+		{
+			throw std::runtime_error("push constant block of " + std::to_string(m_pushConstantRange->size) +
+				" bytes exceeds the device limit of " +
+				std::to_string(device.m_properties.limits.maxPushConstantsSize));
+		}
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+			.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size()),
+			.pSetLayouts = descriptorSetLayouts.data(),
+			.pushConstantRangeCount = m_pushConstantRange ? 1u : 0u,
+			.pPushConstantRanges = m_pushConstantRange ? &*m_pushConstantRange : nullptr,
+		};
+
+		VkPipelineLayout pipelineLayout;
+		if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create pipeline layout!");
+		}
+		return pipelineLayout;
+	}
+}
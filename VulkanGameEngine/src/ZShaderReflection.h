@@ -0,0 +1,83 @@
+﻿#pragma once
+#include "ZDevice.h"
+#include "ZDescriptors.h"
+
+namespace ZZX
+{
+	/**
+	 * Reads the resource interface of a set of SPIR-V shader stages.
+	 *
+	 * Descriptor bindings, the push-constant range and the vertex inputs are extracted directly from the binaries.
+	 * Stage masks only contain the stages that actually access a resource, not every stage that declares it,
+	 * so e.g. a push block that the fragment shader declares but never reads is vertex-only.
+	 * The result can build descriptor set layouts and a pipeline layout, and can check that the C++ structs
+	 * mirroring the shader blocks still have the size the shaders expect.
+	 */
+	class ZShaderReflection
+	{
+	public:
+		struct DescriptorBinding
+		{
+			uint32_t set;
+			uint32_t binding;
+			VkDescriptorType descriptorType;
+			uint32_t descriptorCount;
+			VkShaderStageFlags stageFlags;
+			// size of the block in bytes (buffers only)
+			uint32_t blockSize;
+			std::string name;
+		};
+
+		struct VertexInput
+		{
+			uint32_t location;
+			VkFormat format;
+			std::string name;
+		};
+
+		ZShaderReflection() = default;
+		explicit ZShaderReflection(std::initializer_list<const std::vector<uint32_t>*> stages);
+
+		// reflect one more stage and merge it with the stages reflected so far
+		void addStage(const std::vector<uint32_t>& spirv);
+
+		const std::vector<DescriptorBinding>& getDescriptorBindings() const { return m_descriptorBindings; }
+		const std::vector<VertexInput>& getVertexInputs() const { return m_vertexInputs; }
+		bool hasPushConstants() const { return m_pushConstantRange.has_value(); }
+		const std::optional<VkPushConstantRange>& getPushConstantRange() const { return m_pushConstantRange; }
+		// the stage flags to pass to vkCmdPushConstants
+		VkShaderStageFlags getPushConstantStages() const;
+		VkShaderStageFlags getStages() const { return m_stages; }
+		// the constant ids the stages declare, sorted; a specialization constant set for any other id has no effect
+		const std::vector<uint32_t>& getSpecializationConstantIds() const { return m_specializationConstantIds; }
+
+		// throw if the shaders' push block doesn't have exactly this size
+		void validatePushConstantSize(size_t cppSize) const;
+		// throw if the buffer at (set, binding) doesn't have exactly this size
+		void validateBlockSize(uint32_t set, uint32_t binding, size_t cppSize) const;
+		// throw if the vertex inputs don't match the attribute descriptions fed to the pipeline
+		void validateVertexInputs(const std::vector<VkVertexInputAttributeDescription>& attributeDescriptions) const;
+		// throw if a shared layout lacks a binding the shaders use, or declares it with another type or fewer stages
+		void validateSetLayouts(const std::map<uint32_t, const ZDescriptorSetLayout*>& setLayouts) const;
+
+		// build a layout containing every binding the shaders use in the given set
+		std::unique_ptr<ZDescriptorSetLayout> createDescriptorSetLayout(ZDevice& device, uint32_t set) const;
+
+		/**
+		 * \brief Create a pipeline layout for these shaders
+		 * \param sharedSetLayouts Layouts for sets that are shared with other pipelines (e.g. the global set), keyed by set index.
+		 * They are validated against the shaders and used as-is. Every other set the shaders use gets a layout generated
+		 * from reflection, which is appended to ownedSetLayouts (the caller must keep them alive as long as the pipeline layout)
+		 */
+		VkPipelineLayout createPipelineLayout(ZDevice& device,
+		                                      const std::map<uint32_t, const ZDescriptorSetLayout*>& sharedSetLayouts,
+		                                      std::vector<std::unique_ptr<ZDescriptorSetLayout>>& ownedSetLayouts) const;
+
+	private:
+		std::vector<DescriptorBinding> m_descriptorBindings;
+		std::vector<VertexInput> m_vertexInputs;
+		std::optional<VkPushConstantRange> m_pushConstantRange;
+		std::vector<uint32_t> m_specializationConstantIds;
+		VkShaderStageFlags m_stages = 0;
+	};
+}
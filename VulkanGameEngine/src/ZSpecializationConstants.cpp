@@ -0,0 +1,107 @@
+﻿#include "pch.h"
+#include "ZSpecializationConstants.h"
+#include "ZUtils.h"
+
+namespace ZZX
+{
+	ZSpecializationConstants& ZSpecializationConstants::set(uint32_t constantId, int32_t value)
+	{
+		setWord(constantId, static_cast<uint32_t>(value));
+		return *this;
+	}
+
+	ZSpecializationConstants& ZSpecializationConstants::set(uint32_t constantId, uint32_t value)
+	{
+		setWord(constantId, value);
+		return *this;
+	}
+
+	ZSpecializationConstants& ZSpecializationConstants::set(uint32_t constantId, float value)
+	{
+		uint32_t word;
+		std::memcpy(&word, &value, sizeof(word));
+		setWord(constantId, word);
+		return *this;
+	}
+
+	ZSpecializationConstants& ZSpecializationConstants::set(uint32_t constantId, bool value)
+	{
+		setWord(constantId, value ? VK_TRUE : VK_FALSE);
+		return *this;
+	}
+
+	ZSpecializationConstants ZSpecializationConstants::subset(const std::vector<uint32_t>& constantIds) const
+	{
+		ZSpecializationConstants result{};
+		for (size_t i = 0; i < m_entries.size(); i++)
+		{
+			if (std::ranges::find(constantIds, m_entries[i].constantID) != constantIds.end())
+			{
+				result.setWord(m_entries[i].constantID, m_data[i]);
+			}
+		}
+		return result;
+	}
+
+	uint64_t ZSpecializationConstants::hash() const
+	{
+		uint64_t key = hashBytes(m_data.data(), m_data.size() * sizeof(uint32_t));
+		for (const auto& entry : m_entries)
+		{
+			key = hashBytes(&entry.constantID, sizeof(entry.constantID), key);
+		}
+		return key;
+	}
+
+	bool ZSpecializationConstants::operator==(const ZSpecializationConstants& other) const
+	{
+		if (m_data != other.m_data || m_entries.size() != other.m_entries.size())
+		{
+			return false;
+		}
+		// offsets and sizes follow from the order, only the ids can differ
+		for (size_t i = 0; i < m_entries.size(); i++)
+		{
+			if (m_entries[i].constantID != other.m_entries[i].constantID)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	VkSpecializationInfo ZSpecializationConstants::getInfo() const
+	{
+		return VkSpecializationInfo{
+			.mapEntryCount = static_cast<uint32_t>(m_entries.size()),
+			.pMapEntries = m_entries.data(),
+			.dataSize = m_data.size() * sizeof(uint32_t),
+			.pData = m_data.data(),
+		};
+	}
+
+	void ZSpecializationConstants::setWord(uint32_t constantId, uint32_t word)
+	{
+		auto it = std::lower_bound(m_entries.begin(),
+		                           m_entries.end(),
+		                           constantId,
+		                           [](const VkSpecializationMapEntry& entry, uint32_t id)
+		                           {
+			                           return entry.constantID < id;
+		                           });
+		size_t index = it - m_entries.begin();
+		if (it != m_entries.end() && it->constantID == constantId)
+		{
+			m_data[index] = word;
+			return;
+		}
+
+		m_entries.insert(it, VkSpecializationMapEntry{constantId, 0, sizeof(uint32_t)});
+		m_data.insert(m_data.begin() + index, word);
+		// entries after the new one moved by one word
+		for (size_t i = index; i < m_entries.size(); i++)
+		{
+			m_entries[i].offset = static_cast<uint32_t>(i * sizeof(uint32_t));
+		}
+	}
+}
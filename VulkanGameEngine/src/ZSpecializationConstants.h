@@ -0,0 +1,38 @@
+﻿#pragma once
+
+namespace ZZX
+{
+	/**
+	 * A set of specialization constant values for a pipeline.
+	 *
+	 * Values are baked into the pipeline at creation time, so the driver compiles the shader as if they were
+	 * literals: loops with a constant trip count get unrolled and branches on constants disappear.
+	 * Constants are kept ordered by constant id, so two sets holding the same values compare and hash equal
+	 * no matter in which order they were set.
+	 */
+	class ZSpecializationConstants
+	{
+	public:
+		// the constant ids must match the shader's layout(constant_id = ...) qualifiers
+		ZSpecializationConstants& set(uint32_t constantId, int32_t value);
+		ZSpecializationConstants& set(uint32_t constantId, uint32_t value);
+		ZSpecializationConstants& set(uint32_t constantId, float value);
+		ZSpecializationConstants& set(uint32_t constantId, bool value);
+
+		bool empty() const { return m_entries.empty(); }
+		// only the constants whose id is in constantIds
+		ZSpecializationConstants subset(const std::vector<uint32_t>& constantIds) const;
+		uint64_t hash() const;
+		bool operator==(const ZSpecializationConstants& other) const;
+
+		// the returned struct points into this object, so it must not outlive it
+		VkSpecializationInfo getInfo() const;
+
+	private:
+		// every constant is stored as 4 bytes (bools become VkBool32)
+		void setWord(uint32_t constantId, uint32_t word);
+
+		std::vector<VkSpecializationMapEntry> m_entries;
+		std::vector<uint32_t> m_data;
+	};
+}
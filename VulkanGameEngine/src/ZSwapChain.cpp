@@ -3,24 +3,61 @@
 
 namespace ZZX
 {
-	ZSwapChain::ZSwapChain(ZDevice& deviceRef)
-		: m_ZDevice{deviceRef}
+	static constexpr std::array<std::pair<VkPresentModeKHR, const char*>, 4> PRESENT_MODE_NAMES{
+		{
+			{VK_PRESENT_MODE_IMMEDIATE_KHR, "immediate"},
+			{VK_PRESENT_MODE_MAILBOX_KHR, "mailbox"},
+			{VK_PRESENT_MODE_FIFO_KHR, "fifo"},
+			{VK_PRESENT_MODE_FIFO_RELAXED_KHR, "fifo_relaxed"},
+		}
+	};
+
+	const char* presentModeName(VkPresentModeKHR presentMode)
+	{
+		for (const auto& [mode, name] : PRESENT_MODE_NAMES)
+		{
+			if (mode == presentMode)
+			{
+				return name;
+			}
+		}
+		return "unknown";
+	}
+
+	std::optional<VkPresentModeKHR> presentModeFromName(const std::string& name)
+	{
+		for (const auto& [mode, modeName] : PRESENT_MODE_NAMES)
+		{
+			if (name == modeName)
+			{
+				return mode;
+			}
+		}
+		return std::nullopt;
+	}
+
+	ZSwapChain::ZSwapChain(ZDevice& deviceRef, const SwapChainSettings& settings)
+		: m_settings{settings}, m_ZDevice{deviceRef}
 	{
 		init();
 	}
 
-	ZSwapChain::ZSwapChain(ZDevice& deviceRef, std::shared_ptr<ZSwapChain> previous)
-		: m_ZDevice{deviceRef}, m_oldSwapChain{std::move(previous)}
+	ZSwapChain::ZSwapChain(ZDevice& deviceRef, const SwapChainSettings& settings, std::shared_ptr<ZSwapChain> previous)
+		: m_settings{settings}, m_ZDevice{deviceRef}, m_oldSwapChain{std::move(previous)}
 	{
 		init();
 
 		// we will only use the old swap chain during init(), thus after init() it's no longer needed
-		// clean up old swap chain since it's no longer needed
+		// its frames may still be in flight though, so the caller decides when it is destroyed
 		m_oldSwapChain = nullptr;
 	}
 
 	void ZSwapChain::init()
 	{
+		if (m_settings.framesInFlight == 0 || m_settings.framesInFlight > MAX_FRAMES_IN_FLIGHT)
+		{
+			throw std::runtime_error("failed to create swap chain: unsupported number of frames in flight!");
+		}
 		createSwapChain();
 		createImageViews();
 		createRenderPass();
@@ -58,25 +95,23 @@ namespace ZZX
 		vkDestroyRenderPass(m_ZDevice.device(), m_VkRenderPass, nullptr);
 
 		// cleanup synchronization objects
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		for (size_t i = 0; i < m_settings.framesInFlight; i++)
 		{
 			vkDestroySemaphore(m_ZDevice.device(), m_renderFinishedSemaphores[i], nullptr);
 			vkDestroySemaphore(m_ZDevice.device(), m_imageAvailableSemaphores[i], nullptr);
-			vkDestroyFence(m_ZDevice.device(), m_inFlightFences[i], nullptr);
 		}
 	}
 
+	VkResult ZSwapChain::waitForPresent(uint64_t presentId, uint64_t timeout)
+	{
+		return m_ZDevice.waitForPresent(m_VkSwapchainKHR, presentId, timeout);
+	}
+
 	VkResult ZSwapChain::acquireNextImage(uint32_t* imageIndex)
 	{
-		// At the start of the frame, we want to wait until the previous frame has finished,
+		// At the start of the frame, we want to wait until the previous frame in this slot has finished,
 		// so that the command buffer and semaphores are available to use
-		vkWaitForFences(
-			m_ZDevice.device(),
-			1,
-			&m_inFlightFences[m_currentFrame],
-			VK_TRUE,
-			// disable the timeout
-			std::numeric_limits<uint64_t>::max());
+		m_ZDevice.graphicsTimeline().waitForValue(m_frameValues[m_currentFrame]);
 
 		VkResult result = vkAcquireNextImageKHR(
 			m_ZDevice.device(),
@@ -94,13 +129,14 @@ namespace ZZX
 	}
 
 	VkResult ZSwapChain::submitCommandBuffers(
-		const VkCommandBuffer* buffers, uint32_t* imageIndex)
+		const VkCommandBuffer* buffers, uint32_t* imageIndex, uint64_t frameValue)
 	{
-		/*if (m_imagesInFlight[*imageIndex] != VK_NULL_HANDLE)
-		{
-			vkWaitForFences(m_ZDevice.device(), 1, &m_imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
-		}
-		m_imagesInFlight[*imageIndex] = m_inFlightFences[m_currentFrame];*/
+		ZTimeline& timeline = m_ZDevice.graphicsTimeline();
+		// an older frame may still be rendering to this image, wait for it
+		timeline.waitForValue(m_imageValues[*imageIndex]);
+		// the image and the frame slot now belong to this frame
+		m_imageValues[*imageIndex] = frameValue;
+		m_frameValues[m_currentFrame] = frameValue;
 
 		VkSemaphore waitSemaphores[] = {m_imageAvailableSemaphores[m_currentFrame]};
 		VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
@@ -120,20 +156,22 @@ namespace ZZX
 			.pSignalSemaphores = signalSemaphores,
 		};
 
-		// reset the fence to the unsignaled state
-		vkResetFences(m_ZDevice.device(), 1, &m_inFlightFences[m_currentFrame]);
-
-		// submit the command buffer to the graphics queue
-		if (vkQueueSubmit(m_ZDevice.graphicsQueue(), 1, &submitInfo, m_inFlightFences[m_currentFrame]) !=
-			VK_SUCCESS)
-		{
-			throw std::runtime_error("failed to submit draw command buffer!");
-		}
+		// submit the command buffer to the graphics queue; the timeline tells us when it's done
+		timeline.submit(m_ZDevice.graphicsQueue(), submitInfo, frameValue);
 
 		// Present the swap chain image
 		VkSwapchainKHR swapChains[] = {m_VkSwapchainKHR};
+		// tag the present, so we can wait until it is actually on screen
+		uint64_t presentId = m_lastPresentId + 1;
+		VkPresentIdKHR presentIdInfo{
+			.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+			.swapchainCount = 1,
+			.pPresentIds = &presentId,
+		};
+		bool usePresentId = m_ZDevice.getCapabilities().presentWait;
 		VkPresentInfoKHR presentInfo = {
 			.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+			.pNext = usePresentId ? &presentIdInfo : nullptr,
 			// specify which semaphores to wait on before presentation can happen
 			.waitSemaphoreCount = 1,
 			.pWaitSemaphores = signalSemaphores,
@@ -144,7 +182,11 @@ namespace ZZX
 		};
 
 		auto result = vkQueuePresentKHR(m_ZDevice.presentQueue(), &presentInfo);
-		m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+		if (usePresentId)
+		{
+			m_lastPresentId = presentId;
+		}
+		m_currentFrame = (m_currentFrame + 1) % m_settings.framesInFlight;
 
 		return result;
 	}
@@ -158,7 +200,9 @@ namespace ZZX
 		VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
 		// number of images (buffers) to use in the swap chain (3 => triple buffering)
-		uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+		uint32_t imageCount = m_settings.minImageCount == 0
+			                      ? swapChainSupport.capabilities.minImageCount + 1
+			                      : std::max(m_settings.minImageCount, swapChainSupport.capabilities.minImageCount);
 		if (swapChainSupport.capabilities.maxImageCount > 0 &&
 			imageCount > swapChainSupport.capabilities.maxImageCount)
 		{
@@ -177,6 +221,12 @@ namespace ZZX
 		// what kind of operations we'll use the images in the swap chain for
 		// in this case, we are rendering directly to the images in the swap chain
 		createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		// also allow copying presented images back to the host (for frame captures), where the surface supports it
+		m_supportsTransferSrc = (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+		if (m_supportsTransferSrc)
+		{
+			createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		}
 
 		// Next, we need to specify how to handle swap chain images that will be used across multiple queue families
 		// That will be the case in our application if the graphics queue family is different from the presentation queue
@@ -230,7 +280,8 @@ namespace ZZX
 		m_swapChainImages.resize(imageCount);
 		vkGetSwapchainImagesKHR(m_ZDevice.device(), m_VkSwapchainKHR, &imageCount, m_swapChainImages.data());
 
-		// the following two lines store the format and extent for future use
+		// the following lines store the present mode, format and extent for future use
+		m_presentMode = presentMode;
 		m_swapChainImageFormat = surfaceFormat.format;
 		m_swapChainExtent = extent;
 	}
@@ -281,13 +332,21 @@ namespace ZZX
 
 	void ZSwapChain::createRenderPass()
 	{
+		// the render pass only depends on the formats, so keep using the old swap chain's;
+		// that way pipelines created against it never see it destroyed
+		if (m_oldSwapChain != nullptr && m_oldSwapChain->m_swapChainImageFormat == m_swapChainImageFormat)
+		{
+			m_VkRenderPass = std::exchange(m_oldSwapChain->m_VkRenderPass, VK_NULL_HANDLE);
+			return;
+		}
+
 		// Before creating the graphics pipeline, We must tell Vulkan about the framebuffer attachments that will be used while rendering
 		// We need to specify how many color and depth buffers there will be,
 		// how many samples to use for each of them and how their contents should be handled throughout the rendering operations
 		// All of this information is wrapped in a render pass object
 
 		VkAttachmentDescription colorAttachment = {};
-		colorAttachment.format = getSwapChainImageFormat();
+		colorAttachment.format = getColorFormat();
 		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
 
 		// what to do with the data in the attachment before rendering
@@ -353,9 +412,11 @@ namespace ZZX
 		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
 		dependency.dstSubpass = 0;
 
-		dependency.srcStageMask =
-			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-		dependency.srcAccessMask = 0;
+		// the depth writes of earlier frames (late fragment tests) must be done before this frame clears depth,
+		// as the depth image may have been rendered to by a frame that is still in flight
+		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+			VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
 		dependency.dstStageMask =
 			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
@@ -385,7 +446,7 @@ namespace ZZX
 		{
 			std::array<VkImageView, 2> attachments = {m_swapChainImageViews[i], m_depthImageViews[i]};
 
-			VkExtent2D swapChainExtent = getSwapChainExtent();
+			VkExtent2D swapChainExtent = getExtent();
 			VkFramebufferCreateInfo framebufferInfo = {};
 			framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
 			framebufferInfo.renderPass = m_VkRenderPass;
@@ -410,7 +471,12 @@ namespace ZZX
 	{
 		VkFormat depthFormat = findDepthFormat();
 		m_swapChainDepthFormat = depthFormat;
-		VkExtent2D swapChainExtent = getSwapChainExtent();
+		VkExtent2D swapChainExtent = getExtent();
+		if (adoptDepthResources())
+		{
+			return;
+		}
+		m_depthExtent = swapChainExtent;
 
 		m_depthImages.resize(imageCount());
 		m_depthImageMemorys.resize(imageCount());
@@ -458,30 +524,62 @@ namespace ZZX
 		}
 	}
 
+	bool ZSwapChain::adoptDepthResources()
+	{
+		if (m_oldSwapChain == nullptr)
+		{
+			return false;
+		}
+		ZSwapChain& old = *m_oldSwapChain;
+		VkExtent2D extent = getExtent();
+		bool fits = old.m_depthExtent.width >= extent.width && old.m_depthExtent.height >= extent.height;
+		// after shrinking a lot, a smaller allocation is worth the cost
+		bool wastesMemory = static_cast<uint64_t>(old.m_depthExtent.width) * old.m_depthExtent.height >
+			2 * static_cast<uint64_t>(extent.width) * extent.height;
+		if (old.m_swapChainDepthFormat != m_swapChainDepthFormat || old.m_depthImages.size() != imageCount() ||
+			!fits || wastesMemory)
+		{
+			return false;
+		}
+
+		// frames of the old swap chain may still render to these images: their timeline values come along, so a
+		// frame using an image waits for them (and the render pass's external dependency orders the depth writes)
+		m_depthExtent = old.m_depthExtent;
+		m_depthImages = std::move(old.m_depthImages);
+		m_depthImageMemorys = std::move(old.m_depthImageMemorys);
+		m_depthImageViews = std::move(old.m_depthImageViews);
+		m_imageValues = old.m_imageValues;
+		old.m_depthImages.clear();
+		old.m_depthImageMemorys.clear();
+		old.m_depthImageViews.clear();
+		return true;
+	}
+
 	void ZSwapChain::createSyncObjects()
 	{
-		m_imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		m_renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		m_inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-		// m_imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+		m_imageAvailableSemaphores.resize(m_settings.framesInFlight);
+		m_renderFinishedSemaphores.resize(m_settings.framesInFlight);
+		m_frameValues.resize(m_settings.framesInFlight, 0);
+		// keeps the values adoptDepthResources copied
+		m_imageValues.resize(imageCount(), 0);
+		if (m_oldSwapChain != nullptr && m_oldSwapChain->m_settings.framesInFlight == m_settings.framesInFlight)
+		{
+			// frames recorded against the old swap chain may still be in flight;
+			// the frame slots (and the renderer's command buffers) must keep waiting for them
+			m_frameValues = m_oldSwapChain->m_frameValues;
+			m_currentFrame = m_oldSwapChain->m_currentFrame;
+		}
 
 		VkSemaphoreCreateInfo semaphoreInfo = {
 			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
 		};
 
-		VkFenceCreateInfo fenceInfo = {
-			.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-			// create the fence in the signaled state for the first frame
-			.flags = VK_FENCE_CREATE_SIGNALED_BIT,
-		};
-
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+		for (size_t i = 0; i < m_settings.framesInFlight; i++)
 		{
 			if (vkCreateSemaphore(m_ZDevice.device(), &semaphoreInfo, nullptr, &m_imageAvailableSemaphores[i]) !=
 				VK_SUCCESS ||
 				vkCreateSemaphore(m_ZDevice.device(), &semaphoreInfo, nullptr, &m_renderFinishedSemaphores[i]) !=
-				VK_SUCCESS ||
-				vkCreateFence(m_ZDevice.device(), &fenceInfo, nullptr, &m_inFlightFences[i]) != VK_SUCCESS)
+				VK_SUCCESS)
 			{
 				throw std::runtime_error("failed to create synchronization objects for a frame!");
 			}
@@ -506,16 +604,17 @@ namespace ZZX
 	VkPresentModeKHR ZSwapChain::chooseSwapPresentMode(
 		const std::vector<VkPresentModeKHR>& availablePresentModes)
 	{
-		for (const auto& availablePresentMode : availablePresentModes)
+		for (VkPresentModeKHR preferredPresentMode : m_settings.presentModes)
 		{
-			if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
+			if (std::find(availablePresentModes.begin(), availablePresentModes.end(), preferredPresentMode) !=
+				availablePresentModes.end())
 			{
-				std::cout << "Present mode: Mailbox" << std::endl;
-				return availablePresentMode;
+				std::cout << "Present mode: " << presentModeName(preferredPresentMode) << std::endl;
+				return preferredPresentMode;
 			}
 		}
 
-		std::cout << "Present mode: V-Sync" << std::endl;
+		std::cout << "Present mode: " << presentModeName(VK_PRESENT_MODE_FIFO_KHR) << std::endl;
 		return VK_PRESENT_MODE_FIFO_KHR;
 	}
 
@@ -1,44 +1,71 @@
 ﻿#pragma once
 #include "ZDevice.h"
+#include "ZRenderTarget.h"
 
 namespace ZZX
 {
-	class ZSwapChain
+	// how the swap chain trades latency against throughput; all of these can change at runtime
+	struct SwapChainSettings
+	{
+		// how many frames the CPU may record ahead of the GPU, at most ZSwapChain::MAX_FRAMES_IN_FLIGHT
+		uint32_t framesInFlight = 2;
+		// minimum number of swap chain images to ask for; 0 picks one more than the surface's minimum
+		uint32_t minImageCount = 0;
+		// present modes in order of preference; FIFO is always available, so it is the last resort
+		std::vector<VkPresentModeKHR> presentModes{VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR};
+	};
+
+	// short lowercase name of a present mode ("fifo", "mailbox", ...), for logs and the command line
+	const char* presentModeName(VkPresentModeKHR presentMode);
+	// the reverse of presentModeName; std::nullopt for an unknown name
+	std::optional<VkPresentModeKHR> presentModeFromName(const std::string& name);
+
+	class ZSwapChain : public ZRenderTarget
 	{
 	public:
-		// how many frames should be processed concurrently
-		static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+		// upper bound of SwapChainSettings::framesInFlight; per-frame resources can be sized for this many frames
+		static constexpr int MAX_FRAMES_IN_FLIGHT = 4;
 
-		ZSwapChain(ZDevice& deviceRef);
-		ZSwapChain(ZDevice& deviceRef, std::shared_ptr<ZSwapChain> previous);
-		~ZSwapChain();
+		ZSwapChain(ZDevice& deviceRef, const SwapChainSettings& settings = {});
+		ZSwapChain(ZDevice& deviceRef, const SwapChainSettings& settings, std::shared_ptr<ZSwapChain> previous);
+		~ZSwapChain() override;
 
 		ZSwapChain(const ZSwapChain&) = delete;
 		ZSwapChain& operator=(const ZSwapChain&) = delete;
 
-		VkFramebuffer getFrameBuffer(int index) { return m_swapChainFramebuffers[index]; }
-		VkRenderPass getRenderPass() { return m_VkRenderPass; }
-		VkImageView getImageView(int index) { return m_swapChainImageViews[index]; }
+		VkFramebuffer getFrameBuffer(int index) override { return m_swapChainFramebuffers[index]; }
+		VkRenderPass getRenderPass() override { return m_VkRenderPass; }
+		VkImageView getImageView(int index) override { return m_swapChainImageViews[index]; }
+		VkImage getImage(int index) override { return m_swapChainImages[index]; }
+		VkImage getDepthImage(int index) override { return m_depthImages[index]; }
+		VkImageView getDepthImageView(int index) override { return m_depthImageViews[index]; }
 
 		// this count will likely be 2 (for double buffering) or 3 (for triple buffering)
-		size_t imageCount() { return m_swapChainImages.size(); }
+		size_t imageCount() override { return m_swapChainImages.size(); }
+		uint32_t framesInFlight() const override { return m_settings.framesInFlight; }
+		VkPresentModeKHR getPresentMode() const { return m_presentMode; }
 
-		VkFormat getSwapChainImageFormat() { return m_swapChainImageFormat; }
-		VkExtent2D getSwapChainExtent() { return m_swapChainExtent; }
+		VkFormat getColorFormat() override { return m_swapChainImageFormat; }
+		VkFormat getDepthFormat() override { return m_swapChainDepthFormat; }
+		VkExtent2D getExtent() override { return m_swapChainExtent; }
 		uint32_t width() { return m_swapChainExtent.width; }
 		uint32_t height() { return m_swapChainExtent.height; }
-
-		float extentAspectRatio()
-		{
-			return static_cast<float>(m_swapChainExtent.width) / static_cast<float>(m_swapChainExtent.height);
-		}
+		VkImageLayout getFinalColorLayout() const override { return VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; }
+		bool supportsTransferSrc() const override { return m_supportsTransferSrc; }
 
 		VkFormat findDepthFormat();
 
 		// this function fetches the index of the next available image that your application should render to
 		// it also handles CPU-GPU sync 
-		VkResult acquireNextImage(uint32_t* imageIndex);
-		VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex);
+		VkResult acquireNextImage(uint32_t* imageIndex) override;
+		// also presents the image
+		VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex,
+		                              uint64_t frameValue) override;
+
+		// the id of the last present, or 0; only counts up if the device supports present wait
+		uint64_t lastPresentId() const { return m_lastPresentId; }
+		// wait until the present with this id is on screen (or timeout nanoseconds pass); needs present wait
+		VkResult waitForPresent(uint64_t presentId, uint64_t timeout);
 
 		bool compareSwapFormats(const ZSwapChain& swapChain) const
 		{
@@ -54,19 +81,27 @@ namespace ZZX
 		void createRenderPass();
 		void createFramebuffers();
 		void createSyncObjects();
+		// take over the old swap chain's depth images if they are large enough and not much too large
+		bool adoptDepthResources();
 
 		// Helper functions
 		VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
 		VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
 		VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
 
+		SwapChainSettings m_settings;
+		VkPresentModeKHR m_presentMode;
+
 		VkFormat m_swapChainImageFormat;
 		VkFormat m_swapChainDepthFormat;
 		VkExtent2D m_swapChainExtent;
+		bool m_supportsTransferSrc = false;
 
 		std::vector<VkFramebuffer> m_swapChainFramebuffers;
 		VkRenderPass m_VkRenderPass;
 
+		// can be larger than the swap chain extent when adopted from an old swap chain
+		VkExtent2D m_depthExtent{};
 		std::vector<VkImage> m_depthImages;
 		std::vector<VkImageView> m_depthImageViews;
 
@@ -80,16 +115,19 @@ namespace ZZX
 
 		// keep track of the old swap chain for better resizing behavior
 		// (since resources can be reused when you provide the old swap chain when creating a new one)
+		// only set during init(); whoever recreated us keeps it alive until its frames are done
 		std::shared_ptr<ZSwapChain> m_oldSwapChain;
 
 		// signal that an image has been acquired from the swapchain and is ready for rendering
 		std::vector<VkSemaphore> m_imageAvailableSemaphores;
 		// signal that rendering has finished and presentation can happen
 		std::vector<VkSemaphore> m_renderFinishedSemaphores;
-		// make sure only one frame is rendering at a time 
-		std::vector<VkFence> m_inFlightFences;
-
-		// std::vector<VkFence> m_imagesInFlight;
+		// the graphics timeline value of the last frame submitted from each frame slot (0 if none)
+		std::vector<uint64_t> m_frameValues;
+		// the timeline value of the frame that last rendered to each swap chain image (0 if none);
+		// with more frames in flight than images, a frame may acquire an image an older frame still renders to
+		std::vector<uint64_t> m_imageValues;
+		uint64_t m_lastPresentId = 0;
 		size_t m_currentFrame = 0;
 	};
 };
@@ -0,0 +1,147 @@
+﻿#include "pch.h"
+#include "ZSwapChainBenchmark.h"
+
+namespace ZZX
+{
+	// the first frames of a new swap chain compile pipelines and fill the queue, don't count them
+	static constexpr float WARM_UP_SECONDS = 0.5f;
+
+	ZSwapChainBenchmark::ZSwapChainBenchmark(LatencyKind latencyKind, float secondsPerConfig)
+		: m_latencyKind{latencyKind}, m_secondsPerConfig{secondsPerConfig}
+	{
+		for (uint32_t framesInFlight : {1u, 2u, 3u})
+		{
+			for (uint32_t minImageCount : {2u, 3u})
+			{
+				for (VkPresentModeKHR presentMode : {
+					     VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR
+				     })
+				{
+					// FIFO comes after the requested mode, so an unsupported mode falls back to it
+					m_configs.push_back({framesInFlight, minImageCount, {presentMode, VK_PRESENT_MODE_FIFO_KHR}});
+				}
+			}
+		}
+		resetMeasurements();
+	}
+
+	const SwapChainSettings& ZSwapChainBenchmark::getSettings() const
+	{
+		assert(!isFinished() && "benchmark has no settings left");
+		return m_configs[m_currentConfig];
+	}
+
+	void ZSwapChainBenchmark::recordFrame(int frameIndex, Clock::time_point inputTime)
+	{
+		auto now = Clock::now();
+		if (!m_measureStart)
+		{
+			if (std::chrono::duration<float>(now - m_configStart).count() >= WARM_UP_SECONDS)
+			{
+				m_measureStart = now;
+			}
+		}
+		else
+		{
+			m_frameCount++;
+			// acquireNextImage just waited for the timeline value of this slot's previous frame, so that frame is done
+			auto& previousInput = m_inputTimes[frameIndex];
+			if (m_latencyKind == LatencyKind::INPUT_TO_SLOT_REUSE && previousInput)
+			{
+				addLatency(*previousInput, now);
+			}
+		}
+		m_inputTimes[frameIndex] = inputTime;
+	}
+
+	void ZSwapChainBenchmark::recordPresent(uint64_t presentId, Clock::time_point inputTime)
+	{
+		assert(m_latencyKind == LatencyKind::INPUT_TO_PRESENT && "presents are only recorded with present wait");
+		if (m_measureStart && presentId != 0)
+		{
+			m_pendingPresents.emplace_back(presentId, inputTime);
+		}
+	}
+
+	void ZSwapChainBenchmark::pollPresents(uint64_t lastPresentId, const std::function<bool(uint64_t)>& isPresented)
+	{
+		assert(m_latencyKind == LatencyKind::INPUT_TO_PRESENT && "presents are only polled with present wait");
+		// ids from a swap chain that has been replaced since can never be waited on
+		if (!m_pendingPresents.empty() && m_pendingPresents.back().first > lastPresentId)
+		{
+			m_pendingPresents.clear();
+		}
+		// a present is done once it or any later one is on screen, so stop at the first that isn't
+		while (!m_pendingPresents.empty() && isPresented(m_pendingPresents.front().first))
+		{
+			addLatency(m_pendingPresents.front().second, Clock::now());
+			m_pendingPresents.pop_front();
+		}
+	}
+
+	bool ZSwapChainBenchmark::isConfigDone() const
+	{
+		return m_measureStart &&
+			std::chrono::duration<float>(Clock::now() - *m_measureStart).count() >= m_secondsPerConfig;
+	}
+
+	void ZSwapChainBenchmark::nextConfig(VkPresentModeKHR presentMode, size_t imageCount)
+	{
+		assert(!isFinished() && "benchmark has no settings left");
+		double seconds = m_measureStart
+			                 ? std::chrono::duration<double>(Clock::now() - *m_measureStart).count()
+			                 : 0.0;
+		m_results.push_back({
+			m_configs[m_currentConfig],
+			presentMode,
+			imageCount,
+			m_frameCount,
+			seconds > 0.0 ? m_frameCount / seconds : 0.0,
+			m_latencySamples > 0 ? m_latencySumMs / m_latencySamples : 0.0,
+			m_maxLatencyMs
+		});
+		m_currentConfig++;
+		resetMeasurements();
+	}
+
+	void ZSwapChainBenchmark::printReport() const
+	{
+		std::cout << "latency: " << (m_latencyKind == LatencyKind::INPUT_TO_PRESENT
+			                             ? "input-to-present"
+			                             : "input-to-slot-reuse (no present wait, not a present latency)") << '\n';
+		std::cout << "frames in flight | min images | requested mode | actual mode  | images |     fps | "
+			"avg latency | max latency\n";
+		for (const auto& result : m_results)
+		{
+			std::printf("%16u | %10u | %14s | %-12s | %6zu | %7.1f | %8.2f ms | %8.2f ms\n",
+			            result.requested.framesInFlight,
+			            result.requested.minImageCount,
+			            presentModeName(result.requested.presentModes.front()),
+			            presentModeName(result.presentMode),
+			            result.imageCount,
+			            result.framesPerSecond,
+			            result.averageLatencyMs,
+			            result.maxLatencyMs);
+		}
+	}
+
+	void ZSwapChainBenchmark::resetMeasurements()
+	{
+		m_configStart = Clock::now();
+		m_measureStart.reset();
+		m_frameCount = 0;
+		m_latencySumMs = 0.0;
+		m_maxLatencyMs = 0.0;
+		m_latencySamples = 0;
+		m_inputTimes.fill(std::nullopt);
+		m_pendingPresents.clear();
+	}
+
+	void ZSwapChainBenchmark::addLatency(Clock::time_point inputTime, Clock::time_point endTime)
+	{
+		double latencyMs = std::chrono::duration<double, std::milli>(endTime - inputTime).count();
+		m_latencySumMs += latencyMs;
+		m_maxLatencyMs = std::max(m_maxLatencyMs, latencyMs);
+		m_latencySamples++;
+	}
+}
@@ -0,0 +1,90 @@
+﻿#pragma once
+
+#include "ZSwapChain.h"
+
+namespace ZZX
+{
+	/**
+	 * Sweeps swap chain settings (frames in flight x image count x present mode) and measures each one.
+	 *
+	 * Every configuration runs for a fixed time after a short warm-up. Throughput is frames per second.
+	 * Latency starts when input is sampled for a frame. With present wait it ends when the frame's present id is
+	 * seen on screen; presents are polled once per frame, so that is up to one loop iteration late. Without it,
+	 * it ends when the CPU gets the frame's slot back (acquireNextImage has waited for its timeline value): that
+	 * includes the frame's GPU work but also the loop and any acquire blocking in between, and says nothing
+	 * about when the image was presented.
+	 */
+	class ZSwapChainBenchmark
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		enum class LatencyKind
+		{
+			// needs present wait; see recordPresent and pollPresents
+			INPUT_TO_PRESENT,
+			// measured by recordFrame
+			INPUT_TO_SLOT_REUSE,
+		};
+
+		struct Result
+		{
+			SwapChainSettings requested;
+			// what the surface actually gave us
+			VkPresentModeKHR presentMode;
+			size_t imageCount;
+			uint32_t frameCount;
+			double framesPerSecond;
+			double averageLatencyMs;
+			double maxLatencyMs;
+		};
+
+		ZSwapChainBenchmark(LatencyKind latencyKind, float secondsPerConfig = 3.f);
+
+		ZSwapChainBenchmark(const ZSwapChainBenchmark&) = delete;
+		ZSwapChainBenchmark& operator=(const ZSwapChainBenchmark&) = delete;
+
+		bool isFinished() const { return m_currentConfig >= m_configs.size(); }
+		LatencyKind getLatencyKind() const { return m_latencyKind; }
+		// the settings the renderer should use right now
+		const SwapChainSettings& getSettings() const;
+
+		// call once a frame has started (acquireNextImage has waited for its slot's timeline value) with the time
+		// input was sampled
+		void recordFrame(int frameIndex, Clock::time_point inputTime);
+		// with INPUT_TO_PRESENT: call once the frame was submitted, with the id it was presented with (0 for none)
+		void recordPresent(uint64_t presentId, Clock::time_point inputTime);
+		// with INPUT_TO_PRESENT: measures every recorded present that is on screen now; isPresented must not block.
+		// lastPresentId is the swap chain's latest id, which starts over when the swap chain is recreated
+		void pollPresents(uint64_t lastPresentId, const std::function<bool(uint64_t)>& isPresented);
+		// true once the current configuration has run long enough; finish it with nextConfig()
+		bool isConfigDone() const;
+		// stores the result of the current configuration and moves on to the next one
+		void nextConfig(VkPresentModeKHR presentMode, size_t imageCount);
+
+		const std::vector<Result>& getResults() const { return m_results; }
+		void printReport() const;
+
+	private:
+		void resetMeasurements();
+		void addLatency(Clock::time_point inputTime, Clock::time_point endTime);
+
+		LatencyKind m_latencyKind;
+		float m_secondsPerConfig;
+		std::vector<SwapChainSettings> m_configs;
+		size_t m_currentConfig = 0;
+		std::vector<Result> m_results;
+
+		Clock::time_point m_configStart;
+		// measurements start after the warm-up
+		std::optional<Clock::time_point> m_measureStart;
+		uint32_t m_frameCount = 0;
+		double m_latencySumMs = 0.0;
+		double m_maxLatencyMs = 0.0;
+		uint32_t m_latencySamples = 0;
+		// when input was sampled for the frame each slot is currently rendering
+		std::array<std::optional<Clock::time_point>, ZSwapChain::MAX_FRAMES_IN_FLIGHT> m_inputTimes;
+		// presents not yet seen on screen, oldest first, with the time input was sampled for them
+		std::deque<std::pair<uint64_t, Clock::time_point>> m_pendingPresents;
+	};
+}
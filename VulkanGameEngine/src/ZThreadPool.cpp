@@ -0,0 +1,56 @@
+﻿#include "pch.h"
+#include "ZThreadPool.h"
+
+namespace ZZX
+{
+	ZThreadPool::ZThreadPool(uint32_t threadCount)
+	{
+		if (threadCount == 0)
+		{
+			// hardware_concurrency() is allowed to return 0 if the value is not computable
+			uint32_t hardwareThreads = std::thread::hardware_concurrency();
+			threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+		}
+
+		m_workers.reserve(threadCount);
+		for (uint32_t i = 0; i < threadCount; i++)
+		{
+			m_workers.emplace_back(&ZThreadPool::workerLoop, this);
+		}
+	}
+
+	ZThreadPool::~ZThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock{m_mutex};
+			m_stopping = true;
+		}
+		m_condition.notify_all();
+
+		// workers drain the remaining jobs before they exit, so no future is left broken
+		for (auto& worker : m_workers)
+		{
+			worker.join();
+		}
+	}
+
+	void ZThreadPool::workerLoop()
+	{
+		while (true)
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock{m_mutex};
+				m_condition.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+				if (m_jobs.empty())
+				{
+					// only reachable when stopping
+					return;
+				}
+				job = std::move(m_jobs.front());
+				m_jobs.pop_front();
+			}
+			job();
+		}
+	}
+}
@@ -0,0 +1,46 @@
+﻿#pragma once
+
+namespace ZZX
+{
+	// a fixed-size pool of worker threads that executes submitted jobs in FIFO order
+	class ZThreadPool
+	{
+	public:
+		// threadCount == 0 means "one worker per hardware thread, minus the main thread"
+		explicit ZThreadPool(uint32_t threadCount = 0);
+		~ZThreadPool();
+
+		// delete copy ctor and assignment to avoid dangling pointer
+		ZThreadPool(const ZThreadPool&) = delete;
+		ZThreadPool& operator=(const ZThreadPool&) = delete;
+
+		// queue a job and return a future that becomes ready once a worker has executed it
+		// exceptions thrown by the job are rethrown from future::get()
+		template <typename F>
+		auto submit(F&& job) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+		{
+			using ResultType = std::invoke_result_t<std::decay_t<F>>;
+			// std::function requires a copyable callable, so the packaged task lives on the heap
+			auto task = std::make_shared<std::packaged_task<ResultType()>>(std::forward<F>(job));
+			std::future<ResultType> result = task->get_future();
+			{
+				std::lock_guard<std::mutex> lock{m_mutex};
+				assert(!m_stopping && "cannot submit jobs to a thread pool that is shutting down");
+				m_jobs.emplace_back([task]() { (*task)(); });
+			}
+			m_condition.notify_one();
+			return result;
+		}
+
+		uint32_t threadCount() const { return static_cast<uint32_t>(m_workers.size()); }
+
+	private:
+		void workerLoop();
+
+		std::vector<std::thread> m_workers;
+		std::deque<std::function<void()>> m_jobs;
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		bool m_stopping = false;
+	};
+}
@@ -0,0 +1,205 @@
+﻿#include "pch.h"
+#include "ZTimeline.h"
+#include "ZCpuProfiler.h"
+
+namespace ZZX
+{
+	ZTimeline::ZTimeline(VkDevice device, bool useTimelineSemaphore)
+		: m_device{device}
+	{
+		if (!useTimelineSemaphore)
+		{
+			return;
+		}
+
+		VkSemaphoreTypeCreateInfo typeInfo{
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+			.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+			.initialValue = 0,
+		};
+		VkSemaphoreCreateInfo semaphoreInfo{
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+			.pNext = &typeInfo,
+		};
+		if (vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &m_semaphore) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create timeline semaphore!");
+		}
+	}
+
+	ZTimeline::~ZTimeline()
+	{
+		// nothing may still signal the semaphore or the fences when they are destroyed
+		waitForValue(m_lastSubmittedValue);
+		if (m_semaphore != VK_NULL_HANDLE)
+		{
+			vkDestroySemaphore(m_device, m_semaphore, nullptr);
+		}
+		for (const auto& [value, fence] : m_pendingFences)
+		{
+			vkDestroyFence(m_device, fence, nullptr);
+		}
+		for (VkFence fence : m_freeFences)
+		{
+			vkDestroyFence(m_device, fence, nullptr);
+		}
+	}
+
+	uint64_t ZTimeline::reserveValue()
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		return ++m_lastReservedValue;
+	}
+
+	void ZTimeline::submit(VkQueue queue, const VkSubmitInfo& submitInfo, uint64_t value)
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		assert(value > m_lastSubmittedValue && value <= m_lastReservedValue &&
+			"timeline values must be reserved and submitted in order");
+
+		VkSubmitInfo info = submitInfo;
+		VkFence fence = VK_NULL_HANDLE;
+		// keep these alive until vkQueueSubmit returns
+		std::vector<VkSemaphore> signalSemaphores;
+		std::vector<uint64_t> signalValues;
+		VkTimelineSemaphoreSubmitInfo timelineInfo{};
+		if (m_semaphore != VK_NULL_HANDLE)
+		{
+			signalSemaphores.assign(submitInfo.pSignalSemaphores,
+			                        submitInfo.pSignalSemaphores + submitInfo.signalSemaphoreCount);
+			signalSemaphores.push_back(m_semaphore);
+			// the values of binary semaphores are ignored, but there must be one per semaphore
+			signalValues.resize(signalSemaphores.size(), 0);
+			signalValues.back() = value;
+
+			timelineInfo = {
+				.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+				.pNext = submitInfo.pNext,
+				.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size()),
+				.pSignalSemaphoreValues = signalValues.data(),
+			};
+			info.pNext = &timelineInfo;
+			info.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+			info.pSignalSemaphores = signalSemaphores.data();
+		}
+		else
+		{
+			fence = acquireFence();
+		}
+
+		if (vkQueueSubmit(queue, 1, &info, fence) != VK_SUCCESS)
+		{
+			if (fence != VK_NULL_HANDLE)
+			{
+				m_freeFences.push_back(fence);
+			}
+			throw std::runtime_error("failed to submit command buffer!");
+		}
+		if (fence != VK_NULL_HANDLE)
+		{
+			m_pendingFences.emplace_back(value, fence);
+		}
+		m_lastSubmittedValue = value;
+	}
+
+	uint64_t ZTimeline::completedValue()
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		if (m_semaphore != VK_NULL_HANDLE)
+		{
+			vkGetSemaphoreCounterValue(m_device, m_semaphore, &m_completedValue);
+		}
+		else
+		{
+			retireCompletedFences();
+		}
+		return m_completedValue;
+	}
+
+	uint64_t ZTimeline::lastSubmittedValue() const
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		return m_lastSubmittedValue;
+	}
+
+	void ZTimeline::waitForValue(uint64_t value)
+	{
+		if (value <= completedValue())
+		{
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock{m_mutex};
+			// a value that was reserved but not submitted would never be signaled, and vkWaitSemaphores would hang
+			assert(value <= m_lastSubmittedValue && "cannot wait for a value that was never submitted");
+		}
+		// only the waits that actually block show up in traces
+		ZZX_PROFILE_SCOPE("wait for GPU");
+
+		if (m_semaphore != VK_NULL_HANDLE)
+		{
+			VkSemaphoreWaitInfo waitInfo{
+				.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+				.semaphoreCount = 1,
+				.pSemaphores = &m_semaphore,
+				.pValues = &value,
+			};
+			// disable the timeout
+			vkWaitSemaphores(m_device, &waitInfo, std::numeric_limits<uint64_t>::max());
+			return;
+		}
+
+		VkFence fence = VK_NULL_HANDLE;
+		{
+			std::lock_guard<std::mutex> lock{m_mutex};
+			// values complete in submission order, so the first pending submission at or past value is enough
+			for (const auto& [pendingValue, pendingFence] : m_pendingFences)
+			{
+				if (pendingValue >= value)
+				{
+					fence = pendingFence;
+					break;
+				}
+			}
+			if (fence == VK_NULL_HANDLE)
+			{
+				return;
+			}
+			// waiting on a fence while another thread resets it is not allowed, so wait under the lock
+			vkWaitForFences(m_device, 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+			retireCompletedFences();
+		}
+	}
+
+	void ZTimeline::retireCompletedFences()
+	{
+		while (!m_pendingFences.empty() && vkGetFenceStatus(m_device, m_pendingFences.front().second) == VK_SUCCESS)
+		{
+			auto [value, fence] = m_pendingFences.front();
+			m_pendingFences.pop_front();
+			vkResetFences(m_device, 1, &fence);
+			m_freeFences.push_back(fence);
+			m_completedValue = value;
+		}
+	}
+
+	VkFence ZTimeline::acquireFence()
+	{
+		if (!m_freeFences.empty())
+		{
+			VkFence fence = m_freeFences.back();
+			m_freeFences.pop_back();
+			return fence;
+		}
+
+		VkFenceCreateInfo fenceInfo{
+			.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+		};
+		VkFence fence;
+		if (vkCreateFence(m_device, &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create fence!");
+		}
+		return fence;
+	}
+}
@@ -0,0 +1,54 @@
+﻿#pragma once
+
+namespace ZZX
+{
+	/**
+	 * A monotonic counter of the work submitted to one queue.
+	 *
+	 * Every submission that goes through submit() signals the value it was given once the GPU finishes it,
+	 * so "has frame N / this upload / this readback completed" is a single comparison against completedValue().
+	 * Values are handed out by reserveValue() and must be submitted in the order they were reserved.
+	 *
+	 * With Vulkan 1.2 timeline semaphores the counter is a VkSemaphore; otherwise it is emulated with one
+	 * fence per submission, which callers don't see. All member functions may be called from any thread.
+	 */
+	class ZTimeline
+	{
+	public:
+		ZTimeline(VkDevice device, bool useTimelineSemaphore);
+		~ZTimeline();
+
+		ZTimeline(const ZTimeline&) = delete;
+		ZTimeline& operator=(const ZTimeline&) = delete;
+
+		// the value the next submission will signal
+		uint64_t reserveValue();
+		// submit to queue and signal value once the submitted work completes; submitInfo may already signal
+		// binary semaphores of its own
+		void submit(VkQueue queue, const VkSubmitInfo& submitInfo, uint64_t value);
+
+		// everything that signals this value or a smaller one has completed
+		uint64_t completedValue();
+		// the largest value submitted so far; waiting for it drains the queue
+		uint64_t lastSubmittedValue() const;
+		// block until value has completed (0 and already completed values return immediately)
+		void waitForValue(uint64_t value);
+
+	private:
+		// fence emulation: poll the fences of pending submissions in order
+		void retireCompletedFences();
+		VkFence acquireFence();
+
+		VkDevice m_device;
+		// VK_NULL_HANDLE when emulated with fences
+		VkSemaphore m_semaphore = VK_NULL_HANDLE;
+
+		mutable std::mutex m_mutex;
+		uint64_t m_lastReservedValue = 0;
+		uint64_t m_lastSubmittedValue = 0;
+		uint64_t m_completedValue = 0;
+		// fence emulation: submissions that may still run, oldest first, and fences ready for reuse
+		std::deque<std::pair<uint64_t, VkFence>> m_pendingFences;
+		std::vector<VkFence> m_freeFences;
+	};
+}
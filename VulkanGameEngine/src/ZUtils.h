@@ -9,4 +9,97 @@ namespace ZZX
 		seed ^= std::hash<T>{}(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
 		(hashCombine(seed, rest), ...);
 	};
+
+	// 64-bit FNV-1a over a block of memory (stable across runs, unlike std::hash)
+	inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull)
+	{
+		const auto* bytes = static_cast<const unsigned char*>(data);
+		uint64_t hash = seed;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	// fixed-width lowercase hex, e.g. for naming files after a hash
+	inline std::string toHexString(uint64_t value)
+	{
+		static constexpr char digits[] = "0123456789abcdef";
+		std::string hex(16, '0');
+		for (int i = 15; i >= 0; i--)
+		{
+			hex[i] = digits[value & 0xf];
+			value >>= 4;
+		}
+		return hex;
+	}
+
+	// a JSON string literal, quotes included
+	inline std::string toJsonString(std::string_view text)
+	{
+		std::string json = "\"";
+		for (char c : text)
+		{
+			switch (c)
+			{
+			case '"': json += "\\\""; break;
+			case '\\': json += "\\\\"; break;
+			case '\n': json += "\\n"; break;
+			case '\t': json += "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20)
+				{
+					json += "\\u00" + toHexString(static_cast<unsigned char>(c)).substr(14);
+				}
+				else
+				{
+					json += c;
+				}
+			}
+		}
+		return json + "\"";
+	}
+
+	// nearest-rank percentile (fraction in [0, 1]) of sorted samples; 0 if there are none
+	inline double percentile(const std::vector<double>& sorted, double fraction)
+	{
+		if (sorted.empty())
+		{
+			return 0.0;
+		}
+		size_t rank = static_cast<size_t>(std::ceil(fraction * static_cast<double>(sorted.size())));
+		return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+	}
+
+	// the value after a command line option, e.g. "3" of "--frames-in-flight 3"; i is moved onto it
+	inline std::string nextArgument(int argc, char** argv, int& i)
+	{
+		if (i + 1 >= argc)
+		{
+			throw std::runtime_error(std::string{"missing value for "} + argv[i]);
+		}
+		return argv[++i];
+	}
+
+	// a whole number that fits 32 bits and is at least minimum; anything else is rejected with the option's name
+	inline uint32_t parseCount(int argc, char** argv, int& i, uint32_t minimum = 0)
+	{
+		std::string option = argv[i];
+		std::string value = nextArgument(argc, argv, i);
+		uint32_t count = 0;
+		auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), count);
+		if (value.empty() || error != std::errc{} || end != value.data() + value.size() || count < minimum)
+		{
+			throw std::runtime_error("invalid value for " + option + ": " + value + " (expected a whole number from " +
+				std::to_string(minimum) + " to " + std::to_string(std::numeric_limits<uint32_t>::max()) + ")");
+		}
+		return count;
+	}
+
+	inline double parseNumber(int argc, char** argv, int& i)
+	{
+		return std::stod(nextArgument(argc, argv, i));
+	}
 }
@@ -3,16 +3,35 @@
 
 namespace ZZX
 {
-	ZWindow::ZWindow(int w, int h, const std::string& name)
+	ZWindow::ZWindow(int w, int h, const std::string& name, bool headless)
 		: m_width(w), m_height(h), m_name(name)
 	{
-		initWindow();
+		// without a window there is no need for GLFW at all, which also works on machines without a display
+		if (!headless)
+		{
+			initWindow();
+		}
 	}
 
 	ZWindow::~ZWindow()
 	{
-		glfwDestroyWindow(m_window);
-		glfwTerminate();
+		if (!isHeadless())
+		{
+			glfwDestroyWindow(m_window);
+			glfwTerminate();
+		}
+	}
+
+	void ZWindow::setShouldClose()
+	{
+		if (isHeadless())
+		{
+			m_shouldClose = true;
+		}
+		else
+		{
+			glfwSetWindowShouldClose(m_window, GLFW_TRUE);
+		}
 	}
 
 	void ZWindow::initWindow()
@@ -32,6 +51,7 @@ namespace ZZX
 
 	void ZWindow::createWindowSurface(VkInstance instance, VkSurfaceKHR* surface)
 	{
+		assert(!isHeadless() && "a headless window has no surface");
 		if (glfwCreateWindowSurface(instance, m_window, nullptr, surface) != VK_SUCCESS)
 		{
 			throw std::runtime_error("failed to create window surface!");
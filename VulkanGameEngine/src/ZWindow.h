@@ -5,17 +5,21 @@ namespace ZZX
 	class ZWindow
 	{
 	public:
-		ZWindow(int w, int h, const std::string& name);
+		// a headless window has a size but no GLFW window behind it, so there is nothing to present to
+		ZWindow(int w, int h, const std::string& name, bool headless = false);
 		~ZWindow();
 
 		// delete copy ctor and assignment to avoid dangling pointer
 		ZWindow(const ZWindow&) = delete;
 		ZWindow& operator=(const ZWindow&) = delete;
 
-		bool shouldClose() { return glfwWindowShouldClose(m_window); }
+		bool isHeadless() const { return m_window == nullptr; }
+		bool shouldClose() { return isHeadless() ? m_shouldClose : glfwWindowShouldClose(m_window); }
+		void setShouldClose();
 		VkExtent2D getExtent() { return {static_cast<uint32_t>(m_width), static_cast<uint32_t>(m_height)}; }
 		bool wasWindowResized() { return m_framebufferResized; }
 		void resetWindowResizedFlag() { m_framebufferResized = false; }
+		// nullptr when headless
 		GLFWwindow* getGLFWWindow() const { return m_window; }
 		void createWindowSurface(VkInstance instance, VkSurfaceKHR* surface);
 	private:
@@ -30,9 +34,11 @@ namespace ZZX
 
 		// a flag to signal the window size is changed
 		bool m_framebufferResized = false;
+		// only used when headless
+		bool m_shouldClose = false;
 
 		std::string m_name;
 
-		GLFWwindow* m_window;
+		GLFWwindow* m_window = nullptr;
 	};
 }
@@ -1,12 +1,149 @@
 #include "pch.h"
 #include "FirstApp.h"
+#include "ZUtils.h"
 
-int main()
+static ZZX::AppOptions parseOptions(int argc, char** argv)
 {
-	ZZX::FirstApp app{};
+	ZZX::AppOptions options{};
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--compare-fp16")
+		{
+			options.compareFp16 = true;
+		}
+		else if (arg == "--frames-in-flight")
+		{
+			options.swapChain.framesInFlight = ZZX::parseCount(argc, argv, i);
+		}
+		else if (arg == "--min-images")
+		{
+			options.swapChain.minImageCount = ZZX::parseCount(argc, argv, i);
+		}
+		else if (arg == "--present-mode" && i + 1 < argc)
+		{
+			auto presentMode = ZZX::presentModeFromName(argv[++i]);
+			if (!presentMode)
+			{
+				throw std::runtime_error(std::string{"unknown present mode "} + argv[i]);
+			}
+			// fall back to FIFO if the surface doesn't support the requested mode
+			options.swapChain.presentModes = {*presentMode, VK_PRESENT_MODE_FIFO_KHR};
+		}
+		else if (arg == "--benchmark-swapchain")
+		{
+			options.benchmarkSwapChain = true;
+		}
+		else if (arg == "--low-latency")
+		{
+			options.lowLatency = true;
+		}
+		else if (arg == "--fps-limit")
+		{
+			options.maxFramesPerSecond = ZZX::parseCount(argc, argv, i);
+		}
+		else if (arg == "--headless")
+		{
+			options.headless = true;
+		}
+		else if (arg == "--resolution" && i + 1 < argc)
+		{
+			// e.g. "1280x720"
+			std::string resolution = argv[++i];
+			size_t separator = resolution.find('x');
+			if (separator == std::string::npos)
+			{
+				throw std::runtime_error("resolution must look like 1280x720, not " + resolution);
+			}
+			options.width = static_cast<uint32_t>(std::stoul(resolution.substr(0, separator)));
+			options.height = static_cast<uint32_t>(std::stoul(resolution.substr(separator + 1)));
+		}
+		else if (arg == "--frames")
+		{
+			options.frameCount = ZZX::parseCount(argc, argv, i);
+		}
+		else if (arg == "--scene" && i + 1 < argc)
+		{
+			options.scene = argv[++i];
+		}
+		else if (arg == "--grid-size")
+		{
+			options.gridSize = ZZX::parseCount(argc, argv, i);
+		}
+		else if (arg == "--objects")
+		{
+			options.syntheticScene.objectCount = ZZX::parseCount(argc, argv, i);
+		}
+		else if (arg == "--models")
+		{
+			options.syntheticScene.modelCount = ZZX::parseCount(argc, argv, i);
+		}
+		else if (arg == "--lights")
+		{
+			options.syntheticScene.lightCount = ZZX::parseCount(argc, argv, i);
+		}
+		else if (arg == "--static-fraction" && i + 1 < argc)
+		{
+			options.syntheticScene.staticFraction = std::stof(argv[++i]);
+		}
+		else if (arg == "--seed")
+		{
+			options.syntheticScene.seed = ZZX::parseCount(argc, argv, i);
+		}
+		else if (arg == "--camera-path" && i + 1 < argc)
+		{
+			options.cameraPath = argv[++i];
+		}
+		else if (arg == "--serial-recording")
+		{
+			options.serialRecording = true;
+		}
+		else if (arg == "--cache-static")
+		{
+			options.cacheStaticObjects = true;
+		}
+		else if (arg == "--gpu-profile" && i + 1 < argc)
+		{
+			options.gpuProfilePath = argv[++i];
+		}
+		else if (arg == "--pipeline-stats")
+		{
+			options.pipelineStatistics = true;
+		}
+		else if (arg == "--capture" && i + 1 < argc)
+		{
+			options.capturePath = argv[++i];
+		}
+		else if (arg == "--capture-frames")
+		{
+			options.captureFrameCount = ZZX::parseCount(argc, argv, i);
+		}
+		else if (arg == "--trace" && i + 1 < argc)
+		{
+			options.tracePath = argv[++i];
+		}
+		else if (arg == "--no-render-graph")
+		{
+			options.useRenderGraph = false;
+		}
+		else if (arg == "--dump-frame")
+		{
+			// may be given more than once
+			options.dumpFrames.push_back(ZZX::parseCount(argc, argv, i));
+		}
+		else
+		{
+			throw std::runtime_error("unknown option " + arg);
+		}
+	}
+	return options;
+}
 
+int main(int argc, char** argv)
+{
 	try
 	{
+		ZZX::FirstApp app{parseOptions(argc, argv)};
 		app.run();
 	}
 	// catch standard exception types
@@ -3,7 +3,9 @@
 // std
 #include <iostream>
 #include <fstream>
+#include <iomanip>
 #include <array>
+#include <span>
 #include <chrono>
 #include <string>
 #include <functional>
@@ -11,6 +13,7 @@
 
 #include <cassert>
 #include <cstring>
+#include <cmath>
 
 #include <stdexcept>
 #include <memory>
@@ -24,6 +27,19 @@
 #include <iostream>
 #include <optional>
 
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <atomic>
+#include <deque>
+#include <type_traits>
+#include <filesystem>
+#include <algorithm>
+#include <numeric>
+#include <charconv>
+#include <random>
+
 // libs
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -0,0 +1,161 @@
+﻿#include "pch.h"
+#include "FirstApp.h"
+#include "ZToolReport.h"
+
+// renders a synthetic scene for a fixed number of frames, and reports frame times and memory as percentiles in
+// JSON; given a baseline (an earlier report), it flags every percentile that got worse than the tolerance allows.
+// stdout is only the report: everything else, the app's own output included, goes to stderr
+namespace ZZX
+{
+	// the percentiles a regression is judged on; averages and maxima are reported but too noisy to gate on
+	static const std::vector<std::string> GATED_STATS{"p50", "p95", "p99"};
+
+	struct BenchmarkOptions
+	{
+		AppOptions app{};
+		// frames rendered before measuring starts, while pipelines compile and caches warm up
+		uint32_t warmupFrames = 60;
+		uint32_t measuredFrames = 600;
+		std::string outputPath;
+		BaselineOptions baseline{"tools/benchmark/baseline.json"};
+	};
+
+	static ReportEntry summarize(const std::string& name, std::vector<double> samples, uint32_t skipped)
+	{
+		samples.erase(samples.begin(), samples.begin() + std::min<size_t>(skipped, samples.size()));
+		return summarizeSamples(name, std::move(samples));
+	}
+
+	// the metrics in the order they are reported; empty sample sets (e.g. no timestamps) are left out
+	static std::vector<ReportEntry> summarize(const RunStats& stats, uint32_t warmupFrames)
+	{
+		std::vector<ReportEntry> metrics;
+		auto add = [&](const char* name, const std::vector<double>& samples)
+		{
+			if (samples.size() > warmupFrames)
+			{
+				metrics.push_back(summarize(name, samples, warmupFrames));
+			}
+		};
+		add("cpuFrameMs", stats.frameMs);
+		add("cpuRecordingMs", stats.recordingMs);
+		// lags a few frames behind, which doesn't matter over hundreds of them
+		add("gpuFrameMs", stats.gpuFrameMs);
+		add("deviceMemoryMiB", stats.deviceMemoryMiB);
+		return metrics;
+	}
+
+	static std::string configJson(const BenchmarkOptions& options)
+	{
+		const SceneParams& scene = options.app.syntheticScene;
+		std::ostringstream out;
+		out << "{\"objects\": " << scene.objectCount << ", \"models\": " << scene.modelCount
+			<< ", \"lights\": " << scene.lightCount << ", \"staticFraction\": " << scene.staticFraction
+			<< ", \"seed\": " << scene.seed << ", \"cameraPath\": " << toJsonString(options.app.cameraPath)
+			<< ", \"frames\": " << options.measuredFrames << ", \"headless\": "
+			<< (options.app.headless ? "true" : "false") << "}";
+		return out.str();
+	}
+}
+
+static ZZX::BenchmarkOptions parseOptions(int argc, char** argv)
+{
+	ZZX::BenchmarkOptions options{};
+	options.app.scene = "synthetic";
+	options.app.cameraPath = "orbit";
+	options.app.headless = true;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--objects")
+		{
+			options.app.syntheticScene.objectCount = ZZX::parseCount(argc, argv, i);
+		}
+		else if (arg == "--models")
+		{
+			options.app.syntheticScene.modelCount = ZZX::parseCount(argc, argv, i);
+		}
+		else if (arg == "--lights")
+		{
+			options.app.syntheticScene.lightCount = ZZX::parseCount(argc, argv, i);
+		}
+		else if (arg == "--static-fraction" && i + 1 < argc)
+		{
+			options.app.syntheticScene.staticFraction = std::stof(argv[++i]);
+		}
+		else if (arg == "--seed")
+		{
+			options.app.syntheticScene.seed = ZZX::parseCount(argc, argv, i);
+		}
+		else if (arg == "--camera-path" && i + 1 < argc)
+		{
+			options.app.cameraPath = argv[++i];
+		}
+		else if (arg == "--frames")
+		{
+			options.measuredFrames = ZZX::parseCount(argc, argv, i);
+		}
+		else if (arg == "--warmup")
+		{
+			options.warmupFrames = ZZX::parseCount(argc, argv, i);
+		}
+		else if (arg == "--windowed")
+		{
+			options.app.headless = false;
+		}
+		else if (arg == "--width")
+		{
+			options.app.width = ZZX::parseCount(argc, argv, i);
+		}
+		else if (arg == "--height")
+		{
+			options.app.height = ZZX::parseCount(argc, argv, i);
+		}
+		else if (arg == "--serial-recording")
+		{
+			options.app.serialRecording = true;
+		}
+		else if (arg == "--cache-static")
+		{
+			options.app.cacheStaticObjects = true;
+		}
+		else if (arg == "--output" && i + 1 < argc)
+		{
+			options.outputPath = argv[++i];
+		}
+		else if (!options.baseline.parseOption(arg, argc, argv, i))
+		{
+			throw std::runtime_error("unknown option " + arg);
+		}
+	}
+	options.app.frameCount = options.warmupFrames + options.measuredFrames;
+	return options;
+}
+
+int main(int argc, char** argv)
+{
+	try
+	{
+		ZZX::BenchmarkOptions options = parseOptions(argc, argv);
+		std::optional<ZZX::Report> baseline = ZZX::readBaseline(options.baseline);
+
+		std::vector<ZZX::ReportEntry> metrics;
+		{
+			// the app reports shaders, pipelines and GPU times as it goes, which would end up in the report
+			ZZX::CoutToCerr redirect{};
+			ZZX::FirstApp app{options.app};
+			app.run();
+			metrics = ZZX::summarize(app.getRunStats(), options.warmupFrames);
+		}
+		return ZZX::finishReport(ZZX::configJson(options), "metrics", metrics, options.outputPath, baseline,
+		                         options.baseline, ZZX::GATED_STATS);
+	}
+	// catch standard exception types
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,231 @@
+﻿#pragma once
+
+#include "ZUtils.h"
+
+#include <regex>
+#include <sstream>
+
+// the JSON reports of the benchmark tools, and comparing one against a baseline (an earlier report)
+namespace ZZX
+{
+	// a named set of numbers, e.g. a metric and its percentiles
+	struct ReportEntry
+	{
+		std::string name;
+		std::vector<std::pair<std::string, double>> values;
+	};
+
+	// average, percentiles and maximum of a set of samples, e.g. frame times
+	inline ReportEntry summarizeSamples(const std::string& name, std::vector<double> samples)
+	{
+		std::ranges::sort(samples);
+		double sum = std::accumulate(samples.begin(), samples.end(), 0.0);
+		return {
+			name,
+			{
+				{"average", samples.empty() ? 0.0 : sum / samples.size()},
+				{"p50", percentile(samples, 0.5)},
+				{"p95", percentile(samples, 0.95)},
+				{"p99", percentile(samples, 0.99)},
+				{"max", samples.empty() ? 0.0 : samples.back()},
+			}
+		};
+	}
+
+	// what writeReport wrote: the config as its JSON text, and every entry's numbers
+	struct Report
+	{
+		std::string config;
+		std::map<std::string, std::map<std::string, double>> entries;
+	};
+
+	// sends everything written to std::cout to std::cerr instead, for as long as it lives, so that stdout stays the
+	// report while the engine runs
+	class CoutToCerr
+	{
+	public:
+		CoutToCerr() : m_coutBuffer{std::cout.rdbuf(std::cerr.rdbuf())}
+		{
+		}
+
+		~CoutToCerr() { std::cout.rdbuf(m_coutBuffer); }
+
+		CoutToCerr(const CoutToCerr&) = delete;
+		CoutToCerr& operator=(const CoutToCerr&) = delete;
+
+	private:
+		std::streambuf* m_coutBuffer;
+	};
+
+	// --compare [path] and --tolerance
+	struct BaselineOptions
+	{
+		// where the tool's reference report is kept; --compare without a path compares against it
+		std::string defaultPath;
+		// empty unless --compare was given
+		std::string path;
+		// how much worse than the baseline a number may get before it counts as a regression
+		double tolerance = 0.1;
+
+		// consumes arg (and its value) if it is one of the baseline options
+		bool parseOption(const std::string& arg, int argc, char** argv, int& i)
+		{
+			if (arg == "--compare")
+			{
+				// the path is optional
+				path = i + 1 < argc && !std::string{argv[i + 1]}.starts_with("--") ? argv[++i] : defaultPath;
+				return true;
+			}
+			if (arg == "--tolerance")
+			{
+				tolerance = parseNumber(argc, argv, i);
+				return true;
+			}
+			return false;
+		}
+	};
+
+	// {"config": configJson, section: {name: {value: number, ...}, ...}}, with every entry on a line of its own,
+	// which is what readReport relies on
+	inline void writeReport(std::ostream& out, const std::string& configJson, const std::string& section,
+	                        const std::vector<ReportEntry>& entries)
+	{
+		auto flags = out.flags();
+		out << std::fixed << std::setprecision(4);
+		out << "{\n\t\"config\": " << configJson << ",\n\t\"" << section << "\": {";
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			out << (i == 0 ? "\n" : ",\n") << "\t\t\"" << entries[i].name << "\": {";
+			for (size_t j = 0; j < entries[i].values.size(); j++)
+			{
+				const auto& [name, value] = entries[i].values[j];
+				out << (j == 0 ? "" : ", ") << '"' << name << "\": ";
+				// counts stay integers
+				if (value == std::floor(value) && std::abs(value) < 1e15)
+				{
+					out << static_cast<int64_t>(value);
+				}
+				else
+				{
+					out << value;
+				}
+			}
+			out << "}";
+		}
+		out << "\n\t}\n}\n";
+		out.flags(flags);
+	}
+
+	inline Report readReport(const std::string& filepath)
+	{
+		std::ifstream file{filepath};
+		if (!file)
+		{
+			throw std::runtime_error("failed to open baseline " + filepath + "!");
+		}
+		std::string text{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+
+		Report report{};
+		// reports are flat: every object is one level deep, on one line
+		static const std::regex objectPattern{R"re("([\w.]+)": (\{[^{}]*\}))re"};
+		static const std::regex numberPattern{R"re("(\w+)": (-?[0-9.eE+-]+))re"};
+		for (auto it = std::sregex_iterator{text.begin(), text.end(), objectPattern}; it != std::sregex_iterator{};
+		     ++it)
+		{
+			std::string name = (*it)[1];
+			std::string body = (*it)[2];
+			if (name == "config")
+			{
+				report.config = body;
+				continue;
+			}
+			for (auto number = std::sregex_iterator{body.begin(), body.end(), numberPattern};
+			     number != std::sregex_iterator{}; ++number)
+			{
+				report.entries[name][(*number)[1]] = std::stod((*number)[2]);
+			}
+		}
+		if (report.entries.empty())
+		{
+			throw std::runtime_error("baseline " + filepath + " has no entries!");
+		}
+		return report;
+	}
+
+	// the report --compare names, if it was given; read it before the run, so a bad baseline doesn't cost a
+	// whole run
+	inline std::optional<Report> readBaseline(const BaselineOptions& options)
+	{
+		if (options.path.empty())
+		{
+			return std::nullopt;
+		}
+		return readReport(options.path);
+	}
+
+	// prints every gated number (where higher is worse) next to the baseline's, to stderr so stdout stays the
+	// report; returns how many regressed
+	inline uint32_t compareReports(const Report& baseline, const BaselineOptions& options,
+	                               const std::string& configJson, const std::vector<ReportEntry>& entries,
+	                               const std::vector<std::string>& gatedValues)
+	{
+		if (baseline.config != configJson)
+		{
+			std::cerr << "Warning: the baseline was measured with a different config:\n\t" << baseline.config
+				<< "\nvs\t" << configJson << '\n';
+		}
+		uint32_t regressionCount = 0;
+		std::cerr << "Compared to " << options.path << " (tolerance " << options.tolerance * 100.0 << "%):\n";
+		for (const ReportEntry& entry : entries)
+		{
+			auto baselineEntry = baseline.entries.find(entry.name);
+			if (baselineEntry == baseline.entries.end())
+			{
+				std::cerr << '\t' << entry.name << ": not in the baseline\n";
+				continue;
+			}
+			for (const auto& [name, value] : entry.values)
+			{
+				auto baselineValue = baselineEntry->second.find(name);
+				if (std::ranges::find(gatedValues, name) == gatedValues.end() ||
+					baselineValue == baselineEntry->second.end())
+				{
+					continue;
+				}
+				double change = baselineValue->second > 0.0 ? value / baselineValue->second - 1.0 : 0.0;
+				bool isRegression = change > options.tolerance;
+				regressionCount += isRegression;
+				std::cerr << '\t' << entry.name << ' ' << name << ": " << value << " vs " << baselineValue->second
+					<< " (" << (change >= 0.0 ? "+" : "") << change * 100.0 << "%)"
+					<< (isRegression ? "  REGRESSION" : "") << '\n';
+			}
+		}
+		return regressionCount;
+	}
+
+	// writes the report to stdout and, if outputPath isn't empty, to that file; then compares it against the
+	// baseline if there is one. Returns the tool's exit code
+	inline int finishReport(const std::string& configJson, const std::string& section,
+	                        const std::vector<ReportEntry>& entries, const std::string& outputPath,
+	                        const std::optional<Report>& baseline, const BaselineOptions& baselineOptions,
+	                        const std::vector<std::string>& gatedValues)
+	{
+		writeReport(std::cout, configJson, section, entries);
+		if (!outputPath.empty())
+		{
+			std::ofstream file{outputPath};
+			if (!file)
+			{
+				throw std::runtime_error("failed to open " + outputPath + "!");
+			}
+			writeReport(file, configJson, section, entries);
+			std::cerr << "Saved " << outputPath << '\n';
+		}
+		if (baseline && compareReports(*baseline, baselineOptions, configJson, entries, gatedValues) > 0)
+		{
+			std::cerr << "Performance regressed\n";
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+}
@@ -0,0 +1,362 @@
+﻿#include "pch.h"
+#include "ZCamera.h"
+#include "ZDescriptors.h"
+#include "ZFrameInfo.h"
+#include "ZModel.h"
+#include "ZToolReport.h"
+#include "Systems/PointLightSystem.h"
+
+// times the engine's CPU hot paths in isolation, without creating a device (nothing here needs a GPU); every case
+// is run in samples of a fixed number of iterations, and the per-item time is reported as the median over samples,
+// with the median absolute deviation to show how stable that is
+namespace ZZX
+{
+	// medians are what a regression is judged on; the other numbers show how far they can be trusted
+	static const std::vector<std::string> GATED_STATS{"medianNs"};
+	// a case whose deviation is more than this share of its median is flagged, as its numbers can't be trusted
+	static constexpr double NOISY_DEVIATION = 0.05;
+
+	struct MicrobenchOptions
+	{
+		// samples measured per case, after the warmup ones
+		uint32_t samples = 31;
+		uint32_t warmupSamples = 5;
+		// every sample runs enough iterations to take at least this long, so the clock's resolution doesn't matter
+		double minSampleMs = 5.0;
+		// only the cases whose name contains this
+		std::string filter;
+		std::string modelDirectory = "assets/models";
+		std::string outputPath;
+		BaselineOptions baseline{"tools/microbench/baseline.json"};
+	};
+
+	// keeps the compiler from optimizing away a result that is never used
+	template <typename T>
+	void doNotOptimize(const T& value)
+	{
+#if defined(_MSC_VER)
+		static_cast<void>(*reinterpret_cast<const volatile char*>(&value));
+#else
+		asm volatile("" : : "r,m"(value) : "memory");
+#endif
+	}
+
+	struct MicrobenchCase
+	{
+		std::string name;
+		// items one iteration handles, e.g. the transforms in a batch; times are reported per item
+		uint32_t itemCount;
+		std::function<void()> iteration;
+	};
+
+	struct CaseStats
+	{
+		uint64_t iterations;
+		uint32_t itemCount;
+		// nanoseconds per item
+		double median;
+		double p95;
+		double min;
+		double deviation;
+	};
+
+	using Clock = std::chrono::steady_clock;
+
+	static double timeSample(const MicrobenchCase& microbenchCase, uint64_t iterations)
+	{
+		auto start = Clock::now();
+		for (uint64_t i = 0; i < iterations; i++)
+		{
+			microbenchCase.iteration();
+		}
+		return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+	}
+
+	static CaseStats measure(const MicrobenchCase& microbenchCase, const MicrobenchOptions& options)
+	{
+		// double the iterations until one sample is long enough; this also warms up caches and allocations
+		uint64_t iterations = 1;
+		while (timeSample(microbenchCase, iterations) < options.minSampleMs * 1e6 && iterations < (1ull << 40))
+		{
+			iterations *= 2;
+		}
+		for (uint32_t i = 0; i < options.warmupSamples; i++)
+		{
+			timeSample(microbenchCase, iterations);
+		}
+
+		std::vector<double> samples;
+		samples.reserve(options.samples);
+		for (uint32_t i = 0; i < options.samples; i++)
+		{
+			samples.push_back(timeSample(microbenchCase, iterations) / (iterations * microbenchCase.itemCount));
+		}
+		std::ranges::sort(samples);
+		double median = percentile(samples, 0.5);
+		std::vector<double> deviations;
+		deviations.reserve(samples.size());
+		for (double sample : samples)
+		{
+			deviations.push_back(std::abs(sample - median));
+		}
+		std::ranges::sort(deviations);
+		return {
+			iterations,
+			microbenchCase.itemCount,
+			median,
+			percentile(samples, 0.95),
+			samples.empty() ? 0.0 : samples.front(),
+			percentile(deviations, 0.5),
+		};
+	}
+
+	// the data the cases work on, generated once from a fixed seed so every run measures the same thing
+	class MicrobenchData
+	{
+	public:
+		static constexpr uint32_t BATCH_SIZE = 1024;
+		// about what the synthetic benchmark scene has around its lights
+		static constexpr uint32_t SCENE_OBJECT_COUNT = 1000;
+
+		explicit MicrobenchData(const std::string& modelDirectory)
+		{
+			std::mt19937 random{1};
+			std::uniform_real_distribution<float> unit{-1.f, 1.f};
+			auto randomVec3 = [&](float range) { return range * glm::vec3{unit(random), unit(random), unit(random)}; };
+
+			for (uint32_t i = 0; i < BATCH_SIZE; i++)
+			{
+				TransformComponent transform{};
+				transform.translation = randomVec3(10.f);
+				transform.scale = glm::vec3{1.f} + randomVec3(0.5f);
+				transform.rotation = randomVec3(glm::pi<float>());
+				transforms.push_back(transform);
+			}
+
+			for (const char* name : {"cube", "colored_cube", "quad", "flat_vase", "smooth_vase"})
+			{
+				std::string filepath = modelDirectory + "/" + name + ".obj";
+				if (!std::filesystem::exists(filepath))
+				{
+					throw std::runtime_error("failed to find " + filepath + "!");
+				}
+				modelPaths.emplace_back(name, filepath);
+			}
+			// real vertices, to hash what loadModel hashes
+			ZModel::Builder vase{};
+			vase.loadModel(modelDirectory + "/smooth_vase.obj");
+			vertices = std::move(vase.vertices);
+
+			for (uint32_t i = 0; i < SCENE_OBJECT_COUNT; i++)
+			{
+				auto obj = ZGameObject::createGameObject();
+				obj.m_transform.translation = randomVec3(10.f);
+				gameObjects.emplace(obj.getId(), std::move(obj));
+			}
+			for (uint32_t i = 0; i < MAX_LIGHTS; i++)
+			{
+				auto pointLight = ZGameObject::makePointLight(0.2f);
+				pointLight.m_transform.translation = randomVec3(5.f);
+				gameObjects.emplace(pointLight.getId(), std::move(pointLight));
+			}
+			camera.setViewYXZ({0.f, -1.f, -8.f}, {-0.2f, 0.3f, 0.f});
+
+			// the global set: the ubo, and a texture as the other common kind of descriptor
+			descriptorBindings[0] = {0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_ALL_GRAPHICS, nullptr};
+			descriptorBindings[1] = {
+				1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr
+			};
+		}
+
+		std::vector<TransformComponent> transforms;
+		std::vector<std::pair<std::string, std::string>> modelPaths;
+		std::vector<ZModel::Vertex> vertices;
+		ZGameObject::Map gameObjects;
+		ZCamera camera;
+		std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> descriptorBindings;
+		VkDescriptorBufferInfo bufferInfo{VK_NULL_HANDLE, 0, sizeof(GlobalUbo)};
+		VkDescriptorImageInfo imageInfo{VK_NULL_HANDLE, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+	};
+
+	static std::vector<MicrobenchCase> makeCases(MicrobenchData& data)
+	{
+		std::vector<MicrobenchCase> cases;
+		cases.push_back({
+			"transform.mat4", MicrobenchData::BATCH_SIZE, [&data]
+			{
+				for (auto& transform : data.transforms)
+				{
+					doNotOptimize(transform.mat4());
+				}
+			}
+		});
+		cases.push_back({
+			"transform.normalMatrix", MicrobenchData::BATCH_SIZE, [&data]
+			{
+				for (auto& transform : data.transforms)
+				{
+					doNotOptimize(transform.normalMatrix());
+				}
+			}
+		});
+		cases.push_back({
+			"camera.setViewYXZ", MicrobenchData::BATCH_SIZE, [&data]
+			{
+				ZCamera camera{};
+				for (const auto& transform : data.transforms)
+				{
+					camera.setViewYXZ(transform.translation, transform.rotation);
+					doNotOptimize(camera);
+				}
+			}
+		});
+		for (const auto& [name, filepath] : data.modelPaths)
+		{
+			cases.push_back({
+				"model.loadModel." + name, 1, [filepath]
+				{
+					ZModel::Builder builder{};
+					builder.loadModel(filepath);
+					doNotOptimize(builder.indices.data());
+				}
+			});
+		}
+		cases.push_back({
+			"vertex.hash", static_cast<uint32_t>(data.vertices.size()), [&data]
+			{
+				std::hash<ZModel::Vertex> hash{};
+				for (const auto& vertex : data.vertices)
+				{
+					doNotOptimize(hash(vertex));
+				}
+			}
+		});
+		cases.push_back({
+			"hashCombine", MicrobenchData::BATCH_SIZE, [&data]
+			{
+				size_t seed = 0;
+				for (uint32_t i = 0; i < MicrobenchData::BATCH_SIZE; i++)
+				{
+					hashCombine(seed, i, data.transforms[i].translation.x);
+				}
+				doNotOptimize(seed);
+			}
+		});
+		cases.push_back({
+			"pointLight.sortLights", 1, [&data]
+			{
+				FrameInfo frameInfo{0, 0.f, VK_NULL_HANDLE, data.camera, VK_NULL_HANDLE, data.gameObjects};
+				doNotOptimize(PointLightSystem::sortLights(frameInfo).data());
+			}
+		});
+		cases.push_back({
+			"descriptorWriter.build", 1, [&data]
+			{
+				ZDescriptorWriter writer{data.descriptorBindings};
+				writer.writeBuffer(0, &data.bufferInfo).writeImage(1, &data.imageInfo);
+				doNotOptimize(writer.getWrites().data());
+			}
+		});
+		return cases;
+	}
+
+	static ReportEntry toReportEntry(const std::string& name, const CaseStats& stats)
+	{
+		return {
+			name,
+			{
+				{"iterations", static_cast<double>(stats.iterations)},
+				{"items", stats.itemCount},
+				{"medianNs", stats.median},
+				{"p95Ns", stats.p95},
+				{"minNs", stats.min},
+				{"deviationNs", stats.deviation},
+			}
+		};
+	}
+
+	static std::string configJson(const MicrobenchOptions& options)
+	{
+		std::ostringstream out;
+		out << "{\"samples\": " << options.samples << ", \"minSampleMs\": " << options.minSampleMs << "}";
+		return out.str();
+	}
+}
+
+static ZZX::MicrobenchOptions parseOptions(int argc, char** argv)
+{
+	ZZX::MicrobenchOptions options{};
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--samples")
+		{
+			options.samples = std::max(1u, ZZX::parseCount(argc, argv, i));
+		}
+		else if (arg == "--warmup")
+		{
+			options.warmupSamples = ZZX::parseCount(argc, argv, i);
+		}
+		else if (arg == "--min-sample-ms")
+		{
+			options.minSampleMs = ZZX::parseNumber(argc, argv, i);
+		}
+		else if (arg == "--filter" && i + 1 < argc)
+		{
+			options.filter = argv[++i];
+		}
+		else if (arg == "--models" && i + 1 < argc)
+		{
+			options.modelDirectory = argv[++i];
+		}
+		else if (arg == "--output" && i + 1 < argc)
+		{
+			options.outputPath = argv[++i];
+		}
+		else if (!options.baseline.parseOption(arg, argc, argv, i))
+		{
+			throw std::runtime_error("unknown option " + arg);
+		}
+	}
+	return options;
+}
+
+int main(int argc, char** argv)
+{
+	try
+	{
+		ZZX::MicrobenchOptions options = parseOptions(argc, argv);
+		std::optional<ZZX::Report> baseline = ZZX::readBaseline(options.baseline);
+
+		std::cerr << std::fixed << std::setprecision(3);
+		ZZX::MicrobenchData data{options.modelDirectory};
+		std::vector<ZZX::ReportEntry> results;
+		for (const auto& microbenchCase : ZZX::makeCases(data))
+		{
+			if (microbenchCase.name.find(options.filter) == std::string::npos)
+			{
+				continue;
+			}
+			ZZX::CaseStats stats = ZZX::measure(microbenchCase, options);
+			// progress goes to stderr, so stdout is only the report
+			std::cerr << microbenchCase.name << ": " << stats.median << " ns";
+			if (stats.deviation > ZZX::NOISY_DEVIATION * stats.median)
+			{
+				std::cerr << " (noisy, +-" << stats.deviation << " ns)";
+			}
+			std::cerr << '\n';
+			results.push_back(ZZX::toReportEntry(microbenchCase.name, stats));
+		}
+
+		return ZZX::finishReport(ZZX::configJson(options), "benchmarks", results, options.outputPath, baseline,
+		                         options.baseline, ZZX::GATED_STATS);
+	}
+	// catch standard exception types
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,348 @@
+﻿#include "pch.h"
+#include "ZCommandCapture.h"
+#include "ZRenderer.h"
+#include "ZDescriptors.h"
+#include "ZBuffer.h"
+#include "ZGpuProfiler.h"
+#include "ZToolReport.h"
+
+// runs a capture written by the engine's --capture again and again on a headless device, and reports how long
+// recording and rendering its frames take, in the same JSON as ZBenchmark; it needs nothing but the capture file.
+// stdout is only the report: everything else goes to stderr
+namespace ZZX
+{
+	// the percentiles a regression is judged on; averages and maxima are reported but too noisy to gate on
+	static const std::vector<std::string> GATED_STATS{"p50", "p95", "p99"};
+
+	struct ReplayOptions
+	{
+		std::string capturePath;
+		// how many times the captured frames are run
+		uint32_t iterations = 100;
+		// runs that aren't measured, so pipelines and caches are warm
+		uint32_t warmupIterations = 2;
+		// also write the report here
+		std::string outputPath;
+		BaselineOptions baseline{"tools/replay/baseline.json"};
+	};
+
+	// a captured pipeline, created with the replay's own registry
+	struct ReplayPipeline
+	{
+		ZPipelineRegistry::PipelineId id;
+		VkPipelineLayout layout;
+		VkShaderStageFlags pushConstantStages;
+	};
+
+	class CaptureReplay
+	{
+	public:
+		CaptureReplay(const ZCommandStream& stream, const ReplayOptions& options)
+			: m_stream{stream}, m_options{options}
+		{
+			m_globalPool = ZDescriptorPool::Builder(m_zDevice)
+			               .setMaxSets(ZSwapChain::MAX_FRAMES_IN_FLIGHT)
+			               .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, ZSwapChain::MAX_FRAMES_IN_FLIGHT)
+			               .build();
+			m_globalSetLayout = ZDescriptorSetLayout::Builder(m_zDevice)
+			                    .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
+			                    .build();
+			for (int i = 0; i < ZSwapChain::MAX_FRAMES_IN_FLIGHT; i++)
+			{
+				m_uboBuffers.push_back(std::make_unique<ZBuffer>(m_zDevice,
+				                                                 sizeof(GlobalUbo),
+				                                                 1,
+				                                                 VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				                                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT));
+				m_uboBuffers.back()->map();
+				auto bufferInfo = m_uboBuffers.back()->descriptorInfo();
+				ZDescriptorWriter(*m_globalSetLayout, *m_globalPool)
+					.writeBuffer(0, &bufferInfo)
+					.build(m_globalDescriptorSets[i]);
+			}
+
+			createPipelines();
+			for (const ZModel::Builder& mesh : m_stream.meshes)
+			{
+				m_models.push_back(std::make_unique<ZModel>(m_zDevice, mesh));
+			}
+			// compiles are not what is measured
+			m_pipelineRegistry.waitIdle();
+		}
+
+		// the report's metrics
+		std::vector<ReportEntry> run()
+		{
+			std::vector<double> recordingMs;
+			std::vector<double> frameMs;
+			uint32_t totalIterations = m_options.warmupIterations + m_options.iterations;
+			for (uint32_t iteration = 0; iteration < totalIterations; iteration++)
+			{
+				bool isMeasured = iteration >= m_options.warmupIterations;
+				for (const ZCommandStream::Frame& frame : m_stream.frames)
+				{
+					auto frameStart = std::chrono::steady_clock::now();
+					VkCommandBuffer commandBuffer = m_zRenderer.beginFrame();
+					if (!commandBuffer)
+					{
+						continue;
+					}
+					int frameIndex = m_zRenderer.getFrameIndex();
+					m_pipelineRegistry.beginFrame();
+					GlobalUbo ubo = frame.ubo;
+					m_uboBuffers[frameIndex]->writeToBuffer(&ubo);
+					m_uboBuffers[frameIndex]->flush();
+
+					auto recordingStart = std::chrono::steady_clock::now();
+					if (isMeasured)
+					{
+						m_gpuProfiler.beginFrame(commandBuffer, frameIndex, m_zRenderer.currentFrameValue());
+					}
+					auto scope = isMeasured
+						             ? m_gpuProfiler.beginScope(commandBuffer, "replay")
+						             : ZGpuProfiler::INVALID_SCOPE;
+					m_zRenderer.beginSwapChainRenderPass(commandBuffer);
+					record(commandBuffer, m_globalDescriptorSets[frameIndex], frame);
+					m_zRenderer.endSwapChainRenderPass(commandBuffer);
+					m_gpuProfiler.endScope(commandBuffer, scope);
+					auto recordingEnd = std::chrono::steady_clock::now();
+
+					m_zRenderer.endFrame();
+					if (isMeasured)
+					{
+						recordingMs.push_back(
+							std::chrono::duration<double, std::milli>(recordingEnd - recordingStart).count());
+						frameMs.push_back(std::chrono::duration<double, std::milli>(
+							std::chrono::steady_clock::now() - frameStart).count());
+					}
+				}
+			}
+			vkDeviceWaitIdle(m_zDevice.device());
+			m_gpuProfiler.resolveFinishedFrames();
+			return summarize(std::move(recordingMs), std::move(frameMs));
+		}
+
+	private:
+		void createPipelines()
+		{
+			// the pipeline compiler loads shaders from files, so the captured SPIR-V is written out first
+			std::filesystem::path shaderDir = std::filesystem::temp_directory_path() / "zzx_replay_shaders";
+			std::filesystem::create_directories(shaderDir);
+			auto writeShader = [&shaderDir](const std::vector<uint32_t>& code)
+			{
+				std::filesystem::path path = shaderDir / (toHexString(
+					hashBytes(code.data(), code.size() * sizeof(uint32_t))) + ".spv");
+				ZShaderModule::writeSpirvFile(path, code);
+				return path.string();
+			};
+
+			for (const ZCommandStream::Pipeline& captured : m_stream.pipelines)
+			{
+				ZShaderReflection reflection{&captured.vertCode, &captured.fragCode};
+				VkPipelineLayout layout = m_pipelineRegistry.getPipelineLayout(reflection,
+				                                                               {{0, m_globalSetLayout.get()}});
+
+				PipelineConfigInfo pipelineConfig{};
+				ZPipeline::defaultPipelineConfigInfo(pipelineConfig);
+				if (captured.alphaBlending)
+				{
+					ZPipeline::enableAlphaBlending(pipelineConfig);
+				}
+				if (!captured.hasVertexInput)
+				{
+					pipelineConfig.attributeDescriptions.clear();
+					pipelineConfig.bindingDescriptions.clear();
+				}
+				ZPipeline::setRenderTarget(pipelineConfig, m_zRenderer.getSwapChainRenderTarget());
+				pipelineConfig.m_VkPipelineLayout = layout;
+
+				PipelineBuildRequest request{
+					std::move(pipelineConfig),
+					writeShader(captured.vertCode),
+					writeShader(captured.fragCode),
+				};
+				request.specialization = captured.specialization;
+				m_pipelines.push_back({
+					m_pipelineRegistry.request(std::move(request)), layout, reflection.getPushConstantStages()
+				});
+			}
+		}
+
+		void record(VkCommandBuffer commandBuffer, VkDescriptorSet globalDescriptorSet,
+		            const ZCommandStream::Frame& frame)
+		{
+			const ReplayPipeline* pipeline = nullptr;
+			ZModel* model = nullptr;
+			ZCommandStream::Reader reader{frame};
+			ZCommandStream::Command command;
+			while (reader.next(command))
+			{
+				switch (command.op)
+				{
+				case CapturedOp::BIND_PIPELINE:
+					pipeline = &m_pipelines.at(command.index);
+					m_pipelineRegistry.bind(pipeline->id, commandBuffer);
+					break;
+				case CapturedOp::BIND_GLOBAL_SET:
+					assert(pipeline && "Capture binds a descriptor set before any pipeline");
+					vkCmdBindDescriptorSets(commandBuffer,
+					                        VK_PIPELINE_BIND_POINT_GRAPHICS,
+					                        pipeline->layout,
+					                        0,
+					                        1,
+					                        &globalDescriptorSet,
+					                        0,
+					                        nullptr);
+					break;
+				case CapturedOp::PUSH_CONSTANTS:
+					assert(pipeline && "Capture pushes constants before any pipeline");
+					vkCmdPushConstants(commandBuffer,
+					                   pipeline->layout,
+					                   pipeline->pushConstantStages,
+					                   0,
+					                   static_cast<uint32_t>(command.pushConstants.size()),
+					                   command.pushConstants.data());
+					break;
+				case CapturedOp::BIND_MODEL:
+					model = m_models.at(command.index).get();
+					model->bind(commandBuffer);
+					break;
+				case CapturedOp::DRAW_MODEL:
+					assert(model && "Capture draws a model before binding one");
+					model->draw(commandBuffer);
+					break;
+				case CapturedOp::DRAW:
+					vkCmdDraw(commandBuffer, command.draw[0], command.draw[1], command.draw[2], command.draw[3]);
+					break;
+				}
+			}
+		}
+
+		std::vector<ReportEntry> summarize(std::vector<double> recordingMs, std::vector<double> frameMs) const
+		{
+			std::cerr << "Replayed " << m_stream.frames.size() << " captured frames " << m_options.iterations
+				<< " times (" << frameMs.size() << " frames, " << m_stream.extent.width << "x"
+				<< m_stream.extent.height << ")\n";
+			std::vector<ReportEntry> metrics{
+				summarizeSamples("cpuFrameMs", std::move(frameMs)),
+				summarizeSamples("cpuRecordingMs", std::move(recordingMs)),
+			};
+			// the only scope is the whole replayed frame
+			if (auto stats = m_gpuProfiler.getStats(); !stats.empty())
+			{
+				const ZGpuProfiler::ScopeStats& gpu = stats.front();
+				metrics.push_back({
+					"gpuFrameMs",
+					{
+						{"average", gpu.averageMs},
+						{"p50", gpu.p50Ms},
+						{"p95", gpu.p95Ms},
+						{"p99", gpu.p99Ms},
+						{"max", gpu.maxMs},
+					}
+				});
+			}
+			else
+			{
+				std::cerr << "GPU timing is not available: the graphics queue cannot write timestamps\n";
+			}
+			return metrics;
+		}
+
+		const ZCommandStream& m_stream;
+		ReplayOptions m_options;
+		ZWindow m_zWindow{
+			static_cast<int>(m_stream.extent.width),
+			static_cast<int>(m_stream.extent.height),
+			"Vulkan Engine Replay",
+			true
+		};
+		ZDevice m_zDevice{m_zWindow};
+		ZRenderer m_zRenderer{m_zWindow, m_zDevice};
+		ZThreadPool m_jobPool{};
+		// kept apart from the app's cache, so a replay never warms up the app (or the other way round)
+		ZPipelineCompiler m_pipelineCompiler{m_zDevice, m_jobPool, "replay_pipeline_cache.bin"};
+		ZPipelineRegistry m_pipelineRegistry{m_zDevice, m_pipelineCompiler};
+		ZGpuProfiler m_gpuProfiler{m_zDevice};
+
+		// note: order of declarations matters
+		std::unique_ptr<ZDescriptorPool> m_globalPool{};
+		std::unique_ptr<ZDescriptorSetLayout> m_globalSetLayout{};
+		std::vector<std::unique_ptr<ZBuffer>> m_uboBuffers;
+		std::array<VkDescriptorSet, ZSwapChain::MAX_FRAMES_IN_FLIGHT> m_globalDescriptorSets{};
+		std::vector<ReplayPipeline> m_pipelines;
+		std::vector<std::unique_ptr<ZModel>> m_models;
+	};
+
+	static std::string configJson(const ReplayOptions& options, const ZCommandStream& stream)
+	{
+		std::ostringstream out;
+		out << "{\"capture\": " << toJsonString(options.capturePath) << ", \"capturedFrames\": "
+			<< stream.frames.size() << ", \"iterations\": " << options.iterations << ", \"width\": "
+			<< stream.extent.width << ", \"height\": " << stream.extent.height << "}";
+		return out.str();
+	}
+}
+
+static ZZX::ReplayOptions parseOptions(int argc, char** argv)
+{
+	ZZX::ReplayOptions options{};
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--iterations")
+		{
+			options.iterations = ZZX::parseCount(argc, argv, i, 1);
+		}
+		else if (arg == "--warmup")
+		{
+			options.warmupIterations = ZZX::parseCount(argc, argv, i);
+		}
+		else if (arg == "--output")
+		{
+			options.outputPath = ZZX::nextArgument(argc, argv, i);
+		}
+		else if (options.capturePath.empty() && !arg.starts_with("--"))
+		{
+			options.capturePath = arg;
+		}
+		else if (!options.baseline.parseOption(arg, argc, argv, i))
+		{
+			throw std::runtime_error("unknown option " + arg);
+		}
+	}
+	if (options.capturePath.empty())
+	{
+		throw std::runtime_error("usage: ZReplay <capture> [--iterations <n>] [--warmup <n>] [--output <path>] "
+			"[--compare [<baseline>]] [--tolerance <fraction>]");
+	}
+	return options;
+}
+
+int main(int argc, char** argv)
+{
+	try
+	{
+		ZZX::ReplayOptions options = parseOptions(argc, argv);
+		std::optional<ZZX::Report> baseline = ZZX::readBaseline(options.baseline);
+		ZZX::ZCommandStream stream = ZZX::ZCommandStream::load(options.capturePath);
+
+		std::vector<ZZX::ReportEntry> metrics;
+		{
+			// the engine reports shaders and pipeline caches as it goes, which would end up in the report
+			ZZX::CoutToCerr redirect{};
+			ZZX::CaptureReplay replay{stream, options};
+			metrics = replay.run();
+		}
+		return ZZX::finishReport(ZZX::configJson(options, stream), "metrics", metrics, options.outputPath, baseline,
+		                         options.baseline, ZZX::GATED_STATS);
+	}
+	// catch standard exception types
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}